@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation, either
+# version 3 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, see <http://www.gnu.org/licenses/>.
+#
+
+# Packs files into a read-only asset bundle (see services/inc/asset_bundle.h). The bundle can
+# optionally be wrapped into a resource module that can be flashed via OTA
+
+import argparse
+import os
+import struct
+import sys
+
+from create_module import Module, ModuleFunction, ModuleFlags, Platform, GEN3_PLATFORMS
+
+ASSET_BUNDLE_MAGIC = 0x31424150 # "PAB1"
+ASSET_BUNDLE_VERSION = 1
+HEADER_FORMAT = '<LHHLLL'
+ENTRY_FORMAT = '<LLLLHH'
+DATA_ALIGNMENT = 4
+
+# Start address and maximum size of the asset bundle region in the external flash
+ASSET_REGION = {
+    Platform.TRACKER: (0x650000, 228 * 1024),
+    Platform.B5SOM: (0x650000, 228 * 1024)
+}
+DEFAULT_ASSET_REGION = (0x250000, 228 * 1024)
+
+def name_hash(name):
+    h = 2166136261
+    for b in name:
+        h = ((h ^ b) * 16777619) & 0xffffffff
+    return h
+
+def align(n):
+    return (n + DATA_ALIGNMENT - 1) // DATA_ALIGNMENT * DATA_ALIGNMENT
+
+def pack(assets):
+    """Packs a list of (name, data) tuples into a bundle"""
+    names = set()
+    for name, _ in assets:
+        if name in names:
+            raise ValueError('Duplicate asset name: %s' % name.decode())
+        if len(name) > 0xffff:
+            raise ValueError('Asset name is too long: %s' % name.decode())
+        names.add(name)
+    assets = sorted(assets, key=lambda a: (name_hash(a[0]), a[0]))
+    header_size = struct.calcsize(HEADER_FORMAT)
+    entry_size = struct.calcsize(ENTRY_FORMAT)
+    strings = b''
+    name_offsets = []
+    offs = header_size + entry_size * len(assets)
+    for name, _ in assets:
+        name_offsets.append(offs + len(strings))
+        strings += name
+    index_size = offs + len(strings)
+    data = b''
+    data_offsets = []
+    offs = align(index_size)
+    for _, d in assets:
+        data_offsets.append(offs + len(data))
+        data += d + b'\0' * (align(len(d)) - len(d))
+    total_size = align(index_size) + len(data)
+    out = struct.pack(HEADER_FORMAT, ASSET_BUNDLE_MAGIC, ASSET_BUNDLE_VERSION, header_size, len(assets), index_size,
+                      total_size)
+    for i, (name, d) in enumerate(assets):
+        out += struct.pack(ENTRY_FORMAT, name_hash(name), name_offsets[i], data_offsets[i], len(d), len(name), 0)
+    out += strings
+    out += b'\0' * (align(index_size) - index_size)
+    out += data
+    return out
+
+def collect(paths, strip_dir):
+    assets = []
+    for path in paths:
+        if os.path.isdir(path):
+            for root, _, files in os.walk(path):
+                for f in sorted(files):
+                    p = os.path.join(root, f)
+                    assets.append((os.path.relpath(p, path) if strip_dir else p, p))
+        else:
+            assets.append((os.path.basename(path) if strip_dir else path, path))
+    result = []
+    for name, path in assets:
+        with open(path, 'rb') as f:
+            result.append((name.replace(os.sep, '/').encode(), f.read()))
+    return result
+
+def main():
+    platforms = [x.name.lower() for x in GEN3_PLATFORMS]
+    parser = argparse.ArgumentParser(description='Pack files into a read-only asset bundle')
+    parser.add_argument('input', metavar='INPUT', nargs='+', help='Input file or directory')
+    parser.add_argument('-o', '--output', required=True, type=argparse.FileType('wb'), help='Output bundle file')
+    parser.add_argument('--keep-path', dest='strip_dir', action='store_false',
+                        help='Use input paths as asset names instead of paths relative to the input directories')
+    parser.add_argument('--platform', help='Generate a resource module for this platform', choices=platforms)
+    parser.add_argument('--version', default=0, type=int, help='Module version')
+
+    args = parser.parse_args()
+
+    bundle = pack(collect(args.input, args.strip_dir))
+    if args.platform:
+        platform = Platform[args.platform.upper()]
+        address, max_size = ASSET_REGION.get(platform, DEFAULT_ASSET_REGION)
+        if len(bundle) > max_size:
+            print('Asset bundle is too large: %d bytes (maximum size is %d bytes)' % (len(bundle), max_size))
+            sys.exit(1)
+        m = Module(bundle, address, platform, ModuleFunction.RESOURCE, args.version, flags=ModuleFlags.DROP_MODULE_INFO)
+        args.output.write(m.dump())
+        print(m)
+    else:
+        args.output.write(bundle)
+
+if __name__ == '__main__':
+    main()
@@ -13,6 +13,7 @@
 #include "publisher.h"
 #include "subscriptions.h"
 #include "variables.h"
+#include "response_scheduler.h"
 #include "hal_platform.h"
 #include "mesh.h"
 #include "timesyncmanager.h"
@@ -93,6 +94,11 @@ class Protocol
 	} chunkedTransferCallbacks;
 #endif // !HAL_PLATFORM_OTA_PROTOCOL_V3
 
+	/**
+	 * Piggybacks responses to requests on their ACKs.
+	 */
+	ResponseScheduler responseScheduler;
+
 	/**
 	 * Manages device-hosted variables.
 	 */
@@ -351,6 +357,7 @@ public:
 			channel(channel),
 			product_id(PRODUCT_ID),
 			product_firmware_version(PRODUCT_FIRMWARE_VERSION),
+			responseScheduler(channel),
 			variables(this),
 			publisher(this),
 			last_ack_handlers_update(0),
@@ -419,6 +426,15 @@ public:
 		max_transmit_message_size = size;
 	}
 
+	/**
+	 * Sets the time for which the ACK for a request is held, so that the response can be sent
+	 * in the ACK. A window of 0 disables the coalescing.
+	 */
+	void set_ack_window(system_tick_t window)
+	{
+		responseScheduler.set_window(window);
+	}
+
 	size_t get_max_transmit_message_size() const
 	{
 		return max_transmit_message_size;
@@ -534,7 +550,7 @@ public:
 		return true;
 	}
 
-	void build_describe_message(Appender& appender, int desc_flags);
+	void build_describe_message(BufferAppender& appender, int desc_flags, bool peek = false);
 
 	inline bool add_event_handler(const char *event_name, EventHandler handler)
 	{
@@ -644,6 +660,10 @@ public:
 	MessageChannel& getChannel() {
 		return channel;
 	}
+
+	ResponseScheduler& getResponseScheduler() {
+		return responseScheduler;
+	}
 };
 
 }
@@ -118,6 +118,24 @@ const size_t MAX_FUNCTION_CALL_MESSAGE_SIZE = 4 /* Header */ + 1 /* Token */ + (
  */
 const size_t MAX_VARIABLE_VALUE_MESSAGE_SIZE = 4 /* Header */ + 1 /* Token */ + 1 /* Payload marker */ +
         MAX_VARIABLE_VALUE_LENGTH /* Payload data */;
+/**
+ * Maximum size of the options added to a CoAP message carrying a block of a variable value.
+ */
+const size_t MAX_VARIABLE_BLOCK_OPTIONS_SIZE = 4 /* Block2 option */ + 5 /* Size2 option */;
+/**
+ * Maximum size of the options added to a CoAP message carrying a block of an event payload.
+ */
+const size_t MAX_EVENT_BLOCK_OPTIONS_SIZE = 5 /* Block1 option */ + 5 /* Size1 option */;
+
+// Maximum size of an event payload sent in blocks and of a function argument received in blocks
+// (RFC 7959)
+#if HAL_PLATFORM_GEN >= 3
+const size_t MAX_BLOCKWISE_EVENT_DATA_LENGTH = 16 * 1024;
+const size_t MAX_BLOCKWISE_FUNCTION_ARG_LENGTH = 16 * 1024;
+#else
+const size_t MAX_BLOCKWISE_EVENT_DATA_LENGTH = 4 * 1024;
+const size_t MAX_BLOCKWISE_FUNCTION_ARG_LENGTH = 4 * 1024;
+#endif
 
 #ifndef PROTOCOL_BUFFER_SIZE
 #define PROTOCOL_BUFFER_SIZE MBEDTLS_SSL_MAX_CONTENT_LEN
@@ -157,7 +175,8 @@ enum Enum
     MAX_TRANSMIT_MESSAGE_SIZE = 7, ///< Maximum size of of outgoing CoAP message (set).
     MAX_EVENT_DATA_SIZE = 8, ///< Maximum size of event data (get).
     MAX_VARIABLE_VALUE_SIZE = 9, ///< Maximum size of a variable value (get).
-    MAX_FUNCTION_ARGUMENT_SIZE = 10 ///< Maximum size of a function call argument (get).
+    MAX_FUNCTION_ARGUMENT_SIZE = 10, ///< Maximum size of a function call argument (get).
+    ACK_WINDOW = 11 ///< Time in milliseconds for which the ACK for a request is held (set).
 };
 
 }
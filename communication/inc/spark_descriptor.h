@@ -66,6 +66,20 @@ namespace SparkAppStateUpdate {
 	};
 }
 
+/**
+ * Options passed to `SparkDescriptor::append_metrics()`.
+ */
+struct SparkAppendMetricsOptions
+{
+    enum Flag {
+        PEEK = 0x01 ///< Only the size of the data is needed. The data should not be consumed.
+    };
+
+    uint16_t size; ///< Size of this structure.
+    uint16_t flags; ///< Flags (see `Flag`).
+    uint32_t max_size; ///< Maximum size of the data, or 0 if the size is not limited.
+};
+
 struct SparkDescriptor
 {
     typedef std::function<bool(const void*, SparkReturnType::Enum)> FunctionResultCallback;
@@ -75,7 +89,9 @@ struct SparkDescriptor
      *
      * @param error Result code (a value defined by the `ProtocolError` enum).
      * @param type Variable type (a value defined by the `SparkReturnType::Enum` enum).
-     * @param data Variable value. The ownership over the allocated memory is transferred to the callback.
+     * @param data Variable value. For the `STRING` type, the ownership over the allocated memory is transferred
+     *        to the callback. Values of the fixed-size types (`INT`, `DOUBLE` and `BOOLEAN`) are owned by the caller
+     *        and are only valid for the duration of the callback.
      * @param size Size of the variable value.
      * @param context Context of the variable request.
      */
@@ -116,7 +132,7 @@ struct SparkDescriptor
      * @param append		Opaque data to be passed to appender
      * @param flags		0x01 - append as binary daata, otherwise append as json
      * @param page		A key to select which metrics data to output. Presently unused and should be 0, which means the default metrics.
-     * @param reserved	For future expansion.
+     * @param reserved	Options (`SparkAppendMetricsOptions`), or NULL.
      * @return
      */
     bool (*append_metrics)(appender_fn appender, void* append, uint32_t flags, uint32_t page, void* reserved);
@@ -36,7 +36,9 @@ CPPSRC += $(TARGET_SRC_PATH)/variables.cpp
 CPPSRC += $(TARGET_SRC_PATH)/coap_defs.cpp
 CPPSRC += $(TARGET_SRC_PATH)/coap_message_encoder.cpp
 CPPSRC += $(TARGET_SRC_PATH)/coap_message_decoder.cpp
+CPPSRC += $(TARGET_SRC_PATH)/coap_blockwise.cpp
 CPPSRC += $(TARGET_SRC_PATH)/firmware_update.cpp
+CPPSRC += $(TARGET_SRC_PATH)/response_scheduler.cpp
 
 # ASM source files included in this build.
 ASRC +=
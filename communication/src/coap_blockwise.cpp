@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "coap_blockwise.h"
+
+#include "system_error.h"
+#include "check.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace particle {
+
+namespace protocol {
+
+const size_t CoapBlockReceiver::MAX_KEY_SIZE;
+
+CoapBlockSender::CoapBlockSender() :
+        size_(0),
+        blockSize_(0),
+        blockCount_(0),
+        nextBlock_(0),
+        blockIndex_(0),
+        blocks_(0),
+        ids_() {
+}
+
+int CoapBlockSender::init(std::unique_ptr<char[]> data, size_t size, size_t blockSize) {
+    CHECK_TRUE(data && size > 0, SYSTEM_ERROR_INVALID_ARGUMENT);
+    CHECK_TRUE(blockSize > 0 && coapBlockSizeFloor(blockSize) == blockSize, SYSTEM_ERROR_INVALID_ARGUMENT);
+    const size_t blockCount = (size + blockSize - 1) / blockSize;
+    CHECK_TRUE(blockCount - 1 <= MAX_COAP_BLOCK_NUMBER, SYSTEM_ERROR_TOO_LARGE);
+    reset();
+    data_ = std::move(data);
+    size_ = size;
+    blockSize_ = blockSize;
+    blockCount_ = blockCount;
+    return 0;
+}
+
+bool CoapBlockSender::hasNextBlock() const {
+    if (!data_ || nextBlock_ >= blockCount_ || nextBlock_ >= blockIndex_ + BLOCK1_SEND_WINDOW_SIZE) {
+        return false;
+    }
+    // The last block is sent once all other blocks have been acknowledged
+    return nextBlock_ + 1 < blockCount_ || nextBlock_ == blockIndex_;
+}
+
+void CoapBlockSender::nextBlock(unsigned* num, const char** data, size_t* size, bool* more) const {
+    const size_t offs = nextBlock_ * blockSize_;
+    *num = nextBlock_;
+    *data = data_.get() + offs;
+    *size = std::min(blockSize_, size_ - offs);
+    *more = nextBlock_ + 1 < blockCount_;
+}
+
+void CoapBlockSender::blockSent(CoapMessageId id) {
+    ids_[nextBlock_ % BLOCK1_SEND_WINDOW_SIZE] = id;
+    ++nextBlock_;
+}
+
+int CoapBlockSender::findBlock(CoapMessageId id) const {
+    if (!data_) {
+        return SYSTEM_ERROR_NOT_FOUND;
+    }
+    for (unsigned num = blockIndex_; num < nextBlock_; ++num) {
+        if (!(blocks_ & (1u << (num - blockIndex_))) && ids_[num % BLOCK1_SEND_WINDOW_SIZE] == id) {
+            return num;
+        }
+    }
+    return SYSTEM_ERROR_NOT_FOUND;
+}
+
+int CoapBlockSender::blockAcked(unsigned num) {
+    if (num >= blockIndex_ && num < nextBlock_) {
+        blocks_ |= 1u << (num - blockIndex_);
+        // Shift the sender window
+        while (blocks_ & 1) {
+            blocks_ >>= 1;
+            ++blockIndex_;
+        }
+    }
+    return (blockIndex_ == blockCount_) ? 1 : 0;
+}
+
+void CoapBlockSender::reset() {
+    data_.reset();
+    size_ = 0;
+    blockSize_ = 0;
+    blockCount_ = 0;
+    nextBlock_ = 0;
+    blockIndex_ = 0;
+    blocks_ = 0;
+}
+
+CoapBlockReceiver::CoapBlockReceiver(size_t maxSize) :
+        buf_(nullptr),
+        bufSize_(0),
+        size_(0),
+        maxSize_(maxSize),
+        blockSize_(0),
+        blockCount_(0),
+        blockIndex_(0),
+        blocks_(0),
+        keySize_(0),
+        key_() {
+}
+
+CoapBlockReceiver::~CoapBlockReceiver() {
+    reset();
+}
+
+int CoapBlockReceiver::receive(const char* key, size_t keySize, unsigned num, bool more, size_t blockSize,
+        const char* data, size_t size) {
+    CHECK_TRUE(keySize <= MAX_KEY_SIZE, SYSTEM_ERROR_INVALID_ARGUMENT);
+    // All blocks except the last one carry exactly the block size
+    CHECK_TRUE(size <= blockSize && (!more || size == blockSize), SYSTEM_ERROR_BAD_DATA);
+    if (!blockSize_ || keySize != keySize_ || memcmp(key, key_, keySize) != 0) {
+        // Start a new transfer
+        CHECK_TRUE(num < BLOCK1_RECEIVE_WINDOW_SIZE, SYSTEM_ERROR_NOT_ENOUGH_DATA);
+        reset();
+        memcpy(key_, key, keySize);
+        keySize_ = keySize;
+        blockSize_ = blockSize;
+    } else if (blockSize != blockSize_) {
+        // Changing the block size in the middle of a transfer is not supported
+        return SYSTEM_ERROR_NOT_ENOUGH_DATA;
+    }
+    if (num >= blockIndex_ + BLOCK1_RECEIVE_WINDOW_SIZE) {
+        // The block is out of the receiver window
+        return SYSTEM_ERROR_NOT_ENOUGH_DATA;
+    }
+    if (blockCount_ && (num >= blockCount_ || more != (num + 1 < blockCount_))) {
+        return SYSTEM_ERROR_BAD_DATA; // Inconsistent with the last block
+    }
+    const size_t offs = num * blockSize;
+    CHECK_TRUE(offs + size <= maxSize_, SYSTEM_ERROR_TOO_LARGE);
+    if (num >= blockIndex_) {
+        // Position of the block bit in the bitmap
+        const uint32_t bit = 1u << (num - blockIndex_);
+        if (!(blocks_ & bit)) {
+            CHECK(reserve(offs + size + 1 /* Term. null */));
+            memcpy(buf_ + offs, data, size);
+            blocks_ |= bit;
+            if (!more) {
+                blockCount_ = num + 1;
+                size_ = offs + size;
+            }
+            // Shift the receiver window
+            while (blocks_ & 1) {
+                blocks_ >>= 1;
+                ++blockIndex_;
+            }
+        }
+    } // Otherwise, it's a duplicate block
+    if (!blockCount_ || blockIndex_ < blockCount_) {
+        return 0;
+    }
+    buf_[size_] = '\0';
+    return 1;
+}
+
+void CoapBlockReceiver::reset() {
+    free(buf_);
+    buf_ = nullptr;
+    bufSize_ = 0;
+    size_ = 0;
+    blockSize_ = 0;
+    blockCount_ = 0;
+    blockIndex_ = 0;
+    blocks_ = 0;
+    keySize_ = 0;
+}
+
+int CoapBlockReceiver::reserve(size_t size) {
+    if (size <= bufSize_) {
+        return 0;
+    }
+    // Grow the buffer geometrically to avoid reallocating it for every block
+    size = std::min(std::max(size, bufSize_ * 2), maxSize_ + 1);
+    const auto buf = (char*)realloc(buf_, size);
+    CHECK_TRUE(buf, SYSTEM_ERROR_NO_MEMORY);
+    buf_ = buf;
+    bufSize_ = size;
+    return 0;
+}
+
+} // namespace protocol
+
+} // namespace particle
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "coap_defs.h"
+#include "protocol_defs.h"
+
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace particle {
+
+namespace protocol {
+
+/**
+ * Maximum number of blocks that can be in flight when sending a payload in blocks.
+ *
+ * Every unacknowledged block is kept by the message channel for retransmission, so this window
+ * is kept small.
+ */
+const size_t BLOCK1_SEND_WINDOW_SIZE = 4;
+
+/**
+ * Size of the receiver window in blocks.
+ *
+ * This parameter affects the size of the block bitmap maintained by the receiver.
+ */
+const size_t BLOCK1_RECEIVE_WINDOW_SIZE = 32;
+
+static_assert(BLOCK1_SEND_WINDOW_SIZE <= 32 && BLOCK1_RECEIVE_WINDOW_SIZE <= 32, "Invalid block window size");
+
+/**
+ * Splits a payload into blocks and keeps track of the blocks acknowledged by the peer (RFC 7959).
+ *
+ * Up to `BLOCK1_SEND_WINDOW_SIZE` blocks can be in flight at a time. The acknowledged blocks are
+ * tracked in a bitmap relative to the number of blocks acknowledged in sequence, so the blocks can
+ * be acknowledged in any order. The last block is only sent once all other blocks have been
+ * acknowledged, so that the peer can respond to it with the final response.
+ */
+class CoapBlockSender {
+public:
+    CoapBlockSender();
+
+    /**
+     * Starts a new transfer.
+     *
+     * The sender takes ownership of the payload data.
+     */
+    int init(std::unique_ptr<char[]> data, size_t size, size_t blockSize);
+
+    /**
+     * Returns `true` if the next block can be sent.
+     */
+    bool hasNextBlock() const;
+
+    /**
+     * Gets the next block to send.
+     */
+    void nextBlock(unsigned* num, const char** data, size_t* size, bool* more) const;
+
+    /**
+     * Marks the next block as sent.
+     *
+     * @param id ID of the message carrying the block.
+     */
+    void blockSent(CoapMessageId id);
+
+    /**
+     * Finds a block in flight by the ID of the message carrying it.
+     *
+     * @return Block number, or `SYSTEM_ERROR_NOT_FOUND` if there's no such block in flight.
+     */
+    int findBlock(CoapMessageId id) const;
+
+    /**
+     * Marks a block in flight as acknowledged.
+     *
+     * @return 1 if all blocks have been acknowledged, or 0 otherwise.
+     */
+    int blockAcked(unsigned num);
+
+    bool isActive() const;
+    size_t size() const;
+    size_t blockSize() const;
+
+    void reset();
+
+private:
+    std::unique_ptr<char[]> data_; // Payload data
+    size_t size_; // Payload size
+    size_t blockSize_; // Block size
+    unsigned blockCount_; // Total number of blocks
+    unsigned nextBlock_; // Number of the next block to send
+    unsigned blockIndex_; // Number of blocks acknowledged in sequence
+    uint32_t blocks_; // Bitmap of acknowledged blocks within the sender window
+    CoapMessageId ids_[BLOCK1_SEND_WINDOW_SIZE]; // IDs of the blocks in flight
+};
+
+/**
+ * Reassembles a payload received in blocks (RFC 7959).
+ *
+ * The blocks can be received in any order as long as they fall within the receiver window of
+ * `BLOCK1_RECEIVE_WINDOW_SIZE` blocks, which is tracked in a bitmap relative to the number of
+ * blocks received in sequence, the same way as the firmware chunks. Duplicate blocks are ignored.
+ * The payload buffer is grown as the blocks arrive and is always null-terminated.
+ */
+class CoapBlockReceiver {
+public:
+    /**
+     * Maximum size of the key identifying a transfer.
+     */
+    static const size_t MAX_KEY_SIZE = MAX_FUNCTION_KEY_LENGTH;
+
+    /**
+     * Constructor.
+     *
+     * @param maxSize Maximum size of the payload.
+     */
+    explicit CoapBlockReceiver(size_t maxSize);
+    ~CoapBlockReceiver();
+
+    /**
+     * Processes a received block.
+     *
+     * A block of a payload other than the one being received starts a new transfer if it falls
+     * within the initial receiver window.
+     *
+     * @param key Key identifying the transfer, such as a function name.
+     * @param keySize Size of the key.
+     * @param num Block number.
+     * @param more Value of the "more" flag of the block.
+     * @param blockSize Block size.
+     * @param data Block data.
+     * @param size Size of the block data.
+     * @return 1 if the payload is complete, 0 if more blocks are expected, or a negative result
+     *         code in case of an error. `SYSTEM_ERROR_NOT_ENOUGH_DATA` is returned for a block that
+     *         can't be processed because preceding blocks are missing (4.08 Request Entity
+     *         Incomplete), and `SYSTEM_ERROR_TOO_LARGE` if the payload would exceed the maximum size
+     *         (4.13 Request Entity Too Large).
+     */
+    int receive(const char* key, size_t keySize, unsigned num, bool more, size_t blockSize, const char* data,
+            size_t size);
+
+    /**
+     * Returns the reassembled payload data.
+     */
+    const char* data() const;
+    size_t size() const;
+    size_t maxSize() const;
+
+    bool isActive() const;
+
+    void reset();
+
+private:
+    char* buf_; // Payload buffer
+    size_t bufSize_; // Size of the payload buffer
+    size_t size_; // Payload size, or 0 if the last block hasn't been received yet
+    size_t maxSize_; // Maximum payload size
+    size_t blockSize_; // Block size, or 0 if no transfer is in progress
+    unsigned blockCount_; // Total number of blocks, or 0 if the last block hasn't been received yet
+    unsigned blockIndex_; // Number of blocks received in sequence
+    uint32_t blocks_; // Bitmap of received blocks within the receiver window
+    size_t keySize_;
+    char key_[MAX_KEY_SIZE];
+
+    int reserve(size_t size);
+};
+
+inline bool CoapBlockSender::isActive() const {
+    return (bool)data_;
+}
+
+inline size_t CoapBlockSender::size() const {
+    return size_;
+}
+
+inline size_t CoapBlockSender::blockSize() const {
+    return blockSize_;
+}
+
+inline const char* CoapBlockReceiver::data() const {
+    return buf_ ? buf_ : "";
+}
+
+inline size_t CoapBlockReceiver::size() const {
+    return size_;
+}
+
+inline size_t CoapBlockReceiver::maxSize() const {
+    return maxSize_;
+}
+
+inline bool CoapBlockReceiver::isActive() const {
+    return blockSize_;
+}
+
+} // namespace protocol
+
+} // namespace particle
@@ -18,6 +18,7 @@
 #include "coap_defs.h"
 
 #include "system_error.h"
+#include "check.h"
 
 namespace particle {
 
@@ -60,6 +61,44 @@ CoapCode coapCodeForSystemError(int error) {
     }
 }
 
+int encodeCoapBlockOption(unsigned num, bool more, size_t size) {
+    CHECK_TRUE(num <= MAX_COAP_BLOCK_NUMBER, SYSTEM_ERROR_OUT_OF_RANGE);
+    // The block size is encoded as a power of two: 2^(SZX + 4)
+    unsigned szx = 0;
+    while ((MIN_COAP_BLOCK_SIZE << szx) < size && szx < 6) {
+        ++szx;
+    }
+    CHECK_TRUE((MIN_COAP_BLOCK_SIZE << szx) == size, SYSTEM_ERROR_INVALID_ARGUMENT);
+    return (num << 4) | (more ? 0x08 : 0) | szx;
+}
+
+int decodeCoapBlockOption(unsigned value, unsigned* num, bool* more, size_t* size) {
+    CHECK_TRUE(value <= 0xffffff, SYSTEM_ERROR_BAD_DATA); // The option value is at most 3 bytes long
+    const unsigned szx = value & 0x07;
+    CHECK_TRUE(szx != 7, SYSTEM_ERROR_BAD_DATA); // Reserved
+    if (num) {
+        *num = value >> 4;
+    }
+    if (more) {
+        *more = value & 0x08;
+    }
+    if (size) {
+        *size = MIN_COAP_BLOCK_SIZE << szx;
+    }
+    return 0;
+}
+
+size_t coapBlockSizeFloor(size_t size) {
+    if (size < MIN_COAP_BLOCK_SIZE) {
+        return 0;
+    }
+    size_t n = MAX_COAP_BLOCK_SIZE;
+    while (n > size) {
+        n >>= 1;
+    }
+    return n;
+}
+
 } // namespace protocol
 
 } // namespace particle
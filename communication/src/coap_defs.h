@@ -31,6 +31,11 @@ const size_t MIN_COAP_MESSAGE_SIZE = 4;
 
 const size_t MAX_COAP_TOKEN_SIZE = 8;
 
+// RFC 7959, 2.2. Structure of a Block Option
+const size_t MIN_COAP_BLOCK_SIZE = 16;
+const size_t MAX_COAP_BLOCK_SIZE = 1024;
+const unsigned MAX_COAP_BLOCK_NUMBER = 0xfffff;
+
 constexpr unsigned coapCode(unsigned cls, unsigned detail) {
     return ((cls & 0x07) << 5) | (detail & 0x1f);
 }
@@ -58,6 +63,7 @@ enum class CoapCode {
     VALID = coapCode(2, 3),
     CHANGED = coapCode(2, 4),
     CONTENT = coapCode(2, 5),
+    CONTINUE = coapCode(2, 31), // RFC 7959
     BAD_REQUEST = coapCode(4, 0),
     UNAUTHORIZED = coapCode(4, 1),
     BAD_OPTION = coapCode(4, 2),
@@ -65,6 +71,7 @@ enum class CoapCode {
     NOT_FOUND = coapCode(4, 4),
     METHOD_NOT_ALLOWED = coapCode(4, 5),
     NOT_ACCEPTABLE = coapCode(4, 6),
+    REQUEST_ENTITY_INCOMPLETE = coapCode(4, 8), // RFC 7959
     PRECONDITION_FAILED = coapCode(4, 12),
     REQUEST_ENTITY_TOO_LARGE = coapCode(4, 13),
     UNSUPPORTED_CONTENT_FORMAT = coapCode(4, 15),
@@ -92,6 +99,9 @@ enum class CoapOption {
     URI_QUERY = 15,
     ACCEPT = 17,
     LOCATION_QUERY = 20,
+    BLOCK2 = 23, // RFC 7959
+    BLOCK1 = 27, // RFC 7959
+    SIZE2 = 28, // RFC 7959
     PROXY_URI = 35,
     PROXY_SCHEME = 39,
     SIZE1 = 60
@@ -118,6 +128,12 @@ bool isCoapEmptyAck(CoapType type, unsigned code);
 
 CoapCode coapCodeForSystemError(int error);
 
+// Returns the value of a Block1 or Block2 option, or a negative result code in case of an error
+int encodeCoapBlockOption(unsigned num, bool more, size_t size);
+int decodeCoapBlockOption(unsigned value, unsigned* num, bool* more, size_t* size);
+// Returns the largest valid block size that doesn't exceed the specified size, or 0
+size_t coapBlockSizeFloor(size_t size);
+
 inline unsigned coapCodeClass(unsigned code) {
     return (code >> 5) & 0x07;
 }
@@ -148,6 +148,13 @@ CoapOptionIterator CoapMessageDecoder::findOption(unsigned opt) const {
     return it;
 }
 
+int CoapMessageDecoder::blockOption(CoapOption opt, unsigned* num, bool* more, size_t* size) const {
+    const auto it = findOption(opt);
+    CHECK_TRUE(it, SYSTEM_ERROR_NOT_FOUND);
+    CHECK_TRUE(it.size() <= 3, SYSTEM_ERROR_BAD_DATA);
+    return decodeCoapBlockOption(it.toUInt(), num, more, size);
+}
+
 bool CoapOptionIterator::next() {
     if (!nextOpt_) {
         reset();
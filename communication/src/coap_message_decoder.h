@@ -53,6 +53,9 @@ public:
     bool hasOption(unsigned opt) const;
     bool hasOptions() const;
 
+    // Decodes a Block1 or Block2 option (RFC 7959)
+    int blockOption(CoapOption opt, unsigned* num, bool* more, size_t* size) const;
+
     // TODO: Add convenience methods for decoding URI path and query options
 
     int decode(const char* data, size_t size);
@@ -166,6 +166,23 @@ CoapMessageEncoder& CoapMessageEncoder::option(unsigned opt, unsigned val) {
     return *this;
 }
 
+CoapMessageEncoder& CoapMessageEncoder::blockOption(CoapOption opt, unsigned num, bool more, size_t size) {
+    if (error_) {
+        return *this;
+    }
+    const int val = encodeCoapBlockOption(num, more, size);
+    if (val < 0) {
+        error_ = val;
+        return *this;
+    }
+    if (val > 0xffff) {
+        // The value of a block option can't be longer than 3 bytes
+        const char v[3] = { (char)(val >> 16), (char)(val >> 8), (char)val };
+        return option((unsigned)opt, v, sizeof(v));
+    }
+    return option(opt, (unsigned)val);
+}
+
 CoapMessageEncoder& CoapMessageEncoder::payload(const char* data, size_t size) {
     if (error_) {
         return *this;
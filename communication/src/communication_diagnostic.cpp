@@ -5,3 +5,4 @@ particle::SimpleUnsignedIntegerDiagnosticData g_unacknowledgedMessageCounter(DIA
 particle::SimpleUnsignedIntegerDiagnosticData g_trasmittedMessageCounter(DIAG_ID_CLOUD_TRANSMITTED_MESSAGES, DIAG_NAME_CLOUD_TRANSMITTED_MESSAGES);
 particle::SimpleUnsignedIntegerDiagnosticData g_retransmittedMessageCounter(DIAG_ID_CLOUD_RETRANSMITTED_MESSAGES, DIAG_NAME_CLOUD_RETRANSMITTED_MESSAGES);
 particle::SimpleUnsignedIntegerDiagnosticData g_coapRoundTripMSec(DIAG_ID_CLOUD_COAP_ROUND_TRIP, DIAG_NAME_CLOUD_COAP_ROUND_TRIP);
+particle::SimpleUnsignedIntegerDiagnosticData g_piggybackedResponseCounter(DIAG_ID_CLOUD_PIGGYBACKED_RESPONSES, DIAG_NAME_CLOUD_PIGGYBACKED_RESPONSES);
@@ -5,3 +5,4 @@ extern particle::SimpleUnsignedIntegerDiagnosticData g_unacknowledgedMessageCoun
 extern particle::SimpleUnsignedIntegerDiagnosticData g_trasmittedMessageCounter;
 extern particle::SimpleUnsignedIntegerDiagnosticData g_retransmittedMessageCounter;
 extern particle::SimpleUnsignedIntegerDiagnosticData g_coapRoundTripMSec;
+extern particle::SimpleUnsignedIntegerDiagnosticData g_piggybackedResponseCounter;
@@ -68,7 +68,8 @@ int DTLSProtocol::wait_confirmable(uint32_t timeout)
 	ProtocolError err = NO_ERROR;
 	// FIXME: Additionally wait for 1 second before going into sleep to give
 	// a chance for some requests to arrive (e.g. application describe request)
-	while ((channel.has_unacknowledged_requests() && (millis()-start)<timeout) ||
+	// The held ACKs are pending as well
+	while ((has_pending_messages() && (millis()-start)<timeout) ||
 			(millis() - start) <= 1000)
 	{
 		CoAPMessageType::Enum message;
@@ -83,7 +84,7 @@ int DTLSProtocol::wait_confirmable(uint32_t timeout)
 		channel.client_messages().has_messages() ? "no" : "yes",
 		channel.server_messages().has_unacknowledged_requests() ? "no" : "yes");
 
-	if (err == ProtocolError::NO_ERROR && channel.has_unacknowledged_requests())
+	if (err == ProtocolError::NO_ERROR && has_pending_messages())
 	{
 		err = ProtocolError::MESSAGE_TIMEOUT;
 		LOG(WARN, "Timeout while waiting for confirmable messages to be processed");
@@ -81,6 +81,8 @@ public:
 		case ProtocolCommands::DISCONNECT: {
 			int r = ProtocolError::NO_ERROR;
 			unsigned timeout = DEFAULT_DISCONNECT_COMMAND_TIMEOUT;
+			// Send the held ACKs before the goodbye message
+			getResponseScheduler().flush();
 			if (data) {
 				const auto d = (const spark_disconnect_command*)data;
 				if (d->timeout != 0) {
@@ -131,6 +133,13 @@ public:
 	 * Ensures that all outstanding sent coap messages have been acknowledged.
 	 */
 	int wait_confirmable(uint32_t timeout);
+
+	/**
+	 * Returns `true` if there are unacknowledged requests or held ACKs.
+	 */
+	bool has_pending_messages() {
+		return channel.has_unacknowledged_requests() || getResponseScheduler().pending_ack_count() > 0;
+	}
 };
 
 
@@ -20,10 +20,15 @@
 #pragma once
 
 #include <string.h>
+#include <algorithm>
 #include "protocol_defs.h"
 #include "message_channel.h"
 #include "messages.h"
+#include "response_scheduler.h"
 #include "spark_descriptor.h"
+#include "coap_blockwise.h"
+#include "coap_message_encoder.h"
+#include "coap_message_decoder.h"
 
 
 namespace particle
@@ -33,8 +38,8 @@ namespace protocol
 
 class Functions
 {
-    // TODO: This is quite a large buffer and there's no need for it to be allocated statically
-    char function_arg[MAX_FUNCTION_ARG_LENGTH+1]; // add one for null terminator
+    ResponseScheduler* scheduler;
+    CoapBlockReceiver block_receiver;
 
     ProtocolError function_result(MessageChannel& channel, const void* result, SparkReturnType::Enum, token_t token)
     {
@@ -42,18 +47,154 @@ class Functions
         channel.create(message, Messages::function_return_size);
         size_t length = Messages::function_return(message.buf(), 0, token, long(result), channel.is_unreliable());
         message.set_length(length);
+        if (scheduler) {
+            return scheduler->send_response(message, token);
+        }
         return channel.send(message);
     }
 
+    static CoapCode block_error_code(int error)
+    {
+        switch (error) {
+        case SYSTEM_ERROR_NOT_ENOUGH_DATA:
+            return CoapCode::REQUEST_ENTITY_INCOMPLETE;
+        case SYSTEM_ERROR_TOO_LARGE:
+            return CoapCode::REQUEST_ENTITY_TOO_LARGE;
+        case SYSTEM_ERROR_NO_MEMORY:
+            return CoapCode::SERVICE_UNAVAILABLE;
+        default:
+            return CoapCode::BAD_REQUEST;
+        }
+    }
+
+    /**
+     * Handles a block of a function call request (RFC 7959).
+     *
+     * The argument of a block-wise call is carried in the payload of the request. Every block that
+     * doesn't complete the argument is acknowledged with 2.31 (Continue). The function is called
+     * once all blocks have been received, and its result is sent in response to the block that
+     * completed the argument.
+     */
+    ProtocolError handle_function_call_block(const CoapMessageDecoder& d, token_t token, message_id_t message_id,
+            Message& message, MessageChannel& channel,
+            int (*call_function)(const char *function_key, const char *arg, SparkDescriptor::FunctionResultCallback callback, void* reserved))
+    {
+        // The function key is in the second Uri-Path option
+        const char* key = nullptr;
+        size_t key_size = 0;
+        unsigned uri_path_count = 0;
+        auto it = d.options();
+        while (it.next()) {
+            if (it.option() == (unsigned)CoapOption::URI_PATH && uri_path_count++ == 1) {
+                key = it.data();
+                key_size = it.size();
+            }
+        }
+        unsigned num = 0;
+        bool more = false;
+        size_t block_size = 0;
+        int block_result = d.blockOption(CoapOption::BLOCK1, &num, &more, &block_size);
+        if (block_result >= 0) {
+            if (!key || !key_size || key_size > MAX_FUNCTION_KEY_LENGTH) {
+                block_result = SYSTEM_ERROR_BAD_DATA;
+            } else {
+                block_result = block_receiver.receive(key, key_size, num, more, block_size, d.payload(), d.payloadSize());
+            }
+        }
+        char function_key[MAX_FUNCTION_KEY_LENGTH + 1];
+        if (block_result > 0) {
+            memcpy(function_key, key, key_size);
+            function_key[key_size] = '\0';
+        }
+
+        Message response;
+        ProtocolError error = channel.response(message, response, 16);
+        if (error) {
+            return error;
+        }
+        if (block_result > 0 && scheduler) {
+            // hold the ACK so that the result can be sent with it
+            error = scheduler->defer_ack(response, message_id, token);
+        } else if (block_result > 0) {
+            size_t response_length = Messages::coded_ack(response.buf(), 0x00, 0, 0);
+            response.set_id(message_id);
+            response.set_length(response_length);
+            error = channel.send(response);
+        } else {
+            CoapMessageEncoder e((char*)response.buf(), response.capacity());
+            e.type(CoapType::ACK);
+            e.code((block_result == 0) ? CoapCode::CONTINUE : block_error_code(block_result));
+            e.id(message_id);
+            e.token((const char*)&token, sizeof(token));
+            if (block_result == 0) {
+                e.blockOption(CoapOption::BLOCK1, num, more, block_size);
+            } else if (block_result == SYSTEM_ERROR_TOO_LARGE) {
+                e.option(CoapOption::SIZE1, (unsigned)block_receiver.maxSize());
+            }
+            const int r = e.encode();
+            if (r < 0 || (size_t)r > response.capacity()) {
+                return INSUFFICIENT_STORAGE;
+            }
+            response.set_id(message_id);
+            response.set_length(r);
+            error = channel.send(response);
+        }
+        if (error || block_result <= 0) {
+            return error;
+        }
+
+        // call the given user function
+        auto callback = [=,&channel] (const void* result, SparkReturnType::Enum resultType )
+            { return this->function_result(channel, result, resultType, token); };
+        call_function(function_key, block_receiver.data(), callback, NULL);
+        block_receiver.reset();
+        return NO_ERROR;
+    }
+
 public:
+    Functions() :
+            scheduler(nullptr),
+            block_receiver(MAX_BLOCKWISE_FUNCTION_ARG_LENGTH)
+    {
+    }
+
+    /**
+     * Sets the scheduler used to piggyback the function result on the ACK for the call.
+     *
+     * If no scheduler is set, the call is acknowledged immediately.
+     */
+    void set_response_scheduler(ResponseScheduler* scheduler)
+    {
+        this->scheduler = scheduler;
+    }
+
+    /**
+     * Discards the blocks of a partially received function call.
+     */
+    void reset()
+    {
+        block_receiver.reset();
+    }
+
+    /**
+     * Handles a function call request.
+     *
+     * The function key and argument are passed to the callback as null-terminated strings that
+     * point into the message buffer, so they are only valid for the duration of the callback.
+     * A request that carries a Block1 option is handled as a block of a larger argument.
+     */
     ProtocolError handle_function_call(token_t token, message_id_t message_id, Message& message, MessageChannel& channel,
             int (*call_function)(const char *function_key, const char *arg, SparkDescriptor::FunctionResultCallback callback, void* reserved))
     {
-        // copy the function key
-        char function_key[MAX_FUNCTION_KEY_LENGTH+1]; // add one for null terminator
-        memset(function_key, 0, sizeof(function_key));
+        CoapMessageDecoder d;
+        if (d.decode((const char*)message.buf(), message.length()) >= 0 && d.hasOption(CoapOption::BLOCK1)) {
+            return handle_function_call_block(d, token, message_id, message, channel, call_function);
+        }
         uint8_t* queue = message.buf();
-        uint8_t queue_offset = 8;
+        const size_t message_length = message.length();
+        bool has_function = true;
+
+        size_t queue_offset = 8;
         size_t function_key_length = queue[7] & 0x0F;
         if (function_key_length == MAX_OPTION_DELTA_LENGTH+1)
         {
@@ -64,54 +205,79 @@ public:
         // {
         //     // MAX_OPTION_DELTA_LENGTH+2 not supported and not required for function_key_length
         // }
-        // allocated memory bounds check
-        if (function_key_length > MAX_FUNCTION_KEY_LENGTH)
+        if (queue_offset + function_key_length > message_length)
         {
-            function_key_length = MAX_FUNCTION_KEY_LENGTH;
-            // already memset to 0 (null terminator padded to end)
+            function_key_length = (queue_offset < message_length) ? message_length - queue_offset : 0;
+            queue_offset = std::min(queue_offset, message_length);
+            has_function = false;
         }
-        memcpy(function_key, queue + queue_offset, function_key_length);
 
         // How long is the argument?
         size_t q_index = queue_offset + function_key_length;
-        size_t function_arg_length = queue[q_index] & 0x0F;
-        if (function_arg_length == MAX_OPTION_DELTA_LENGTH+1)
+        size_t function_arg_length = 0;
+        size_t arg_offset = q_index;
+        if (q_index < message_length)
         {
-            ++q_index;
-            function_arg_length = MAX_OPTION_DELTA_LENGTH+1 + queue[q_index];
+            function_arg_length = queue[q_index] & 0x0F;
+            if (function_arg_length == MAX_OPTION_DELTA_LENGTH+1 && q_index + 1 < message_length)
+            {
+                ++q_index;
+                function_arg_length = MAX_OPTION_DELTA_LENGTH+1 + queue[q_index];
+            }
+            else if (function_arg_length == MAX_OPTION_DELTA_LENGTH+2 && q_index + 2 < message_length)
+            {
+                ++q_index;
+                function_arg_length = queue[q_index] << 8;
+                ++q_index;
+                function_arg_length |= queue[q_index];
+                function_arg_length += 269;
+            }
+            arg_offset = q_index + 1;
+            if (arg_offset + function_arg_length > message_length)
+            {
+                function_arg_length = (arg_offset < message_length) ? message_length - arg_offset : 0;
+                arg_offset = std::min(arg_offset, message_length);
+                has_function = false;
+            }
         }
-        else if (function_arg_length == MAX_OPTION_DELTA_LENGTH+2)
+        // allocated memory bounds check
+        if (function_key_length > MAX_FUNCTION_KEY_LENGTH)
         {
-            ++q_index;
-            function_arg_length = queue[q_index] << 8;
-            ++q_index;
-            function_arg_length |= queue[q_index];
-            function_arg_length += 269;
+            function_key_length = MAX_FUNCTION_KEY_LENGTH;
         }
-
-        bool has_function = true;
-        // allocated memory bounds check
         if (function_arg_length > MAX_FUNCTION_ARG_LENGTH)
         {
             function_arg_length = MAX_FUNCTION_ARG_LENGTH;
             has_function = false;
-            // in case we got here due to inconceivable error, memset with null terminators
-            memset(function_arg, 0, sizeof(function_arg));
         }
-        // save a copy of the argument
-        memcpy(function_arg, queue + q_index + 1, function_arg_length);
-        function_arg[function_arg_length] = 0; // null terminate string
 
         Message response;
-        channel.response(message, response, 16);
-        // send ACK
-        size_t response_length = Messages::coded_ack(response.buf(), has_function ? 0x00 : RESPONSE_CODE(4,00), 0, 0);
-        response.set_id(message_id);
-        response.set_length(response_length);
-        ProtocolError error = channel.send(response);
+        ProtocolError error = channel.response(message, response, 16);
         if (error) {
             return error;
         }
+        if (has_function && scheduler) {
+            // hold the ACK so that the result can be sent with it
+            error = scheduler->defer_ack(response, message_id, token);
+        } else {
+            // send ACK
+            size_t response_length = Messages::coded_ack(response.buf(), has_function ? 0x00 : RESPONSE_CODE(4,00), 0, 0);
+            response.set_id(message_id);
+            response.set_length(response_length);
+            error = channel.send(response);
+        }
+        if (error) {
+            return error;
+        }
+
+        // Null-terminate the key and argument in place. The terminator of the key overwrites the
+        // option header of the argument, which has been decoded already. The terminator of the
+        // argument may end up in the part of the buffer that was used for the ACK, so it can only
+        // be written after the ACK is sent
+        char* function_key = (char*)queue + queue_offset;
+        char* function_arg = (char*)queue + arg_offset;
+        function_key[function_key_length] = 0;
+        function_arg[function_arg_length] = 0;
 
         // call the given user function
         auto callback = [=,&channel] (const void* result, SparkReturnType::Enum resultType )
@@ -121,5 +287,4 @@ public:
     }
 };
 
-
 }}
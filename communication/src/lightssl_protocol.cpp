@@ -30,6 +30,8 @@ int LightSSLProtocol::command(ProtocolCommands::Enum command, uint32_t value, co
   case ProtocolCommands::DISCONNECT: {
     int r = ProtocolError::NO_ERROR;
     unsigned timeout = DEFAULT_DISCONNECT_COMMAND_TIMEOUT;
+    // Send the held ACKs before the goodbye message
+    getResponseScheduler().flush();
     if (data) {
       const auto d = (const spark_disconnect_command*)data;
       if (d->timeout != 0) {
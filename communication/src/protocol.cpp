@@ -31,6 +31,8 @@ LOG_SOURCE_CATEGORY("comm.protocol")
 #include "subscriptions.h"
 #include "functions.h"
 
+#include <algorithm>
+
 namespace particle { namespace protocol {
 
 namespace {
@@ -89,6 +91,12 @@ ProtocolError Protocol::handle_received_message(Message& message,
 		}
 		notify_message_complete(msg_id, code);
 		handle_app_state_reply(msg_id, code);
+		if (publisher.is_sending_blocks()) {
+			const ProtocolError error = publisher.response_ack(channel, msg_id, code, callbacks.millis());
+			if (error != ProtocolError::NO_ERROR) {
+				return error;
+			}
+		}
 #if HAL_PLATFORM_OTA_PROTOCOL_V3
 		if (type == CoAPType::ACK && firmwareUpdate.isRunning()) {
 			const ProtocolError error = firmwareUpdate.responseAck(&message);
@@ -297,6 +305,8 @@ void Protocol::init(const SparkCallbacks &callbacks,
 	chunkedTransferCallbacks.init(&this->callbacks);
 	chunkedTransfer.init(&chunkedTransferCallbacks);
 #endif
+	responseScheduler.init(this->callbacks.millis);
+	functions.set_response_scheduler(&responseScheduler);
 
 	initialized = true;
 }
@@ -430,6 +440,12 @@ void Protocol::reset() {
 #endif
 	pinger.reset();
 	timesync_.reset();
+	// Send the held ACKs, if the session is still up, so that the server doesn't retransmit the
+	// requests
+	responseScheduler.flush();
+	responseScheduler.reset();
+	publisher.reset();
+	functions.reset();
 	ack_handlers.clear();
 	channel.reset();
 	app_describe_msg_id = INVALID_MESSAGE_HANDLE;
@@ -533,6 +549,21 @@ ProtocolError Protocol::event_loop(CoAPMessageType::Enum& message_type)
 			error = event_loop_idle();
 		}
 	}
+	if (!error)
+	{
+		// Send the ACKs for which no response became available in time
+		error = responseScheduler.process();
+	}
+#if HAL_PLATFORM_OTA_PROTOCOL_V3
+	const bool updating = firmwareUpdate.isRunning();
+#else
+	const bool updating = chunkedTransfer.is_updating();
+#endif
+	if (!error && !updating)
+	{
+		// Send the events that were held back by the rate limiter
+		error = publisher.process(channel, callbacks.millis());
+	}
 
 	if (error)
 	{
@@ -548,7 +579,7 @@ ProtocolError Protocol::event_loop(CoAPMessageType::Enum& message_type)
 	return error;
 }
 
-void Protocol::build_describe_message(Appender& appender, int desc_flags)
+void Protocol::build_describe_message(BufferAppender& appender, int desc_flags, bool peek)
 {
 	// diagnostics must be requested in isolation to be a binary packet
 	if (descriptor.append_metrics && (desc_flags == DESCRIBE_METRICS))
@@ -558,7 +589,17 @@ void Protocol::build_describe_message(Appender& appender, int desc_flags)
 		appender.append(char(0));	//
 		const int flags = 1;		// binary
 		const int page = 0;
-		descriptor.append_metrics(Appender::callback, &appender, flags, page, nullptr);
+		SparkAppendMetricsOptions opts = {};
+		opts.size = sizeof(opts);
+		if (peek) {
+			opts.flags |= SparkAppendMetricsOptions::PEEK;
+		} else {
+			// BufferAppender never fails, so the metrics need to be limited to the free space in the
+			// buffer. A zero size would mean that the size is not limited
+			const size_t space = (appender.bufferSize() > appender.dataSize()) ? appender.bufferSize() - appender.dataSize() : 0;
+			opts.max_size = std::max(space, (size_t)1);
+		}
+		descriptor.append_metrics(Appender::callback, &appender, flags, page, &opts);
 	}
 	else {
 		appender.append("{");
@@ -835,7 +876,7 @@ int Protocol::get_describe_data(spark_protocol_describe_data* data, void* reserv
 {
 	data->maximum_size = 768;  // a conservative guess based on dtls and lightssl encryption overhead and the CoAP data
 	BufferAppender appender(nullptr,  0);	// don't need to store the data, just count the size
-	build_describe_message(appender, data->flags);
+	build_describe_message(appender, data->flags, true /* peek */);
 	data->current_size = appender.dataSize();
 	return 0;
 }
@@ -18,25 +18,144 @@
 #include "publisher.h"
 
 #include "protocol.h"
+#include "coap_message_encoder.h"
+
+#include <new>
+#include <cstring>
 
 namespace particle {
 
 namespace protocol {
 
+const unsigned Publisher::USER_EVENT_BURST;
+const system_tick_t Publisher::USER_EVENT_INTERVAL;
+const unsigned Publisher::SYSTEM_EVENT_BURST;
+const system_tick_t Publisher::SYSTEM_EVENT_INTERVAL;
+const size_t Publisher::MAX_QUEUED_EVENTS;
+
+Publisher::Publisher(Protocol* protocol) :
+        protocol(protocol),
+        blockwise(),
+        user_bucket(USER_EVENT_BURST, USER_EVENT_INTERVAL),
+        system_bucket(SYSTEM_EVENT_BURST, SYSTEM_EVENT_INTERVAL),
+        queue(nullptr),
+        queue_size(0) {
+}
+
+Publisher::~Publisher() {
+    reset();
+}
+
 void Publisher::add_ack_handler(message_id_t msg_id, CompletionHandler handler) {
     protocol->add_ack_handler(msg_id, std::move(handler), SEND_EVENT_ACK_TIMEOUT);
 }
 
 ProtocolError Publisher::send_event(MessageChannel& channel, const char* event_name,
             const char* data, int ttl, EventType::Enum event_type, int flags,
-            system_tick_t time, CompletionHandler handler) {
-    bool is_system_event = is_system(event_name);
-    bool rate_limited = is_rate_limited(is_system_event, time);
-    if (rate_limited) {
+            system_tick_t time, CompletionHandler&& handler) {
+    const bool is_system_event = is_system(event_name);
+    size_t data_size = 0;
+    if (data) {
+        // Data that doesn't fit in a single message can only be sent in blocks if the channel
+        // acknowledges messages
+        const auto max_data_size = channel.is_unreliable() ? MAX_BLOCKWISE_EVENT_DATA_LENGTH :
+                protocol->get_max_event_data_size();
+        data_size = strnlen(data, max_data_size);
+    }
+    // Queued events of the same class go first
+    if (!blockwise.sender.isActive() && !has_queued_events(is_system_event) && bucket(is_system_event).take(time)) {
+        return send(channel, event_name, data, data_size, ttl, event_type, flags, time, std::move(handler));
+    }
+    const ProtocolError error = enqueue(event_name, data, data_size, ttl, event_type, flags, is_system_event,
+            std::move(handler));
+    if (error == BANDWIDTH_EXCEEDED) {
         g_rateLimitedEventsCounter++;
-        return BANDWIDTH_EXCEEDED;
     }
+    return error;
+}
+
+ProtocolError Publisher::process(MessageChannel& channel, system_tick_t time) {
+    if (blockwise.sender.isActive()) {
+        if (time - blockwise.ack_time < SEND_EVENT_ACK_TIMEOUT) {
+            // Other events are sent once all blocks of this event are acknowledged
+            return NO_ERROR;
+        }
+        complete_blockwise(SYSTEM_ERROR_TIMEOUT);
+    }
+    QueuedEvent** prev = &queue;
+    while (*prev) {
+        QueuedEvent* const e = *prev;
+        if (!bucket(e->system).take(time)) {
+            // Events of the other class may still be sent
+            prev = &e->next;
+            continue;
+        }
+        *prev = e->next;
+        --queue_size;
+        std::unique_ptr<QueuedEvent> event(e);
+        const ProtocolError error = send(channel, event->name, event->data.get(), event->data_size, event->ttl,
+                event->event_type, event->flags, time, std::move(event->handler));
+        if (error != NO_ERROR) {
+            event->handler.setError(toSystemError(error));
+            return error;
+        }
+        if (blockwise.sender.isActive()) {
+            break;
+        }
+    }
+    return NO_ERROR;
+}
 
+ProtocolError Publisher::response_ack(MessageChannel& channel, message_id_t msg_id, CoAPCode::Enum code,
+            system_tick_t time) {
+    const int num = blockwise.sender.findBlock(msg_id);
+    if (num < 0) {
+        return NO_ERROR; // Not a block of the event being sent
+    }
+    if (!CoAPCode::is_success(code)) {
+        int error = SYSTEM_ERROR_COAP;
+        if (code == CoAPCode::REQUEST_ENTITY_TOO_LARGE) {
+            error = SYSTEM_ERROR_TOO_LARGE;
+        } else if (((int)code >> 5) == 4) {
+            error = SYSTEM_ERROR_COAP_4XX;
+        } else if (((int)code >> 5) == 5) {
+            error = SYSTEM_ERROR_COAP_5XX;
+        }
+        complete_blockwise(error);
+        return NO_ERROR;
+    }
+    blockwise.ack_time = time;
+    if (blockwise.sender.blockAcked(num) > 0) {
+        complete_blockwise(SYSTEM_ERROR_NONE);
+        return NO_ERROR;
+    }
+    const ProtocolError error = send_blocks(channel);
+    if (error != NO_ERROR) {
+        complete_blockwise(toSystemError(error));
+    }
+    return error;
+}
+
+void Publisher::reset() {
+    if (blockwise.sender.isActive()) {
+        complete_blockwise(SYSTEM_ERROR_CANCELLED);
+    }
+    while (queue) {
+        std::unique_ptr<QueuedEvent> event(queue);
+        queue = queue->next;
+        event->handler.setError(SYSTEM_ERROR_CANCELLED);
+    }
+    queue_size = 0;
+    user_bucket.reset();
+    system_bucket.reset();
+}
+
+ProtocolError Publisher::send(MessageChannel& channel, const char* event_name, const char* data,
+            size_t data_size, int ttl, EventType::Enum event_type, int flags, system_tick_t time,
+            CompletionHandler&& handler) {
+    if (data_size > protocol->get_max_event_data_size()) {
+        return send_blockwise(channel, event_name, data, data_size, ttl, event_type, time, std::move(handler));
+    }
     Message message;
     channel.create(message);
     bool confirmable = channel.is_unreliable();
@@ -45,12 +164,6 @@ ProtocolError Publisher::send_event(MessageChannel& channel, const char* event_n
     } else if (flags & EventType::WITH_ACK) {
         confirmable = true;
     }
-
-    size_t data_size = 0;
-    if (data) {
-        const auto max_data_size = protocol->get_max_event_data_size();
-        data_size = strnlen(data, max_data_size);
-    }
     size_t msglen = Messages::event(message.buf(), 0, event_name, data, data_size, ttl,
             event_type, confirmable);
     message.set_length(msglen);
@@ -66,6 +179,152 @@ ProtocolError Publisher::send_event(MessageChannel& channel, const char* event_n
     return result;
 }
 
+ProtocolError Publisher::send_blockwise(MessageChannel& channel, const char* event_name, const char* data,
+            size_t data_size, int ttl, EventType::Enum event_type, system_tick_t time, CompletionHandler&& handler) {
+    // Use the largest block size that fits in a single message along with the block options
+    auto max_block_size = protocol->get_max_event_data_size();
+    max_block_size = (max_block_size > MAX_EVENT_BLOCK_OPTIONS_SIZE) ? max_block_size - MAX_EVENT_BLOCK_OPTIONS_SIZE : 0;
+    const size_t block_size = coapBlockSizeFloor(max_block_size);
+    if (!block_size) {
+        return INSUFFICIENT_STORAGE;
+    }
+    // The event data needs to be kept until all blocks are acknowledged
+    std::unique_ptr<char[]> d(new(std::nothrow) char[data_size]);
+    if (!d) {
+        return INSUFFICIENT_STORAGE;
+    }
+    memcpy(d.get(), data, data_size);
+    if (blockwise.sender.init(std::move(d), data_size, block_size) < 0) {
+        return INTERNAL;
+    }
+    strncpy(blockwise.name, event_name, MAX_EVENT_NAME_LENGTH);
+    blockwise.name[MAX_EVENT_NAME_LENGTH] = '\0';
+    blockwise.ttl = ttl;
+    blockwise.event_type = event_type;
+    blockwise.ack_time = time;
+    blockwise.handler = std::move(handler);
+    const ProtocolError error = send_blocks(channel);
+    if (error != NO_ERROR) {
+        // Leave the handler intact
+        handler = std::move(blockwise.handler);
+        blockwise.sender.reset();
+    }
+    return error;
+}
+
+ProtocolError Publisher::send_blocks(MessageChannel& channel) {
+    auto& sender = blockwise.sender;
+    while (sender.hasNextBlock()) {
+        unsigned num = 0;
+        const char* data = nullptr;
+        size_t size = 0;
+        bool more = false;
+        sender.nextBlock(&num, &data, &size, &more);
+        Message message;
+        ProtocolError error = channel.create(message);
+        if (error != NO_ERROR) {
+            return error;
+        }
+        // The blocks are always confirmable, since the server acknowledges every block
+        CoapMessageEncoder e((char*)message.buf(), message.capacity());
+        e.type(CoapType::CON);
+        e.code(CoapCode::POST);
+        e.id(0); // Will be assigned by the message channel
+        const char type = blockwise.event_type;
+        e.option(CoapOption::URI_PATH, &type, sizeof(type));
+        e.option(CoapOption::URI_PATH, blockwise.name);
+        if (blockwise.ttl != 60) {
+            e.option(CoapOption::MAX_AGE, (unsigned)blockwise.ttl);
+        }
+        e.blockOption(CoapOption::BLOCK1, num, more, sender.blockSize());
+        if (num == 0) {
+            e.option(CoapOption::SIZE1, (unsigned)sender.size());
+        }
+        e.payload(data, size);
+        const int r = e.encode();
+        if (r < 0 || (size_t)r > message.capacity()) {
+            return INSUFFICIENT_STORAGE;
+        }
+        message.set_length(r);
+        error = channel.send(message);
+        if (error != NO_ERROR) {
+            return error;
+        }
+        sender.blockSent(message.get_id());
+    }
+    return NO_ERROR;
+}
+
+void Publisher::complete_blockwise(int error) {
+    CompletionHandler handler = std::move(blockwise.handler);
+    blockwise.sender.reset();
+    if (error < 0) {
+        handler.setError(error);
+    } else {
+        handler.setResult();
+    }
+}
+
+ProtocolError Publisher::enqueue(const char* event_name, const char* data, size_t data_size, int ttl,
+            EventType::Enum event_type, int flags, bool is_system_event, CompletionHandler&& handler) {
+    const bool priority = flags & EventType::PRIORITY;
+    if (queue_size == MAX_QUEUED_EVENTS) {
+        // A priority event takes the place of the most recently queued normal event
+        QueuedEvent** victim = nullptr;
+        for (QueuedEvent** e = &queue; *e; e = &(*e)->next) {
+            if (!((*e)->flags & EventType::PRIORITY)) {
+                victim = e;
+            }
+        }
+        if (!priority || !victim) {
+            return BANDWIDTH_EXCEEDED;
+        }
+        std::unique_ptr<QueuedEvent> event(*victim);
+        *victim = event->next;
+        --queue_size;
+        g_rateLimitedEventsCounter++;
+        event->handler.setError(SYSTEM_ERROR_LIMIT_EXCEEDED);
+    }
+    std::unique_ptr<QueuedEvent> event(new(std::nothrow) QueuedEvent());
+    if (!event) {
+        return INSUFFICIENT_STORAGE;
+    }
+    if (data_size > 0) {
+        event->data.reset(new(std::nothrow) char[data_size + 1]);
+        if (!event->data) {
+            return INSUFFICIENT_STORAGE;
+        }
+        memcpy(event->data.get(), data, data_size);
+        event->data[data_size] = '\0';
+    }
+    strncpy(event->name, event_name, MAX_EVENT_NAME_LENGTH);
+    event->name[MAX_EVENT_NAME_LENGTH] = '\0';
+    event->data_size = data_size;
+    event->ttl = ttl;
+    event->flags = flags;
+    event->event_type = event_type;
+    event->system = is_system_event;
+    event->handler = std::move(handler);
+    // Priority events are queued after other priority events but before normal events
+    QueuedEvent** pos = &queue;
+    while (*pos && (!priority || ((*pos)->flags & EventType::PRIORITY))) {
+        pos = &(*pos)->next;
+    }
+    event->next = *pos;
+    *pos = event.release();
+    ++queue_size;
+    return NO_ERROR;
+}
+
+bool Publisher::has_queued_events(bool is_system_event) const {
+    for (const QueuedEvent* e = queue; e; e = e->next) {
+        if (e->system == is_system_event) {
+            return true;
+        }
+    }
+    return false;
+}
+
 } // protocol
 
 } // particle
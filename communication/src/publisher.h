@@ -23,10 +23,14 @@
 #include "events.h"
 #include "message_channel.h"
 #include "messages.h"
+#include "token_bucket.h"
+#include "coap_blockwise.h"
 
 #include "completion_handler.h"
 #include "communication_diagnostic.h"
 
+#include <memory>
+
 namespace particle
 {
 namespace protocol
@@ -34,65 +38,132 @@ namespace protocol
 
 class Protocol;
 
+/**
+ * Sends events to the cloud, enforcing the publish rate limits.
+ *
+ * System and application events are rate limited by separate token buckets. An event that can't
+ * be sent immediately is queued and sent by process() as soon as its bucket refills. Events of
+ * the same class are sent in order, except that events published with the EventType::PRIORITY
+ * flag are sent before any queued normal events. An event is rejected with BANDWIDTH_EXCEEDED
+ * only if the queue is full.
+ *
+ * Over a channel that acknowledges messages, an event whose data doesn't fit in a single message
+ * is sent in blocks (RFC 7959) using the Block1 option. Only one such event is sent at a time,
+ * and other events are queued until all of its blocks are acknowledged.
+ */
 class Publisher
 {
 public:
-	explicit Publisher(Protocol* protocol) :
-			protocol(protocol)
-	{
-	}
+	/**
+	 * Maximum burst of application events.
+	 */
+	static const unsigned USER_EVENT_BURST = 4;
+	/**
+	 * Time in milliseconds in which one more application event can be sent.
+	 */
+	static const system_tick_t USER_EVENT_INTERVAL = 1000;
+	/**
+	 * Maximum burst of system events.
+	 */
+	static const unsigned SYSTEM_EVENT_BURST = 255;
+	/**
+	 * Time in milliseconds in which one more system event can be sent (255 events per minute).
+	 */
+	static const system_tick_t SYSTEM_EVENT_INTERVAL = 60000 / SYSTEM_EVENT_BURST;
+	/**
+	 * Maximum number of events waiting for the rate limiter.
+	 */
+	static const size_t MAX_QUEUED_EVENTS = 8;
+
+	explicit Publisher(Protocol* protocol);
+	~Publisher();
 
 	inline bool is_system(const char* event_name)
 	{
 		return !strncmp(event_name, "spark", 5) || !strncmp(event_name, "particle", 8);
 	}
 
-	bool is_rate_limited(bool is_system_event, system_tick_t millis)
+	/**
+	 * Sends an event or queues it if the rate limit has been reached.
+	 *
+	 * The handler is left intact if an error is returned.
+	 */
+	ProtocolError send_event(MessageChannel& channel, const char* event_name,
+			const char* data, int ttl, EventType::Enum event_type, int flags,
+			system_tick_t time, CompletionHandler&& handler);
+
+	/**
+	 * Sends the queued events for which tokens are available.
+	 */
+	ProtocolError process(MessageChannel& channel, system_tick_t time);
+
+	/**
+	 * Processes an acknowledgement for a block of the event being sent in blocks.
+	 */
+	ProtocolError response_ack(MessageChannel& channel, message_id_t msg_id, CoAPCode::Enum code,
+			system_tick_t time);
+
+	/**
+	 * Discards all queued events and completes their handlers with an error.
+	 */
+	void reset();
+
+	bool is_sending_blocks() const
 	{
-		if (is_system_event)
-		{
-			static uint16_t lastMinute = 0;
-			static uint8_t eventsThisMinute = 0;
-
-			uint16_t currentMinute = uint16_t(millis >> 16);
-			if (currentMinute == lastMinute)
-			{      // == handles millis() overflow
-				if (eventsThisMinute == 255)
-					return true;
-			}
-			else
-			{
-				lastMinute = currentMinute;
-				eventsThisMinute = 0;
-			}
-			eventsThisMinute++;
-		}
-		else
-		{
-			static system_tick_t recent_event_ticks[5] =
-			{ (system_tick_t) -1000, (system_tick_t) -1000,
-					(system_tick_t) -1000, (system_tick_t) -1000,
-					(system_tick_t) -1000 };
-			static int evt_tick_idx = 0;
-
-			system_tick_t now = recent_event_ticks[evt_tick_idx] = millis;
-			evt_tick_idx++;
-			evt_tick_idx %= 5;
-			if (now - recent_event_ticks[evt_tick_idx] < 1000)
-			{
-				// exceeded allowable burst of 4 events per second
-				return true;
-			}
-		}
-		return false;
+		return blockwise.sender.isActive();
 	}
 
-	ProtocolError send_event(MessageChannel& channel, const char* event_name,
-			const char* data, int ttl, EventType::Enum event_type, int flags,
-			system_tick_t time, CompletionHandler handler);
+	size_t queued_event_count() const
+	{
+		return queue_size;
+	}
 
 private:
+	struct QueuedEvent
+	{
+		QueuedEvent* next;
+		CompletionHandler handler;
+		std::unique_ptr<char[]> data;
+		size_t data_size;
+		int ttl;
+		int flags;
+		EventType::Enum event_type;
+		bool system;
+		char name[MAX_EVENT_NAME_LENGTH + 1];
+	};
+
+	struct BlockwiseEvent
+	{
+		CoapBlockSender sender;
+		CompletionHandler handler;
+		system_tick_t ack_time; // Time the last block was acknowledged
+		int ttl;
+		EventType::Enum event_type;
+		char name[MAX_EVENT_NAME_LENGTH + 1];
+	};
+
 	Protocol* protocol;
+	BlockwiseEvent blockwise;
+	TokenBucket user_bucket;
+	TokenBucket system_bucket;
+	QueuedEvent* queue;
+	size_t queue_size;
+
+	TokenBucket& bucket(bool is_system_event)
+	{
+		return is_system_event ? system_bucket : user_bucket;
+	}
+
+	ProtocolError send(MessageChannel& channel, const char* event_name, const char* data,
+			size_t data_size, int ttl, EventType::Enum event_type, int flags, system_tick_t time,
+			CompletionHandler&& handler);
+	ProtocolError send_blockwise(MessageChannel& channel, const char* event_name, const char* data,
+			size_t data_size, int ttl, EventType::Enum event_type, system_tick_t time, CompletionHandler&& handler);
+	ProtocolError send_blocks(MessageChannel& channel);
+	void complete_blockwise(int error);
+	ProtocolError enqueue(const char* event_name, const char* data, size_t data_size, int ttl,
+			EventType::Enum event_type, int flags, bool is_system_event, CompletionHandler&& handler);
+	bool has_queued_events(bool is_system_event) const;
 
 	void add_ack_handler(message_id_t msg_id, CompletionHandler handler);
 };
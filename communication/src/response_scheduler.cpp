@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "response_scheduler.h"
+
+#include "messages.h"
+#include "coap.h"
+#include "communication_diagnostic.h"
+
+namespace particle {
+
+namespace protocol {
+
+const system_tick_t ResponseScheduler::DEFAULT_ACK_WINDOW;
+const size_t ResponseScheduler::MAX_PENDING_ACKS;
+
+ResponseScheduler::ResponseScheduler(MessageChannel& channel) :
+        stats_(),
+        channel_(channel),
+        millis_(nullptr),
+        count_(0),
+        window_(DEFAULT_ACK_WINDOW) {
+}
+
+void ResponseScheduler::init(system_tick_t (*millis)()) {
+    millis_ = millis;
+    count_ = 0;
+}
+
+ProtocolError ResponseScheduler::defer_ack(Message& msg, message_id_t id, token_t token) {
+    if (!window_ || !millis_ || find_by_token(token) >= 0) {
+        // Send the ACK immediately. If there's already a held ACK for a request with the same
+        // token, it wouldn't be clear which request a response belongs to
+        return send_empty_ack(msg, id);
+    }
+    if (count_ == MAX_PENDING_ACKS) {
+        // Make room by sending the oldest ACK
+        const ProtocolError error = send_held_ack(msg, 0);
+        if (error != ProtocolError::NO_ERROR) {
+            return error;
+        }
+    }
+    auto& ack = acks_[count_++];
+    ack.id = id;
+    ack.token = token;
+    ack.time = millis_();
+    ++stats_.deferred_acks;
+    return ProtocolError::NO_ERROR;
+}
+
+ProtocolError ResponseScheduler::send_response(Message& msg, token_t token) {
+    const int index = find_by_token(token);
+    if (index >= 0 && msg.length() >= 4) {
+        // Convert the separate response to a piggybacked one
+        const auto buf = msg.buf();
+        buf[0] = (buf[0] & ~0x30) | (CoAPType::ACK << 4);
+        msg.set_id(acks_[index].id);
+        remove(index);
+        const ProtocolError error = channel_.send(msg);
+        if (error == ProtocolError::NO_ERROR) {
+            ++stats_.piggybacked_responses;
+            g_piggybackedResponseCounter++;
+        }
+        return error;
+    }
+    return channel_.send(msg);
+}
+
+ProtocolError ResponseScheduler::flush(message_id_t id) {
+    const int index = find_by_id(id);
+    if (index < 0) {
+        return ProtocolError::NO_ERROR;
+    }
+    Message msg;
+    const ProtocolError error = channel_.create(msg);
+    if (error != ProtocolError::NO_ERROR) {
+        return error;
+    }
+    return send_held_ack(msg, index);
+}
+
+ProtocolError ResponseScheduler::flush() {
+    while (count_ > 0) {
+        Message msg;
+        ProtocolError error = channel_.create(msg);
+        if (error == ProtocolError::NO_ERROR) {
+            error = send_held_ack(msg, 0);
+        }
+        if (error != ProtocolError::NO_ERROR) {
+            return error;
+        }
+    }
+    return ProtocolError::NO_ERROR;
+}
+
+ProtocolError ResponseScheduler::process() {
+    if (!count_) {
+        return ProtocolError::NO_ERROR;
+    }
+    const system_tick_t now = millis_();
+    // ACKs are stored in the order in which they were deferred
+    while (count_ > 0 && now - acks_[0].time >= window_) {
+        Message msg;
+        ProtocolError error = channel_.create(msg);
+        if (error == ProtocolError::NO_ERROR) {
+            error = send_held_ack(msg, 0);
+        }
+        if (error != ProtocolError::NO_ERROR) {
+            return error;
+        }
+    }
+    return ProtocolError::NO_ERROR;
+}
+
+ProtocolError ResponseScheduler::send_held_ack(Message& msg, size_t index) {
+    const message_id_t id = acks_[index].id;
+    remove(index);
+    ++stats_.empty_acks;
+    return send_empty_ack(msg, id);
+}
+
+ProtocolError ResponseScheduler::send_empty_ack(Message& msg, message_id_t id) {
+    msg.set_length(Messages::empty_ack(msg.buf(), 0, 0));
+    msg.set_id(id);
+    return channel_.send(msg);
+}
+
+void ResponseScheduler::remove(size_t index) {
+    for (size_t i = index + 1; i < count_; ++i) {
+        acks_[i - 1] = acks_[i];
+    }
+    --count_;
+}
+
+int ResponseScheduler::find_by_id(message_id_t id) const {
+    for (size_t i = 0; i < count_; ++i) {
+        if (acks_[i].id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int ResponseScheduler::find_by_token(token_t token) const {
+    for (size_t i = 0; i < count_; ++i) {
+        if (acks_[i].token == token) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+} // namespace protocol
+
+} // namespace particle
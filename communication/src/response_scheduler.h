@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "message_channel.h"
+#include "protocol_defs.h"
+
+namespace particle {
+
+namespace protocol {
+
+/**
+ * Coalesces the acknowledgement of a confirmable request with the response to that request.
+ *
+ * Rather than sending an empty ACK immediately and the response separately, the ACK is held for
+ * a short window. If the response is ready within that window, it is sent piggybacked in the ACK,
+ * which saves a DTLS record and a radio transmission. Otherwise, the empty ACK is sent when the
+ * window expires and the response is sent as a separate message.
+ */
+class ResponseScheduler {
+public:
+    /**
+     * Default time in milliseconds for which an ACK is held.
+     *
+     * This needs to be well below the server's ACK timeout, so that the request is not retransmitted.
+     */
+    static const system_tick_t DEFAULT_ACK_WINDOW = 100;
+
+    /**
+     * Maximum number of ACKs that can be held at the same time.
+     */
+    static const size_t MAX_PENDING_ACKS = 4;
+
+    struct Stats {
+        unsigned deferred_acks; ///< Number of ACKs that were held.
+        unsigned piggybacked_responses; ///< Number of responses sent in an ACK, i.e. records saved.
+        unsigned empty_acks; ///< Number of empty ACKs sent for held requests.
+    };
+
+    explicit ResponseScheduler(MessageChannel& channel);
+
+    /**
+     * Sets the function used to get the current time.
+     *
+     * The ACK window is not changed.
+     */
+    void init(system_tick_t (*millis)());
+
+    /**
+     * Sets the ACK window.
+     *
+     * A window of 0 disables the coalescing.
+     */
+    void set_window(system_tick_t window) {
+        window_ = window;
+    }
+
+    system_tick_t window() const {
+        return window_;
+    }
+
+    /**
+     * Schedules an empty ACK for a confirmable request.
+     *
+     * @param msg Message buffer that is used if an ACK needs to be sent immediately.
+     * @param id ID of the request message.
+     * @param token Token of the request.
+     */
+    ProtocolError defer_ack(Message& msg, message_id_t id, token_t token);
+
+    /**
+     * Sends a response to a request.
+     *
+     * The message needs to be a separate response with the request's token. If the ACK for the
+     * request is still held, the message is converted to a piggybacked response.
+     */
+    ProtocolError send_response(Message& msg, token_t token);
+
+    /**
+     * Sends the held ACK for the request with the given ID, if any.
+     */
+    ProtocolError flush(message_id_t id);
+
+    /**
+     * Sends all held ACKs.
+     *
+     * This method should be called before the session is reset or the device goes to sleep, so
+     * that the server doesn't need to retransmit the requests.
+     */
+    ProtocolError flush();
+
+    /**
+     * Returns `true` if the ACK for the request with the given ID is being held.
+     */
+    bool has_pending_ack(message_id_t id) const {
+        return find_by_id(id) >= 0;
+    }
+
+    size_t pending_ack_count() const {
+        return count_;
+    }
+
+    /**
+     * Sends the ACKs whose window has expired.
+     */
+    ProtocolError process();
+
+    /**
+     * Discards all held ACKs.
+     */
+    void reset() {
+        count_ = 0;
+    }
+
+    const Stats& stats() const {
+        return stats_;
+    }
+
+private:
+    struct PendingAck {
+        message_id_t id;
+        token_t token;
+        system_tick_t time;
+    };
+
+    PendingAck acks_[MAX_PENDING_ACKS];
+    Stats stats_;
+    MessageChannel& channel_;
+    system_tick_t (*millis_)();
+    size_t count_;
+    system_tick_t window_;
+
+    ProtocolError send_held_ack(Message& msg, size_t index);
+    ProtocolError send_empty_ack(Message& msg, message_id_t id);
+    void remove(size_t index);
+
+    int find_by_id(message_id_t id) const;
+    int find_by_token(token_t token) const;
+};
+
+} // namespace protocol
+
+} // namespace particle
@@ -229,6 +229,10 @@ int spark_protocol_set_connection_property(ProtocolFacade* protocol, unsigned pr
         protocol->set_max_transmit_message_size(value);
         return 0;
     }
+    case Connection::ACK_WINDOW: {
+        protocol->set_ack_window(value);
+        return 0;
+    }
     default:
         return ProtocolError::NOT_IMPLEMENTED;
     }
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "system_tick_hal.h"
+
+namespace particle {
+
+namespace protocol {
+
+/**
+ * Token bucket rate limiter.
+ *
+ * The bucket holds up to `capacity` tokens and gains one token every `interval` milliseconds.
+ * The bucket is full initially.
+ */
+class TokenBucket {
+public:
+    TokenBucket(unsigned capacity, system_tick_t interval) :
+            capacity_(capacity),
+            tokens_(capacity),
+            interval_(interval),
+            last_(0),
+            started_(false) {
+    }
+
+    /**
+     * Takes a token from the bucket.
+     *
+     * @return `true` if a token was available, or `false` otherwise.
+     */
+    bool take(system_tick_t now) {
+        refill(now);
+        if (!tokens_) {
+            return false;
+        }
+        --tokens_;
+        return true;
+    }
+
+    /**
+     * Returns the number of tokens available at the given time.
+     */
+    unsigned available(system_tick_t now) {
+        refill(now);
+        return tokens_;
+    }
+
+    /**
+     * Returns the time in milliseconds until the next token becomes available.
+     */
+    system_tick_t wait_time(system_tick_t now) {
+        refill(now);
+        return tokens_ ? 0 : interval_ - (now - last_);
+    }
+
+    unsigned capacity() const {
+        return capacity_;
+    }
+
+    system_tick_t interval() const {
+        return interval_;
+    }
+
+    void reset() {
+        tokens_ = capacity_;
+        started_ = false;
+    }
+
+private:
+    unsigned capacity_;
+    unsigned tokens_;
+    system_tick_t interval_;
+    system_tick_t last_;
+    bool started_;
+
+    void refill(system_tick_t now) {
+        if (!started_) {
+            last_ = now;
+            started_ = true;
+            return;
+        }
+        // Unsigned arithmetic handles the wrap-around of the tick counter
+        const system_tick_t n = (now - last_) / interval_;
+        if (!n) {
+            return;
+        }
+        if (n >= capacity_ - tokens_) {
+            tokens_ = capacity_;
+            last_ = now;
+        } else {
+            tokens_ += n;
+            last_ += n * interval_;
+        }
+    }
+};
+
+} // namespace protocol
+
+} // namespace particle
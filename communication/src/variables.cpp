@@ -19,10 +19,13 @@
 
 #include "protocol.h"
 #include "messages.h"
+#include "coap_message_encoder.h"
+#include "coap_message_decoder.h"
 
 #include "endian_util.h"
 
 #include <memory>
+#include <algorithm>
 #include <cstring>
 
 namespace particle {
@@ -30,38 +33,46 @@ namespace particle {
 namespace protocol {
 
 struct Variables::Context {
-    Context(Variables* self, token_t token) :
+    Context(Variables* self, token_t token, const Block& block) :
             self(self),
-            token(token) {
+            token(token),
+            block(block) {
     }
 
     Variables* self;
     token_t token;
+    Block block;
 };
 
 ProtocolError Variables::handle_request(Message& message, token_t token, message_id_t id) {
-    char key[MAX_VARIABLE_KEY_LENGTH + 1];
-    auto result = decode_request(message, key);
+    // The Block2 option needs to be decoded before the key is terminated in place
+    Block block = {};
+    auto result = decode_block(message, &block);
+    const char* key = nullptr;
+    if (result == ProtocolError::NO_ERROR) {
+        result = decode_request(message, &key);
+    }
     if (result != ProtocolError::NO_ERROR) {
         return send_error_ack(message, token, id, CoAPCode::BAD_REQUEST);
     }
     if (protocol_->getDescriptor().get_variable_async) {
-        result = handle_request(message, token, id, key);
+        result = handle_request(message, token, id, key, block);
     } else {
         // Use the compatibility callback
-        result = handle_request_compat(message, token, id, key);
+        result = handle_request_compat(message, token, id, key, block);
     }
     return result;
 }
 
-ProtocolError Variables::handle_request(Message& message, token_t token, message_id_t id, const char* key) {
+ProtocolError Variables::handle_request(Message& message, token_t token, message_id_t id, const char* key,
+        const Block& block) {
     // Allocate a context for the request
-    std::unique_ptr<Context> ctx(new(std::nothrow) Context(this, token));
+    std::unique_ptr<Context> ctx(new(std::nothrow) Context(this, token, block));
     if (!ctx) {
         return send_error_ack(message, token, id, CoAPCode::INTERNAL_SERVER_ERROR);
     }
     // Acknowledge the request
-    const auto result = send_empty_ack(message, id);
+    const auto result = protocol_->getResponseScheduler().defer_ack(message, id, token);
     if (result != ProtocolError::NO_ERROR) {
         return result;
     }
@@ -71,7 +82,8 @@ ProtocolError Variables::handle_request(Message& message, token_t token, message
     return ProtocolError::NO_ERROR;
 }
 
-ProtocolError Variables::handle_request_compat(Message& message, token_t token, message_id_t id, const char* key) {
+ProtocolError Variables::handle_request_compat(Message& message, token_t token, message_id_t id, const char* key,
+        const Block& block) {
     const auto& descriptor = protocol_->getDescriptor();
     const auto value = descriptor.get_variable(key);
     if (!value) {
@@ -100,19 +112,21 @@ ProtocolError Variables::handle_request_compat(Message& message, token_t token,
         // Unsupported variable type
         return send_error_ack(message, token, id, CoAPCode::INTERNAL_SERVER_ERROR);
     }
+    if (!is_valid_block(block, value_size)) {
+        return send_error_ack(message, token, id, CoAPCode::BAD_OPTION);
+    }
     // Acknowledge the request
-    const auto result = send_empty_ack(message, id);
+    const auto result = protocol_->getResponseScheduler().defer_ack(message, id, token);
     if (result != ProtocolError::NO_ERROR) {
         return result;
     }
     // Send a separate response
-    return send_response(token, value, value_size, value_type);
+    return send_response(token, value, value_size, value_type, block);
 }
 
-ProtocolError Variables::decode_request(Message& message, char* key) {
+ProtocolError Variables::decode_request(Message& message, const char** key) {
     uint8_t* queue = message.buf();
     uint8_t queue_offset = 8;
-    // copy the variable key
     size_t key_length;
     if (queue[7] == 0x0d) {
         key_length = 0x0d + (queue[8] & 0xFF);
@@ -120,11 +134,41 @@ ProtocolError Variables::decode_request(Message& message, char* key) {
     } else {
         key_length = queue[7] & 0x0F;
     }
+    if (queue_offset + key_length > message.length()) {
+        return ProtocolError::MALFORMED_MESSAGE;
+    }
     if (key_length > MAX_VARIABLE_KEY_LENGTH) {
         key_length = MAX_VARIABLE_KEY_LENGTH;
     }
-    memcpy(key, queue + queue_offset, key_length);
-    memset(key + key_length, 0, MAX_VARIABLE_KEY_LENGTH - key_length + 1);
+    // Rather than copying the key, move it one byte back, over its option header, to make room for
+    // the terminator. The byte following the key cannot be used as it may belong to the part of
+    // the buffer where the response is created
+    char* k = (char*)queue + queue_offset - 1;
+    memmove(k, k + 1, key_length);
+    k[key_length] = '\0';
+    *key = k;
+    return ProtocolError::NO_ERROR;
+}
+
+ProtocolError Variables::decode_block(Message& message, Block* block) {
+    CoapMessageDecoder d;
+    if (d.decode((const char*)message.buf(), message.length()) < 0) {
+        return ProtocolError::MALFORMED_MESSAGE;
+    }
+    unsigned num = 0;
+    size_t size = 0;
+    const int r = d.blockOption(CoapOption::BLOCK2, &num, nullptr /* more */, &size);
+    if (r == SYSTEM_ERROR_NOT_FOUND) {
+        // Not a block-wise transfer
+        block->num = 0;
+        block->size = 0;
+        return ProtocolError::NO_ERROR;
+    }
+    if (r < 0) {
+        return ProtocolError::MALFORMED_MESSAGE;
+    }
+    block->num = num;
+    block->size = size;
     return ProtocolError::NO_ERROR;
 }
 
@@ -170,24 +214,77 @@ ProtocolError Variables::encode_response(Message& message, token_t token, const
     return ProtocolError::NO_ERROR;
 }
 
+ProtocolError Variables::encode_block_response(Message& message, token_t token, const char* value, size_t value_size,
+        const Block& block) {
+    // The block is sliced directly from the value data, so serving a large variable doesn't
+    // require any additional memory
+    // If the block size requested by the server is too large, the block at the requested offset is
+    // sent using a smaller size and renumbered accordingly (RFC 7959, 2.2)
+    const size_t size = block_size(block);
+    const size_t offs = block.num * block.size;
+    const unsigned num = offs / size;
+    const size_t n = std::min(size, value_size - offs);
+    const bool more = offs + n < value_size;
+    auto& channel = protocol_->getChannel();
+    CoapMessageEncoder e((char*)message.buf(), message.capacity());
+    e.type(channel.is_unreliable() ? CoapType::CON : CoapType::NON);
+    e.code(CoapCode::CONTENT);
+    e.id(0); // Will be assigned by the message channel
+    e.token((const char*)&token, sizeof(token));
+    e.blockOption(CoapOption::BLOCK2, num, more, size);
+    if (num == 0) {
+        e.option(CoapOption::SIZE2, (unsigned)value_size);
+    }
+    e.payload(value + offs, n);
+    const int r = e.encode();
+    if (r < 0 || (size_t)r > message.capacity()) {
+        return ProtocolError::INSUFFICIENT_STORAGE;
+    }
+    message.set_length(r);
+    return ProtocolError::NO_ERROR;
+}
+
+size_t Variables::block_size(const Block& block) const {
+    auto n = protocol_->get_max_variable_value_size();
+    n = (n > MAX_VARIABLE_BLOCK_OPTIONS_SIZE) ? n - MAX_VARIABLE_BLOCK_OPTIONS_SIZE : 0;
+    // Use the block size requested by the server unless it's too large
+    return std::min(block.size, coapBlockSizeFloor(n));
+}
+
+bool Variables::is_valid_block(const Block& block, size_t value_size) const {
+    if (!block.size) {
+        return true; // Not a block-wise transfer
+    }
+    const size_t size = block_size(block);
+    return size && (block.num == 0 || block.num * block.size < value_size);
+}
+
 size_t Variables::encode_response(uint8_t* buffer, token_t token, const void* value, size_t value_size) {
     auto& channel = protocol_->getChannel();
     return Messages::separate_response_with_payload(buffer, 0 /* message_id */, token, CoAPCode::CONTENT,
             (const uint8_t*)value, value_size, channel.is_unreliable());
 }
 
-ProtocolError Variables::send_response(token_t token, const void* value, size_t value_size, SparkReturnType::Enum value_type) {
+ProtocolError Variables::send_response(token_t token, const void* value, size_t value_size, SparkReturnType::Enum value_type,
+        const Block& block) {
     Message msg;
     auto& channel = protocol_->getChannel();
     ProtocolError result = channel.create(msg);
     if (result != ProtocolError::NO_ERROR) {
         return result;
     }
-    result = encode_response(msg, token, value, value_size, value_type);
+    if (block.size && value_type == SparkReturnType::STRING) {
+        if (!is_valid_block(block, value_size)) {
+            return send_error_response(msg, token, CoAPCode::BAD_OPTION);
+        }
+        result = encode_block_response(msg, token, (const char*)value, value_size, block);
+    } else {
+        result = encode_response(msg, token, value, value_size, value_type);
+    }
     if (result != ProtocolError::NO_ERROR) {
         return send_error_response(msg, token, CoAPCode::INTERNAL_SERVER_ERROR);
     }
-    return channel.send(msg);
+    return protocol_->getResponseScheduler().send_response(msg, token);
 }
 
 ProtocolError Variables::send_error_response(token_t token, uint8_t code) {
@@ -204,15 +301,7 @@ ProtocolError Variables::send_error_response(Message& message, token_t token, ui
     auto& channel = protocol_->getChannel();
     const size_t size = Messages::separate_response(message.buf(), 0 /* message_id */, token, code, channel.is_unreliable());
     message.set_length(size);
-    return channel.send(message);
-}
-
-ProtocolError Variables::send_empty_ack(Message& message, message_id_t id) {
-    const auto buf = message.buf();
-    const size_t size = Messages::coded_ack(buf, CoAPCode::NONE, 0 /* message_id_msb */, 0 /* message_id_lsb */);
-    message.set_length(size);
-    message.set_id(id);
-    return protocol_->getChannel().send(message);
+    return protocol_->getResponseScheduler().send_response(message, token);
 }
 
 ProtocolError Variables::send_error_ack(Message& message, token_t token, message_id_t id, uint8_t code) {
@@ -229,9 +318,12 @@ void Variables::get_variable_callback(int result, int type, void* data, size_t s
         const auto code = CoAP::codeForProtocolError((ProtocolError)result);
         p->self->send_error_response(p->token, code);
     } else {
-        p->self->send_response(p->token, data, size, (SparkReturnType::Enum)type);
+        p->self->send_response(p->token, data, size, (SparkReturnType::Enum)type, p->block);
+    }
+    // Values of the fixed-size types are owned by the caller
+    if (type != SparkReturnType::INT && type != SparkReturnType::DOUBLE && type != SparkReturnType::BOOLEAN) {
+        free(data);
     }
-    free(data);
     delete p;
 }
 
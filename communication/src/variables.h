@@ -42,22 +42,35 @@ public:
 private:
     struct Context;
 
+    /**
+     * Block of a variable value requested by the server (RFC 7959).
+     */
+    struct Block {
+        unsigned num; // Block number
+        size_t size; // Block size, or 0 if the request has no Block2 option
+    };
+
     Protocol* protocol_;
 
-    ProtocolError handle_request(Message& message, token_t token, message_id_t id, const char* key);
-    ProtocolError handle_request_compat(Message& message, token_t token, message_id_t id, const char* key);
+    ProtocolError handle_request(Message& message, token_t token, message_id_t id, const char* key, const Block& block);
+    ProtocolError handle_request_compat(Message& message, token_t token, message_id_t id, const char* key, const Block& block);
 
-    ProtocolError decode_request(Message& message, char* key);
+    ProtocolError decode_request(Message& message, const char** key);
+    ProtocolError decode_block(Message& message, Block* block);
     ProtocolError encode_response(Message& message, token_t token, const void* value, size_t value_size, SparkReturnType::Enum value_type);
+    ProtocolError encode_block_response(Message& message, token_t token, const char* value, size_t value_size, const Block& block);
     size_t encode_response(uint8_t* buffer, token_t token, const void* value, size_t value_size);
 
-    ProtocolError send_response(token_t token, const void* value, size_t value_size, SparkReturnType::Enum value_type);
+    ProtocolError send_response(token_t token, const void* value, size_t value_size, SparkReturnType::Enum value_type,
+            const Block& block);
     ProtocolError send_error_response(token_t token, uint8_t code);
     ProtocolError send_error_response(Message& message, token_t token, uint8_t code);
 
-    ProtocolError send_empty_ack(Message& message, message_id_t id);
     ProtocolError send_error_ack(Message& message, token_t token, message_id_t id, uint8_t code);
 
+    size_t block_size(const Block& block) const;
+    bool is_valid_block(const Block& block, size_t value_size) const;
+
     static void get_variable_callback(int result, int type, void* data, size_t size, void* context); // SparkDescriptor::GetVariableCallback
 };
 
@@ -19,6 +19,7 @@
 #define ADC_HAL_H
 
 #include "pinmap_hal.h"
+#include <stddef.h>
 
 typedef enum hal_adc_state_t {
     HAL_ADC_STATE_DISABLED,
@@ -26,15 +27,70 @@ typedef enum hal_adc_state_t {
     HAL_ADC_STATE_SUSPENDED
 } hal_adc_state_t;
 
+/**
+ * Callback invoked when a block of samples has been acquired.
+ *
+ * The callback is invoked in an ISR context. The samples are interleaved, one sample per pin for
+ * each scan, and remain valid until the callback returns.
+ *
+ * @param samples Samples.
+ * @param count Number of samples.
+ * @param context User data.
+ */
+typedef void (*hal_adc_stream_callback)(const int16_t* samples, size_t count, void* context);
+
+/**
+ * Configuration of a continuous ADC acquisition.
+ */
+typedef struct hal_adc_stream_config {
+    uint16_t size; ///< Size of this structure.
+    uint16_t version; ///< Version of this structure.
+    const pin_t* pins; ///< Pins to scan.
+    uint8_t pin_count; ///< Number of pins.
+    uint32_t sample_rate; ///< Number of scans per second.
+    int16_t* buffer; ///< Buffer for two blocks of samples.
+    size_t block_size; ///< Number of samples in a block. Must be a multiple of the number of pins.
+    hal_adc_stream_callback callback; ///< Block callback.
+    void* context; ///< User data passed to the callback.
+} hal_adc_stream_config;
+
+#define HAL_ADC_STREAM_CONFIG_VERSION_1 (1)
+#define HAL_ADC_STREAM_CONFIG_VERSION (HAL_ADC_STREAM_CONFIG_VERSION_1)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void hal_adc_set_sample_time(uint8_t sample_time);
+
+/**
+ * Reads a single sample.
+ *
+ * @return Sample value, or `SYSTEM_ERROR_BUSY` if a continuous acquisition is in progress (see
+ *         `hal_adc_stream_start()`).
+ */
 int32_t hal_adc_read(pin_t pin);
 void hal_adc_dma_init();
 int hal_adc_sleep(bool sleep, void* reserved);
 
+/**
+ * Starts a continuous acquisition.
+ *
+ * Conversions are triggered by a hardware timer at the configured rate and the samples are
+ * transferred via DMA. While the callback is processing one half of the buffer, the other half is
+ * being filled.
+ *
+ * @return 0 on success, or a negative result code in case of an error.
+ */
+int hal_adc_stream_start(const hal_adc_stream_config* conf, void* reserved);
+
+/**
+ * Stops a continuous acquisition.
+ *
+ * @return 0 on success, or a negative result code in case of an error.
+ */
+int hal_adc_stream_stop(void* reserved);
+
 
 #include "adc_hal_compat.h"
 
@@ -89,6 +89,8 @@ DYNALIB_FN(36, hal_gpio, HAL_Set_Direct_Interrupt_Handler, int(IRQn_Type irqn, H
 DYNALIB_FN(37, hal_gpio, hal_adc_sleep, int(bool, void*))
 DYNALIB_FN(38, hal_gpio, hal_pwm_sleep, int(bool, void*))
 DYNALIB_FN(39, hal_gpio, HAL_Pin_Configure, int(pin_t, const hal_gpio_config_t*, void*))
+DYNALIB_FN(40, hal_gpio, hal_adc_stream_start, int(const hal_adc_stream_config*, void*))
+DYNALIB_FN(41, hal_gpio, hal_adc_stream_stop, int(void*))
 
 DYNALIB_END(hal_gpio)
 
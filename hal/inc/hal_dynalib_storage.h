@@ -28,5 +28,6 @@ DYNALIB_BEGIN(hal_storage)
 DYNALIB_FN(0, hal_storage, hal_storage_read, int(hal_storage_id, uintptr_t, uint8_t*, size_t))
 DYNALIB_FN(1, hal_storage, hal_storage_write, int(hal_storage_id, uintptr_t, const uint8_t*, size_t))
 DYNALIB_FN(2, hal_storage, hal_storage_erase, int(hal_storage_id, uintptr_t, size_t))
+DYNALIB_FN(3, hal_storage, hal_storage_get_region_info, int(hal_storage_region_id, hal_storage_region_info*, void*))
 
 DYNALIB_END(hal_storage)
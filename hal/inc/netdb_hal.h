@@ -25,6 +25,7 @@
 #define NETDB_HAL_H
 
 #include "netdb_hal_impl.h"
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -46,6 +47,18 @@ extern "C" {
 #define NI_NUMERICSERV AI_NUMERICSERV
 #endif /* NI_NUMERICHOST */
 
+/**
+ * DNS cache statistics.
+ */
+typedef struct netdb_cache_stats {
+    uint16_t size; ///< Size of this structure.
+    uint16_t reserved; ///< Reserved.
+    uint32_t hits; ///< Number of lookups answered from the cache, including negative answers.
+    uint32_t misses; ///< Number of lookups that required a DNS query.
+    uint32_t prefetches; ///< Number of cache entries refreshed before they expired.
+    uint32_t entries; ///< Number of entries in the cache.
+} netdb_cache_stats;
+
 /**
  * Gets the IPv4 address for the given hostname.
  *
@@ -107,6 +120,16 @@ int netdb_getaddrinfo(const char* hostname, const char* servname,
 int netdb_getnameinfo(const struct sockaddr* sa, socklen_t salen, char* host,
                       socklen_t hostlen, char* serv, socklen_t servlen, int flags);
 
+/**
+ * Gets the DNS cache statistics.
+ *
+ * @param[out] stats     the statistics
+ * @param      reserved  reserved argument, should be set to NULL
+ *
+ * @returns    0 on success or a negative result code in case of failure.
+ */
+int netdb_get_cache_stats(netdb_cache_stats* stats, void* reserved);
+
 /**
  * @}
  *
@@ -99,6 +99,12 @@ typedef struct {
  * The Device Serial Number and Device Secret are not added as keys when this flag is set.
  */
 #define HAL_SYSTEM_INFO_FLAGS_CLOUD (0x01)
+/**
+ * The flag indicates that the caller doesn't need the result of the module integrity checks.
+ * The platform may skip the CRC verification of the modules, in which case `MODULE_VALIDATION_INTEGRITY`
+ * is not set in `validity_checked`.
+ */
+#define HAL_SYSTEM_INFO_FLAGS_SKIP_INTEGRITY (0x02)
 
 /**
  *
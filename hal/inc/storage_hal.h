@@ -31,10 +31,36 @@ typedef enum hal_storage_id {
     HAL_STORAGE_ID_MAX = 0x7fffffff
 } hal_storage_id;
 
+typedef enum hal_storage_region_id {
+    HAL_STORAGE_REGION_INVALID = 0,
+    HAL_STORAGE_REGION_ASSET_BUNDLE = 1, // Read-only asset bundle
+    HAL_STORAGE_REGION_MAX = 0x7fffffff
+} hal_storage_region_id;
+
+typedef struct hal_storage_region_info {
+    uint16_t size; // Size of this structure
+    uint16_t reserved;
+    hal_storage_id storage; // Storage the region is located in
+    uintptr_t address; // Start address of the region, as accepted by hal_storage_read()
+    size_t length; // Length of the region
+    uintptr_t xip_address; // Memory-mapped address of the region, or 0 if the storage is not memory-mapped
+} hal_storage_region_info;
+
 int hal_storage_read(hal_storage_id id, uintptr_t addr, uint8_t* buf, size_t size);
 int hal_storage_write(hal_storage_id id, uintptr_t addr, const uint8_t* buf, size_t size);
 int hal_storage_erase(hal_storage_id id, uintptr_t addr, size_t size);
 
+/**
+ * Get the location of a storage region.
+ *
+ * @param id Region ID.
+ * @param[in,out] info Region info. The `size` field needs to be set to the size of the structure by the
+ *        caller. On return, it's set to the size of the structure version that has been filled in.
+ * @param reserved Reserved argument (should be set to NULL).
+ * @return 0 on success, or a negative result code in case of an error.
+ */
+int hal_storage_get_region_info(hal_storage_region_id id, hal_storage_region_info* info, void* reserved);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -23,9 +23,111 @@
 
 /* netdb_hal_impl.h should get included from netdb_hal.h automagically */
 #include "netdb_hal.h"
+#include "dns_resolver.h"
+#include "resolvapi.h"
+#include "static_recursive_mutex.h"
+#include "system_error.h"
+#include "check.h"
 #include <lwip/sockets.h>
 #include <errno.h>
 #include <algorithm>
+#include <mutex>
+
+using namespace particle;
+
+namespace {
+
+const uint16_t DNS_PORT = 53;
+
+StaticRecursiveMutex g_dnsMutex;
+DnsResolver g_dnsResolver;
+
+bool isNumericHost(const char* hostname) {
+    ip_addr_t addr = {};
+    return ipaddr_aton(hostname, &addr);
+}
+
+int updateDnsServers() {
+    resolv_dns_servers* servers = nullptr;
+    if (resolv_get_dns_servers(&servers) != 0) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+    g_dnsResolver.clearServers();
+    for (auto s = servers; s != nullptr; s = s->next) {
+        if (s->server->sa_family == AF_INET) {
+            ((struct sockaddr_in*)s->server)->sin_port = lwip_htons(DNS_PORT);
+        } else {
+            ((struct sockaddr_in6*)s->server)->sin6_port = lwip_htons(DNS_PORT);
+        }
+        if (g_dnsResolver.addServer(s->server) < 0) {
+            break;
+        }
+    }
+    resolv_free_dns_servers(servers);
+    return 0;
+}
+
+/*
+ * Resolves the hostname using the caching resolver. Returns a negative result code if the request
+ * should be handled by lwIP instead
+ */
+int cachedGetAddrInfo(const char* hostname, const char* servname, const struct addrinfo* hints,
+        struct addrinfo** res) {
+    if (!hostname || !hints || (hints->ai_flags & AI_NUMERICHOST) ||
+            (hints->ai_family != AF_UNSPEC && hints->ai_family != AF_INET && hints->ai_family != AF_INET6) ||
+            isNumericHost(hostname)) {
+        return SYSTEM_ERROR_NOT_SUPPORTED;
+    }
+    // The lock is only held while the cache is accessed, so that a slow query doesn't block the
+    // lookups of other threads. A prefetched answer is stored in the cache by the next lookup
+    DnsResolver::Request req;
+    int r = 0;
+    {
+        std::lock_guard<StaticRecursiveMutex> lk(g_dnsMutex);
+        CHECK(updateDnsServers());
+        if (!g_dnsResolver.serverCount()) {
+            return SYSTEM_ERROR_INVALID_STATE;
+        }
+        r = CHECK(g_dnsResolver.lookup(&req, hostname, hints->ai_family));
+    }
+    if (r) {
+        DnsResolver::query(&req);
+    }
+    DnsAddress addrs[2] = {};
+    int count = 0;
+    {
+        std::lock_guard<StaticRecursiveMutex> lk(g_dnsMutex);
+        count = g_dnsResolver.complete(&req, addrs, sizeof(addrs) / sizeof(addrs[0]));
+    }
+    if (count < 0) {
+        if (count == SYSTEM_ERROR_NOT_FOUND || count == SYSTEM_ERROR_TIMEOUT || count == SYSTEM_ERROR_PROTOCOL) {
+            return EAI_FAIL;
+        }
+        return count;
+    }
+    /* Let lwIP allocate the results so that they can be freed with lwip_freeaddrinfo() */
+    struct addrinfo* first = nullptr;
+    struct addrinfo** next = &first;
+    for (int i = 0; i < count; ++i) {
+        char host[INET6_ADDRSTRLEN] = {};
+        if (!lwip_inet_ntop(addrs[i].family, addrs[i].addr, host, sizeof(host))) {
+            continue;
+        }
+        struct addrinfo h = *hints;
+        h.ai_family = addrs[i].family;
+        h.ai_flags |= AI_NUMERICHOST;
+        if (lwip_getaddrinfo(host, servname, &h, next) == 0 && *next) {
+            next = &(*next)->ai_next;
+        }
+    }
+    if (!first) {
+        return EAI_FAIL;
+    }
+    *res = first;
+    return 0;
+}
+
+} // namespace
 
 struct hostent* netdb_gethostbyname(const char *name) {
     return lwip_gethostbyname(name);
@@ -42,6 +144,10 @@ void netdb_freeaddrinfo(struct addrinfo* ai) {
 
 int netdb_getaddrinfo(const char* hostname, const char* servname,
                       const struct addrinfo* hints, struct addrinfo** res) {
+    const int r = cachedGetAddrInfo(hostname, servname, hints, res);
+    if (r >= 0) {
+        return r;
+    }
     /* Change the behavior when AF_UNSPEC is used */
     if (hints && hints->ai_family == AF_UNSPEC) {
         struct addrinfo h = *hints;
@@ -64,6 +170,19 @@ int netdb_getaddrinfo(const char* hostname, const char* servname,
     return lwip_getaddrinfo(hostname, servname, hints, res);
 }
 
+int netdb_get_cache_stats(netdb_cache_stats* stats, void* reserved) {
+    if (!stats) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    std::lock_guard<StaticRecursiveMutex> lk(g_dnsMutex);
+    const auto s = g_dnsResolver.cacheStats();
+    stats->hits = s.hits + s.negativeHits;
+    stats->misses = s.misses;
+    stats->prefetches = s.prefetches;
+    stats->entries = s.entries;
+    return 0;
+}
+
 int netdb_getnameinfo(const struct sockaddr* sa, socklen_t salen, char* host,
                       socklen_t hostlen, char* serv, socklen_t servlen, int flags) {
 
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wifi_network_index.h"
+
+#include "logging.h"
+#include "check.h"
+
+#include <algorithm>
+#include <cstring>
+
+LOG_SOURCE_CATEGORY("ncp.mgr")
+
+namespace particle {
+
+const uint16_t WifiNetworkIndex::VERSION;
+const unsigned WifiNetworkIndex::MAX_FAILURES;
+
+WifiNetworkIndex::WifiNetworkIndex(const char* fileName) :
+        data_(),
+        fileName_(fileName),
+        modified_(false) {
+    data_.version = VERSION;
+}
+
+int WifiNetworkIndex::load() {
+    data_ = Data();
+    data_.version = VERSION;
+    modified_ = false;
+    Data d = {};
+    const int r = SimpleFileStorage::load(fileName_, &d, sizeof(d));
+    if (r < 0 && r != SYSTEM_ERROR_BAD_DATA) {
+        return r;
+    }
+    if (r != sizeof(d) || d.version != VERSION || d.count > MAX_CONFIGURED_WIFI_NETWORK_COUNT) {
+        LOG(WARN, "Ignoring incompatible file: %s", fileName_);
+        return SYSTEM_ERROR_NOT_FOUND;
+    }
+    for (size_t i = 0; i < d.count; ++i) {
+        d.entries[i].ssid[MAX_SSID_SIZE] = '\0';
+    }
+    data_ = d;
+    return 0;
+}
+
+int WifiNetworkIndex::save() {
+    if (!modified_) {
+        return 0;
+    }
+    // The file has a fixed size, so that SimpleFileStorage can append the data instead of rewriting
+    // the file each time
+    CHECK(SimpleFileStorage::save(fileName_, &data_, sizeof(data_)));
+    modified_ = false;
+    return 0;
+}
+
+int WifiNetworkIndex::sync(const Vector<WifiNetworkConfig>& networks) {
+    for (size_t i = 0; i < data_.count;) {
+        const auto it = std::find_if(networks.begin(), networks.end(), [this, i](const WifiNetworkConfig& conf) {
+            return strcmp(conf.ssid(), data_.entries[i].ssid) == 0;
+        });
+        if (it == networks.end()) {
+            removeAt(i);
+        } else {
+            ++i;
+        }
+    }
+    for (const auto& conf: networks) {
+        if (!has(conf.ssid())) {
+            CHECK(add(conf.ssid()));
+        }
+    }
+    return 0;
+}
+
+int WifiNetworkIndex::add(const char* ssid) {
+    const size_t len = strlen(ssid);
+    CHECK_TRUE(len > 0 && len <= MAX_SSID_SIZE, SYSTEM_ERROR_INVALID_ARGUMENT);
+    auto e = entry(ssid);
+    if (e) {
+        if (e->failures) {
+            e->failures = 0;
+            modified_ = true;
+        }
+        return 0;
+    }
+    CHECK_TRUE(data_.count < MAX_CONFIGURED_WIFI_NETWORK_COUNT, SYSTEM_ERROR_LIMIT_EXCEEDED);
+    e = &data_.entries[data_.count++];
+    *e = Entry();
+    memcpy(e->ssid, ssid, len);
+    modified_ = true;
+    return 0;
+}
+
+void WifiNetworkIndex::remove(const char* ssid) {
+    const auto e = entry(ssid);
+    if (e) {
+        removeAt(e - data_.entries);
+    }
+}
+
+void WifiNetworkIndex::clear() {
+    if (data_.count) {
+        data_.count = 0;
+        modified_ = true;
+    }
+}
+
+int WifiNetworkIndex::priority(const char* ssid, int priority) {
+    CHECK_TRUE(priority >= 0 && priority <= 255, SYSTEM_ERROR_INVALID_ARGUMENT);
+    const auto e = entry(ssid);
+    CHECK_TRUE(e, SYSTEM_ERROR_NOT_FOUND);
+    if (e->priority != priority) {
+        e->priority = priority;
+        modified_ = true;
+    }
+    return 0;
+}
+
+int WifiNetworkIndex::priority(const char* ssid) const {
+    const auto e = entry(ssid);
+    CHECK_TRUE(e, SYSTEM_ERROR_NOT_FOUND);
+    return e->priority;
+}
+
+void WifiNetworkIndex::connected(const char* ssid) {
+    const auto e = entry(ssid);
+    if (!e) {
+        return;
+    }
+    // Avoid writing the file on every reconnection to the same network
+    if (!e->lastConnected || e->lastConnected != data_.lastConnected) {
+        e->lastConnected = ++data_.lastConnected;
+        modified_ = true;
+    }
+    if (e->failures >= MAX_FAILURES) {
+        modified_ = true; // Failures are only written to the file once the network is considered failing
+    }
+    e->failures = 0;
+}
+
+void WifiNetworkIndex::connectionFailed(const char* ssid) {
+    const auto e = entry(ssid);
+    if (e && e->failures < 0xff) {
+        ++e->failures;
+        if (e->failures == MAX_FAILURES) {
+            modified_ = true;
+        }
+    }
+}
+
+bool WifiNetworkIndex::isPreferred(const WifiScanResult& ap1, const WifiScanResult& ap2) const {
+    const auto e1 = entry(ap1.ssid());
+    const auto e2 = entry(ap2.ssid());
+    if (e1 && e2 && e1 != e2) {
+        if (isPreferred(*e1, *e2)) {
+            return true;
+        }
+        if (isPreferred(*e2, *e1)) {
+            return false;
+        }
+    }
+    return (ap1.rssi() > ap2.rssi()); // In descending order
+}
+
+void WifiNetworkIndex::sortCandidates(Vector<WifiScanResult>* aps) const {
+    for (int i = 0; i < aps->size();) {
+        if (!has(aps->at(i).ssid())) {
+            aps->removeAt(i);
+        } else {
+            ++i;
+        }
+    }
+    std::sort(aps->begin(), aps->end(), [this](const WifiScanResult& ap1, const WifiScanResult& ap2) {
+        return isPreferred(ap1, ap2);
+    });
+}
+
+const char* WifiNetworkIndex::mostPreferred() const {
+    if (!data_.count) {
+        return nullptr;
+    }
+    const Entry* e = &data_.entries[0];
+    for (size_t i = 1; i < data_.count; ++i) {
+        if (isPreferred(data_.entries[i], *e)) {
+            e = &data_.entries[i];
+        }
+    }
+    return e->ssid;
+}
+
+const char* WifiNetworkIndex::leastPreferred() const {
+    if (!data_.count) {
+        return nullptr;
+    }
+    const Entry* e = &data_.entries[0];
+    for (size_t i = 1; i < data_.count; ++i) {
+        if (!isPreferred(data_.entries[i], *e)) {
+            e = &data_.entries[i];
+        }
+    }
+    return e->ssid;
+}
+
+WifiNetworkIndex::Entry* WifiNetworkIndex::entry(const char* ssid) {
+    return const_cast<Entry*>(const_cast<const WifiNetworkIndex*>(this)->entry(ssid));
+}
+
+const WifiNetworkIndex::Entry* WifiNetworkIndex::entry(const char* ssid) const {
+    for (size_t i = 0; i < data_.count; ++i) {
+        if (strcmp(data_.entries[i].ssid, ssid) == 0) {
+            return &data_.entries[i];
+        }
+    }
+    return nullptr;
+}
+
+void WifiNetworkIndex::removeAt(size_t index) {
+    memmove(&data_.entries[index], &data_.entries[index + 1], (data_.count - index - 1) * sizeof(Entry));
+    --data_.count;
+    modified_ = true;
+}
+
+bool WifiNetworkIndex::isPreferred(const Entry& e1, const Entry& e2) {
+    const bool failing1 = e1.failures >= MAX_FAILURES;
+    const bool failing2 = e2.failures >= MAX_FAILURES;
+    if (failing1 != failing2) {
+        return failing2;
+    }
+    if (e1.priority != e2.priority) {
+        return e1.priority > e2.priority;
+    }
+    return e1.lastConnected > e2.lastConnected;
+}
+
+} // particle
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "wifi_network_manager.h"
+#include "simple_file_storage.h"
+
+#include "spark_wiring_vector.h"
+
+namespace particle {
+
+/**
+ * An index of the configured Wi-Fi networks.
+ *
+ * The index keeps the priority and connection history of each network in RAM, so that the access
+ * points found during a scan can be ordered without parsing the network settings. Networks with
+ * a higher priority are tried first, then the ones that were connected to most recently, then
+ * the ones with a stronger signal. A network that failed to connect several times in a row is
+ * tried after all other networks.
+ *
+ * Changes are kept in RAM until `save()` is called.
+ *
+ * The class doesn't do any locking.
+ */
+class WifiNetworkIndex {
+public:
+    /**
+     * Version of the file format.
+     */
+    static const uint16_t VERSION = 1;
+    /**
+     * Number of consecutive failures after which a network is tried last.
+     */
+    static const unsigned MAX_FAILURES = 3;
+
+    explicit WifiNetworkIndex(const char* fileName);
+
+    /**
+     * Loads the index from the file.
+     *
+     * The index is left empty if the file doesn't exist or was written by an incompatible version
+     * of this class.
+     *
+     * @return 0 on success, `SYSTEM_ERROR_NOT_FOUND` if there's no compatible index file, or
+     *         another negative result code in case of an error.
+     */
+    int load();
+    /**
+     * Writes the index to the file if it has been modified.
+     *
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int save();
+    bool isModified() const;
+
+    /**
+     * Adds the missing networks to the index and removes the networks that are not configured.
+     *
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int sync(const Vector<WifiNetworkConfig>& networks);
+    /**
+     * Adds a network to the index or resets its failure count if it's already there.
+     *
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int add(const char* ssid);
+    void remove(const char* ssid);
+    void clear();
+    bool has(const char* ssid) const;
+    size_t size() const;
+
+    /**
+     * Sets the priority of a network.
+     *
+     * @param ssid SSID.
+     * @param priority Priority (0 to 255). Networks with a higher priority are tried first.
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int priority(const char* ssid, int priority);
+    /**
+     * Returns the priority of a network, or a negative result code in case of an error.
+     */
+    int priority(const char* ssid) const;
+
+    /**
+     * Records a successful connection to a network.
+     *
+     * Reconnecting to the network that was connected to most recently doesn't modify the index.
+     */
+    void connected(const char* ssid);
+    /**
+     * Records a failed connection attempt.
+     *
+     * Failed attempts are only written to the file once the network is considered failing.
+     */
+    void connectionFailed(const char* ssid);
+
+    /**
+     * Returns `true` if the access point `ap1` should be tried before `ap2`.
+     *
+     * Both access points should belong to the networks in the index.
+     */
+    bool isPreferred(const WifiScanResult& ap1, const WifiScanResult& ap2) const;
+    /**
+     * Orders the access points found during a scan in the order in which they should be tried.
+     *
+     * Access points of the networks that are not in the index are removed.
+     */
+    void sortCandidates(Vector<WifiScanResult>* aps) const;
+    /**
+     * Returns the SSID of the network that should be tried first, or `nullptr` if the index is empty.
+     */
+    const char* mostPreferred() const;
+    /**
+     * Returns the SSID of the network that should be replaced when no more networks can be added,
+     * or `nullptr` if the index is empty.
+     */
+    const char* leastPreferred() const;
+
+private:
+    struct Entry {
+        char ssid[MAX_SSID_SIZE + 1];
+        uint8_t priority;
+        uint8_t failures;
+        uint8_t reserved;
+        uint32_t lastConnected; // Sequence number of the last successful connection
+    };
+
+    struct Data {
+        uint16_t version;
+        uint16_t count;
+        uint32_t lastConnected;
+        Entry entries[MAX_CONFIGURED_WIFI_NETWORK_COUNT];
+    };
+
+    Data data_;
+    const char* fileName_;
+    bool modified_;
+
+    Entry* entry(const char* ssid);
+    const Entry* entry(const char* ssid) const;
+    void removeAt(size_t index);
+
+    static bool isPreferred(const Entry& e1, const Entry& e2);
+};
+
+inline bool WifiNetworkIndex::isModified() const {
+    return modified_;
+}
+
+inline bool WifiNetworkIndex::has(const char* ssid) const {
+    return entry(ssid);
+}
+
+inline size_t WifiNetworkIndex::size() const {
+    return data_.count;
+}
+
+} // particle
@@ -16,6 +16,8 @@
  */
 
 #include "wifi_network_manager.h"
+#include "wifi_network_index.h"
+#include "wifi_scan_util.h"
 
 #include "wifi_ncp_client.h"
 
@@ -23,10 +25,12 @@
 #include "logging.h"
 #include "scope_guard.h"
 #include "check.h"
+#include "static_recursive_mutex.h"
 
 #include "spark_wiring_vector.h"
 
 #include <algorithm>
+#include <mutex>
 
 // FIXME: Move nanopb utilities to a common header file
 #include "../../../system/src/control/common.h"
@@ -38,6 +42,7 @@
 #define PB_WIFI(_name) particle_ctrl_wifi_##_name
 
 #define CONFIG_FILE "/sys/wifi_config.bin"
+#define INDEX_FILE "/sys/wifi_index.bin"
 
 LOG_SOURCE_CATEGORY("ncp.mgr")
 
@@ -170,12 +175,83 @@ int networkIndexForSsid(const char* ssid, const Vector<WifiNetworkConfig>& netwo
     return -1;
 }
 
-void sortByRssi(Vector<WifiScanResult>* scanResults) {
-    std::sort(scanResults->begin(), scanResults->end(), [](const WifiScanResult& ap1, const WifiScanResult& ap2) {
-        return (ap1.rssi() > ap2.rssi()); // In descending order
-    });
+// Configured networks are parsed once and kept in RAM
+Vector<WifiNetworkConfig> g_networks;
+bool g_networksLoaded = false;
+WifiNetworkIndex g_index(INDEX_FILE);
+StaticRecursiveMutex g_mutex;
+
+int loadNetworks() {
+    if (g_networksLoaded) {
+        return 0;
+    }
+    g_networks.clear();
+    CHECK(loadConfig(&g_networks));
+    if (g_index.load() < 0) {
+        // Older firmware kept the networks in the order of their most recent use
+        for (int i = g_networks.size() - 1; i >= 0; --i) {
+            const auto ssid = g_networks.at(i).ssid();
+            CHECK(g_index.add(ssid));
+            g_index.connected(ssid);
+        }
+    }
+    CHECK(g_index.sync(g_networks));
+    // The priority of a network is stored in the index file rather than in the network settings
+    for (auto& conf: g_networks) {
+        conf.priority(std::max(g_index.priority(conf.ssid()), 0));
+    }
+    g_networksLoaded = true;
+    return 0;
 }
 
+int saveNetworks() {
+    const int r = saveConfig(g_networks);
+    if (r < 0) {
+        // Reload the settings from the file next time
+        g_networksLoaded = false;
+        return r;
+    }
+    g_index.save();
+    return 0;
+}
+
+// Maximum number of access points that are tried when connecting to a network
+const size_t MAX_CONNECT_CANDIDATES = 5;
+
+// An access point of the most preferred network is tried without waiting for the remaining scan
+// results if its RSSI is at least this value
+const int STRONG_RSSI = -65;
+
+class CandidateOrder {
+public:
+    explicit CandidateOrder(const WifiNetworkIndex* index) :
+            index_(index) {
+    }
+
+    bool operator()(const WifiScanResult& ap1, const WifiScanResult& ap2) const {
+        return index_->isPreferred(ap1, ap2);
+    }
+
+private:
+    const WifiNetworkIndex* index_;
+};
+
+struct ScanContext {
+    WifiNetworkIndex index;
+    WifiScanTopK<MAX_CONNECT_CANDIDATES, CandidateOrder> candidates;
+    const Vector<WifiNetworkConfig>* networks;
+    const char* ssid;
+    const char* preferredSsid;
+
+    ScanContext(const Vector<WifiNetworkConfig>* networks, const char* ssid) :
+            index(INDEX_FILE),
+            candidates(CandidateOrder(&index)),
+            networks(networks),
+            ssid(ssid),
+            preferredSsid(nullptr) {
+    }
+};
+
 } // unnamed
 
 WifiNetworkManager::WifiNetworkManager(WifiNcpClient* client) :
@@ -188,124 +264,108 @@ WifiNetworkManager::~WifiNetworkManager() {
 int WifiNetworkManager::connect(const char* ssid) {
     // Get known networks
     Vector<WifiNetworkConfig> networks;
-    CHECK(loadConfig(&networks));
-    int index = 0;
-    if (ssid) {
-        // Find network with the given SSID
-        for (; index < networks.size(); ++index) {
-            if (strcmp(networks.at(index).ssid(), ssid) == 0) {
-                break;
-            }
-        }
+    ScanContext ctx(&networks, ssid);
+    {
+        std::lock_guard<StaticRecursiveMutex> lock(g_mutex);
+        CHECK(loadNetworks());
+        CHECK_TRUE(networks.append(g_networks), SYSTEM_ERROR_NO_MEMORY);
+        ctx.index = g_index;
     }
-    if (index == networks.size()) {
+    if (networks.isEmpty() || (ssid && networkIndexForSsid(ssid, networks) < 0)) {
         return SYSTEM_ERROR_NOT_FOUND;
     }
-    // Connect to the network
-    bool updateConfig = false;
-    auto network = &networks.at(index);
-    // Always perform a network scan for now, because ESP32 doesn't support 802.11v/k/r
-#if 0
-    int r = client_->connect(network->ssid(), network->bssid(), network->security(), network->credentials());
-#else
-    int r = SYSTEM_ERROR_INTERNAL;
-#endif
-    if (r < 0) {
-        // Perform network scan
-        Vector<WifiScanResult> scanResults;
-        CHECK_TRUE(scanResults.reserve(10), SYSTEM_ERROR_NO_MEMORY);
-        CHECK(client_->scan([](WifiScanResult result, void* data) -> int {
-            auto scanResults = (Vector<WifiScanResult>*)data;
-            CHECK_TRUE(scanResults->append(std::move(result)), SYSTEM_ERROR_NO_MEMORY);
-            return 0;
-        }, &scanResults));
-        // Sort discovered networks by RSSI
-        sortByRssi(&scanResults);
-        // Try to connect to any known network among the discovered ones
-        bool connected = false;
-        for (const auto& ap: scanResults) {
-            if (!ssid) {
-                index = 0;
-                for (; index < networks.size(); ++index) {
-                    network = &networks.at(index);
-                    if (strcmp(network->ssid(), ap.ssid()) == 0) {
-                        break;
-                    }
-                }
-                if (index == networks.size()) {
-                    continue;
-                }
-            } else if (strcmp(ssid, ap.ssid()) != 0) {
-                continue;
-            }
-            r = client_->connect(network->ssid(), ap.bssid(), network->security(), network->credentials());
-            if (r == 0) {
-                if (network->bssid() != ap.bssid()) {
-                    // Update BSSID
-                    network->bssid(ap.bssid());
-                    updateConfig = true;
-                }
-                connected = true;
-                break;
-            }
+    ctx.preferredSsid = ssid ? ssid : ctx.index.mostPreferred();
+    // Always perform a network scan for now, because ESP32 doesn't support 802.11v/k/r. The scan
+    // results are matched against the known networks as they arrive, keeping only the best candidates
+    CHECK(client_->scan([](WifiScanResult result, void* data) -> int {
+        const auto ctx = (ScanContext*)data;
+        if (ctx->ssid ? strcmp(ctx->ssid, result.ssid()) != 0 : networkIndexForSsid(result.ssid(), *ctx->networks) < 0) {
+            return 0; // Unknown network
         }
-        if (!connected) {
-            return SYSTEM_ERROR_NOT_FOUND;
-        }
-    } else if (network->bssid() == INVALID_MAC_ADDRESS) {
-        // Update BSSID
-        WifiNetworkInfo info;
-        r = client_->getNetworkInfo(&info);
+        // Stop the scan if the most preferred network has been found and its signal is strong enough
+        const bool found = ctx->preferredSsid && strcmp(ctx->preferredSsid, result.ssid()) == 0 &&
+                result.rssi() >= STRONG_RSSI;
+        ctx->candidates.add(std::move(result));
+        return found ? 1 : 0;
+    }, &ctx));
+    ctx.candidates.sort();
+    // Try to connect to the candidates in the order of priority, connection history and RSSI
+    const WifiNetworkConfig* network = nullptr;
+    const WifiScanResult* connectedAp = nullptr;
+    for (const auto& ap: ctx.candidates) {
+        network = &networks.at(networkIndexForSsid(ap.ssid(), networks));
+        const int r = client_->connect(network->ssid(), ap.bssid(), network->security(), network->credentials());
+        std::lock_guard<StaticRecursiveMutex> lock(g_mutex);
         if (r == 0) {
-            network->bssid(info.bssid());
-            updateConfig = true;
+            g_index.connected(network->ssid());
+            connectedAp = &ap;
+            break;
         }
+        g_index.connectionFailed(network->ssid());
     }
-    if (index != 0) {
-        // Move the network to the beginning of the list
-        auto network = networks.takeAt(index);
-        networks.prepend(std::move(network));
-        updateConfig = true;
+    std::lock_guard<StaticRecursiveMutex> lock(g_mutex);
+    if (!connectedAp) {
+        g_index.save();
+        return SYSTEM_ERROR_NOT_FOUND;
     }
-    if (updateConfig) {
-        saveConfig(networks);
+    const int index = networkIndexForSsid(network->ssid(), g_networks);
+    if (index >= 0 && g_networks.at(index).bssid() != connectedAp->bssid()) {
+        // Update BSSID
+        g_networks.at(index).bssid(connectedAp->bssid());
+        saveNetworks();
+    } else {
+        g_index.save();
     }
     return 0;
 }
 
 int WifiNetworkManager::setNetworkConfig(WifiNetworkConfig conf) {
     CHECK_TRUE(conf.ssid(), SYSTEM_ERROR_INVALID_ARGUMENT);
-    Vector<WifiNetworkConfig> networks;
-    CHECK(loadConfig(&networks));
-    int index = networkIndexForSsid(conf.ssid(), networks);
+    std::lock_guard<StaticRecursiveMutex> lock(g_mutex);
+    CHECK(loadNetworks());
+    int index = networkIndexForSsid(conf.ssid(), g_networks);
     if (index < 0) {
-        // Add a new network or replace the last network in the list
-        if (networks.size() < (int)MAX_CONFIGURED_WIFI_NETWORK_COUNT) {
-            CHECK_TRUE(networks.resize(networks.size() + 1), SYSTEM_ERROR_NO_MEMORY);
+        // Add a new network or replace the least preferred network in the list
+        if (g_networks.size() < (int)MAX_CONFIGURED_WIFI_NETWORK_COUNT) {
+            CHECK_TRUE(g_networks.resize(g_networks.size() + 1), SYSTEM_ERROR_NO_MEMORY);
+            index = g_networks.size() - 1;
+        } else {
+            const auto ssid = g_index.leastPreferred();
+            index = ssid ? networkIndexForSsid(ssid, g_networks) : -1;
+            if (index < 0) {
+                index = g_networks.size() - 1;
+            }
+            g_index.remove(g_networks.at(index).ssid());
         }
-        index = networks.size() - 1;
     }
-    networks[index] = std::move(conf);
-    CHECK(saveConfig(networks));
+    CHECK_TRUE(conf.priority() >= 0 && conf.priority() <= 255, SYSTEM_ERROR_INVALID_ARGUMENT);
+    g_networks[index] = std::move(conf);
+    const auto& network = g_networks.at(index);
+    CHECK(g_index.add(network.ssid()));
+    CHECK(g_index.priority(network.ssid(), network.priority()));
+    CHECK(saveNetworks());
     return 0;
 }
 
 int WifiNetworkManager::getNetworkConfig(const char* ssid, WifiNetworkConfig* conf) {
-    // TODO: Cache the list of networks
     CHECK_TRUE(ssid, SYSTEM_ERROR_INVALID_ARGUMENT);
-    Vector<WifiNetworkConfig> networks;
-    CHECK(loadConfig(&networks));
-    const int index = networkIndexForSsid(ssid, networks);
+    std::lock_guard<StaticRecursiveMutex> lock(g_mutex);
+    CHECK(loadNetworks());
+    const int index = networkIndexForSsid(ssid, g_networks);
     if (index < 0) {
         return SYSTEM_ERROR_NOT_FOUND;
     }
-    *conf = std::move(networks[index]);
+    *conf = g_networks.at(index);
     return 0;
 }
 
 int WifiNetworkManager::getNetworkConfig(GetNetworkConfigCallback callback, void* data) {
     Vector<WifiNetworkConfig> networks;
-    CHECK(loadConfig(&networks));
+    {
+        std::lock_guard<StaticRecursiveMutex> lock(g_mutex);
+        CHECK(loadNetworks());
+        CHECK_TRUE(networks.append(g_networks), SYSTEM_ERROR_NO_MEMORY);
+    }
     for (int i = 0; i < networks.size(); ++i) {
         const int ret = callback(std::move(networks[i]), data);
         if (ret < 0) {
@@ -315,31 +375,47 @@ int WifiNetworkManager::getNetworkConfig(GetNetworkConfigCallback callback, void
     return 0;
 }
 
+int WifiNetworkManager::setNetworkPriority(const char* ssid, int priority) {
+    CHECK_TRUE(ssid, SYSTEM_ERROR_INVALID_ARGUMENT);
+    std::lock_guard<StaticRecursiveMutex> lock(g_mutex);
+    CHECK(loadNetworks());
+    const int index = networkIndexForSsid(ssid, g_networks);
+    CHECK_TRUE(index >= 0, SYSTEM_ERROR_NOT_FOUND);
+    CHECK(g_index.priority(ssid, priority));
+    g_networks.at(index).priority(priority);
+    CHECK(g_index.save());
+    return 0;
+}
+
 void WifiNetworkManager::removeNetworkConfig(const char* ssid) {
-    Vector<WifiNetworkConfig> networks;
-    if (loadConfig(&networks) < 0) {
+    std::lock_guard<StaticRecursiveMutex> lock(g_mutex);
+    if (loadNetworks() < 0) {
         return;
     }
-    const int index = networkIndexForSsid(ssid, networks);
+    const int index = networkIndexForSsid(ssid, g_networks);
     if (index < 0) {
         return;
     }
-    networks.removeAt(index);
-    saveConfig(networks);
+    g_networks.removeAt(index);
+    g_index.remove(ssid);
+    saveNetworks();
 }
 
 void WifiNetworkManager::clearNetworkConfig() {
-    Vector<WifiNetworkConfig> networks;
-    saveConfig(networks);
+    std::lock_guard<StaticRecursiveMutex> lock(g_mutex);
+    g_networks.clear();
+    g_networksLoaded = true;
+    g_index.clear();
+    saveNetworks();
 }
 
 bool WifiNetworkManager::hasNetworkConfig() {
-    Vector<WifiNetworkConfig> networks;
-    const int r = loadConfig(&networks);
+    std::lock_guard<StaticRecursiveMutex> lock(g_mutex);
+    const int r = loadNetworks();
     if (r < 0) {
         return false;
     }
-    return !networks.isEmpty();
+    return !g_networks.isEmpty();
 }
 
 } // particle
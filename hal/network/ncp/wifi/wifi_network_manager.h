@@ -79,11 +79,15 @@ public:
     WifiNetworkConfig& credentials(WifiCredentials cred);
     const WifiCredentials& credentials() const;
 
+    WifiNetworkConfig& priority(int priority);
+    int priority() const;
+
 private:
     CString ssid_;
     MacAddress bssid_;
     WifiCredentials cred_;
     WifiSecurity sec_;
+    int priority_;
 };
 
 class WifiNetworkInfo {
@@ -136,6 +140,7 @@ private:
     int rssi_;
 };
 
+// Returning a positive value from the callback stops the scan
 typedef int(*WifiScanCallback)(WifiScanResult result, void* data);
 
 class WifiNetworkManager {
@@ -151,6 +156,7 @@ public:
     static int setNetworkConfig(WifiNetworkConfig conf);
     static int getNetworkConfig(const char* ssid, WifiNetworkConfig* conf);
     static int getNetworkConfig(GetNetworkConfigCallback callback, void* data);
+    static int setNetworkPriority(const char* ssid, int priority);
     static void removeNetworkConfig(const char* ssid);
     static void clearNetworkConfig();
     static bool hasNetworkConfig();
@@ -185,7 +191,8 @@ inline WifiCredentials::Type WifiCredentials::type() const {
 
 inline WifiNetworkConfig::WifiNetworkConfig() :
         bssid_(INVALID_MAC_ADDRESS),
-        sec_(WifiSecurity::NONE) {
+        sec_(WifiSecurity::NONE),
+        priority_(0) {
 }
 
 inline WifiNetworkConfig& WifiNetworkConfig::ssid(const char* ssid) {
@@ -224,6 +231,15 @@ inline const WifiCredentials& WifiNetworkConfig::credentials() const {
     return cred_;
 }
 
+inline WifiNetworkConfig& WifiNetworkConfig::priority(int priority) {
+    priority_ = priority;
+    return *this;
+}
+
+inline int WifiNetworkConfig::priority() const {
+    return priority_;
+}
+
 inline WifiNetworkInfo::WifiNetworkInfo() :
         bssid_(INVALID_MAC_ADDRESS),
         channel_(0),
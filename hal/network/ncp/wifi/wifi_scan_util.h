@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "wifi_network_manager.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace particle {
+
+/**
+ * Keeps the `K` best access points out of a stream of scan results.
+ *
+ * The results are kept in a bounded heap with the worst of them at the top, so that each new
+ * result is either dropped or replaces the worst one without buffering the entire scan list.
+ *
+ * @tparam K Maximum number of results.
+ * @tparam BetterT Function object type. `better(ap1, ap2)` should return `true` if `ap1` should
+ *         be tried before `ap2`.
+ */
+template<size_t K, typename BetterT>
+class WifiScanTopK {
+public:
+    explicit WifiScanTopK(BetterT better = BetterT()) :
+            size_(0),
+            better_(better) {
+    }
+
+    /**
+     * Adds a scan result.
+     *
+     * @return `true` if the result has been added, or `false` if it's worse than all results
+     *         that are currently kept.
+     */
+    bool add(WifiScanResult ap) {
+        if (size_ < K) {
+            aps_[size_++] = std::move(ap);
+            std::push_heap(aps_, aps_ + size_, better_);
+            return true;
+        }
+        if (!better_(ap, aps_[0])) {
+            return false;
+        }
+        std::pop_heap(aps_, aps_ + size_, better_);
+        aps_[size_ - 1] = std::move(ap);
+        std::push_heap(aps_, aps_ + size_, better_);
+        return true;
+    }
+
+    /**
+     * Sorts the results from the best to the worst.
+     *
+     * After this call, the results can be iterated but no more results can be added.
+     */
+    void sort() {
+        std::sort_heap(aps_, aps_ + size_, better_);
+    }
+
+    const WifiScanResult* begin() const {
+        return aps_;
+    }
+
+    const WifiScanResult* end() const {
+        return aps_ + size_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    static constexpr size_t capacity() {
+        return K;
+    }
+
+private:
+    static_assert(K > 0, "Number of results must be greater than 0");
+
+    WifiScanResult aps_[K];
+    size_t size_;
+    BetterT better_;
+};
+
+} // particle
@@ -20,6 +20,7 @@
 LOG_SOURCE_CATEGORY("ncp.esp32.client");
 
 #include "esp32_ncp_client.h"
+#include "esp32_scan_parser.h"
 
 #include "at_command.h"
 #include "at_response.h"
@@ -443,27 +444,17 @@ int Esp32NcpClient::scan(WifiScanCallback callback, void* data) {
     CHECK(checkParser());
     auto resp = parser_.sendCommand("AT+CWLAP");
     while (resp.hasNextLine()) {
-        char ssid[MAX_SSID_SIZE + 2] = {};
-        char bssidStr[MAC_ADDRESS_STRING_SIZE + 1] = {};
-        int security = 0;
-        int channel = 0;
-        int rssi = 0;
-        const int r = CHECK_PARSER(resp.scanf("+CWLAP:(%d,\"%33[^,],%d,\"%17[^\"]\",%d)", &security, ssid, &rssi,
-                bssidStr, &channel));
-        if (r != 5) {
-            // FIXME: ESP32 doesn't escape special characters, such as ',' and '"', in SSIDs. For now,
-            // we're skipping such entries
+        char line[128] = {};
+        CHECK_PARSER(resp.readLine(line, sizeof(line)));
+        WifiScanResult result;
+        if (parseEsp32ScanResult(line, &result) < 0) {
             LOG(WARN, "Unable to parse AP info");
             continue;
         }
-        // Fixup SSID
-        CHECK_TRUE(strlen(ssid) > 0, SYSTEM_ERROR_UNKNOWN);
-        ssid[strlen(ssid) - 1] = '\0';
-        MacAddress bssid = INVALID_MAC_ADDRESS;
-        CHECK_TRUE(macAddressFromString(&bssid, bssidStr), SYSTEM_ERROR_UNKNOWN);
-        auto result = WifiScanResult().ssid(ssid).bssid(bssid).security((WifiSecurity)security).channel(channel)
-                .rssi(rssi);
-        CHECK(callback(std::move(result), data));
+        if (CHECK(callback(std::move(result), data)) > 0) {
+            // The remaining response data is discarded when the response object is destroyed
+            return 0;
+        }
     }
     const int r = CHECK_PARSER(resp.readResult());
     CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_AT_NOT_OK);
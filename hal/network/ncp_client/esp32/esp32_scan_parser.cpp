@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "esp32_scan_parser.h"
+
+#include "system_error.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace particle {
+
+int parseEsp32ScanResult(const char* line, WifiScanResult* result) {
+    char ssid[MAX_SSID_SIZE + 2] = {};
+    char bssidStr[MAC_ADDRESS_STRING_SIZE + 1] = {};
+    int security = 0;
+    int channel = 0;
+    int rssi = 0;
+    const int r = sscanf(line, "+CWLAP:(%d,\"%33[^,],%d,\"%17[^\"]\",%d)", &security, ssid, &rssi, bssidStr, &channel);
+    if (r != 5) {
+        // FIXME: ESP32 doesn't escape special characters, such as ',' and '"', in SSIDs. For now,
+        // such entries can't be parsed
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    // Fixup SSID
+    const size_t len = strlen(ssid);
+    if (len == 0 || ssid[len - 1] != '"') {
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    ssid[len - 1] = '\0';
+    MacAddress bssid = INVALID_MAC_ADDRESS;
+    if (!macAddressFromString(&bssid, bssidStr)) {
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    *result = WifiScanResult().ssid(ssid).bssid(bssid).security((WifiSecurity)security).channel(channel).rssi(rssi);
+    return 0;
+}
+
+} // particle
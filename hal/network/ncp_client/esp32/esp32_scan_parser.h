@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "network/ncp/wifi/wifi_network_manager.h"
+
+namespace particle {
+
+/**
+ * Parses a line of the `AT+CWLAP` response.
+ *
+ * @param line Response line, e.g. `+CWLAP:(3,"ssid",-60,"aa:bb:cc:dd:ee:ff",6)`.
+ * @param[out] result Scan result.
+ * @return 0 on success, `SYSTEM_ERROR_BAD_DATA` if the line can't be parsed, or another negative
+ *         result code in case of an error.
+ */
+int parseEsp32ScanResult(const char* line, WifiScanResult* result);
+
+} // particle
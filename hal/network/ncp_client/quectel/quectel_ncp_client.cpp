@@ -98,6 +98,9 @@ const auto QUECTEL_NCP_KEEPALIVE_MAX_MISSED = 5;
 // FIXME: for now using a very large buffer
 const auto QUECTEL_NCP_AT_CHANNEL_RX_BUFFER_SIZE = 4096;
 const auto QUECTEL_NCP_PPP_CHANNEL_RX_BUFFER_SIZE = 256;
+const auto QUECTEL_NCP_AT_CHANNEL_TX_BUFFER_SIZE = 256;
+// Fits a PPP frame with all bytes escaped
+const auto QUECTEL_NCP_PPP_CHANNEL_TX_BUFFER_SIZE = QUECTEL_NCP_MAX_MUXER_FRAME_SIZE * 2;
 
 const auto QUECTEL_NCP_AT_CHANNEL = 1;
 const auto QUECTEL_NCP_PPP_CHANNEL = 2;
@@ -137,7 +140,8 @@ const int CGDCONT_ATTEMPTS = 5;
 
 } // anonymous
 
-QuectelNcpClient::QuectelNcpClient() {
+QuectelNcpClient::QuectelNcpClient() :
+        muxerScheduler_(&muxer_) {
 }
 
 QuectelNcpClient::~QuectelNcpClient() {
@@ -157,6 +161,12 @@ int QuectelNcpClient::init(const NcpClientConfig& conf) {
     decltype(muxerAtStream_) muxStrm(new (std::nothrow) decltype(muxerAtStream_)::element_type(&muxer_, QUECTEL_NCP_AT_CHANNEL));
     CHECK_TRUE(muxStrm, SYSTEM_ERROR_NO_MEMORY);
     CHECK(muxStrm->init(QUECTEL_NCP_AT_CHANNEL_RX_BUFFER_SIZE));
+    // The AT channel gets a turn after each full frame of PPP data
+    CHECK(muxerScheduler_.addChannel(QUECTEL_NCP_AT_CHANNEL, QUECTEL_NCP_AT_CHANNEL_TX_BUFFER_SIZE,
+            QUECTEL_NCP_AT_CHANNEL_RX_BUFFER_SIZE));
+    CHECK(muxerScheduler_.addChannel(QUECTEL_NCP_PPP_CHANNEL, QUECTEL_NCP_PPP_CHANNEL_TX_BUFFER_SIZE,
+            0 /* rxBufSize */, QUECTEL_NCP_MAX_MUXER_FRAME_SIZE));
+    muxStrm->scheduler(&muxerScheduler_);
     CHECK(initParser(serial.get()));
     decltype(muxerDataStream_) muxDataStrm(new(std::nothrow) decltype(muxerDataStream_)::element_type(&muxer_, QUECTEL_NCP_PPP_CHANNEL));
     CHECK_TRUE(muxDataStrm, SYSTEM_ERROR_NO_MEMORY);
@@ -459,10 +469,12 @@ int QuectelNcpClient::dataChannelWrite(int id, const uint8_t* data, size_t size)
     CHECK_TRUE(connState_ == NcpConnectionState::CONNECTED, SYSTEM_ERROR_INVALID_STATE);
     CHECK_FALSE(muxerDataStream_->enabled(), SYSTEM_ERROR_INVALID_STATE);
 
-    int err = muxer_.writeChannel(QUECTEL_NCP_PPP_CHANNEL, data, size);
-    if (err == gsm0710::GSM0710_ERROR_FLOW_CONTROL) {
-        LOG_DEBUG(WARN, "Remote side flow control");
-        // Not an error
+    // PPP frames are queued either entirely or not at all
+    int err = muxerScheduler_.write(QUECTEL_NCP_PPP_CHANNEL, (const char*)data, size, false /* partial */);
+    if (err >= 0) {
+        if ((size_t)err != size) {
+            LOG_DEBUG(WARN, "Remote side flow control");
+        }
         err = 0;
     }
 
@@ -493,6 +505,8 @@ int QuectelNcpClient::dataChannelFlowControl(bool state) {
 
 void QuectelNcpClient::processEvents() {
     const NcpClientLock lock(this);
+    // Send the data held back by the remote side flow control, if any
+    muxerScheduler_.process();
     processEventsImpl();
 }
 
@@ -1198,6 +1212,8 @@ int QuectelNcpClient::checkRuntimeState(ModemState& state) {
 }
 
 int QuectelNcpClient::initMuxer() {
+    // Discard the data queued for the previous muxer session
+    muxerScheduler_.reset();
     muxer_.setStream(serial_.get());
     muxer_.setMaxFrameSize(QUECTEL_NCP_MAX_MUXER_FRAME_SIZE);
     muxer_.setKeepAlivePeriod(QUECTEL_NCP_KEEPALIVE_PERIOD);
@@ -105,6 +105,9 @@ const auto UBLOX_NCP_KEEPALIVE_MAX_MISSED = 5;
 // FIXME: for now using a very large buffer
 const auto UBLOX_NCP_AT_CHANNEL_RX_BUFFER_SIZE = 4096;
 const auto UBLOX_NCP_PPP_CHANNEL_RX_BUFFER_SIZE = 256;
+const auto UBLOX_NCP_AT_CHANNEL_TX_BUFFER_SIZE = 256;
+// Fits a PPP frame with all bytes escaped
+const auto UBLOX_NCP_PPP_CHANNEL_TX_BUFFER_SIZE = UBLOX_NCP_MAX_MUXER_FRAME_SIZE * 2;
 
 const auto UBLOX_NCP_AT_CHANNEL = 1;
 const auto UBLOX_NCP_PPP_CHANNEL = 2;
@@ -141,7 +144,8 @@ const int CCID_MAX_RETRY_CNT = 2;
 
 } // anonymous
 
-SaraNcpClient::SaraNcpClient() {
+SaraNcpClient::SaraNcpClient() :
+        muxerScheduler_(&muxer_) {
 }
 
 SaraNcpClient::~SaraNcpClient() {
@@ -159,6 +163,12 @@ int SaraNcpClient::init(const NcpClientConfig& conf) {
     decltype(muxerAtStream_) muxStrm(new(std::nothrow) decltype(muxerAtStream_)::element_type(&muxer_, UBLOX_NCP_AT_CHANNEL));
     CHECK_TRUE(muxStrm, SYSTEM_ERROR_NO_MEMORY);
     CHECK(muxStrm->init(UBLOX_NCP_AT_CHANNEL_RX_BUFFER_SIZE));
+    // The AT channel gets a turn after each full frame of PPP data
+    CHECK(muxerScheduler_.addChannel(UBLOX_NCP_AT_CHANNEL, UBLOX_NCP_AT_CHANNEL_TX_BUFFER_SIZE,
+            UBLOX_NCP_AT_CHANNEL_RX_BUFFER_SIZE));
+    CHECK(muxerScheduler_.addChannel(UBLOX_NCP_PPP_CHANNEL, UBLOX_NCP_PPP_CHANNEL_TX_BUFFER_SIZE,
+            0 /* rxBufSize */, UBLOX_NCP_MAX_MUXER_FRAME_SIZE));
+    muxStrm->scheduler(&muxerScheduler_);
     CHECK(initParser(serial.get()));
     decltype(muxerDataStream_) muxDataStrm(new(std::nothrow) decltype(muxerDataStream_)::element_type(&muxer_, UBLOX_NCP_PPP_CHANNEL));
     CHECK_TRUE(muxDataStrm, SYSTEM_ERROR_NO_MEMORY);
@@ -486,10 +496,12 @@ int SaraNcpClient::dataChannelWrite(int id, const uint8_t* data, size_t size) {
         }
     }
 
-    int err = muxer_.writeChannel(UBLOX_NCP_PPP_CHANNEL, data, size);
-    if (err == gsm0710::GSM0710_ERROR_FLOW_CONTROL) {
-        // Not an error
-        LOG_DEBUG(WARN, "Remote side flow control");
+    // PPP frames are queued either entirely or not at all
+    int err = muxerScheduler_.write(UBLOX_NCP_PPP_CHANNEL, (const char*)data, size, false /* partial */);
+    if (err >= 0) {
+        if ((size_t)err != size) {
+            LOG_DEBUG(WARN, "Remote side flow control");
+        }
         err = 0;
     }
     if (ncpId() == PLATFORM_NCP_SARA_R410 && fwVersion_ <= UBLOX_NCP_R4_APP_FW_VERSION_NO_HW_FLOW_CONTROL_MAX) {
@@ -523,6 +535,8 @@ int SaraNcpClient::dataChannelFlowControl(bool state) {
 
 void SaraNcpClient::processEvents() {
     const NcpClientLock lock(this);
+    // Send the data held back by the remote side flow control, if any
+    muxerScheduler_.process();
     processEventsImpl();
 }
 
@@ -1554,6 +1568,8 @@ int SaraNcpClient::checkRuntimeState(ModemState& state) {
 }
 
 int SaraNcpClient::initMuxer() {
+    // Discard the data queued for the previous muxer session
+    muxerScheduler_.reset();
     // Initialize muxer
     muxer_.setStream(serial_.get());
     muxer_.setMaxFrameSize(UBLOX_NCP_MAX_MUXER_FRAME_SIZE);
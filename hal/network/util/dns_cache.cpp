@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dns_cache.h"
+
+#include "system_error.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+namespace particle {
+
+const size_t DnsCache::MAX_ENTRIES;
+const uint32_t DnsCache::MIN_TTL;
+const uint32_t DnsCache::MAX_TTL;
+const uint32_t DnsCache::MAX_NEGATIVE_TTL;
+const unsigned DnsCache::PREFETCH_MIN_HITS;
+const unsigned DnsCache::PREFETCH_TTL_FRACTION;
+
+DnsCache::DnsCache() :
+        entries_(),
+        stats_() {
+}
+
+DnsCache::~DnsCache() {
+    clear();
+}
+
+DnsCache::Result DnsCache::find(const char* name, int family, system_tick_t now, void* addr, bool* prefetch) {
+    if (prefetch) {
+        *prefetch = false;
+    }
+    Entry* e = entry(name, family);
+    if (!e) {
+        ++stats_.misses;
+        return MISS;
+    }
+    const system_tick_t age = now - e->time;
+    if (age >= e->ttl) {
+        removeEntry(e);
+        ++stats_.misses;
+        return MISS;
+    }
+    e->lastUsed = now;
+    if (e->flags & NEGATIVE_ANSWER) {
+        ++stats_.negativeHits;
+        return NEGATIVE;
+    }
+    memcpy(addr, e->addr, e->addrSize);
+    if (e->hits < 0xffff) {
+        ++e->hits;
+    }
+    if (prefetch && e->hits >= PREFETCH_MIN_HITS && !(e->flags & PREFETCH_REPORTED) &&
+            e->ttl - age < e->ttl / PREFETCH_TTL_FRACTION) {
+        e->flags |= PREFETCH_REPORTED;
+        ++stats_.prefetches;
+        *prefetch = true;
+    }
+    ++stats_.hits;
+    return HIT;
+}
+
+int DnsCache::put(const char* name, int family, const void* addr, size_t addrSize, uint32_t ttl, system_tick_t now) {
+    if (addrSize > DNS_CACHE_MAX_ADDRESS_SIZE) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    Entry* e = addEntry(name, family, now);
+    if (!e) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+    ttl = std::min(std::max(ttl, MIN_TTL), MAX_TTL);
+    e->ttl = ttl * 1000;
+    e->flags = 0;
+    e->hits = 0;
+    e->addrSize = addrSize;
+    memcpy(e->addr, addr, addrSize);
+    return 0;
+}
+
+int DnsCache::putNegative(const char* name, int family, uint32_t ttl, system_tick_t now) {
+    Entry* e = addEntry(name, family, now);
+    if (!e) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+    ttl = std::min(std::max(ttl, MIN_TTL), MAX_NEGATIVE_TTL);
+    e->ttl = ttl * 1000;
+    e->flags = NEGATIVE_ANSWER;
+    e->hits = 0;
+    e->addrSize = 0;
+    return 0;
+}
+
+void DnsCache::cancelPrefetch(const char* name, int family) {
+    Entry* e = entry(name, family);
+    if (e) {
+        e->flags &= ~PREFETCH_REPORTED;
+    }
+}
+
+void DnsCache::clear() {
+    for (auto& e: entries_) {
+        removeEntry(&e);
+    }
+}
+
+DnsCacheStats DnsCache::stats() const {
+    DnsCacheStats s = stats_;
+    s.entries = 0;
+    for (const auto& e: entries_) {
+        if (e.name) {
+            ++s.entries;
+        }
+    }
+    return s;
+}
+
+DnsCache::Entry* DnsCache::entry(const char* name, int family) {
+    for (auto& e: entries_) {
+        // Host names are case-insensitive
+        if (e.name && e.family == family && !strcasecmp(e.name, name)) {
+            return &e;
+        }
+    }
+    return nullptr;
+}
+
+DnsCache::Entry* DnsCache::addEntry(const char* name, int family, system_tick_t now) {
+    Entry* e = entry(name, family);
+    if (!e) {
+        // Use a free entry or evict the least recently used one
+        e = &entries_[0];
+        for (auto& e2: entries_) {
+            if (!e2.name) {
+                e = &e2;
+                break;
+            }
+            if ((system_tick_t)(now - e2.lastUsed) > (system_tick_t)(now - e->lastUsed)) {
+                e = &e2;
+            }
+        }
+        removeEntry(e);
+        e->name = strdup(name);
+        if (!e->name) {
+            return nullptr;
+        }
+        e->family = family;
+    }
+    e->time = now;
+    e->lastUsed = now;
+    return e;
+}
+
+void DnsCache::removeEntry(Entry* e) {
+    if (e && e->name) {
+        free(e->name);
+        e->name = nullptr;
+    }
+}
+
+} // namespace particle
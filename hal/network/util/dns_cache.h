@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "system_tick_hal.h"
+
+#include <cstdint>
+#include <cstddef>
+
+namespace particle {
+
+/**
+ * Maximum size of an address stored in the DNS cache.
+ */
+const size_t DNS_CACHE_MAX_ADDRESS_SIZE = 16;
+
+/**
+ * DNS cache statistics.
+ */
+struct DnsCacheStats {
+    unsigned hits; ///< Number of lookups answered with an address.
+    unsigned negativeHits; ///< Number of lookups answered with a cached negative answer.
+    unsigned misses; ///< Number of lookups that required a query.
+    unsigned prefetches; ///< Number of entries refreshed before they expired.
+    unsigned entries; ///< Number of entries in the cache.
+};
+
+/**
+ * A cache of DNS answers.
+ *
+ * Entries are keyed by the host name and address family. An entry holds either an address or a
+ * negative answer (the name doesn't exist or has no addresses of the given family) and expires
+ * according to the TTL received from the server. The TTL is clamped to a range that keeps a device
+ * from querying a name in a tight loop or holding on to an address for too long. When the cache is
+ * full, the least recently used entry is evicted.
+ *
+ * The class doesn't do any locking.
+ */
+class DnsCache {
+public:
+    /**
+     * Maximum number of entries.
+     */
+    static const size_t MAX_ENTRIES = 8;
+    /**
+     * Minimum TTL of an answer in seconds.
+     */
+    static const uint32_t MIN_TTL = 5;
+    /**
+     * Maximum TTL of a positive answer in seconds.
+     */
+    static const uint32_t MAX_TTL = 3600;
+    /**
+     * Maximum TTL of a negative answer in seconds.
+     */
+    static const uint32_t MAX_NEGATIVE_TTL = 300;
+    /**
+     * Number of lookups after which an entry is considered hot and gets prefetched.
+     */
+    static const unsigned PREFETCH_MIN_HITS = 2;
+    /**
+     * A hot entry gets prefetched when less than 1/PREFETCH_TTL_FRACTION of its TTL is left.
+     */
+    static const unsigned PREFETCH_TTL_FRACTION = 8;
+
+    enum Result {
+        MISS = 0,
+        HIT = 1,
+        NEGATIVE = 2
+    };
+
+    DnsCache();
+    ~DnsCache();
+
+    /**
+     * Looks up an entry.
+     *
+     * @param name Host name.
+     * @param family Address family.
+     * @param now Current time.
+     * @param[out] addr Buffer for the address. Must be at least `DNS_CACHE_MAX_ADDRESS_SIZE` bytes.
+     * @param[out] prefetch Set to `true` if the entry is hot and about to expire. This is reported
+     *        only once for each entry.
+     * @return Lookup result.
+     */
+    Result find(const char* name, int family, system_tick_t now, void* addr, bool* prefetch = nullptr);
+    /**
+     * Adds or updates an entry with an address.
+     *
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int put(const char* name, int family, const void* addr, size_t addrSize, uint32_t ttl, system_tick_t now);
+    /**
+     * Adds or updates an entry with a negative answer.
+     *
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int putNegative(const char* name, int family, uint32_t ttl, system_tick_t now);
+    /**
+     * Allows reporting a hot entry for prefetching again, e.g. if the prefetch query failed.
+     */
+    void cancelPrefetch(const char* name, int family);
+    void clear();
+
+    DnsCacheStats stats() const;
+
+private:
+    enum EntryFlag {
+        NEGATIVE_ANSWER = 0x01,
+        PREFETCH_REPORTED = 0x02
+    };
+
+    struct Entry {
+        char* name;
+        system_tick_t time; // Time when the answer was received
+        system_tick_t lastUsed;
+        uint32_t ttl; // Milliseconds
+        uint16_t hits;
+        uint8_t flags;
+        uint8_t addrSize;
+        int family;
+        uint8_t addr[DNS_CACHE_MAX_ADDRESS_SIZE];
+    };
+
+    Entry entries_[MAX_ENTRIES];
+    DnsCacheStats stats_;
+
+    Entry* entry(const char* name, int family);
+    Entry* addEntry(const char* name, int family, system_tick_t now);
+    void removeEntry(Entry* e);
+};
+
+} // namespace particle
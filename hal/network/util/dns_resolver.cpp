@@ -0,0 +1,623 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dns_resolver.h"
+
+#if HAL_USE_SOCKET_HAL_POSIX
+
+#include "timer_hal.h"
+#include "rng_hal.h"
+#include "system_error.h"
+#include "scope_guard.h"
+#include "check.h"
+
+#include <algorithm>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+namespace particle {
+
+namespace {
+
+const size_t DNS_HEADER_SIZE = 12;
+const size_t MAX_DNS_NAME_LENGTH = 253;
+const size_t MAX_DNS_QUERY_SIZE = DNS_HEADER_SIZE + MAX_DNS_NAME_LENGTH + 2 /* Length of the first label, root label */
+        + 4 /* QTYPE, QCLASS */;
+const size_t MAX_DNS_MESSAGE_SIZE = 512; // RFC 1035, 2.3.4
+
+const uint16_t DNS_TYPE_A = 1;
+const uint16_t DNS_TYPE_CNAME = 5;
+const uint16_t DNS_TYPE_SOA = 6;
+const uint16_t DNS_TYPE_AAAA = 28;
+const uint16_t DNS_CLASS_IN = 1;
+
+const uint16_t DNS_FLAG_QR = 0x8000;
+const uint16_t DNS_FLAG_TC = 0x0200;
+const uint16_t DNS_FLAG_RD = 0x0100;
+const uint16_t DNS_RCODE_MASK = 0x000f;
+const uint16_t DNS_RCODE_NO_ERROR = 0;
+const uint16_t DNS_RCODE_NAME_ERROR = 3;
+
+inline uint16_t readUInt16(const uint8_t* p) {
+    return ((uint16_t)p[0] << 8) | p[1];
+}
+
+inline uint32_t readUInt32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+inline uint16_t queryType(int family) {
+    return (family == AF_INET6) ? DNS_TYPE_AAAA : DNS_TYPE_A;
+}
+
+inline size_t addressSize(int family) {
+    return (family == AF_INET6) ? sizeof(struct in6_addr) : sizeof(struct in_addr);
+}
+
+inline socklen_t sockAddrSize(const struct sockaddr* addr) {
+    return (addr->sa_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+}
+
+inline uint16_t randomId() {
+    return HAL_RNG_GetRandomNumber();
+}
+
+// Returns the length of a host name without the trailing dot
+size_t nameLength(const char* name) {
+    size_t len = strlen(name);
+    if (len > 0 && name[len - 1] == '.') {
+        --len;
+    }
+    return len;
+}
+
+bool sameSockAddr(const struct sockaddr* a, const struct sockaddr* b) {
+    if (a->sa_family != b->sa_family) {
+        return false;
+    }
+    if (a->sa_family == AF_INET) {
+        const auto a4 = (const struct sockaddr_in*)a;
+        const auto b4 = (const struct sockaddr_in*)b;
+        return a4->sin_port == b4->sin_port && a4->sin_addr.s_addr == b4->sin_addr.s_addr;
+    }
+    if (a->sa_family == AF_INET6) {
+        const auto a6 = (const struct sockaddr_in6*)a;
+        const auto b6 = (const struct sockaddr_in6*)b;
+        return a6->sin6_port == b6->sin6_port && !memcmp(&a6->sin6_addr, &b6->sin6_addr, sizeof(a6->sin6_addr));
+    }
+    return false;
+}
+
+int encodeQuery(uint8_t* buf, size_t size, uint16_t id, const char* name, uint16_t type) {
+    const size_t nameLen = nameLength(name);
+    if (nameLen == 0 || nameLen > MAX_DNS_NAME_LENGTH) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    const size_t msgSize = DNS_HEADER_SIZE + nameLen + 6;
+    if (msgSize > size) {
+        return SYSTEM_ERROR_TOO_LARGE;
+    }
+    memset(buf, 0, DNS_HEADER_SIZE);
+    buf[0] = id >> 8;
+    buf[1] = id & 0xff;
+    buf[2] = DNS_FLAG_RD >> 8; // Recursion desired
+    buf[5] = 1; // QDCOUNT
+    uint8_t* p = buf + DNS_HEADER_SIZE;
+    const char* const end = name + nameLen;
+    for (const char* label = name; label < end;) {
+        const char* dot = (const char*)memchr(label, '.', end - label);
+        const size_t n = (dot ? dot : end) - label;
+        if (n == 0 || n > 63) {
+            return SYSTEM_ERROR_INVALID_ARGUMENT;
+        }
+        *p++ = n;
+        memcpy(p, label, n);
+        p += n;
+        label += n + 1;
+    }
+    *p++ = 0; // Root label
+    *p++ = type >> 8;
+    *p++ = type & 0xff;
+    *p++ = 0;
+    *p++ = DNS_CLASS_IN;
+    return p - buf;
+}
+
+// Reads a domain name that may be compressed (RFC 1035, 4.1.4). Returns the offset of the data
+// following the name in the message
+int readName(const uint8_t* msg, size_t size, size_t offs, char* name) {
+    size_t nextOffs = 0;
+    size_t len = 0;
+    unsigned jumps = 0;
+    for (;;) {
+        if (offs >= size) {
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        const uint8_t n = msg[offs];
+        if ((n & 0xc0) == 0xc0) {
+            // Pointer
+            if (offs + 1 >= size || ++jumps > 16) {
+                return SYSTEM_ERROR_BAD_DATA;
+            }
+            if (!nextOffs) {
+                nextOffs = offs + 2;
+            }
+            offs = ((n & 0x3f) << 8) | msg[offs + 1];
+            continue;
+        }
+        if (n & 0xc0) {
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        ++offs;
+        if (!n) {
+            break;
+        }
+        if (offs + n > size) {
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        if (name) {
+            if (len + (len ? 1 : 0) + n > MAX_DNS_NAME_LENGTH) {
+                return SYSTEM_ERROR_BAD_DATA;
+            }
+            if (len) {
+                name[len++] = '.';
+            }
+            memcpy(name + len, msg + offs, n);
+            len += n;
+        }
+        offs += n;
+    }
+    if (name) {
+        name[len] = '\0';
+    }
+    return nextOffs ? nextOffs : offs;
+}
+
+// Parses a response to an A or AAAA query. Returns SYSTEM_ERROR_BAD_DATA if the message is malformed
+// or is not a response to the query, or SYSTEM_ERROR_PROTOCOL if the server failed to answer
+int parseResponse(const uint8_t* msg, size_t size, const char* name, uint16_t type, DnsAnswer* ans) {
+    if (size < DNS_HEADER_SIZE) {
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    const uint16_t flags = readUInt16(msg + 2);
+    const unsigned qdCount = readUInt16(msg + 4);
+    const unsigned anCount = readUInt16(msg + 6);
+    const unsigned nsCount = readUInt16(msg + 8);
+    if (!(flags & DNS_FLAG_QR) || qdCount != 1) {
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    // Check the question
+    char qname[MAX_DNS_NAME_LENGTH + 1];
+    size_t offs = CHECK(readName(msg, size, DNS_HEADER_SIZE, qname));
+    if (offs + 4 > size || readUInt16(msg + offs) != type || readUInt16(msg + offs + 2) != DNS_CLASS_IN) {
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    offs += 4;
+    const size_t nameLen = nameLength(name);
+    if (strlen(qname) != nameLen || strncasecmp(qname, name, nameLen) != 0) {
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    const uint16_t rcode = flags & DNS_RCODE_MASK;
+    if ((rcode != DNS_RCODE_NO_ERROR && rcode != DNS_RCODE_NAME_ERROR) || (flags & DNS_FLAG_TC)) {
+        return SYSTEM_ERROR_PROTOCOL;
+    }
+    // Find the address in the answer section. The address record may follow a chain of CNAME
+    // records, in which case the shortest TTL in the chain applies
+    bool found = false;
+    uint32_t ttl = 0xffffffff;
+    for (unsigned i = 0; i < anCount; ++i) {
+        offs = CHECK(readName(msg, size, offs, nullptr));
+        if (offs + 10 > size) {
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        const uint16_t rrType = readUInt16(msg + offs);
+        const uint16_t rrClass = readUInt16(msg + offs + 2);
+        const uint32_t rrTtl = readUInt32(msg + offs + 4);
+        const size_t rdLen = readUInt16(msg + offs + 8);
+        offs += 10;
+        if (offs + rdLen > size) {
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        if (rrClass == DNS_CLASS_IN) {
+            if (rrType == type && !found && rdLen == (type == DNS_TYPE_AAAA ? 16 : 4)) {
+                memcpy(ans->addr, msg + offs, rdLen);
+                ttl = std::min(ttl, rrTtl);
+                found = true;
+            } else if (rrType == DNS_TYPE_CNAME) {
+                ttl = std::min(ttl, rrTtl);
+            }
+        }
+        offs += rdLen;
+    }
+    if (found) {
+        ans->ttl = ttl;
+        ans->negative = false;
+        return 0;
+    }
+    // The name doesn't exist or has no records of the requested type. The TTL of a negative answer
+    // is the smaller of the TTL and MINIMUM fields of the SOA record (RFC 2308, 5)
+    ans->ttl = DnsResolver::DEFAULT_NEGATIVE_TTL;
+    ans->negative = true;
+    for (unsigned i = 0; i < nsCount; ++i) {
+        offs = CHECK(readName(msg, size, offs, nullptr));
+        if (offs + 10 > size) {
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        const uint16_t rrType = readUInt16(msg + offs);
+        const uint32_t rrTtl = readUInt32(msg + offs + 4);
+        const size_t rdLen = readUInt16(msg + offs + 8);
+        offs += 10;
+        if (offs + rdLen > size) {
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        if (rrType == DNS_TYPE_SOA && rdLen >= 22) {
+            ans->ttl = std::min(rrTtl, readUInt32(msg + offs + rdLen - 4));
+            break;
+        }
+        offs += rdLen;
+    }
+    return 0;
+}
+
+} // namespace
+
+const size_t DnsResolver::MAX_SERVERS;
+const system_tick_t DnsResolver::QUERY_TIMEOUT;
+const unsigned DnsResolver::MAX_ATTEMPTS;
+const system_tick_t DnsResolver::PREFETCH_TIMEOUT;
+const size_t DnsResolver::MAX_PREFETCH_QUERIES;
+const uint32_t DnsResolver::DEFAULT_NEGATIVE_TTL;
+
+DnsResolver::Request::Request() :
+        servers_(),
+        queries_(),
+        found_(),
+        hasAddr_(),
+        families_(),
+        name_(nullptr),
+        serverCount_(0),
+        familyCount_(0),
+        queryCount_(0),
+        error_(0) {
+}
+
+DnsResolver::DnsResolver() :
+        servers_(),
+        prefetch_(),
+        serverCount_(0),
+        prefetchSock_(-1) {
+}
+
+DnsResolver::~DnsResolver() {
+    for (auto& q: prefetch_) {
+        free(q.name);
+    }
+    closePrefetchSocket();
+}
+
+int DnsResolver::addServer(const struct sockaddr* addr) {
+    if (addr->sa_family != AF_INET && addr->sa_family != AF_INET6) {
+        return SYSTEM_ERROR_NOT_SUPPORTED;
+    }
+    if (serverCount_ == MAX_SERVERS) {
+        return SYSTEM_ERROR_LIMIT_EXCEEDED;
+    }
+    memcpy(&servers_[serverCount_++], addr, sockAddrSize(addr));
+    return 0;
+}
+
+void DnsResolver::clearServers() {
+    memset(servers_, 0, sizeof(servers_));
+    serverCount_ = 0;
+}
+
+int DnsResolver::resolve(const char* name, int family, DnsAddress* addrs, size_t maxCount) {
+    Request req;
+    if (CHECK(lookup(&req, name, family))) {
+        query(&req);
+    }
+    return complete(&req, addrs, maxCount);
+}
+
+int DnsResolver::lookup(Request* req, const char* name, int family) {
+    if (family == AF_UNSPEC) {
+        req->families_[req->familyCount_++] = AF_INET6;
+        req->families_[req->familyCount_++] = AF_INET;
+    } else if (family == AF_INET || family == AF_INET6) {
+        req->families_[req->familyCount_++] = family;
+    } else {
+        return SYSTEM_ERROR_NOT_SUPPORTED;
+    }
+    req->name_ = name;
+    process();
+    // Look up the cache
+    const system_tick_t now = HAL_Timer_Get_Milli_Seconds();
+    for (size_t i = 0; i < req->familyCount_; ++i) {
+        const int f = req->families_[i];
+        bool prefetch = false;
+        const auto r = cache_.find(name, f, now, req->found_[i].addr, &prefetch);
+        if (r == DnsCache::HIT) {
+            req->found_[i].family = f;
+            req->hasAddr_[i] = true;
+            if (prefetch) {
+                sendPrefetchQuery(name, f);
+            }
+        } else if (r == DnsCache::MISS) {
+            req->queries_[req->queryCount_++].family = f;
+        }
+    }
+    if (!req->queryCount_) {
+        return 0;
+    }
+    // The servers are copied so that the queries can be sent without accessing the resolver state
+    memcpy(req->servers_, servers_, sizeof(servers_));
+    req->serverCount_ = serverCount_;
+    return 1;
+}
+
+int DnsResolver::complete(Request* req, DnsAddress* addrs, size_t maxCount) {
+    int error = req->error_;
+    const system_tick_t t = HAL_Timer_Get_Milli_Seconds();
+    for (size_t i = 0; i < req->queryCount_; ++i) {
+        const Request::Query& q = req->queries_[i];
+        if (q.result != 1) {
+            if (q.result < 0) {
+                error = q.result;
+            }
+            continue;
+        }
+        if (q.answer.negative) {
+            cache_.putNegative(req->name_, q.family, q.answer.ttl, t);
+            continue;
+        }
+        cache_.put(req->name_, q.family, q.answer.addr, addressSize(q.family), q.answer.ttl, t);
+        const size_t j = (q.family == req->families_[0]) ? 0 : 1;
+        req->found_[j].family = q.family;
+        memcpy(req->found_[j].addr, q.answer.addr, addressSize(q.family));
+        req->hasAddr_[j] = true;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < req->familyCount_ && count < maxCount; ++i) {
+        if (req->hasAddr_[i]) {
+            addrs[count++] = req->found_[i];
+        }
+    }
+    if (!count) {
+        return (error < 0) ? error : SYSTEM_ERROR_NOT_FOUND;
+    }
+    return count;
+}
+
+void DnsResolver::process() {
+    if (prefetchSock_ < 0) {
+        return;
+    }
+    std::unique_ptr<uint8_t[]> buf(new(std::nothrow) uint8_t[MAX_DNS_MESSAGE_SIZE]);
+    if (buf) {
+        for (;;) {
+            struct sockaddr_storage from = {};
+            socklen_t fromLen = sizeof(from);
+            const ssize_t n = sock_recvfrom(prefetchSock_, buf.get(), MAX_DNS_MESSAGE_SIZE, MSG_DONTWAIT,
+                    (struct sockaddr*)&from, &fromLen);
+            if (n < 0) {
+                break;
+            }
+            if (!serverCount_ || !sameSockAddr((const struct sockaddr*)&from, (const struct sockaddr*)&servers_[0]) ||
+                    n < 2) {
+                continue;
+            }
+            const uint16_t id = readUInt16(buf.get());
+            for (auto& q: prefetch_) {
+                if (!q.name || q.id != id) {
+                    continue;
+                }
+                DnsAnswer ans = {};
+                const int r = parseResponse(buf.get(), n, q.name, queryType(q.family), &ans);
+                if (r == SYSTEM_ERROR_BAD_DATA) {
+                    break; // Keep waiting
+                }
+                const system_tick_t t = HAL_Timer_Get_Milli_Seconds();
+                if (r < 0) {
+                    cache_.cancelPrefetch(q.name, q.family);
+                } else if (ans.negative) {
+                    cache_.putNegative(q.name, q.family, ans.ttl, t);
+                } else {
+                    cache_.put(q.name, q.family, ans.addr, addressSize(q.family), ans.ttl, t);
+                }
+                free(q.name);
+                q.name = nullptr;
+                break;
+            }
+        }
+    }
+    // Discard the queries that timed out
+    bool pending = false;
+    const system_tick_t now = HAL_Timer_Get_Milli_Seconds();
+    for (auto& q: prefetch_) {
+        if (!q.name) {
+            continue;
+        }
+        if (now - q.time >= PREFETCH_TIMEOUT) {
+            cache_.cancelPrefetch(q.name, q.family);
+            free(q.name);
+            q.name = nullptr;
+        } else {
+            pending = true;
+        }
+    }
+    if (!pending) {
+        closePrefetchSocket();
+    }
+}
+
+void DnsResolver::query(Request* req) {
+    const char* const name = req->name_;
+    const auto queries = req->queries_;
+    const size_t count = req->queryCount_;
+    if (!req->serverCount_) {
+        req->error_ = SYSTEM_ERROR_INVALID_STATE;
+        return;
+    }
+    std::unique_ptr<uint8_t[]> buf(new(std::nothrow) uint8_t[MAX_DNS_MESSAGE_SIZE]);
+    if (!buf) {
+        req->error_ = SYSTEM_ERROR_NO_MEMORY;
+        return;
+    }
+    int error = SYSTEM_ERROR_TIMEOUT;
+    size_t pending = count;
+    for (size_t i = 0; i < req->serverCount_ && pending > 0; ++i) {
+        const auto server = (const struct sockaddr*)&req->servers_[i];
+        const int sock = sock_socket(server->sa_family, SOCK_DGRAM, IPPROTO_UDP);
+        if (sock < 0) {
+            error = SYSTEM_ERROR_NETWORK;
+            continue;
+        }
+        SCOPE_GUARD({
+            sock_close(sock);
+        });
+        for (size_t j = 0; j < count; ++j) {
+            queries[j].id = randomId();
+            queries[j].skip = false;
+        }
+        for (unsigned attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+            // Send the A and AAAA queries at once
+            size_t active = 0;
+            for (size_t j = 0; j < count; ++j) {
+                Request::Query& q = queries[j];
+                if (q.result == 1 || q.skip) {
+                    continue;
+                }
+                const int n = encodeQuery(buf.get(), MAX_DNS_MESSAGE_SIZE, q.id, name, queryType(q.family));
+                if (n < 0) {
+                    req->error_ = n;
+                    return;
+                }
+                if (sock_sendto(sock, buf.get(), n, 0, server, sockAddrSize(server)) != n) {
+                    q.skip = true;
+                    q.result = SYSTEM_ERROR_NETWORK;
+                    continue;
+                }
+                ++active;
+            }
+            const system_tick_t t0 = HAL_Timer_Get_Milli_Seconds();
+            for (;;) {
+                const system_tick_t dt = HAL_Timer_Get_Milli_Seconds() - t0;
+                if (!active || dt >= QUERY_TIMEOUT) {
+                    break;
+                }
+                struct pollfd pfd = {};
+                pfd.fd = sock;
+                pfd.events = POLLIN;
+                const int r = sock_poll(&pfd, 1, QUERY_TIMEOUT - dt);
+                if (r < 0) {
+                    break;
+                }
+                if (r == 0 || !(pfd.revents & POLLIN)) {
+                    continue;
+                }
+                struct sockaddr_storage from = {};
+                socklen_t fromLen = sizeof(from);
+                const ssize_t n = sock_recvfrom(sock, buf.get(), MAX_DNS_MESSAGE_SIZE, MSG_DONTWAIT,
+                        (struct sockaddr*)&from, &fromLen);
+                if (n < 2 || !sameSockAddr((const struct sockaddr*)&from, server)) {
+                    continue;
+                }
+                const uint16_t id = readUInt16(buf.get());
+                for (size_t j = 0; j < count; ++j) {
+                    Request::Query& q = queries[j];
+                    if (q.result == 1 || q.skip || q.id != id) {
+                        continue;
+                    }
+                    const int r = parseResponse(buf.get(), n, name, queryType(q.family), &q.answer);
+                    if (r == 0) {
+                        q.result = 1;
+                        --active;
+                        --pending;
+                    } else if (r != SYSTEM_ERROR_BAD_DATA) {
+                        // Try the next server
+                        q.result = r;
+                        q.skip = true;
+                        --active;
+                    }
+                    break;
+                }
+            }
+            if (!active) {
+                break;
+            }
+        }
+    }
+    for (size_t j = 0; j < count; ++j) {
+        if (queries[j].result == 0) {
+            queries[j].result = error;
+        }
+    }
+    if (pending == count) {
+        req->error_ = error;
+    }
+}
+
+void DnsResolver::sendPrefetchQuery(const char* name, int family) {
+    PrefetchQuery* q = nullptr;
+    for (auto& q2: prefetch_) {
+        if (!q2.name) {
+            q = &q2;
+            break;
+        }
+    }
+    if (!q || !serverCount_) {
+        cache_.cancelPrefetch(name, family);
+        return;
+    }
+    const auto server = (const struct sockaddr*)&servers_[0];
+    if (prefetchSock_ < 0) {
+        prefetchSock_ = sock_socket(server->sa_family, SOCK_DGRAM, IPPROTO_UDP);
+        if (prefetchSock_ < 0) {
+            cache_.cancelPrefetch(name, family);
+            return;
+        }
+    }
+    uint8_t buf[MAX_DNS_QUERY_SIZE];
+    const uint16_t id = randomId();
+    const int n = encodeQuery(buf, sizeof(buf), id, name, queryType(family));
+    if (n < 0 || !(q->name = strdup(name))) {
+        cache_.cancelPrefetch(name, family);
+        return;
+    }
+    if (sock_sendto(prefetchSock_, buf, n, 0, server, sockAddrSize(server)) != n) {
+        free(q->name);
+        q->name = nullptr;
+        cache_.cancelPrefetch(name, family);
+        return;
+    }
+    q->id = id;
+    q->family = family;
+    q->time = HAL_Timer_Get_Milli_Seconds();
+}
+
+void DnsResolver::closePrefetchSocket() {
+    if (prefetchSock_ >= 0) {
+        sock_close(prefetchSock_);
+        prefetchSock_ = -1;
+    }
+}
+
+} // namespace particle
+
+#endif // HAL_USE_SOCKET_HAL_POSIX
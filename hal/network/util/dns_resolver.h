@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "hal_platform.h"
+
+#if HAL_USE_SOCKET_HAL_POSIX
+
+#include "dns_cache.h"
+#include "socket_hal_posix.h"
+
+namespace particle {
+
+/**
+ * A resolved address.
+ */
+struct DnsAddress {
+    int family; ///< `AF_INET` or `AF_INET6`.
+    uint8_t addr[DNS_CACHE_MAX_ADDRESS_SIZE]; ///< `in_addr` or `in6_addr` in network byte order.
+};
+
+/**
+ * An answer to an A or AAAA query.
+ */
+struct DnsAnswer {
+    uint8_t addr[DNS_CACHE_MAX_ADDRESS_SIZE];
+    uint32_t ttl;
+    bool negative;
+};
+
+/**
+ * A caching stub resolver.
+ *
+ * The resolver queries the configured DNS servers over UDP and caches the answers, including the
+ * negative ones, according to their TTL. When both IPv4 and IPv6 addresses are requested, the A and
+ * AAAA queries are sent in parallel. A cached address that is in frequent use is refreshed shortly
+ * before it expires: the query is sent in the background and the answer is only stored in the
+ * cache by one of the subsequent calls to `resolve()`, `lookup()` or `process()`. Until then, the
+ * cached address keeps being returned.
+ *
+ * Only one address of each family is returned for a host name.
+ *
+ * The class doesn't do any locking. A host name can be resolved in steps so that the caller only
+ * needs to hold a lock while the resolver state is accessed: `lookup()` and `complete()` access
+ * the cache, while `query()` sends the queries and waits for the answers without accessing the
+ * resolver state.
+ */
+class DnsResolver {
+public:
+    /**
+     * Maximum number of DNS servers.
+     */
+    static const size_t MAX_SERVERS = 3;
+    /**
+     * Time in milliseconds to wait for an answer before sending a query again.
+     */
+    static const system_tick_t QUERY_TIMEOUT = 2000;
+    /**
+     * Number of times a query is sent to each server.
+     */
+    static const unsigned MAX_ATTEMPTS = 2;
+    /**
+     * Time in milliseconds to wait for an answer to a prefetch query.
+     */
+    static const system_tick_t PREFETCH_TIMEOUT = 5000;
+    /**
+     * Maximum number of prefetch queries in flight.
+     */
+    static const size_t MAX_PREFETCH_QUERIES = 2;
+    /**
+     * TTL of a negative answer in seconds if the server didn't provide one (RFC 2308, 5).
+     */
+    static const uint32_t DEFAULT_NEGATIVE_TTL = 60;
+
+    /**
+     * State of a host name resolution.
+     */
+    class Request {
+    public:
+        Request();
+
+    private:
+        struct Query {
+            DnsAnswer answer;
+            int family;
+            int result; // 1 if the query is answered, 0 if pending, or a negative result code
+            uint16_t id;
+            bool skip; // Set if the current server failed to answer the query
+        };
+
+        struct sockaddr_storage servers_[MAX_SERVERS];
+        Query queries_[2];
+        DnsAddress found_[2];
+        bool hasAddr_[2];
+        int families_[2];
+        const char* name_;
+        size_t serverCount_;
+        size_t familyCount_;
+        size_t queryCount_;
+        int error_;
+
+        friend class DnsResolver;
+    };
+
+    DnsResolver();
+    ~DnsResolver();
+
+    /**
+     * Adds a DNS server.
+     *
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int addServer(const struct sockaddr* addr);
+    void clearServers();
+    size_t serverCount() const;
+
+    /**
+     * Resolves a host name.
+     *
+     * @param name Host name.
+     * @param family `AF_INET`, `AF_INET6` or `AF_UNSPEC`. IPv6 addresses are returned first.
+     * @param[out] addrs Resolved addresses.
+     * @param maxCount Maximum number of addresses to return.
+     * @return Number of resolved addresses, `SYSTEM_ERROR_NOT_FOUND` if the name doesn't have
+     *         addresses of the requested family, or another negative result code in case of an error.
+     */
+    int resolve(const char* name, int family, DnsAddress* addrs, size_t maxCount);
+    /**
+     * Looks up a host name in the cache.
+     *
+     * This is the first step of `resolve()`. The request keeps a pointer to `name`.
+     *
+     * @param req Request.
+     * @param name Host name.
+     * @param family `AF_INET`, `AF_INET6` or `AF_UNSPEC`.
+     * @return 1 if `query()` needs to be called for the request, 0 if `complete()` can be called
+     *         right away, or a negative result code in case of an error.
+     */
+    int lookup(Request* req, const char* name, int family);
+    /**
+     * Queries the DNS servers for the addresses that were not found in the cache.
+     *
+     * This method blocks until the servers answer or the queries time out. It doesn't access the
+     * state of the resolver and can be called without holding the lock that protects it.
+     */
+    static void query(Request* req);
+    /**
+     * Stores the answers in the cache and gets the resolved addresses.
+     *
+     * @return Same as `resolve()`.
+     */
+    int complete(Request* req, DnsAddress* addrs, size_t maxCount);
+    /**
+     * Processes the answers to the prefetch queries.
+     */
+    void process();
+
+    DnsCacheStats cacheStats() const;
+    void clearCache();
+
+private:
+    struct PrefetchQuery {
+        char* name;
+        system_tick_t time;
+        int family;
+        uint16_t id;
+    };
+
+    struct sockaddr_storage servers_[MAX_SERVERS];
+    PrefetchQuery prefetch_[MAX_PREFETCH_QUERIES];
+    DnsCache cache_;
+    size_t serverCount_;
+    int prefetchSock_;
+
+    void sendPrefetchQuery(const char* name, int family);
+    void closePrefetchSocket();
+};
+
+inline size_t DnsResolver::serverCount() const {
+    return serverCount_;
+}
+
+inline DnsCacheStats DnsResolver::cacheStats() const {
+    return cache_.stats();
+}
+
+inline void DnsResolver::clearCache() {
+    cache_.clear();
+}
+
+} // namespace particle
+
+#endif // HAL_USE_SOCKET_HAL_POSIX
@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "hal_platform.h"
+
+#if HAL_PLATFORM_BLE
+
+#include "ble_hal_defines.h"
+#include "hash_util.h"
+#include "spark_wiring_vector.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace particle {
+
+namespace ble {
+
+/**
+ * Invokes `fn(type, data, size)` for each AD structure found in the advertising data.
+ *
+ * The data is parsed in place. The iteration stops at the first malformed AD structure or when
+ * the callback returns `false`.
+ *
+ * @return `false` if the iteration has been stopped by the callback, or `true` otherwise.
+ */
+template<typename F>
+inline bool forEachAdStructure(const uint8_t* buf, size_t size, F fn) {
+    size_t offs = 0;
+    while (offs + 2 <= size) {
+        const size_t len = buf[offs]; // Length of the type and data fields
+        if (len == 0) {
+            // Early termination of the advertising data
+            break;
+        }
+        if (offs + len + 1 > size) {
+            break;
+        }
+        if (!fn(buf[offs + 1], buf + offs + 2, len - 1)) {
+            return false;
+        }
+        offs += len + 1;
+    }
+    return true;
+}
+
+enum class ScanDedupResult {
+    NEW, // The peer hasn't been seen before
+    CHANGED, // The peer has been seen before, but its data or RSSI has changed
+    UNCHANGED // The peer has been seen before and nothing has changed
+};
+
+/**
+ * Fixed-size hash table for deduplicating scan results by peer address.
+ *
+ * For every peer, the table keeps a hash of its advertising data (see `fnv1a_update()`) and a
+ * running average of its
+ * RSSI. A peer is considered changed if its data hash differs from the one that was reported last
+ * time, or if its average RSSI has drifted away from the reported value by at least the configured
+ * threshold.
+ *
+ * When the table is full, the peer that hasn't been seen for the longest time is evicted to make
+ * room for a new one. The class doesn't do any locking.
+ *
+ * @tparam N Number of entries. Must be a power of 2.
+ */
+template<size_t N>
+class ScanDedupTable {
+public:
+    struct Entry {
+        uint8_t addr[BLE_SIG_ADDR_LEN];
+        uint8_t addrType;
+        uint8_t used;
+        int16_t rssi; // Running average, in 1/16 dBm
+        int8_t reportedRssi;
+        uint8_t reserved;
+        uint16_t count; // Number of scan results received for this peer
+        uint32_t dataHash;
+        uint32_t lastSeen; // Value of the update counter when the peer was last seen
+    };
+
+    explicit ScanDedupTable(uint8_t rssiThreshold = 0)
+            : size_(0),
+              updateCount_(0),
+              rssiThreshold_(rssiThreshold) {
+        clear();
+    }
+
+    /**
+     * Sets the minimum change in the average RSSI for a peer to be reported as changed.
+     *
+     * A value of 0 disables the RSSI check.
+     */
+    void rssiThreshold(uint8_t threshold) {
+        rssiThreshold_ = threshold;
+    }
+
+    uint8_t rssiThreshold() const {
+        return rssiThreshold_;
+    }
+
+    ScanDedupResult update(const uint8_t* addr, uint8_t addrType, int8_t rssi, uint32_t dataHash) {
+        Entry* e = lookup(addr, addrType);
+        if (!e) {
+            evict();
+            e = lookup(addr, addrType);
+        }
+        e->lastSeen = ++updateCount_;
+        if (!e->used) {
+            memcpy(e->addr, addr, BLE_SIG_ADDR_LEN);
+            e->addrType = addrType;
+            e->used = 1;
+            e->rssi = (int16_t)rssi * 16;
+            e->reportedRssi = rssi;
+            e->count = 1;
+            e->dataHash = dataHash;
+            ++size_;
+            return ScanDedupResult::NEW;
+        }
+        if (e->count < UINT16_MAX) {
+            ++e->count;
+        }
+        // Exponential moving average with a weight of 1/4 for the new sample
+        e->rssi += ((int16_t)rssi * 16 - e->rssi) / 4;
+        const int8_t avgRssi = e->rssi / 16;
+        bool changed = false;
+        if (e->dataHash != dataHash) {
+            e->dataHash = dataHash;
+            changed = true;
+        }
+        if (rssiThreshold_ > 0) {
+            const int diff = (int)avgRssi - e->reportedRssi;
+            if (diff >= rssiThreshold_ || -diff >= rssiThreshold_) {
+                changed = true;
+            }
+        }
+        if (!changed) {
+            return ScanDedupResult::UNCHANGED;
+        }
+        e->reportedRssi = avgRssi;
+        return ScanDedupResult::CHANGED;
+    }
+
+    const Entry* find(const uint8_t* addr, uint8_t addrType) const {
+        const Entry* e = const_cast<ScanDedupTable*>(this)->lookup(addr, addrType);
+        if (!e || !e->used) {
+            return nullptr;
+        }
+        return e;
+    }
+
+    void clear() {
+        memset(entries_, 0, sizeof(entries_));
+        size_ = 0;
+        updateCount_ = 0;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    static constexpr size_t capacity() {
+        return N;
+    }
+
+private:
+    static_assert(N > 0 && (N & (N - 1)) == 0, "Number of entries must be a power of 2");
+
+    Entry entries_[N];
+    size_t size_;
+    uint32_t updateCount_;
+    uint8_t rssiThreshold_;
+
+    static size_t slot(const uint8_t* addr, uint8_t addrType) {
+        uint32_t h = fnv1a_update(FNV1A_INIT, addr, BLE_SIG_ADDR_LEN);
+        h = fnv1a_update(h, &addrType, 1);
+        return h & (N - 1);
+    }
+
+    // Returns the entry for the address, an unused entry where it can be stored, or nullptr if the table is full
+    Entry* lookup(const uint8_t* addr, uint8_t addrType) {
+        const size_t s = slot(addr, addrType);
+        for (size_t i = 0; i < N; ++i) {
+            Entry* e = &entries_[(s + i) & (N - 1)];
+            if (!e->used || (e->addrType == addrType && memcmp(e->addr, addr, BLE_SIG_ADDR_LEN) == 0)) {
+                return e;
+            }
+        }
+        return nullptr;
+    }
+
+    // Removes the least recently seen entry
+    void evict() {
+        size_t i = 0;
+        for (size_t j = 1; j < N; ++j) {
+            if ((int32_t)(entries_[j].lastSeen - entries_[i].lastSeen) < 0) {
+                i = j;
+            }
+        }
+        // Move the subsequent entries of the probe sequence back, so that they remain reachable
+        // from their home slots
+        for (size_t n = 1; n < N; ++n) {
+            const size_t j = (i + n) & (N - 1);
+            const Entry& e = entries_[j];
+            if (!e.used) {
+                break;
+            }
+            const size_t s = slot(e.addr, e.addrType);
+            if (((j - s) & (N - 1)) >= ((j - i) & (N - 1))) {
+                entries_[i] = e;
+                i = j;
+                n = 0;
+            }
+        }
+        memset(&entries_[i], 0, sizeof(Entry));
+        --size_;
+    }
+};
+
+/**
+ * Scan filter compiled into a form that can be matched against the raw advertising data.
+ *
+ * Both the advertising data and the scan response data are parsed only once, in place. A device
+ * passes the filter if it matches at least one of the configured values of each kind. The custom
+ * data is not copied and needs to remain valid while the matcher is in use.
+ */
+class ScanFilterMatcher {
+public:
+    ScanFilterMatcher()
+            : customData_(nullptr),
+              customDataLen_(0),
+              minRssi_(INT8_MIN),
+              maxRssi_(INT8_MAX),
+              required_(0) {
+    }
+
+    void clear() {
+        addresses_.clear();
+        names_.clear();
+        uuids16_.clear();
+        uuids128_.clear();
+        appearances_.clear();
+        customData_ = nullptr;
+        customDataLen_ = 0;
+        minRssi_ = INT8_MIN;
+        maxRssi_ = INT8_MAX;
+        required_ = 0;
+    }
+
+    bool addAddress(const uint8_t* addr, uint8_t addrType) {
+        Address a = {};
+        memcpy(a.addr, addr, BLE_SIG_ADDR_LEN);
+        a.addrType = addrType;
+        return addresses_.append(a);
+    }
+
+    bool addName(const char* name, size_t len) {
+        required_ |= MATCHED_NAME;
+        if (len > UINT8_MAX) {
+            // Can't be contained in an AD structure and thus never matches
+            return true;
+        }
+        // Names are stored as a sequence of length-prefixed strings
+        return names_.append((char)len) && names_.append(name, len);
+    }
+
+    bool addServiceUuid16(uint16_t uuid) {
+        required_ |= MATCHED_SERVICE_UUID;
+        return uuids16_.append(uuid);
+    }
+
+    bool addServiceUuid128(const uint8_t* uuid) {
+        required_ |= MATCHED_SERVICE_UUID;
+        return uuids128_.append(uuid, BLE_SIG_UUID_128BIT_LEN);
+    }
+
+    bool addAppearance(uint16_t appearance) {
+        required_ |= MATCHED_APPEARANCE;
+        return appearances_.append(appearance);
+    }
+
+    void customData(const uint8_t* data, size_t len) {
+        customData_ = data;
+        customDataLen_ = len;
+        if (data && len > 0) {
+            required_ |= MATCHED_CUSTOM_DATA;
+        } else {
+            required_ &= ~MATCHED_CUSTOM_DATA;
+        }
+    }
+
+    void minRssi(int8_t rssi) {
+        minRssi_ = rssi;
+    }
+
+    void maxRssi(int8_t rssi) {
+        maxRssi_ = rssi;
+    }
+
+    bool match(const uint8_t* addr, uint8_t addrType, int8_t rssi, const uint8_t* advData, size_t advDataLen,
+            const uint8_t* srData, size_t srDataLen) const {
+        if (rssi < minRssi_ || rssi > maxRssi_) {
+            return false;
+        }
+        if (addresses_.size() > 0) {
+            bool found = false;
+            for (const auto& a: addresses_) {
+                if (a.addrType == addrType && !memcmp(a.addr, addr, BLE_SIG_ADDR_LEN)) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                return false;
+            }
+        }
+        if (!required_) {
+            return true;
+        }
+        unsigned matched = matchData(advData, advDataLen);
+        if ((matched & required_) != required_) {
+            matched |= matchData(srData, srDataLen);
+            if ((matched & required_) != required_) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    enum MatchFlag {
+        MATCHED_NAME = 0x01,
+        MATCHED_SERVICE_UUID = 0x02,
+        MATCHED_APPEARANCE = 0x04,
+        MATCHED_CUSTOM_DATA = 0x08
+    };
+
+    struct Address {
+        uint8_t addr[BLE_SIG_ADDR_LEN];
+        uint8_t addrType;
+    };
+
+    spark::Vector<Address> addresses_;
+    spark::Vector<char> names_;
+    spark::Vector<uint16_t> uuids16_;
+    spark::Vector<uint8_t> uuids128_;
+    spark::Vector<uint16_t> appearances_;
+    const uint8_t* customData_;
+    size_t customDataLen_;
+    int8_t minRssi_;
+    int8_t maxRssi_;
+    unsigned required_;
+
+    unsigned matchData(const uint8_t* data, size_t size) const {
+        unsigned matched = 0;
+        bool hasAppearance = false;
+        bool hasCustomData = false;
+        if (data && size > 0) {
+            forEachAdStructure(data, size, [&](uint8_t type, const uint8_t* buf, size_t len) {
+                switch (type) {
+                case BLE_SIG_AD_TYPE_SHORT_LOCAL_NAME:
+                case BLE_SIG_AD_TYPE_COMPLETE_LOCAL_NAME: {
+                    if (matchName((const char*)buf, len)) {
+                        matched |= MATCHED_NAME;
+                    }
+                    break;
+                }
+                case BLE_SIG_AD_TYPE_16BIT_SERVICE_UUID_MORE_AVAILABLE:
+                case BLE_SIG_AD_TYPE_16BIT_SERVICE_UUID_COMPLETE: {
+                    for (size_t i = 0; i + BLE_SIG_UUID_16BIT_LEN <= len; i += BLE_SIG_UUID_16BIT_LEN) {
+                        const uint16_t uuid = (uint16_t)buf[i] | ((uint16_t)buf[i + 1] << 8);
+                        if (uuids16_.contains(uuid)) {
+                            matched |= MATCHED_SERVICE_UUID;
+                            break;
+                        }
+                    }
+                    break;
+                }
+                case BLE_SIG_AD_TYPE_128BIT_SERVICE_UUID_MORE_AVAILABLE:
+                case BLE_SIG_AD_TYPE_128BIT_SERVICE_UUID_COMPLETE: {
+                    for (size_t i = 0; i + BLE_SIG_UUID_128BIT_LEN <= len; i += BLE_SIG_UUID_128BIT_LEN) {
+                        if (matchUuid128(buf + i)) {
+                            matched |= MATCHED_SERVICE_UUID;
+                            break;
+                        }
+                    }
+                    break;
+                }
+                case BLE_SIG_AD_TYPE_APPEARANCE: {
+                    // Only the first structure of a given type is taken into account
+                    if (!hasAppearance && len >= 2) {
+                        hasAppearance = true;
+                        const uint16_t appearance = (uint16_t)buf[0] | ((uint16_t)buf[1] << 8);
+                        if (appearances_.contains(appearance)) {
+                            matched |= MATCHED_APPEARANCE;
+                        }
+                    }
+                    break;
+                }
+                case BLE_SIG_AD_TYPE_MANUFACTURER_SPECIFIC_DATA: {
+                    if (!hasCustomData) {
+                        hasCustomData = true;
+                        if (len == customDataLen_ && customData_ && !memcmp(buf, customData_, len)) {
+                            matched |= MATCHED_CUSTOM_DATA;
+                        }
+                    }
+                    break;
+                }
+                default:
+                    break;
+                }
+                return true;
+            });
+        }
+        if (!hasAppearance && appearances_.contains(BLE_SIG_APPEARANCE_UNKNOWN)) {
+            matched |= MATCHED_APPEARANCE;
+        }
+        return matched;
+    }
+
+    bool matchName(const char* name, size_t len) const {
+        for (int i = 0; i < names_.size(); i += (uint8_t)names_[i] + 1) {
+            if ((uint8_t)names_[i] == len && !memcmp(names_.data() + i + 1, name, len)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool matchUuid128(const uint8_t* uuid) const {
+        for (int i = 0; i < uuids128_.size(); i += BLE_SIG_UUID_128BIT_LEN) {
+            if (!memcmp(uuids128_.data() + i, uuid, BLE_SIG_UUID_128BIT_LEN)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+} // namespace ble
+
+} // namespace particle
+
+#endif // HAL_PLATFORM_BLE
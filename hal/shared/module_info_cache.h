@@ -0,0 +1,502 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "ota_flash_hal.h"
+#include "hal_platform.h"
+#include "system_error.h"
+#include "crc32_util.h"
+
+#include <cstring>
+#include <cstddef>
+
+namespace particle {
+
+const size_t MODULE_INFO_CACHE_MAX_MODULES = 10;
+
+/**
+ * List of the modules whose integrity has been verified.
+ *
+ * The list is meant to be placed in retained memory, so that the modules don't need to be verified
+ * again after a reset. A module is identified by its start address, length and the CRC stored at
+ * its end, so a module replaced with a different one doesn't match the old entry. The entries
+ * overlapping with a region of the flash need to be removed when the region is written to.
+ *
+ * The list data is validated with a checksum and discarded if it's corrupted, e.g. after a cold
+ * boot. The class doesn't do any locking.
+ */
+class VerifiedModuleList {
+public:
+    struct Entry {
+        uint32_t address;
+        uint32_t length;
+        uint32_t crc;
+    };
+
+    struct Data {
+        uint32_t magic;
+        uint32_t count;
+        Entry entries[MODULE_INFO_CACHE_MAX_MODULES];
+        uint32_t checksum;
+    };
+
+    explicit VerifiedModuleList(Data* data) :
+            d_(data) {
+    }
+
+    /**
+     * Returns `true` if a module with the given start address, length and stored CRC has been
+     * verified.
+     */
+    bool has(uint32_t address, uint32_t length, uint32_t crc) const {
+        if (!isValid()) {
+            return false;
+        }
+        for (size_t i = 0; i < d_->count; ++i) {
+            const auto& e = d_->entries[i];
+            if (e.address == address && e.length == length && e.crc == crc) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Adds a verified module to the list, replacing any other module stored at the same address.
+     *
+     * If the list is full, the oldest entry is removed.
+     */
+    void add(uint32_t address, uint32_t length, uint32_t crc) {
+        if (!isValid()) {
+            clear();
+        }
+        removeAt(address);
+        if (d_->count == MODULE_INFO_CACHE_MAX_MODULES) {
+            memmove(&d_->entries[0], &d_->entries[1], (d_->count - 1) * sizeof(Entry));
+            --d_->count;
+        }
+        d_->entries[d_->count++] = { address, length, crc };
+        d_->checksum = checksum(*d_);
+    }
+
+    /**
+     * Removes the modules overlapping with the given region of the flash.
+     */
+    void remove(uint32_t address, size_t size) {
+        if (!isValid()) {
+            return;
+        }
+        for (size_t i = 0; i < d_->count;) {
+            const auto& e = d_->entries[i];
+            // Include the CRC stored after the end of the module
+            if (e.address < address + size && address < e.address + e.length + sizeof(uint32_t)) {
+                memmove(&d_->entries[i], &d_->entries[i + 1], (d_->count - i - 1) * sizeof(Entry));
+                --d_->count;
+            } else {
+                ++i;
+            }
+        }
+        d_->checksum = checksum(*d_);
+    }
+
+    void clear() {
+        memset(d_, 0, sizeof(Data));
+        d_->magic = MAGIC;
+        d_->checksum = checksum(*d_);
+    }
+
+    size_t size() const {
+        return isValid() ? d_->count : 0;
+    }
+
+private:
+    static const uint32_t MAGIC = 0x7ef1c4c3;
+
+    Data* d_;
+
+    bool isValid() const {
+        return d_->magic == MAGIC && d_->count <= MODULE_INFO_CACHE_MAX_MODULES && d_->checksum == checksum(*d_);
+    }
+
+    void removeAt(uint32_t address) {
+        for (size_t i = 0; i < d_->count; ++i) {
+            if (d_->entries[i].address == address) {
+                memmove(&d_->entries[i], &d_->entries[i + 1], (d_->count - i - 1) * sizeof(Entry));
+                --d_->count;
+                return;
+            }
+        }
+    }
+
+    static uint32_t checksum(const Data& d) {
+        return crc32_update(0, &d, offsetof(Data, checksum));
+    }
+};
+
+/**
+ * Interface used by `ModuleInfoCache` to access the module storage.
+ */
+class ModuleReader {
+public:
+    /**
+     * Result code indicating that the module has been validated by the platform.
+     */
+    static const int PLATFORM_VALIDATED = 1;
+
+    virtual ~ModuleReader() = default;
+
+    /**
+     * Reads the module info and its offset in the module.
+     *
+     * Modules that are not stored in a regular way (e.g. the radio stack) are validated by the platform,
+     * in which case the reader also sets the validity flags of the module and returns `PLATFORM_VALIDATED`.
+     *
+     * @return 0 or `PLATFORM_VALIDATED` on success, or a negative result code in case of an error.
+     */
+    virtual int readInfo(const module_bounds_t* bounds, hal_module_t* module) = 0;
+    /**
+     * Reads the module suffix and CRC. Called only for the modules not validated by the platform.
+     */
+    virtual int readSuffix(const module_bounds_t* bounds, hal_module_t* module) = 0;
+    /**
+     * Verifies the CRC of a module.
+     */
+    virtual bool verifyIntegrity(const module_bounds_t* bounds, const module_info_t* info) = 0;
+    /**
+     * Returns `true` if the integrity of a module has already been verified, e.g. before a reset.
+     * Called only for the modules whose suffix and CRC have been read.
+     */
+    virtual bool isVerified(const module_bounds_t* bounds, const hal_module_t* module) {
+        return false;
+    }
+    /**
+     * Called when the integrity of a module has been verified successfully. Called only for the
+     * modules whose suffix and CRC have been read.
+     */
+    virtual void verified(const module_bounds_t* bounds, const hal_module_t* module) {
+    }
+};
+
+/**
+ * Cache of the module info for the modules in the module bounds table.
+ *
+ * The module headers are read in a single pass on first use and the dependency checks are then
+ * performed against the cached data. The integrity of a module is verified only when it's requested
+ * via `MODULE_VALIDATION_INTEGRITY`, and the result is cached as well. The cached data needs to be
+ * invalidated when a module region is written to.
+ *
+ * The class doesn't do any locking.
+ */
+class ModuleInfoCache {
+public:
+    ModuleInfoCache(ModuleReader* reader, const module_bounds_t* const* bounds, size_t count, uint16_t platformId) :
+            entries_(),
+            bounds_(bounds),
+            reader_(reader),
+            count_(count),
+            platformId_(platformId) {
+        if (count_ > MODULE_INFO_CACHE_MAX_MODULES) {
+            count_ = MODULE_INFO_CACHE_MAX_MODULES;
+        }
+    }
+
+    /**
+     * Gets a module and validates it.
+     *
+     * The range, platform and dependency checks are always performed. Other checks are performed
+     * according to `flags`. This method is equivalent to `fetch_module()`.
+     *
+     * @return `true` if the module info could be read, or `false` otherwise.
+     */
+    bool getModule(size_t index, hal_module_t* module, unsigned flags, bool userDepsOptional = false) {
+        memset(module, 0, sizeof(hal_module_t));
+        if (index >= count_) {
+            return false;
+        }
+        const auto bounds = bounds_[index];
+        module->bounds = *bounds;
+        Entry* e = entry(index);
+        if (!(e->state & INFO_VALID)) {
+            return false;
+        }
+        *module = e->module;
+        module->bounds = *bounds;
+        if (e->state & PLATFORM_CHECKED) {
+            return true;
+        }
+        module->validity_checked = MODULE_VALIDATION_RANGE | MODULE_VALIDATION_DEPENDENCIES | MODULE_VALIDATION_PLATFORM | flags;
+        module->validity_result = 0;
+        const module_info_t* info = &module->info;
+        // On Gen 3 platforms, the reserved field of the module info contains the MCU target
+        const module_bounds_t* expected = findBounds(info->module_function, info->module_index, info->reserved);
+        const uintptr_t end = (uintptr_t)info->module_end_address;
+        if (!expected || end < expected->start_address || end > expected->end_address) {
+            return false;
+        }
+        module->validity_result |= MODULE_VALIDATION_RANGE;
+        if (info->platform_id == platformId_) {
+            module->validity_result |= MODULE_VALIDATION_PLATFORM;
+        }
+        if (!(e->state & SUFFIX_VALID)) {
+            return false;
+        }
+        if (checkDependencies(info, userDepsOptional) &&
+                (!(flags & MODULE_VALIDATION_DEPENDENCIES_FULL) || checkDependenciesFull(info, bounds))) {
+            module->validity_result |= MODULE_VALIDATION_DEPENDENCIES | (flags & MODULE_VALIDATION_DEPENDENCIES_FULL);
+        }
+        if (flags & MODULE_VALIDATION_INTEGRITY) {
+            checkIntegrity(bounds, e);
+            if (e->state & INTEGRITY_VALID) {
+                module->validity_result |= MODULE_VALIDATION_INTEGRITY;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Verifies the integrity of the module stored at the given address.
+     *
+     * The result is cached together with the module info, so that `getModule()` doesn't need to
+     * verify the module again, and vice versa.
+     *
+     * @param location Module location.
+     * @param address Start address of the module.
+     * @param[out] valid Set to `true` if the module is valid, or `false` otherwise.
+     * @return 0 on success, or `SYSTEM_ERROR_NOT_FOUND` if no module is expected at the given address.
+     */
+    int checkIntegrity(module_bounds_location_t location, uintptr_t address, bool* valid) {
+        for (size_t i = 0; i < count_; ++i) {
+            const auto bounds = bounds_[i];
+            if (bounds->location != location || bounds->start_address != address) {
+                continue;
+            }
+            Entry* e = entry(i);
+            if (!(e->state & INFO_VALID)) {
+                *valid = false;
+            } else if (e->state & PLATFORM_CHECKED) {
+                *valid = e->module.validity_result & MODULE_VALIDATION_INTEGRITY;
+            } else {
+                checkIntegrity(bounds, e);
+                *valid = e->state & INTEGRITY_VALID;
+            }
+            return 0;
+        }
+        return SYSTEM_ERROR_NOT_FOUND;
+    }
+
+    /**
+     * Gets the info of the module stored at the location matching the given function, index and
+     * MCU target. No validation is performed. This method is equivalent to `locate_module()`.
+     */
+    int findModuleInfo(uint8_t func, uint8_t index, uint8_t mcu, module_info_t* info) {
+        const int i = findIndex(func, index, mcu);
+        if (i < 0) {
+            return SYSTEM_ERROR_NOT_FOUND;
+        }
+        const Entry* e = entry(i);
+        if (!(e->state & INFO_VALID)) {
+            return SYSTEM_ERROR_NOT_FOUND;
+        }
+        *info = e->module.info;
+        return 0;
+    }
+
+    /**
+     * Checks if the dependencies of a module are satisfied by the modules in the cache.
+     *
+     * This check is not transitive.
+     */
+    bool checkDependencies(const module_info_t* info, bool userOptional) {
+        if (info->dependency.module_function == MODULE_FUNCTION_NONE ||
+                (userOptional && info->module_function == MODULE_FUNCTION_USER_PART)) {
+            return true;
+        }
+        if (!checkDependency(info->dependency)) {
+            return false;
+        }
+        if (info->dependency2.module_function == MODULE_FUNCTION_NONE ||
+                (info->dependency2.module_function == MODULE_FUNCTION_BOOTLOADER && userOptional)) {
+            return true;
+        }
+        return checkDependency(info->dependency2);
+    }
+
+    /**
+     * Checks if the dependencies of the other system modules would still be satisfied if the given
+     * system module replaced the current one.
+     */
+    bool checkDependenciesFull(const module_info_t* module, const module_bounds_t* bounds) {
+        if (module->module_function != MODULE_FUNCTION_SYSTEM_PART) {
+            return true;
+        }
+        for (size_t i = 0; i < count_; ++i) {
+            const Entry* e = entry(i);
+            if (!(e->state & INFO_VALID)) {
+                continue;
+            }
+            const module_info_t* info = &e->module.info;
+            if (!memcmp(bounds_[i], bounds, sizeof(module_bounds_t))) {
+                // Do not validate against self
+                continue;
+            }
+            if (info->module_function != MODULE_FUNCTION_SYSTEM_PART) {
+                continue;
+            }
+            if (info->module_start_address == module->module_start_address &&
+                    info->module_function == module->module_function && info->module_index == module->module_index) {
+                // Do not validate the replaced module
+                continue;
+            }
+            if (!dependencySatisfied(info->dependency, module) || !dependencySatisfied(info->dependency2, module)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Finds the bounds of a module.
+     */
+    const module_bounds_t* findBounds(uint8_t func, uint8_t index, uint8_t mcu) const {
+        const int i = findIndex(func, index, mcu);
+        return (i >= 0) ? bounds_[i] : nullptr;
+    }
+
+    /**
+     * Invalidates the cached data of the modules overlapping with the given region.
+     */
+    void invalidate(module_bounds_location_t location, uintptr_t address, size_t size) {
+        for (size_t i = 0; i < count_; ++i) {
+            const auto b = bounds_[i];
+            if (b->location == location && b->start_address < address + size && address < b->end_address) {
+                entries_[i].state = 0;
+            }
+        }
+    }
+
+    void invalidateAll() {
+        for (size_t i = 0; i < count_; ++i) {
+            entries_[i].state = 0;
+        }
+    }
+
+    size_t moduleCount() const {
+        return count_;
+    }
+
+private:
+    enum EntryState {
+        FETCHED = 0x01,
+        INFO_VALID = 0x02,
+        SUFFIX_VALID = 0x04,
+        PLATFORM_CHECKED = 0x08,
+        INTEGRITY_CHECKED = 0x10,
+        INTEGRITY_VALID = 0x20
+    };
+
+    struct Entry {
+        hal_module_t module;
+        uint8_t state;
+    };
+
+    Entry entries_[MODULE_INFO_CACHE_MAX_MODULES];
+    const module_bounds_t* const* bounds_;
+    ModuleReader* reader_;
+    size_t count_;
+    uint16_t platformId_;
+
+    Entry* entry(size_t index) {
+        Entry* e = &entries_[index];
+        if (!(e->state & FETCHED)) {
+            // Read the headers of all modules that are not cached yet in one pass
+            for (size_t i = 0; i < count_; ++i) {
+                fetch(i);
+            }
+        }
+        return e;
+    }
+
+    void fetch(size_t index) {
+        Entry* e = &entries_[index];
+        if (e->state & FETCHED) {
+            return;
+        }
+        memset(&e->module, 0, sizeof(e->module));
+        e->state = FETCHED;
+        const auto bounds = bounds_[index];
+        const int r = reader_->readInfo(bounds, &e->module);
+        if (r < 0) {
+            return;
+        }
+        e->state |= INFO_VALID;
+        if (r == ModuleReader::PLATFORM_VALIDATED) {
+            e->state |= PLATFORM_CHECKED;
+        } else if (reader_->readSuffix(bounds, &e->module) == 0) {
+            e->state |= SUFFIX_VALID;
+        }
+    }
+
+    void checkIntegrity(const module_bounds_t* bounds, Entry* e) {
+        if (e->state & INTEGRITY_CHECKED) {
+            return;
+        }
+        const bool hasCrc = e->state & SUFFIX_VALID;
+        if (hasCrc && reader_->isVerified(bounds, &e->module)) {
+            e->state |= INTEGRITY_VALID;
+        } else if (reader_->verifyIntegrity(bounds, &e->module.info)) {
+            e->state |= INTEGRITY_VALID;
+            if (hasCrc) {
+                reader_->verified(bounds, &e->module);
+            }
+        }
+        e->state |= INTEGRITY_CHECKED;
+    }
+
+    int findIndex(uint8_t func, uint8_t index, uint8_t mcu) const {
+        for (size_t i = 0; i < count_; ++i) {
+            const auto b = bounds_[i];
+            if (b->module_function == func && b->module_index == index && matchesMcu(b->mcu_identifier, mcu)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    bool checkDependency(const module_dependency_t& dep) {
+        module_info_t info = {};
+        // NOTE: we ignore MCU type
+        if (findModuleInfo(dep.module_function, dep.module_index, HAL_PLATFORM_MCU_ANY, &info) < 0) {
+            return false;
+        }
+        return info.module_version >= dep.module_version;
+    }
+
+    static bool dependencySatisfied(const module_dependency_t& dep, const module_info_t* module) {
+        if (dep.module_function == MODULE_FUNCTION_NONE || dep.module_function != module->module_function ||
+                dep.module_index != module->module_index) {
+            return true;
+        }
+        return module->module_version >= dep.module_version;
+    }
+
+    static bool matchesMcu(uint8_t boundsMcu, uint8_t mcu) {
+        return boundsMcu == HAL_PLATFORM_MCU_ANY || mcu == HAL_PLATFORM_MCU_ANY || boundsMcu == mcu;
+    }
+};
+
+} // namespace particle
@@ -17,12 +17,68 @@
 
 #include "nrfx.h"
 #include "nrfx_saadc.h"
+#include <nrf_ppi.h>
+#include <nrf_timer.h>
 #include "adc_hal.h"
 #include "pinmap_impl.h"
 #include "check.h"
 
 static volatile hal_adc_state_t adcState = HAL_ADC_STATE_DISABLED;
 
+namespace {
+
+// Peripherals used for continuous acquisition. TIMER2, TIMER3 and PPI channels 4 and 5 are used
+// by the USART HAL
+NRF_TIMER_Type* const ADC_STREAM_TIMER = NRF_TIMER4;
+const nrf_ppi_channel_t ADC_STREAM_PPI_CHANNEL = NRF_PPI_CHANNEL6;
+
+const uint32_t ADC_STREAM_TIMER_FREQUENCY = 16000000;
+
+// Acquisition time plus conversion time of a single channel, rounded up
+const uint32_t ADC_CHANNEL_CONVERSION_TIME_US = 12;
+
+struct AdcStream {
+    hal_adc_stream_callback callback;
+    void* context;
+    uint8_t channelCount;
+    volatile bool active;
+};
+
+AdcStream adcStream = {};
+
+int getAdcInput(pin_t pin, nrf_saadc_input_t* input) {
+    CHECK_TRUE(pin < TOTAL_PINS, SYSTEM_ERROR_INVALID_ARGUMENT);
+    Hal_Pin_Info* const PIN_MAP = HAL_Pin_Map();
+    CHECK_TRUE(PIN_MAP[pin].pin_func == PF_NONE || PIN_MAP[pin].pin_func == PF_DIO, SYSTEM_ERROR_INVALID_STATE);
+    switch (PIN_MAP[pin].adc_channel) {
+        case 0: *input = NRF_SAADC_INPUT_AIN0; break;
+        case 1: *input = NRF_SAADC_INPUT_AIN1; break;
+        case 2: *input = NRF_SAADC_INPUT_AIN2; break;
+        case 3: *input = NRF_SAADC_INPUT_AIN3; break;
+        case 4: *input = NRF_SAADC_INPUT_AIN4; break;
+        case 5: *input = NRF_SAADC_INPUT_AIN5; break;
+        case 6: *input = NRF_SAADC_INPUT_AIN6; break;
+        case 7: *input = NRF_SAADC_INPUT_AIN7; break;
+        default: return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    return 0;
+}
+
+void stopAdcStream() {
+    nrf_timer_task_trigger(ADC_STREAM_TIMER, NRF_TIMER_TASK_STOP);
+    nrf_timer_task_trigger(ADC_STREAM_TIMER, NRF_TIMER_TASK_SHUTDOWN);
+    nrf_timer_shorts_disable(ADC_STREAM_TIMER, NRF_TIMER_SHORT_COMPARE0_CLEAR_MASK);
+    nrf_ppi_channel_disable(ADC_STREAM_PPI_CHANNEL);
+    adcStream.active = false;
+    nrfx_saadc_abort();
+    for (uint8_t i = 0; i < adcStream.channelCount; ++i) {
+        nrfx_saadc_channel_uninit(i);
+    }
+    adcStream.channelCount = 0;
+}
+
+} // namespace
+
 static const nrfx_saadc_config_t saadcConfig = {
     .resolution         = NRF_SAADC_RESOLUTION_12BIT,
     .oversample         = NRF_SAADC_OVERSAMPLE_DISABLED,
@@ -31,7 +87,16 @@ static const nrfx_saadc_config_t saadcConfig = {
 };
 
 static void analog_in_event_handler(nrfx_saadc_evt_t const *p_event) {
-    (void) p_event;
+    if (p_event->type != NRFX_SAADC_EVT_DONE || !adcStream.active) {
+        return;
+    }
+    // The other half of the buffer is being filled while the callback is running
+    const auto buf = p_event->data.done.p_buffer;
+    const auto size = p_event->data.done.size;
+    adcStream.callback(buf, size, adcStream.context);
+    if (adcStream.active) {
+        nrfx_saadc_buffer_convert(buf, size);
+    }
 }
 
 void hal_adc_set_sample_time(uint8_t sample_time) {
@@ -44,6 +109,10 @@ void hal_adc_set_sample_time(uint8_t sample_time) {
  * Note: ADC is 12-bit. Currently it returns 0-4096
  */
 int32_t hal_adc_read(uint16_t pin) {
+    if (adcStream.active) {
+        // The SAADC is owned by the stream
+        return SYSTEM_ERROR_BUSY;
+    }
     if (adcState != HAL_ADC_STATE_ENABLED) {
         hal_adc_dma_init();
     }
@@ -130,6 +199,9 @@ int hal_adc_sleep(bool sleep, void* reserved) {
     if (sleep) {
         // Suspend ADC
         CHECK_TRUE(adcState == HAL_ADC_STATE_ENABLED, SYSTEM_ERROR_INVALID_STATE);
+        if (adcStream.active) {
+            stopAdcStream();
+        }
         hal_adc_dma_uninit(nullptr);
         adcState = HAL_ADC_STATE_SUSPENDED;
     } else {
@@ -140,3 +212,61 @@ int hal_adc_sleep(bool sleep, void* reserved) {
     return SYSTEM_ERROR_NONE;
 }
 
+int hal_adc_stream_start(const hal_adc_stream_config* conf, void* reserved) {
+    CHECK_TRUE(conf && conf->pins && conf->buffer && conf->callback, SYSTEM_ERROR_INVALID_ARGUMENT);
+    CHECK_TRUE(conf->pin_count > 0 && conf->pin_count <= NRF_SAADC_CHANNEL_COUNT, SYSTEM_ERROR_INVALID_ARGUMENT);
+    CHECK_TRUE(conf->block_size > 0 && conf->block_size % conf->pin_count == 0 &&
+            conf->block_size <= UINT16_MAX, SYSTEM_ERROR_INVALID_ARGUMENT);
+    // Make sure the ADC can keep up with the sample rate
+    CHECK_TRUE(conf->sample_rate > 0 && (uint64_t)conf->sample_rate * conf->pin_count *
+            ADC_CHANNEL_CONVERSION_TIME_US <= 1000000, SYSTEM_ERROR_INVALID_ARGUMENT);
+    CHECK_TRUE(!adcStream.active, SYSTEM_ERROR_BUSY);
+    nrf_saadc_input_t inputs[NRF_SAADC_CHANNEL_COUNT] = {};
+    for (uint8_t i = 0; i < conf->pin_count; ++i) {
+        CHECK(getAdcInput(conf->pins[i], &inputs[i]));
+    }
+    if (adcState != HAL_ADC_STATE_ENABLED) {
+        hal_adc_dma_init();
+    }
+    // The SAADC scans all configured channels on each SAMPLE task
+    for (uint8_t i = 0; i < conf->pin_count; ++i) {
+        nrf_saadc_channel_config_t channelConfig = NRFX_SAADC_DEFAULT_CHANNEL_CONFIG_SE(inputs[i]);
+        channelConfig.gain = NRF_SAADC_GAIN1_4;
+        channelConfig.reference = NRF_SAADC_REFERENCE_VDD4;
+        channelConfig.acq_time = NRF_SAADC_ACQTIME_10US;
+        if (nrfx_saadc_channel_init(i, &channelConfig) != NRFX_SUCCESS) {
+            adcStream.channelCount = i;
+            stopAdcStream();
+            return SYSTEM_ERROR_INTERNAL;
+        }
+    }
+    adcStream.callback = conf->callback;
+    adcStream.context = conf->context;
+    adcStream.channelCount = conf->pin_count;
+    adcStream.active = true;
+    // Queue both halves of the buffer
+    if (nrfx_saadc_buffer_convert(conf->buffer, conf->block_size) != NRFX_SUCCESS ||
+            nrfx_saadc_buffer_convert(conf->buffer + conf->block_size, conf->block_size) != NRFX_SUCCESS) {
+        stopAdcStream();
+        return SYSTEM_ERROR_INTERNAL;
+    }
+    // Trigger the conversions from a hardware timer via PPI
+    nrf_timer_mode_set(ADC_STREAM_TIMER, NRF_TIMER_MODE_TIMER);
+    nrf_timer_bit_width_set(ADC_STREAM_TIMER, NRF_TIMER_BIT_WIDTH_32);
+    nrf_timer_frequency_set(ADC_STREAM_TIMER, NRF_TIMER_FREQ_16MHz);
+    nrf_timer_cc_write(ADC_STREAM_TIMER, NRF_TIMER_CC_CHANNEL0, ADC_STREAM_TIMER_FREQUENCY / conf->sample_rate);
+    nrf_timer_shorts_enable(ADC_STREAM_TIMER, NRF_TIMER_SHORT_COMPARE0_CLEAR_MASK);
+    nrf_timer_task_trigger(ADC_STREAM_TIMER, NRF_TIMER_TASK_CLEAR);
+    nrf_ppi_channel_endpoint_setup(ADC_STREAM_PPI_CHANNEL,
+            nrf_timer_event_address_get(ADC_STREAM_TIMER, NRF_TIMER_EVENT_COMPARE0),
+            nrf_saadc_task_address_get(NRF_SAADC_TASK_SAMPLE));
+    nrf_ppi_channel_enable(ADC_STREAM_PPI_CHANNEL);
+    nrf_timer_task_trigger(ADC_STREAM_TIMER, NRF_TIMER_TASK_START);
+    return 0;
+}
+
+int hal_adc_stream_stop(void* reserved) {
+    CHECK_TRUE(adcStream.active, SYSTEM_ERROR_INVALID_STATE);
+    stopAdcStream();
+    return 0;
+}
@@ -39,6 +39,7 @@ LOG_SOURCE_CATEGORY("hal.ble");
 #include "app_util.h"
 
 #include "concurrent_hal.h"
+#include "timer_hal.h"
 #include "static_recursive_mutex.h"
 #include <mutex>
 
@@ -93,6 +94,9 @@ const hal_ble_attr_handle_t SERVICES_TOP_END_HANDLE = 0xFFFF;
 // Pool for BLE event data.
 constexpr size_t BLE_EVT_DATA_POOL_SIZE = 2048;
 
+// Block size of the slab used for legacy advertising report payloads.
+constexpr size_t BLE_EVT_SLAB_ADV_DATA_BLOCK_SIZE = BLE_GAP_ADV_SET_DATA_SIZE_MAX;
+
 // Timeout for a BLE procedure.
 constexpr uint32_t BLE_OPERATION_TIMEOUT_MS = 30000;
 // Delay for GATT Client to send the ATT MTU exchanging request.
@@ -183,6 +187,78 @@ hal_ble_addr_t chipDefaultAddress() {
     return localAddr;
 }
 
+/*
+ * Pool of equally sized blocks. Unlike the general purpose event data pool, allocation and
+ * deallocation are O(1) and the pool can't get fragmented, which makes it suitable for events
+ * generated at a high rate, e.g. advertising reports received while scanning.
+ */
+class BleEventSlab {
+public:
+    BleEventSlab()
+            : begin_(nullptr),
+              end_(nullptr),
+              blockSize_(0),
+              freeList_(nullptr) {
+    }
+
+    ~BleEventSlab() {
+        delete[] begin_;
+    }
+
+    int init(size_t blockSize, size_t blockCount) {
+        blockSize_ = (blockSize + sizeof(uintptr_t) - 1) & ~(sizeof(uintptr_t) - 1);
+        const size_t size = blockSize_ * blockCount;
+        begin_ = new(std::nothrow) uint8_t[size];
+        if (!begin_) {
+            return SYSTEM_ERROR_NO_MEMORY;
+        }
+        end_ = begin_ + size;
+        freeList_ = nullptr;
+        for (size_t i = blockCount; i > 0; --i) {
+            const auto block = reinterpret_cast<FreeBlock*>(begin_ + (i - 1) * blockSize_);
+            block->next = freeList_;
+            freeList_ = block;
+        }
+        return SYSTEM_ERROR_NONE;
+    }
+
+    void* alloc(size_t size) {
+        if (size > blockSize_) {
+            return nullptr;
+        }
+        FreeBlock* block = nullptr;
+        ATOMIC_BLOCK() {
+            block = freeList_;
+            if (block) {
+                freeList_ = block->next;
+            }
+        }
+        return block;
+    }
+
+    void free(void* p) {
+        const auto block = static_cast<FreeBlock*>(p);
+        ATOMIC_BLOCK() {
+            block->next = freeList_;
+            freeList_ = block;
+        }
+    }
+
+    bool contains(const void* p) const {
+        return p >= begin_ && p < end_;
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    uint8_t* begin_;
+    uint8_t* end_;
+    size_t blockSize_;
+    FreeBlock* freeList_;
+};
+
 } //anonymous namespace
 
 class BleObject {
@@ -229,33 +305,73 @@ public:
     BleEventDispatcher()
             : evtDispatcherinitialized_(false),
               evtQueue_(nullptr),
-              evtThread_(nullptr) {
+              evtThread_(nullptr),
+              advReportsDropped_(0),
+              eventsDropped_(0) {
     }
     ~BleEventDispatcher() = default;
     int init();
     bool initialized() const {
         return evtDispatcherinitialized_;
     }
-    void enqueue(ble_evt_t** event);
-    void enqueue(const ble_evt_t* event);
+    // Enqueue an event. The event is dropped and counted if there's no buffer or queue space for it
+    int enqueue(ble_evt_t** event);
+    int enqueue(const ble_evt_t* event);
+    int tryEnqueue(ble_evt_t** event);
 
+    // Allocates a SoftDevice event, optionally followed by variable-length data
     void* allocEventData(size_t size) {
-        return pool_.alloc(size);
+        void* p = eventSlab_.alloc(size);
+        if (!p) {
+            p = pool_.alloc(size);
+        }
+        return p;
+    }
+
+    // Allocates the payload of an advertising report, so that scanning doesn't exhaust the event buffers
+    void* allocAdvReportData(size_t size) {
+        void* p = advDataSlab_.alloc(size);
+        if (!p) {
+            p = pool_.alloc(size);
+        }
+        return p;
     }
 
     void freeEventData(void* p) {
-        if (p) {
+        if (!p) {
+            return;
+        }
+        if (advDataSlab_.contains(p)) {
+            advDataSlab_.free(p);
+        } else if (eventSlab_.contains(p)) {
+            eventSlab_.free(p);
+        } else {
             pool_.free(p);
         }
     }
 
+    // Called when an advertising report is dropped due to the lack of buffers or queue space
+    void advReportDropped() {
+        ++advReportsDropped_;
+    }
+
+    // Called when any other event is dropped due to the lack of buffers or queue space
+    void eventDropped() {
+        ++eventsDropped_;
+    }
+
 private:
     static os_thread_return_t processBleEventFromThread(void* param);
+    static void dispatchEvent(const ble_evt_t* event);
 
     bool evtDispatcherinitialized_;
     os_queue_t evtQueue_;                                   /**< BLE event queue. */
     os_thread_t evtThread_;                                 /**< BLE event thread. */
-    AtomicAllocedPool pool_;
+    BleEventSlab eventSlab_;                                /**< Buffers for plain SoftDevice events. */
+    BleEventSlab advDataSlab_;                              /**< Buffers for legacy advertising report payloads. */
+    AtomicAllocedPool pool_;                                /**< Buffers for events carrying variable-length data. */
+    volatile uint32_t advReportsDropped_;                   /**< Number of dropped advertising reports. */
+    volatile uint32_t eventsDropped_;                       /**< Number of other dropped events. */
 };
 
 class BleObject::BleGap {
@@ -641,6 +757,11 @@ private:
     };
 
     void resetDiscoveryState();
+    void abortDiscovery() {
+        isDiscovering_ = false;
+        os_semaphore_give(discoverySemaphore_, false);
+        // TODO: Use a flag to indicate the failure as the returned value for the discovery functions.
+    }
     bool readServiceUUID128IfNeeded() const;
     bool readCharacteristicUUID128IfNeeded() const;
     hal_ble_svc_t* findDiscoveredService(hal_ble_attr_handle_t attrHandle);
@@ -689,6 +810,12 @@ int BleObject::BleEventDispatcher::init() {
     if (pool_.init(BLE_EVT_DATA_POOL_SIZE) != SYSTEM_ERROR_NONE) {
         goto error;
     }
+    if (eventSlab_.init(sizeof(ble_evt_t), BLE_EVENT_SLAB_EVENT_COUNT) != SYSTEM_ERROR_NONE) {
+        goto error;
+    }
+    if (advDataSlab_.init(BLE_EVT_SLAB_ADV_DATA_BLOCK_SIZE, BLE_EVENT_SLAB_ADV_DATA_COUNT) != SYSTEM_ERROR_NONE) {
+        goto error;
+    }
     evtDispatcherinitialized_ = true;
     return SYSTEM_ERROR_NONE;
 error:
@@ -703,104 +830,135 @@ error:
     return SYSTEM_ERROR_INTERNAL;
 }
 
-void BleObject::BleEventDispatcher::enqueue(ble_evt_t** event) {
+int BleObject::BleEventDispatcher::enqueue(ble_evt_t** event) {
+    const int ret = tryEnqueue(event);
+    if (ret != SYSTEM_ERROR_NONE) {
+        freeEventData(*event);
+        *event = nullptr;
+        eventDropped();
+    }
+    return ret;
+}
+
+int BleObject::BleEventDispatcher::tryEnqueue(ble_evt_t** event) {
     if (os_queue_put(evtQueue_, event, 0, nullptr)) {
-        LOG(ERROR, "os_queue_put() failed.");
-        SPARK_ASSERT(false);
+        return SYSTEM_ERROR_BUSY;
     }
+    return SYSTEM_ERROR_NONE;
 }
 
-void BleObject::BleEventDispatcher::enqueue(const ble_evt_t* event) {
+int BleObject::BleEventDispatcher::enqueue(const ble_evt_t* event) {
     ble_evt_t* pBleEvent = (ble_evt_t*)allocEventData(sizeof(ble_evt_t));
     if (!pBleEvent) {
-        LOG(ERROR, "Allocate memory for BLE event failed.");
-        SPARK_ASSERT(false);
+        eventDropped();
+        return SYSTEM_ERROR_NO_MEMORY;
     }
     memcpy(pBleEvent, event, sizeof(ble_evt_t));
-    enqueue(&pBleEvent);
+    return enqueue(&pBleEvent);
 }
 
 os_thread_return_t BleObject::BleEventDispatcher::processBleEventFromThread(void* param) {
     BleEventDispatcher* dispatcher = static_cast<BleEventDispatcher*>(param);
+    uint32_t advReportsDropped = 0;
+    uint32_t eventsDropped = 0;
+    system_tick_t droppedLogTime = 0;
     while (1) {
-        ble_evt_t* event;
-        if (!os_queue_take(dispatcher->evtQueue_, &event, CONCURRENT_WAIT_FOREVER, nullptr)) {
-            SCOPE_GUARD ({
-                dispatcher->freeEventData(event);
-            });
-            switch (event->header.evt_id) {
-                case BLE_GAP_EVT_ADV_SET_TERMINATED: {
-                    BleObject::getInstance().broadcaster()->processAdvStoppedEventFromThread(event);
-                    break;
-                }
-                case BLE_GAP_EVT_ADV_REPORT: {
-                    BleObject::getInstance().observer()->processAdvReportEventFromThread(event);
-                    break;
-                }
-                case BLE_GAP_EVT_CONNECTED: {
-                    BleObject::getInstance().connMgr()->processConnectedEventFromThread(event);
-                    break;
-                }
-                case BLE_GAP_EVT_DISCONNECTED: {
-                    BleObject::getInstance().connMgr()->processDisconnectedEventFromThread(event);
-                    break;
-                }
-                case BLE_GAP_EVT_CONN_PARAM_UPDATE: {
-                    BleObject::getInstance().connMgr()->processConnParamsUpdatedEventFromThread(event);
-                    break;
-                }
-                case BLE_GATTC_EVT_EXCHANGE_MTU_RSP:
-                case BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST: {
-                    BleObject::getInstance().connMgr()->processAttMtuExchangeEventFromThread(event);
-                    break;
-                }
-                case BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP: {
-                    BleObject::getInstance().gattc()->processSvcDiscEventFromThread(event);
-                    break;
-                }
-                case BLE_GATTC_EVT_CHAR_DISC_RSP: {
-                    BleObject::getInstance().gattc()->processCharDiscEventFromThread(event);
-                    break;
-                }
-                case BLE_GATTC_EVT_DESC_DISC_RSP: {
-                    BleObject::getInstance().gattc()->processDescDiscEventFromThread(event);
-                    break;
-                }
-                case BLE_GATTC_EVT_READ_RSP: {
-                    BleObject::getInstance().gattc()->processDataReadEventFromThread(event);
-                    break;
-                }
-                case BLE_GATTS_EVT_WRITE: {
-                    BleObject::getInstance().gatts()->processDataWrittenEventFromThread(event);
-                    break;
-                }
-                case BLE_GATTC_EVT_HVX: {
-                    BleObject::getInstance().gattc()->processDataNotifiedEventFromThread(event);
-                    break;
-                }
-                case BLE_GAP_EVT_SEC_INFO_REQUEST:
-                case BLE_GAP_EVT_LESC_DHKEY_REQUEST:
-                case BLE_GAP_EVT_PASSKEY_DISPLAY:
-                case BLE_GAP_EVT_AUTH_KEY_REQUEST:
-                case BLE_GAP_EVT_SEC_REQUEST:
-                case BLE_GAP_EVT_SEC_PARAMS_REQUEST:
-                case BLE_GAP_EVT_AUTH_STATUS:
-                case BLE_GAP_EVT_CONN_SEC_UPDATE: {
-                    BleObject::getInstance().connMgr()->processSecurityEventFromThread(event);
-                    break;
-                }
-                default: {
-                    break;
-                }
-            }
-        } else {
+        ble_evt_t* events[BLE_EVENT_BATCH_SIZE];
+        if (os_queue_take(dispatcher->evtQueue_, &events[0], CONCURRENT_WAIT_FOREVER, nullptr)) {
             LOG(ERROR, "BLE event thread exited.");
             break;
         }
+        // Drain whatever else is pending without blocking, so that bursts of events are handled in one go
+        size_t count = 1;
+        while (count < BLE_EVENT_BATCH_SIZE && !os_queue_take(dispatcher->evtQueue_, &events[count], 0, nullptr)) {
+            ++count;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            dispatchEvent(events[i]);
+            dispatcher->freeEventData(events[i]);
+        }
+        if (dispatcher->advReportsDropped_ != advReportsDropped || dispatcher->eventsDropped_ != eventsDropped) {
+            const auto now = HAL_Timer_Get_Milli_Seconds();
+            if (!droppedLogTime || now - droppedLogTime >= BLE_EVENTS_DROPPED_LOG_INTERVAL) {
+                advReportsDropped = dispatcher->advReportsDropped_;
+                eventsDropped = dispatcher->eventsDropped_;
+                droppedLogTime = now;
+                LOG(WARN, "Dropped %u advertising reports and %u other events in total", (unsigned)advReportsDropped,
+                        (unsigned)eventsDropped);
+            }
+        }
     }
     os_thread_exit(dispatcher->evtThread_);
 }
 
+void BleObject::BleEventDispatcher::dispatchEvent(const ble_evt_t* event) {
+    switch (event->header.evt_id) {
+        case BLE_GAP_EVT_ADV_SET_TERMINATED: {
+            BleObject::getInstance().broadcaster()->processAdvStoppedEventFromThread(event);
+            break;
+        }
+        case BLE_GAP_EVT_ADV_REPORT: {
+            BleObject::getInstance().observer()->processAdvReportEventFromThread(event);
+            break;
+        }
+        case BLE_GAP_EVT_CONNECTED: {
+            BleObject::getInstance().connMgr()->processConnectedEventFromThread(event);
+            break;
+        }
+        case BLE_GAP_EVT_DISCONNECTED: {
+            BleObject::getInstance().connMgr()->processDisconnectedEventFromThread(event);
+            break;
+        }
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE: {
+            BleObject::getInstance().connMgr()->processConnParamsUpdatedEventFromThread(event);
+            break;
+        }
+        case BLE_GATTC_EVT_EXCHANGE_MTU_RSP:
+        case BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST: {
+            BleObject::getInstance().connMgr()->processAttMtuExchangeEventFromThread(event);
+            break;
+        }
+        case BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP: {
+            BleObject::getInstance().gattc()->processSvcDiscEventFromThread(event);
+            break;
+        }
+        case BLE_GATTC_EVT_CHAR_DISC_RSP: {
+            BleObject::getInstance().gattc()->processCharDiscEventFromThread(event);
+            break;
+        }
+        case BLE_GATTC_EVT_DESC_DISC_RSP: {
+            BleObject::getInstance().gattc()->processDescDiscEventFromThread(event);
+            break;
+        }
+        case BLE_GATTC_EVT_READ_RSP: {
+            BleObject::getInstance().gattc()->processDataReadEventFromThread(event);
+            break;
+        }
+        case BLE_GATTS_EVT_WRITE: {
+            BleObject::getInstance().gatts()->processDataWrittenEventFromThread(event);
+            break;
+        }
+        case BLE_GATTC_EVT_HVX: {
+            BleObject::getInstance().gattc()->processDataNotifiedEventFromThread(event);
+            break;
+        }
+        case BLE_GAP_EVT_SEC_INFO_REQUEST:
+        case BLE_GAP_EVT_LESC_DHKEY_REQUEST:
+        case BLE_GAP_EVT_PASSKEY_DISPLAY:
+        case BLE_GAP_EVT_AUTH_KEY_REQUEST:
+        case BLE_GAP_EVT_SEC_REQUEST:
+        case BLE_GAP_EVT_SEC_PARAMS_REQUEST:
+        case BLE_GAP_EVT_AUTH_STATUS:
+        case BLE_GAP_EVT_CONN_SEC_UPDATE: {
+            BleObject::getInstance().connMgr()->processSecurityEventFromThread(event);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
 struct BleGapImpl {
     BleObject::BleGap* instance;
 };
@@ -1300,13 +1458,7 @@ void BleObject::Broadcaster::processBroadcasterEvents(const ble_evt_t* event, vo
                 break;
             }
             broadcaster->isAdvertising_ = false;
-            ble_evt_t* advStoppedEvent = (ble_evt_t*)BleObject::getInstance().dispatcher()->allocEventData(sizeof(ble_evt_t));
-            if (!advStoppedEvent) {
-                LOG(ERROR, "Allocate memory for BLE event failed.");
-                break;
-            }
-            memcpy(advStoppedEvent, event, sizeof(ble_evt_t));
-            BleObject::getInstance().dispatcher()->enqueue(&advStoppedEvent);
+            BleObject::getInstance().dispatcher()->enqueue(event);
             break;
         }
         case BLE_GAP_EVT_CONNECTED: {
@@ -1650,21 +1802,24 @@ void BleObject::Observer::processObserverEvents(const ble_evt_t* event, void* co
                     break;
                 }
             }
-            ble_evt_t* observerEvent = (ble_evt_t*)BleObject::getInstance().dispatcher()->allocEventData(sizeof(ble_evt_t));
+            // Advertising reports are dropped rather than treated as fatal if the event thread can't keep up,
+            // the peer will be reported again when it advertises next time.
+            auto dispatcher = BleObject::getInstance().dispatcher();
+            ble_evt_t* observerEvent = (ble_evt_t*)dispatcher->allocEventData(sizeof(ble_evt_t));
             if (!observerEvent) {
-                LOG(ERROR, "Allocate memory for BLE event failed.");
-                observer->stopScanning();
+                dispatcher->advReportDropped();
+                observer->continueScanning();
                 break;
             }
             // Copy the SoftDevice event.
             memcpy(observerEvent, event, sizeof(ble_evt_t));
             ble_gap_evt_adv_report_t& advReport = observerEvent->evt.gap_evt.params.adv_report;
             if (event->evt.gap_evt.params.adv_report.data.len > 0) {
-                advReport.data.p_data = (uint8_t*)BleObject::getInstance().dispatcher()->allocEventData(advReport.data.len);
+                advReport.data.p_data = (uint8_t*)dispatcher->allocAdvReportData(advReport.data.len);
                 if (!advReport.data.p_data) {
-                    LOG(ERROR, "Allocate memory for adv report data failed.");
-                    BleObject::getInstance().dispatcher()->freeEventData(observerEvent);
-                    observer->stopScanning();
+                    dispatcher->freeEventData(observerEvent);
+                    dispatcher->advReportDropped();
+                    observer->continueScanning();
                     break;
                 }
                 // Copy the advertising packet data payload.
@@ -1672,7 +1827,12 @@ void BleObject::Observer::processObserverEvents(const ble_evt_t* event, void* co
             } else {
                 advReport.data.p_data = nullptr;
             }
-            BleObject::getInstance().dispatcher()->enqueue(&observerEvent);
+            if (dispatcher->tryEnqueue(&observerEvent) != SYSTEM_ERROR_NONE) {
+                dispatcher->freeEventData(advReport.data.p_data);
+                dispatcher->freeEventData(observerEvent);
+                dispatcher->advReportDropped();
+                observer->continueScanning();
+            }
             break;
         }
         case BLE_GAP_EVT_TIMEOUT: {
@@ -2643,9 +2803,8 @@ void BleObject::ConnectionsManager::processConnectionEvents(const ble_evt_t* eve
         case BLE_GAP_EVT_CONNECTED: {
             LOG_DEBUG(TRACE, "BLE GAP event: connected.");
             const ble_gap_evt_connected_t& connected = event->evt.gap_evt.params.connected;
-            ble_evt_t* connectedEvent = (ble_evt_t*)BleObject::getInstance().dispatcher()->allocEventData(sizeof(ble_evt_t));
-            if (!connectedEvent) {
-                LOG(ERROR, "Allocate memory for BLE event failed. Disconnect from peer.");
+            if (BleObject::getInstance().dispatcher()->enqueue(event) != SYSTEM_ERROR_NONE) {
+                LOG(ERROR, "Failed to enqueue BLE event. Disconnect from peer.");
                 sd_ble_gap_disconnect(event->evt.gatts_evt.conn_handle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
                 hal_ble_addr_t address = toHalAddress(connected.peer_addr);
                 if (connMgr->isConnecting_ && connected.role == BLE_GAP_ROLE_CENTRAL && addressEqual(address, connMgr->connectingAddr_)) {
@@ -2654,8 +2813,6 @@ void BleObject::ConnectionsManager::processConnectionEvents(const ble_evt_t* eve
                 }
                 break;
             }
-            memcpy(connectedEvent, event, sizeof(ble_evt_t));
-            BleObject::getInstance().dispatcher()->enqueue(&connectedEvent);
             break;
         }
         case BLE_GAP_EVT_DISCONNECTED: {
@@ -2710,14 +2867,7 @@ void BleObject::ConnectionsManager::processConnectionEvents(const ble_evt_t* eve
         }
         case BLE_GATTC_EVT_EXCHANGE_MTU_RSP: {
             LOG_DEBUG(TRACE, "BLE GAP event: exchange MTU response.");
-            ble_evt_t* attMtuExchangeEvent = (ble_evt_t*)BleObject::getInstance().dispatcher()->allocEventData(sizeof(ble_evt_t));
-            if (!attMtuExchangeEvent) {
-                LOG(ERROR, "Allocate memory for BLE event failed.");
-                SPARK_ASSERT(false);
-                break;
-            }
-            memcpy(attMtuExchangeEvent, event, sizeof(ble_evt_t));
-            BleObject::getInstance().dispatcher()->enqueue(&attMtuExchangeEvent);
+            BleObject::getInstance().dispatcher()->enqueue(event);
             break;
         }
         default: {
@@ -3055,7 +3205,7 @@ void BleObject::GattServer::processGattServerEvents(const ble_evt_t* event, void
             ble_evt_t* dataWrittenEvent = (ble_evt_t*)BleObject::getInstance().dispatcher()->allocEventData(sizeof(ble_evt_t) +
                     SUB1(event->evt.gatts_evt.params.write.len) * sizeof(uint8_t));
             if (!dataWrittenEvent) {
-                LOG(ERROR, "Allocate memory for received data failed.");
+                BleObject::getInstance().dispatcher()->eventDropped();
                 break;
             }
             memcpy(dataWrittenEvent, event, sizeof(ble_evt_t));
@@ -3608,9 +3758,7 @@ void BleObject::GattClient::processGattClientEvents(const ble_evt_t* event, void
     switch (event->header.evt_id) {
         case BLE_GAP_EVT_DISCONNECTED: {
             if (gattc->isDiscovering_ && event->evt.gap_evt.conn_handle == gattc->currDiscConnHandle_) {
-                gattc->isDiscovering_ = false;
-                os_semaphore_give(gattc->discoverySemaphore_, false);
-                // TODO: Use a flag to indicate the failure as the returned value for the discovery functions.
+                gattc->abortDiscovery();
             }
             if (gattc->isReading_ && gattc->currReadConnHandle_ == event->evt.gattc_evt.conn_handle) {
                 gattc->isReading_ = false;
@@ -3631,15 +3779,17 @@ void BleObject::GattClient::processGattClientEvents(const ble_evt_t* event, void
             ble_evt_t* svcDiscEvent = (ble_evt_t*)BleObject::getInstance().dispatcher()->allocEventData(sizeof(ble_evt_t) +
                     SUB1(event->evt.gattc_evt.params.prim_srvc_disc_rsp.count) * sizeof(ble_gattc_service_t));
             if (!svcDiscEvent) {
-                LOG(ERROR, "Allocate memory for discovered services failed.");
-                // Assert it since the discovered services are incomplete.
-                SPARK_ASSERT(false);
+                BleObject::getInstance().dispatcher()->eventDropped();
+                // The discovered services would be incomplete
+                gattc->abortDiscovery();
                 break;
             }
             memcpy(svcDiscEvent, event, sizeof(ble_evt_t));
             ble_gattc_evt_prim_srvc_disc_rsp_t& primSvcDiscRsp = svcDiscEvent->evt.gattc_evt.params.prim_srvc_disc_rsp;
             memcpy(primSvcDiscRsp.services, event->evt.gattc_evt.params.prim_srvc_disc_rsp.services, primSvcDiscRsp.count * sizeof(ble_gattc_service_t));
-            BleObject::getInstance().dispatcher()->enqueue(&svcDiscEvent);
+            if (BleObject::getInstance().dispatcher()->enqueue(&svcDiscEvent) != SYSTEM_ERROR_NONE) {
+                gattc->abortDiscovery();
+            }
             break;
         }
         case BLE_GATTC_EVT_CHAR_DISC_RSP: {
@@ -3651,15 +3801,17 @@ void BleObject::GattClient::processGattClientEvents(const ble_evt_t* event, void
             ble_evt_t* charDiscEvent = (ble_evt_t*)BleObject::getInstance().dispatcher()->allocEventData(sizeof(ble_evt_t) +
                     SUB1(event->evt.gattc_evt.params.char_disc_rsp.count) * sizeof(ble_gattc_char_t));
             if (!charDiscEvent) {
-                LOG(ERROR, "Allocate memory for discovered characteristics failed.");
-                // Assert it since the discovered characteristics are incomplete.
-                SPARK_ASSERT(false);
+                BleObject::getInstance().dispatcher()->eventDropped();
+                // The discovered characteristics would be incomplete
+                gattc->abortDiscovery();
                 break;
             }
             memcpy(charDiscEvent, event, sizeof(ble_evt_t));
             ble_gattc_evt_char_disc_rsp_t& charDiscRsp = charDiscEvent->evt.gattc_evt.params.char_disc_rsp;
             memcpy(charDiscRsp.chars, event->evt.gattc_evt.params.char_disc_rsp.chars, charDiscRsp.count * sizeof(ble_gattc_char_t));
-            BleObject::getInstance().dispatcher()->enqueue(&charDiscEvent);
+            if (BleObject::getInstance().dispatcher()->enqueue(&charDiscEvent) != SYSTEM_ERROR_NONE) {
+                gattc->abortDiscovery();
+            }
             break;
         }
         case BLE_GATTC_EVT_DESC_DISC_RSP: {
@@ -3671,33 +3823,36 @@ void BleObject::GattClient::processGattClientEvents(const ble_evt_t* event, void
             ble_evt_t* descDiscEvent = (ble_evt_t*)BleObject::getInstance().dispatcher()->allocEventData(sizeof(ble_evt_t) +
                     SUB1(event->evt.gattc_evt.params.desc_disc_rsp.count) * sizeof(ble_gattc_desc_t));
             if (!descDiscEvent) {
-                LOG(ERROR, "Allocate memory for discovered descriptors failed.");
-                // Assert it since the discovered descriptors are incomplete.
-                SPARK_ASSERT(false);
+                BleObject::getInstance().dispatcher()->eventDropped();
+                // The discovered descriptors would be incomplete
+                gattc->abortDiscovery();
                 break;
             }
             memcpy(descDiscEvent, event, sizeof(ble_evt_t));
             ble_gattc_evt_desc_disc_rsp_t& descDiscRsp = descDiscEvent->evt.gattc_evt.params.desc_disc_rsp;
             memcpy(descDiscRsp.descs, event->evt.gattc_evt.params.desc_disc_rsp.descs, descDiscRsp.count * sizeof(ble_gattc_desc_t));
-            BleObject::getInstance().dispatcher()->enqueue(&descDiscEvent);
+            if (BleObject::getInstance().dispatcher()->enqueue(&descDiscEvent) != SYSTEM_ERROR_NONE) {
+                gattc->abortDiscovery();
+            }
             break;
         }
         case BLE_GATTC_EVT_READ_RSP: {
             LOG_DEBUG(TRACE, "BLE GATT Client event: read response.");
             ble_evt_t* readRspEvent = (ble_evt_t*)BleObject::getInstance().dispatcher()->allocEventData(sizeof(ble_evt_t) +
                     SUB1(event->evt.gattc_evt.params.read_rsp.len) * sizeof(uint8_t));
-            if (!readRspEvent) {
-                LOG(ERROR, "Allocate memory for read response failed.");
+            if (readRspEvent) {
+                memcpy(readRspEvent, event, sizeof(ble_evt_t));
+                ble_gattc_evt_read_rsp_t& readRsp = readRspEvent->evt.gattc_evt.params.read_rsp;
+                memcpy(readRsp.data, event->evt.gattc_evt.params.read_rsp.data, readRsp.len);
+            } else {
+                BleObject::getInstance().dispatcher()->eventDropped();
+            }
+            if (!readRspEvent || BleObject::getInstance().dispatcher()->enqueue(&readRspEvent) != SYSTEM_ERROR_NONE) {
                 if (gattc->isReading_ && gattc->currReadConnHandle_ == event->evt.gattc_evt.conn_handle) {
                     gattc->isReading_ = false;
                     os_semaphore_give(gattc->readSemaphore_, false);
                 }
-                break;
             }
-            memcpy(readRspEvent, event, sizeof(ble_evt_t));
-            ble_gattc_evt_read_rsp_t& readRsp = readRspEvent->evt.gattc_evt.params.read_rsp;
-            memcpy(readRsp.data, event->evt.gattc_evt.params.read_rsp.data, readRsp.len);
-            BleObject::getInstance().dispatcher()->enqueue(&readRspEvent);
             break;
         }
         case BLE_GATTC_EVT_WRITE_RSP: {
@@ -3721,7 +3876,7 @@ void BleObject::GattClient::processGattClientEvents(const ble_evt_t* event, void
             ble_evt_t* dataNotifiedEvent = (ble_evt_t*)BleObject::getInstance().dispatcher()->allocEventData(sizeof(ble_evt_t) +
                     SUB1(event->evt.gattc_evt.params.hvx.len) * sizeof(uint8_t));
             if (!dataNotifiedEvent) {
-                LOG(ERROR, "Allocate memory for received data failed.");
+                BleObject::getInstance().dispatcher()->eventDropped();
                 break;
             }
             memcpy(dataNotifiedEvent, event, sizeof(ble_evt_t));
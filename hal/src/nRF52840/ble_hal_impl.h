@@ -43,6 +43,18 @@
 /* BLE event queue depth */
 #define BLE_EVENT_QUEUE_ITEM_COUNT                  30
 
+/* Number of preallocated fixed-size buffers for SoftDevice events */
+#define BLE_EVENT_SLAB_EVENT_COUNT                  BLE_EVENT_QUEUE_ITEM_COUNT
+
+/* Number of preallocated buffers for legacy advertising report payloads */
+#define BLE_EVENT_SLAB_ADV_DATA_COUNT               16
+
+/* Maximum number of BLE events processed by the BLE event thread per wake-up */
+#define BLE_EVENT_BATCH_SIZE                        8
+
+/* Minimum interval between the warnings about dropped events, in milliseconds */
+#define BLE_EVENTS_DROPPED_LOG_INTERVAL             10000
+
 /* Maximum length of device name, non null-terminated */
 #define BLE_MAX_DEV_NAME_LEN                        20
 
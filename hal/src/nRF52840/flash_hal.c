@@ -22,6 +22,11 @@
 #include "flash_hal.h"
 #include "flash_acquire.h"
 #include "flash_common.h"
+#include "module_info.h"
+
+#if MODULE_FUNCTION != MOD_FUNC_BOOTLOADER
+#include "ota_module.h"
+#endif /* MODULE_FUNCTION != MOD_FUNC_BOOTLOADER */
 
 #ifdef SOFTDEVICE_PRESENT
 #include "nrf_fstorage_sd.h"
@@ -107,6 +112,11 @@ int hal_flash_write(uintptr_t addr, const uint8_t* data_buf, size_t data_size)
     int ret = hal_flash_common_write(addr, data_buf, data_size,
                                      &fstorage_perform_write, &hal_flash_common_dummy_read);
 
+#if MODULE_FUNCTION != MOD_FUNC_BOOTLOADER
+    // Any write to the internal flash may modify a module that has already been verified
+    invalidate_internal_module_info(addr, data_size);
+#endif /* MODULE_FUNCTION != MOD_FUNC_BOOTLOADER */
+
     __flash_release();
 
     return ret;
@@ -145,6 +155,9 @@ int hal_flash_erase_sector(uintptr_t addr, size_t num_sectors)
     }
 
 hal_flash_erase_sector_done:
+#if MODULE_FUNCTION != MOD_FUNC_BOOTLOADER
+    invalidate_internal_module_info(addr, num_sectors * INTERNAL_FLASH_PAGE_SIZE);
+#endif /* MODULE_FUNCTION != MOD_FUNC_BOOTLOADER */
     __flash_release();
     return ret;
 }
@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GSM0710_MUXER_CHANNEL_SCHEDULER_H
+#define GSM0710_MUXER_CHANNEL_SCHEDULER_H
+
+#include "gsm0710muxer/muxer.h"
+#include "ringbuffer.h"
+#include "check.h"
+#include "system_error.h"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+namespace particle {
+
+namespace detail {
+const auto MUXER_CHANNEL_SUSPEND_THRESHOLD = 3; // 1/3
+const auto MUXER_CHANNEL_RESUME_THRESHOLD = 2; // 1/2
+} // detail
+
+struct MuxerChannelStats {
+    size_t txBytes; // Bytes written to the muxer
+    size_t txFrames; // Number of writes to the muxer
+    size_t txStalls; // Number of times the channel got blocked by the remote side flow control
+    size_t rxBytes; // Bytes stored in the channel's receive buffer
+    size_t rxDropped; // Bytes dropped due to the receive buffer overflow
+    size_t suspends; // Number of times the channel was suspended due to the lack of receive credit
+};
+
+/**
+ * Schedules the traffic of the muxer channels sharing a single serial link.
+ *
+ * Outgoing data is buffered per channel and written to the muxer using deficit round robin: each
+ * channel may send up to its weight in bytes per round, so a long PPP burst can't hold back the
+ * AT channel for more than one quantum. Whichever thread writes to a channel drives the muxer on
+ * behalf of all channels; a concurrent writer only queues its data. A channel suspended by the
+ * remote side is skipped until process() is called again.
+ *
+ * Incoming data is accounted per channel as receive credit, i.e. the free space in the channel's
+ * receive buffer. A channel is suspended (MSC with FC bit set) when its credit gets low and resumed
+ * when enough data has been consumed. The aggregate FCon/FCoff commands are not used, so that a
+ * full AT channel buffer doesn't stall the PPP channel and vice versa.
+ */
+template <typename MuxerT, typename MutexT>
+class MuxerChannelScheduler {
+public:
+    static const size_t MAX_CHANNELS = 4;
+    static const unsigned DEFAULT_WEIGHT = 256;
+
+    explicit MuxerChannelScheduler(MuxerT* muxer);
+
+    /**
+     * Registers a channel.
+     *
+     * @param channel Channel number.
+     * @param txBufSize Size of the transmit buffer.
+     * @param rxBufSize Size of the channel's receive buffer, or 0 if receive credit isn't tracked.
+     * @param weight Maximum number of bytes sent in a round.
+     */
+    int addChannel(uint8_t channel, size_t txBufSize, size_t rxBufSize, unsigned weight = DEFAULT_WEIGHT);
+
+    /**
+     * Discards all queued data and resets the receive credit of all channels.
+     */
+    void reset();
+
+    /**
+     * Queues data for sending and runs the scheduler.
+     *
+     * Once the data is queued, it stays in the transmit buffer until it's sent or `reset()` is
+     * called, so an error reported by the muxer while sending doesn't fail the write. Such an error
+     * is returned by the next call to `process()`.
+     *
+     * @param partial If `false`, the data is queued only if it fits in the transmit buffer entirely.
+     * @return Number of bytes queued, or a negative error code.
+     */
+    int write(uint8_t channel, const char* data, size_t size, bool partial = true);
+
+    /**
+     * Sends the queued data of all channels.
+     */
+    int process();
+
+    int availForWrite(uint8_t channel);
+    int txPending(uint8_t channel);
+
+    /**
+     * Accounts for data received on a channel.
+     *
+     * @param size Number of bytes stored in the channel's receive buffer.
+     * @param dropped Number of bytes that didn't fit in the buffer.
+     */
+    int received(uint8_t channel, size_t size, size_t dropped = 0);
+
+    /**
+     * Accounts for data consumed from a channel's receive buffer.
+     */
+    int consumed(uint8_t channel, size_t size);
+
+    int rxCredit(uint8_t channel);
+    bool suspended(uint8_t channel);
+
+    int stats(uint8_t channel, MuxerChannelStats* stats);
+
+private:
+    struct Channel {
+        std::unique_ptr<char[]> txBufData;
+        particle::services::RingBuffer<char> txBuf;
+        MuxerChannelStats stats;
+        size_t rxBufSize;
+        size_t rxPending;
+        size_t deficit;
+        unsigned weight;
+        uint8_t id;
+        bool suspended;
+        bool stalled;
+    };
+
+    MuxerT* muxer_;
+    Channel channels_[MAX_CHANNELS];
+    size_t count_;
+    size_t next_;
+    bool running_;
+    bool kick_;
+    MutexT mutex_;
+
+    Channel* channel(uint8_t id);
+    int sendQueued(Channel* ch, bool* progress);
+};
+
+template <typename MuxerT, typename MutexT>
+const size_t MuxerChannelScheduler<MuxerT, MutexT>::MAX_CHANNELS;
+
+template <typename MuxerT, typename MutexT>
+const unsigned MuxerChannelScheduler<MuxerT, MutexT>::DEFAULT_WEIGHT;
+
+template <typename MuxerT, typename MutexT>
+inline MuxerChannelScheduler<MuxerT, MutexT>::MuxerChannelScheduler(MuxerT* muxer)
+        : muxer_(muxer),
+          count_(0),
+          next_(0),
+          running_(false),
+          kick_(false) {
+}
+
+template <typename MuxerT, typename MutexT>
+inline int MuxerChannelScheduler<MuxerT, MutexT>::addChannel(uint8_t channel, size_t txBufSize, size_t rxBufSize,
+        unsigned weight) {
+    CHECK_TRUE(txBufSize > 0 && weight > 0, SYSTEM_ERROR_INVALID_ARGUMENT);
+    std::lock_guard<MutexT> lock(mutex_);
+    auto ch = this->channel(channel);
+    if (!ch) {
+        CHECK_TRUE(count_ < MAX_CHANNELS, SYSTEM_ERROR_TOO_LARGE);
+        ch = &channels_[count_++];
+    }
+    if (!ch->txBufData || ch->txBuf.size() != txBufSize) {
+        ch->txBufData.reset(new (std::nothrow) char[txBufSize]);
+        CHECK_TRUE(ch->txBufData, SYSTEM_ERROR_NO_MEMORY);
+    }
+    ch->txBuf.init(ch->txBufData.get(), txBufSize);
+    ch->stats = MuxerChannelStats();
+    ch->rxBufSize = rxBufSize;
+    ch->rxPending = 0;
+    ch->deficit = 0;
+    ch->weight = weight;
+    ch->id = channel;
+    ch->suspended = false;
+    ch->stalled = false;
+    return 0;
+}
+
+template <typename MuxerT, typename MutexT>
+inline void MuxerChannelScheduler<MuxerT, MutexT>::reset() {
+    std::lock_guard<MutexT> lock(mutex_);
+    for (size_t i = 0; i < count_; ++i) {
+        auto& ch = channels_[i];
+        ch.txBuf.reset();
+        ch.rxPending = 0;
+        ch.deficit = 0;
+        ch.suspended = false;
+        ch.stalled = false;
+    }
+}
+
+template <typename MuxerT, typename MutexT>
+inline int MuxerChannelScheduler<MuxerT, MutexT>::write(uint8_t channel, const char* data, size_t size, bool partial) {
+    size_t n = 0;
+    {
+        std::lock_guard<MutexT> lock(mutex_);
+        const auto ch = this->channel(channel);
+        CHECK_TRUE(ch, SYSTEM_ERROR_NOT_FOUND);
+        const size_t space = CHECK(ch->txBuf.space());
+        if (partial || size <= space) {
+            n = std::min(size, space);
+            CHECK(ch->txBuf.put(data, n));
+        }
+        kick_ = true;
+    }
+    process();
+    return n;
+}
+
+template <typename MuxerT, typename MutexT>
+inline int MuxerChannelScheduler<MuxerT, MutexT>::process() {
+    {
+        std::lock_guard<MutexT> lock(mutex_);
+        if (running_) {
+            // Another thread is sending, the queued data will be picked up by that thread
+            kick_ = true;
+            return 0;
+        }
+        running_ = true;
+    }
+    int r = 0;
+    for (;;) {
+        size_t count = 0;
+        {
+            std::lock_guard<MutexT> lock(mutex_);
+            kick_ = false;
+            count = count_;
+        }
+        // Keep running rounds until no channel can make progress
+        bool progress = false;
+        for (size_t i = 0; i < count && r >= 0; ++i) {
+            const auto ch = &channels_[next_];
+            next_ = (next_ + 1) % count;
+            r = sendQueued(ch, &progress);
+        }
+        std::lock_guard<MutexT> lock(mutex_);
+        if (r < 0 || (!progress && !kick_)) {
+            running_ = false;
+            break;
+        }
+    }
+    return r;
+}
+
+template <typename MuxerT, typename MutexT>
+inline int MuxerChannelScheduler<MuxerT, MutexT>::sendQueued(Channel* ch, bool* progress) {
+    {
+        std::lock_guard<MutexT> lock(mutex_);
+        if (ch->txBuf.empty()) {
+            ch->deficit = 0;
+            return 0;
+        }
+        ch->deficit += ch->weight;
+    }
+    const size_t maxFrameSize = muxer_->getMaxFrameSize();
+    for (;;) {
+        const char* data = nullptr;
+        size_t size = 0;
+        {
+            std::lock_guard<MutexT> lock(mutex_);
+            size = std::min(std::min(ch->txBuf.consumable(), ch->deficit), maxFrameSize);
+            if (!size) {
+                if (ch->txBuf.empty()) {
+                    ch->deficit = 0;
+                }
+                return 0;
+            }
+            data = ch->txBuf.consume(size);
+        }
+        // The muxer is called without holding the lock, so that other threads can queue more data
+        const int r = muxer_->writeChannel(ch->id, (const uint8_t*)data, size);
+        std::lock_guard<MutexT> lock(mutex_);
+        if (r != 0) {
+            ch->txBuf.consumeCommit(0, size);
+            if (r == gsm0710::GSM0710_ERROR_FLOW_CONTROL) {
+                // Try again in a later round. The channel is retried on every call to process(),
+                // so only the transition to the stalled state is counted
+                if (!ch->stalled) {
+                    ch->stalled = true;
+                    ++ch->stats.txStalls;
+                }
+                ch->deficit = 0;
+                return 0;
+            }
+            return r;
+        }
+        ch->txBuf.consumeCommit(size);
+        ch->stalled = false;
+        ch->deficit -= size;
+        ch->stats.txBytes += size;
+        ++ch->stats.txFrames;
+        *progress = true;
+    }
+}
+
+template <typename MuxerT, typename MutexT>
+inline int MuxerChannelScheduler<MuxerT, MutexT>::availForWrite(uint8_t channel) {
+    std::lock_guard<MutexT> lock(mutex_);
+    const auto ch = this->channel(channel);
+    CHECK_TRUE(ch, SYSTEM_ERROR_NOT_FOUND);
+    return ch->txBuf.space();
+}
+
+template <typename MuxerT, typename MutexT>
+inline int MuxerChannelScheduler<MuxerT, MutexT>::txPending(uint8_t channel) {
+    std::lock_guard<MutexT> lock(mutex_);
+    const auto ch = this->channel(channel);
+    CHECK_TRUE(ch, SYSTEM_ERROR_NOT_FOUND);
+    return ch->txBuf.data();
+}
+
+template <typename MuxerT, typename MutexT>
+inline int MuxerChannelScheduler<MuxerT, MutexT>::received(uint8_t channel, size_t size, size_t dropped) {
+    bool suspend = false;
+    {
+        std::lock_guard<MutexT> lock(mutex_);
+        const auto ch = this->channel(channel);
+        CHECK_TRUE(ch, SYSTEM_ERROR_NOT_FOUND);
+        ch->stats.rxBytes += size;
+        ch->stats.rxDropped += dropped;
+        if (!ch->rxBufSize) {
+            return 0;
+        }
+        ch->rxPending = std::min(ch->rxPending + size, ch->rxBufSize);
+        const size_t credit = ch->rxBufSize - ch->rxPending;
+        if (!ch->suspended && credit <= ch->rxBufSize / detail::MUXER_CHANNEL_SUSPEND_THRESHOLD) {
+            ch->suspended = true;
+            ++ch->stats.suspends;
+            suspend = true;
+        }
+    }
+    if (suspend) {
+        muxer_->suspendChannel(channel);
+    }
+    return 0;
+}
+
+template <typename MuxerT, typename MutexT>
+inline int MuxerChannelScheduler<MuxerT, MutexT>::consumed(uint8_t channel, size_t size) {
+    bool resume = false;
+    {
+        std::lock_guard<MutexT> lock(mutex_);
+        const auto ch = this->channel(channel);
+        CHECK_TRUE(ch, SYSTEM_ERROR_NOT_FOUND);
+        ch->rxPending -= std::min(size, ch->rxPending);
+        const size_t credit = ch->rxBufSize - ch->rxPending;
+        if (ch->suspended && credit >= ch->rxBufSize / detail::MUXER_CHANNEL_RESUME_THRESHOLD) {
+            ch->suspended = false;
+            resume = true;
+        }
+    }
+    if (resume) {
+        muxer_->resumeChannel(channel);
+    }
+    return 0;
+}
+
+template <typename MuxerT, typename MutexT>
+inline int MuxerChannelScheduler<MuxerT, MutexT>::rxCredit(uint8_t channel) {
+    std::lock_guard<MutexT> lock(mutex_);
+    const auto ch = this->channel(channel);
+    CHECK_TRUE(ch, SYSTEM_ERROR_NOT_FOUND);
+    return ch->rxBufSize - ch->rxPending;
+}
+
+template <typename MuxerT, typename MutexT>
+inline bool MuxerChannelScheduler<MuxerT, MutexT>::suspended(uint8_t channel) {
+    std::lock_guard<MutexT> lock(mutex_);
+    const auto ch = this->channel(channel);
+    return ch && ch->suspended;
+}
+
+template <typename MuxerT, typename MutexT>
+inline int MuxerChannelScheduler<MuxerT, MutexT>::stats(uint8_t channel, MuxerChannelStats* stats) {
+    CHECK_TRUE(stats, SYSTEM_ERROR_INVALID_ARGUMENT);
+    std::lock_guard<MutexT> lock(mutex_);
+    const auto ch = this->channel(channel);
+    CHECK_TRUE(ch, SYSTEM_ERROR_NOT_FOUND);
+    *stats = ch->stats;
+    return 0;
+}
+
+template <typename MuxerT, typename MutexT>
+inline typename MuxerChannelScheduler<MuxerT, MutexT>::Channel* MuxerChannelScheduler<MuxerT, MutexT>::channel(uint8_t id) {
+    for (size_t i = 0; i < count_; ++i) {
+        if (channels_[i].id == id) {
+            return &channels_[i];
+        }
+    }
+    return nullptr;
+}
+
+} // particle
+
+#endif // GSM0710_MUXER_CHANNEL_SCHEDULER_H
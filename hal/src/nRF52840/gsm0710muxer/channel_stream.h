@@ -19,6 +19,7 @@
 #define GSM0710_MUXER_CHANNEL_STREAM_H
 
 #include "gsm0710muxer/muxer.h"
+#include "gsm0710muxer/channel_scheduler.h"
 #include "stream.h"
 #include "ringbuffer.h"
 #include "check.h"
@@ -30,14 +31,11 @@
 
 namespace particle {
 
-namespace detail {
-const auto MUXER_CHANNEL_SUSPEND_THRESHOLD = 3; // 1/3
-const auto MUXER_CHANNEL_RESUME_THRESHOLD = 2; // 1/2
-} // detail
-
 template <typename MuxerT>
 class MuxerChannelStream : virtual public Stream {
 public:
+    typedef MuxerChannelScheduler<MuxerT, RecursiveMutex> Scheduler;
+
     MuxerChannelStream(MuxerT* muxer, uint8_t channel);
     virtual ~MuxerChannelStream();
 
@@ -59,12 +57,16 @@ public:
     void enabled(bool enabled);
     bool enabled() const;
 
+    // Routes the channel's traffic through a scheduler shared with the other channels
+    void scheduler(Scheduler* scheduler);
+
 private:
     void suspend();
     void resume();
 
 private:
     MuxerT* muxer_;
+    Scheduler* scheduler_ = nullptr;
     uint8_t channel_;
     size_t rxBufSize_ = 0;
     std::unique_ptr<particle::services::RingBuffer<char> > rxBuf_;
@@ -114,15 +116,21 @@ inline int MuxerChannelStream<MuxerT>::init(size_t rxBufSize) {
 template <typename MuxerT>
 inline int MuxerChannelStream<MuxerT>::channelDataCb(const uint8_t* data, size_t size, void* ctx) {
     auto self = (MuxerChannelStream<MuxerT>*)ctx;
+    bool stored = true;
     {
         std::lock_guard<RecursiveMutex> lock(self->mutex_);
         auto r = self->rxBuf_->put((const char*)data, size);
         if (r == SYSTEM_ERROR_TOO_LARGE) {
             LOG_DEBUG(WARN, "No space in muxer channel stream rx buffer while trying to put %d bytes (%d available)",
                     (int)size, self->rxBuf_->space());
+            stored = false;
         }
     }
-    self->suspend();
+    if (self->scheduler_) {
+        self->scheduler_->received(self->channel_, stored ? size : 0, stored ? 0 : size);
+    } else {
+        self->suspend();
+    }
     os_semaphore_give(self->sem_, false);
     return 0;
 }
@@ -139,7 +147,13 @@ inline int MuxerChannelStream<MuxerT>::read(char* data, size_t size) {
         size_t willRead = std::min(canRead, size);
         r = rxBuf_->get(data, willRead);
     }
-    resume();
+    if (scheduler_) {
+        if (r > 0) {
+            scheduler_->consumed(channel_, r);
+        }
+    } else {
+        resume();
+    }
     return r;
 }
 
@@ -176,6 +190,9 @@ inline int MuxerChannelStream<MuxerT>::write(const char* data, size_t size) {
     if (size == 0) {
         return 0;
     }
+    if (scheduler_) {
+        return scheduler_->write(channel_, data, size);
+    }
     auto r = muxer_->writeChannel(channel_, (const uint8_t*)data, size);
     if (!r) {
         return size;
@@ -198,6 +215,9 @@ inline int MuxerChannelStream<MuxerT>::availForWrite() {
     if (!enabled_) {
         return SYSTEM_ERROR_INVALID_STATE;
     }
+    if (scheduler_) {
+        return scheduler_->availForWrite(channel_);
+    }
     return muxer_->getMaxFrameSize();
 }
 
@@ -217,6 +237,10 @@ inline int MuxerChannelStream<MuxerT>::waitEvent(unsigned flags, unsigned timeou
     for (;;) {
         // Make sure to clear any notification before we check current state
         os_semaphore_take(sem_, 0, false);
+        if (scheduler_ && (flags & Stream::WRITABLE)) {
+            // Send the data held back by the remote side flow control, if any
+            scheduler_->process();
+        }
         {
             std::lock_guard<RecursiveMutex> lock(mutex_);
             if (availForRead() > 0) {
@@ -288,6 +312,11 @@ inline bool MuxerChannelStream<MuxerT>::enabled() const {
     return enabled_;
 }
 
+template <typename MuxerT>
+inline void MuxerChannelStream<MuxerT>::scheduler(Scheduler* scheduler) {
+    scheduler_ = scheduler;
+}
+
 } // particle
 
 #endif // GSM0710_MUXER_CHANNEL_STREAM_H
@@ -61,6 +61,7 @@ const uint16_t BOOTLOADER_MBR_UPDATE_MIN_VERSION = 1001; // 2.0.0-rc.1
 } // anonymous
 
 static int flash_bootloader(const hal_module_t* mod, uint32_t moduleLength);
+static int flash_asset_bundle(const hal_module_t* mod, uint32_t moduleLength);
 
 inline bool matches_mcu(uint8_t bounds_mcu, uint8_t actual_mcu) {
 	return bounds_mcu==HAL_PLATFORM_MCU_ANY || actual_mcu==HAL_PLATFORM_MCU_ANY || (bounds_mcu==actual_mcu);
@@ -80,6 +81,10 @@ const module_bounds_t* find_module_bounds(uint8_t module_function, uint8_t modul
         if (module_bounds[i]->module_function==module_function && module_bounds[i]->module_index==module_index && matches_mcu(module_bounds[i]->mcu_identifier, mcu_identifier))
             return module_bounds[i];
     }
+    if (module_function == module_asset_bundle.module_function && module_index == module_asset_bundle.module_index &&
+            matches_mcu(module_asset_bundle.mcu_identifier, mcu_identifier)) {
+        return &module_asset_bundle;
+    }
     return NULL;
 }
 
@@ -166,6 +171,11 @@ int HAL_System_Info(hal_system_info_t* info, bool construct, void* reserved)
 {
     if (construct) {
         info->platform_id = PLATFORM_ID;
+        uint16_t flags = 0;
+        if (info->size > offsetof(hal_system_info_t, flags)) {
+            flags = info->flags;
+        }
+        const uint16_t checkFlags = (flags & HAL_SYSTEM_INFO_FLAGS_SKIP_INTEGRITY) ? 0 : MODULE_VALIDATION_INTEGRITY;
         uint8_t count = module_bounds_length;
         info->modules = new hal_module_t[count];
         if (info->modules) {
@@ -186,7 +196,7 @@ int HAL_System_Info(hal_system_info_t* info, bool construct, void* reserved)
                     module->bounds = *bounds;
                     continue;
                 }
-                bool valid = fetch_module(module, bounds, false, MODULE_VALIDATION_INTEGRITY);
+                bool valid = fetch_cached_module(module, i, false, checkFlags);
                 valid = valid && (module->validity_checked == module->validity_result);
                 if (valid && bounds->module_function == MODULE_FUNCTION_USER_PART) {
                     user_module_found = true;
@@ -204,108 +214,12 @@ int HAL_System_Info(hal_system_info_t* info, bool construct, void* reserved)
     return 0;
 }
 
-bool validate_module_dependencies_full(const module_info_t* module, const module_bounds_t* bounds)
-{
-    if (module_function(module) != MODULE_FUNCTION_SYSTEM_PART)
-        return true;
-
-    bool valid = true;
-
-    // When updating system-parts
-    // If MODULE_VALIDATION_DEPENDENCIES_FULL was requested, validate that the dependecies
-    // would still be satisfied after the module from the "ota_module" replaces the current one
-    hal_system_info_t sysinfo;
-    memset(&sysinfo, 0, sizeof(sysinfo));
-    sysinfo.size = sizeof(sysinfo);
-    HAL_System_Info(&sysinfo, true, nullptr);
-    for (unsigned i=0; i<sysinfo.module_count; i++) {
-        const hal_module_t& smod = sysinfo.modules[i];
-        const module_info_t* info = &smod.info;
-        if (!info)
-            continue;
-
-        // Just in case
-        if (!memcmp((const void*)&smod.bounds, (const void*)bounds, sizeof(module_bounds_t))) {
-            // Do not validate against self
-            continue;
-        }
-
-        // Validate only system parts
-        if (module_function(info) != MODULE_FUNCTION_SYSTEM_PART)
-            continue;
-
-        if (info->module_start_address == module->module_start_address &&
-            module_function(module) == module_function(info) &&
-            module_index(module) == module_index(info)) {
-            // Do not validate replaced module
-            continue;
-        }
-
-        if (info->dependency.module_function != MODULE_FUNCTION_NONE) {
-            if (info->dependency.module_function == module->module_function &&
-                info->dependency.module_index == module->module_index) {
-                valid = module->module_version >= info->dependency.module_version;
-                if (!valid)
-                    break;
-            }
-        }
-
-        if (info->dependency2.module_function != MODULE_FUNCTION_NONE) {
-            if (info->dependency2.module_function == module->module_function &&
-                info->dependency2.module_index == module->module_index) {
-                valid = module->module_version >= info->dependency2.module_version;
-                if (!valid)
-                    break;
-            }
-        }
-    }
-    HAL_System_Info(&sysinfo, false, nullptr);
-
-    return valid;
-}
-
 bool validate_module_dependencies(const module_bounds_t* bounds, bool userOptional, bool fullDeps)
 {
-    bool valid = false;
     module_info_t moduleInfo = {};
     CHECK_TRUE(locate_module(bounds, &moduleInfo) == SYSTEM_ERROR_NONE, false);
-    if (moduleInfo.dependency.module_function == MODULE_FUNCTION_NONE || (userOptional && module_function(&moduleInfo) == MODULE_FUNCTION_USER_PART)) {
-        valid = true;
-    } else {
-        // deliberately not transitive, so we only check the first dependency
-        // so only user->system_part_2 is checked
-        if (moduleInfo.dependency.module_function != MODULE_FUNCTION_NONE) {
-            // NOTE: we ignore MCU type
-            const module_bounds_t* dependency_bounds = find_module_bounds(moduleInfo.dependency.module_function, moduleInfo.dependency.module_index, HAL_PLATFORM_MCU_ANY);
-            if (!dependency_bounds) {
-                return false;
-            }
-            module_info_t infoDep = {};
-            int ret = locate_module(dependency_bounds, &infoDep);
-            valid = (ret == SYSTEM_ERROR_NONE) && (infoDep.module_version >= moduleInfo.dependency.module_version);
-        } else {
-            valid = true;
-        }
-        // Validate dependency2
-        if (moduleInfo.dependency2.module_function == MODULE_FUNCTION_NONE ||
-            (moduleInfo.dependency2.module_function == MODULE_FUNCTION_BOOTLOADER && userOptional)) {
-            valid = valid && true;
-        } else {
-            // NOTE: we ignore MCU type
-            const module_bounds_t* dependency_bounds = find_module_bounds(moduleInfo.dependency2.module_function, moduleInfo.dependency2.module_index, HAL_PLATFORM_MCU_ANY);
-            if (!dependency_bounds) {
-                return false;
-            }
-            module_info_t infoDep;
-            int ret = locate_module(dependency_bounds, &infoDep);
-            valid = valid && (ret == SYSTEM_ERROR_NONE) && (infoDep.module_version >= moduleInfo.dependency2.module_version);
-        }
-    }
-
-    if (fullDeps && valid) {
-        valid = valid && validate_module_dependencies_full(&moduleInfo, bounds);
-    }
-    return valid;
+    // The dependencies are looked up in the module info cache rather than read from flash every time
+    return check_module_dependencies(&moduleInfo, bounds, userOptional, fullDeps);
 }
 
 bool HAL_Verify_User_Dependencies()
@@ -354,6 +268,7 @@ uint16_t HAL_OTA_ChunkSize()
 
 bool HAL_FLASH_Begin(uint32_t address, uint32_t length, void* reserved)
 {
+    invalidate_module_info_cache(MODULE_BOUNDS_LOC_EXTERNAL_FLASH, address, length);
     const int r = FLASH_Begin(address, length);
     if (r != FLASH_ACCESS_RESULT_OK) {
         return false;
@@ -363,6 +278,7 @@ bool HAL_FLASH_Begin(uint32_t address, uint32_t length, void* reserved)
 
 int HAL_FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved)
 {
+    invalidate_module_info_cache(MODULE_BOUNDS_LOC_EXTERNAL_FLASH, address, length);
     return FLASH_Update(pBuffer, address, length);
 }
 
@@ -416,6 +332,43 @@ static int flash_bootloader(const hal_module_t* mod, uint32_t moduleLength)
     return ok ? (int)HAL_UPDATE_APPLIED : SYSTEM_ERROR_UNKNOWN;
 }
 
+/**
+ * Copies the payload of a resource module from the OTA region into the asset bundle region.
+ * Unlike firmware modules, asset bundles are not applied by the bootloader and take effect immediately.
+ */
+static int flash_asset_bundle(const hal_module_t* mod, uint32_t moduleLength)
+{
+    const module_info_t& info = mod->info;
+    if ((uintptr_t)info.module_start_address != module_asset_bundle.start_address) {
+        SYSTEM_ERROR_MESSAGE("Invalid asset bundle address");
+        return SYSTEM_ERROR_OTA_INVALID_ADDRESS;
+    }
+    if (!(info.flags & MODULE_INFO_FLAG_DROP_MODULE_INFO) || moduleLength < sizeof(module_info_t) + sizeof(module_info_suffix_t)) {
+        SYSTEM_ERROR_MESSAGE("Invalid asset bundle format");
+        return SYSTEM_ERROR_OTA_INVALID_FORMAT;
+    }
+    const uintptr_t srcAddr = mod->bounds.start_address + sizeof(module_info_t);
+    const size_t size = moduleLength - sizeof(module_info_t) - sizeof(module_info_suffix_t);
+    const uintptr_t destAddr = module_asset_bundle.start_address;
+    const size_t sectors = (size + sFLASH_PAGESIZE - 1) / sFLASH_PAGESIZE;
+    CHECK_TRUE(hal_exflash_erase_sector(destAddr, sectors) == 0, SYSTEM_ERROR_FLASH_IO);
+    // The first word of the bundle (its magic number) is written last so that an interrupted
+    // update leaves behind an invalid bundle rather than a partially written one
+    const size_t magicSize = 4;
+    uint8_t buf[256];
+    size_t offs = std::min(size, magicSize);
+    while (offs < size) {
+        const size_t n = std::min(size - offs, sizeof(buf));
+        CHECK_TRUE(hal_exflash_read(srcAddr + offs, buf, n) == 0, SYSTEM_ERROR_FLASH_IO);
+        CHECK_TRUE(hal_exflash_write(destAddr + offs, buf, n) == 0, SYSTEM_ERROR_FLASH_IO);
+        offs += n;
+    }
+    const size_t n = std::min(size, magicSize);
+    CHECK_TRUE(hal_exflash_read(srcAddr, buf, n) == 0, SYSTEM_ERROR_FLASH_IO);
+    CHECK_TRUE(hal_exflash_write(destAddr, buf, n) == 0, SYSTEM_ERROR_FLASH_IO);
+    return HAL_UPDATE_APPLIED;
+}
+
 namespace {
 
 int validityResultToSystemError(unsigned result, unsigned checked) {
@@ -579,6 +532,10 @@ int HAL_FLASH_End(void* reserved)
             break;
         }
 #endif // HAL_PLATFORM_NCP_UPDATABLE
+        case MODULE_FUNCTION_RESOURCE: {
+            result = flash_asset_bundle(module, moduleSize);
+            break;
+        }
         case MODULE_FUNCTION_BOOTLOADER: {
             if (bootloader_get_version() < BOOTLOADER_MBR_UPDATE_MIN_VERSION) {
                 result = flash_bootloader(module, moduleSize);
@@ -612,6 +569,8 @@ int HAL_FLASH_End(void* reserved)
             break;
         }
         }
+        // The module may have been written to the bootloader, asset or NCP flash
+        reset_module_info_cache();
         if (result < 0) {
             LOG(ERROR, "Unable to apply module");
             // TODO: Clear module slots in DCT?
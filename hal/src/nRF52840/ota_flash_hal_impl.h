@@ -43,6 +43,9 @@ extern const module_bounds_t module_ncp_mono;
 
 extern const module_bounds_t module_radio_stack;
 
+// Not included in module_bounds[] as it's not a firmware module
+extern const module_bounds_t module_asset_bundle;
+
 const uint8_t* fetch_server_public_key(uint8_t lock);
 const uint8_t* fetch_device_private_key(uint8_t lock);
 const uint8_t* fetch_device_public_key(uint8_t lock);
@@ -23,10 +23,34 @@
 #include "ota_flash_hal_impl.h"
 #include "platform_radio_stack.h"
 #include "platform_ncp.h"
+#include "module_info_cache.h"
+#include "static_recursive_mutex.h"
+#include "interrupts_hal.h"
 #include "check.h"
 
+#include <algorithm>
+#include <mutex>
+
 namespace {
 
+using particle::ModuleInfoCache;
+using particle::ModuleReader;
+using particle::VerifiedModuleList;
+
+// Region of the internal flash that has been written to since the module info cache was last used.
+// The flash HAL can't lock the cache while the flash is locked, so the region is recorded here and
+// invalidated in the cache on the next access
+uint32_t g_writtenStart = 0;
+uint32_t g_writtenEnd = 0;
+
+// Modules in the internal flash that have been verified. The list survives a warm reset and is
+// discarded by its checksum check after a cold boot. A module rewritten by the bootloader, DFU or
+// SWD doesn't match its entry unless it has the same length and stored CRC
+__attribute__((section(".retained_system"))) VerifiedModuleList::Data g_verifiedModuleData;
+VerifiedModuleList g_verifiedModules(&g_verifiedModuleData);
+// Incremented on every write to the internal flash
+volatile uint32_t g_flashWriteCount = 0;
+
 int get_module_info(const module_bounds_t* bounds, module_info_t* infoOut, uint32_t* offset = nullptr) {
     if (!memcmp(bounds, &module_radio_stack, sizeof(module_radio_stack))) {
         hal_module_t module;
@@ -69,8 +93,134 @@ bool verify_crc32(const module_bounds_t* bounds, const module_info_t* info) {
     return false;
 }
 
+class FlashModuleReader: public ModuleReader {
+public:
+    int readInfo(const module_bounds_t* bounds, hal_module_t* module) override {
+        if (!memcmp(bounds, &module_radio_stack, sizeof(module_radio_stack))) {
+            CHECK(platform_radio_stack_fetch_module_info(module));
+            return PLATFORM_VALIDATED;
+        }
+#if HAL_PLATFORM_NCP_UPDATABLE
+        if (!memcmp(bounds, &module_ncp_mono, sizeof(module_ncp_mono))) {
+            CHECK(platform_ncp_fetch_module_info(module));
+            return PLATFORM_VALIDATED;
+        }
+#endif
+        return get_module_info(bounds, &module->info, &module->module_info_offset);
+    }
+
+    int readSuffix(const module_bounds_t* bounds, hal_module_t* module) override {
+        return get_module_crc_suffix(bounds, &module->info, &module->crc, &module->suffix);
+    }
+
+    bool verifyIntegrity(const module_bounds_t* bounds, const module_info_t* info) override {
+        writeCount_ = g_flashWriteCount;
+        return verify_crc32(bounds, info);
+    }
+
+    bool isVerified(const module_bounds_t* bounds, const hal_module_t* module) override {
+        if (bounds->location != MODULE_BOUNDS_LOC_INTERNAL_FLASH) {
+            return false;
+        }
+        const int state = HAL_disable_irq();
+        const bool ok = g_verifiedModules.has(bounds->start_address, module_length(&module->info), module->crc.crc32);
+        HAL_enable_irq(state);
+        return ok;
+    }
+
+    void verified(const module_bounds_t* bounds, const hal_module_t* module) override {
+        if (bounds->location != MODULE_BOUNDS_LOC_INTERNAL_FLASH) {
+            return;
+        }
+        const int state = HAL_disable_irq();
+        // Don't record the result if the flash was written to while the module was being verified
+        if (writeCount_ == g_flashWriteCount) {
+            g_verifiedModules.add(bounds->start_address, module_length(&module->info), module->crc.crc32);
+        }
+        HAL_enable_irq(state);
+    }
+
+private:
+    uint32_t writeCount_ = 0;
+};
+
+StaticRecursiveMutex g_moduleInfoCacheMutex;
+
+ModuleInfoCache* moduleInfoCache() {
+    static FlashModuleReader reader;
+    static ModuleInfoCache cache(&reader, module_bounds, module_bounds_length, PLATFORM_ID);
+    SPARK_ASSERT(module_bounds_length <= particle::MODULE_INFO_CACHE_MAX_MODULES);
+    const int state = HAL_disable_irq();
+    const uint32_t start = g_writtenStart;
+    const uint32_t end = g_writtenEnd;
+    g_writtenStart = 0;
+    g_writtenEnd = 0;
+    HAL_enable_irq(state);
+    if (start < end) {
+        cache.invalidate(MODULE_BOUNDS_LOC_INTERNAL_FLASH, start, end - start);
+    }
+    return &cache;
+}
+
 } // namespace
 
+bool fetch_cached_module(hal_module_t* target, size_t index, bool userDepsOptional, uint16_t check_flags) {
+    std::lock_guard<StaticRecursiveMutex> lock(g_moduleInfoCacheMutex);
+    return moduleInfoCache()->getModule(index, target, check_flags, userDepsOptional);
+}
+
+bool check_module_dependencies(const module_info_t* info, const module_bounds_t* bounds, bool userDepsOptional, bool fullDeps) {
+    std::lock_guard<StaticRecursiveMutex> lock(g_moduleInfoCacheMutex);
+    const auto cache = moduleInfoCache();
+    return cache->checkDependencies(info, userDepsOptional) && (!fullDeps || cache->checkDependenciesFull(info, bounds));
+}
+
+void invalidate_module_info_cache(module_bounds_location_t location, uint32_t address, size_t length) {
+    std::lock_guard<StaticRecursiveMutex> lock(g_moduleInfoCacheMutex);
+    moduleInfoCache()->invalidate(location, address, length);
+}
+
+void reset_module_info_cache() {
+    std::lock_guard<StaticRecursiveMutex> lock(g_moduleInfoCacheMutex);
+    moduleInfoCache()->invalidateAll();
+    const int state = HAL_disable_irq();
+    g_verifiedModules.clear();
+    HAL_enable_irq(state);
+}
+
+bool verify_module_crc32_cached(uint32_t address, uint32_t length) {
+    if (!length) {
+        return false;
+    }
+    {
+        std::lock_guard<StaticRecursiveMutex> lock(g_moduleInfoCacheMutex);
+        bool valid = false;
+        if (moduleInfoCache()->checkIntegrity(MODULE_BOUNDS_LOC_INTERNAL_FLASH, address, &valid) == 0) {
+            return valid;
+        }
+    }
+    return FLASH_VerifyCRC32(FLASH_INTERNAL, address, length);
+}
+
+void invalidate_internal_module_info(uint32_t address, uint32_t length) {
+    if (!length) {
+        return;
+    }
+    const int state = HAL_disable_irq();
+    // The list of verified modules is updated immediately, as the device may be reset before the
+    // module info cache is accessed again
+    g_verifiedModules.remove(address, length);
+    ++g_flashWriteCount;
+    if (g_writtenStart < g_writtenEnd) {
+        g_writtenStart = std::min(g_writtenStart, address);
+        g_writtenEnd = std::max(g_writtenEnd, address + length);
+    } else {
+        g_writtenStart = address;
+        g_writtenEnd = address + length;
+    }
+    HAL_enable_irq(state);
+}
+
 /**
  * Determines if a given address is in range.
  * @param test      The address to test
@@ -35,6 +35,45 @@ const module_bounds_t* find_module_bounds(uint8_t module_function, uint8_t modul
 bool fetch_module(hal_module_t* target, const module_bounds_t* bounds, bool userDepsOptional, uint16_t check_flags);
 int locate_module(const module_bounds_t* bounds, module_info_t* infoOut);
 
+/**
+ * Fetches and validates the module at the given index in the module bounds table.
+ *
+ * This function is equivalent to `fetch_module()` but uses the module info cache: the module
+ * headers are read only once, and the integrity of a module is verified only if requested via
+ * `check_flags` and hasn't been verified yet.
+ */
+bool fetch_cached_module(hal_module_t* target, size_t index, bool userDepsOptional, uint16_t check_flags);
+/**
+ * Checks the dependencies of a module against the cached info of the modules on the device.
+ */
+bool check_module_dependencies(const module_info_t* info, const module_bounds_t* bounds, bool userDepsOptional, bool fullDeps);
+/**
+ * Invalidates the cached info of the modules overlapping with the given region.
+ */
+void invalidate_module_info_cache(module_bounds_location_t location, uint32_t address, size_t length);
+/**
+ * Invalidates the cached info of all modules.
+ */
+void reset_module_info_cache(void);
+
+/**
+ * Verifies the CRC of a module in the internal flash.
+ *
+ * The result is stored in the module info cache until the module region is written to. Successful
+ * results are also kept in retained memory, keyed by the module address, length and stored CRC,
+ * so that the module isn't verified again after a warm reset. Addresses that don't match any
+ * module bounds are verified without caching.
+ */
+bool verify_module_crc32_cached(uint32_t address, uint32_t length);
+/**
+ * Invalidates the cached info of the modules overlapping with the given region of the internal
+ * flash.
+ *
+ * Unlike `invalidate_module_info_cache()`, this function doesn't lock the cache and can be called
+ * while the flash is locked: the region is invalidated on the next access to the cache.
+ */
+void invalidate_internal_module_info(uint32_t address, uint32_t length);
+
 inline uint8_t module_mcu_target(const module_info_t* info) {
 	return info->reserved;
 }
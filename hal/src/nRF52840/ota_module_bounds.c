@@ -132,6 +132,20 @@ const module_bounds_t module_xip_code = {
         ,.location = MODULE_BOUNDS_LOC_INTERNAL_FLASH
     };
 
+// Read-only asset bundle
+const module_bounds_t module_asset_bundle = {
+        .maximum_size = EXTERNAL_FLASH_ASSET_LENGTH,
+        .start_address = EXTERNAL_FLASH_ASSET_ADDRESS,
+        .end_address = EXTERNAL_FLASH_ASSET_ADDRESS + EXTERNAL_FLASH_ASSET_LENGTH,
+        .module_function = MODULE_FUNCTION_RESOURCE,
+        .module_index = 0,
+        .store = MODULE_STORE_MAIN
+#if HAL_PLATFORM_NCP
+        ,.mcu_identifier = HAL_PLATFORM_MCU_DEFAULT
+#endif
+        ,.location = MODULE_BOUNDS_LOC_EXTERNAL_FLASH
+    };
+
 #if HAL_PLATFORM_NCP_UPDATABLE
 const module_bounds_t module_ncp_mono = {
         .maximum_size = 1500*1024,
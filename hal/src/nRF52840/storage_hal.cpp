@@ -22,6 +22,7 @@
 #include "system_error.h"
 #include "flash_mal.h"
 #include "check.h"
+#include "hal_platform.h"
 
 int hal_storage_read(hal_storage_id id, uintptr_t addr, uint8_t* buf, size_t size) {
     if (id == HAL_STORAGE_ID_INTERNAL_FLASH) {
@@ -60,3 +61,22 @@ int hal_storage_erase(hal_storage_id id, uintptr_t addr, size_t size) {
 
     return SYSTEM_ERROR_NOT_FOUND;
 }
+
+int hal_storage_get_region_info(hal_storage_region_id id, hal_storage_region_info* info, void* reserved) {
+    // Newer callers may pass a larger structure; the size is set to the size of the version filled in below
+    CHECK_TRUE(info && info->size >= sizeof(hal_storage_region_info), SYSTEM_ERROR_INVALID_ARGUMENT);
+    if (id == HAL_STORAGE_REGION_ASSET_BUNDLE) {
+        info->size = sizeof(hal_storage_region_info);
+        info->storage = HAL_STORAGE_ID_EXTERNAL_FLASH;
+        info->address = EXTERNAL_FLASH_ASSET_ADDRESS;
+        info->length = EXTERNAL_FLASH_ASSET_LENGTH;
+#if !HAL_PLATFORM_PROHIBIT_XIP
+        info->xip_address = EXTERNAL_FLASH_ASSET_XIP_ADDRESS;
+#else
+        info->xip_address = 0;
+#endif // !HAL_PLATFORM_PROHIBIT_XIP
+        return 0;
+    }
+
+    return SYSTEM_ERROR_NOT_FOUND;
+}
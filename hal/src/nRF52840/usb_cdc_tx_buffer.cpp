@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "usb_cdc_tx_buffer.h"
+
+using namespace particle;
+
+namespace {
+
+UsbCdcTxBuffer g_txBuffer;
+
+} // unnamed
+
+void usb_cdc_tx_buffer_init(uint8_t* buf, size_t size, size_t max_transfer_size) {
+    g_txBuffer.init(buf, size, max_transfer_size);
+}
+
+void usb_cdc_tx_buffer_reset(void) {
+    g_txBuffer.reset();
+}
+
+size_t usb_cdc_tx_buffer_write(const uint8_t* data, size_t size) {
+    return g_txBuffer.write(data, size);
+}
+
+size_t usb_cdc_tx_buffer_space(void) {
+    return g_txBuffer.space();
+}
+
+size_t usb_cdc_tx_buffer_pending(void) {
+    return g_txBuffer.pending();
+}
+
+const uint8_t* usb_cdc_tx_buffer_begin_transfer(size_t* size) {
+    return g_txBuffer.beginTransfer(size);
+}
+
+void usb_cdc_tx_buffer_end_transfer(void) {
+    g_txBuffer.endTransfer();
+}
+
+void usb_cdc_tx_buffer_cancel_transfer(void) {
+    g_txBuffer.cancelTransfer();
+}
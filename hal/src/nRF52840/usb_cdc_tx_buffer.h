@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+
+#include "ringbuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace particle {
+
+/**
+ * Transmit buffer of the USB CDC interface.
+ *
+ * IN transfers are set up directly on the contiguous spans of the ring buffer, so that the USBD
+ * peripheral reads the data via EasyDMA without copying it to an intermediate endpoint buffer.
+ * While a transfer is in progress, the application can keep writing to the free part of the
+ * buffer. A transfer can span several packets, in which case only one completion event needs to
+ * be handled for the entire batch.
+ *
+ * Calls to `write()` and `reset()` need to be synchronized with the USBD interrupt by the caller.
+ */
+class UsbCdcTxBuffer {
+public:
+    UsbCdcTxBuffer() :
+            maxTransferSize_(0),
+            transferSize_(0) {
+    }
+
+    /**
+     * Initializes the buffer.
+     *
+     * @param buf Buffer.
+     * @param size Buffer size.
+     * @param maxTransferSize Maximum size of a transfer.
+     */
+    void init(uint8_t* buf, size_t size, size_t maxTransferSize) {
+        ring_.init(buf, size);
+        maxTransferSize_ = maxTransferSize;
+        transferSize_ = 0;
+    }
+
+    /**
+     * Discards all buffered data, including the data of the ongoing transfer.
+     */
+    void reset() {
+        ring_.reset();
+        transferSize_ = 0;
+    }
+
+    /**
+     * Copies as much data as fits into the buffer.
+     *
+     * @return Number of bytes written.
+     */
+    size_t write(const uint8_t* data, size_t size) {
+        size_t written = 0;
+        while (written < size) {
+            // Contiguous space up to the end of the buffer or the start of the buffered data
+            const size_t n = std::min(ring_.acquirable(), size - written);
+            if (!n) {
+                break;
+            }
+            const auto ptr = ring_.acquire(n);
+            memcpy(ptr, data + written, n);
+            ring_.acquireCommit(n);
+            written += n;
+        }
+        return written;
+    }
+
+    /**
+     * Returns the number of bytes that can be written to the buffer.
+     */
+    size_t space() const {
+        return ring_.size() - pending();
+    }
+
+    /**
+     * Returns the number of bytes that haven't been sent yet, including the data of the ongoing
+     * transfer.
+     */
+    size_t pending() const {
+        // RingBuffer::data() can't be used while the data is being consumed
+        const size_t head = ring_.head_;
+        const size_t tail = ring_.tail_;
+        if (head >= tail && !ring_.full_) {
+            return head - tail;
+        }
+        return ring_.size() + head - tail;
+    }
+
+    /**
+     * Starts a transfer.
+     *
+     * @param[out] size Size of the transfer.
+     * @return Pointer to the data to be sent, or `nullptr` if there's no data to send or another
+     *         transfer is in progress.
+     */
+    const uint8_t* beginTransfer(size_t* size) {
+        if (transferSize_) {
+            return nullptr;
+        }
+        const size_t n = std::min(ring_.consumable(), maxTransferSize_);
+        if (!n) {
+            return nullptr;
+        }
+        transferSize_ = n;
+        *size = n;
+        return ring_.consume(n);
+    }
+
+    /**
+     * Releases the data of the ongoing transfer.
+     *
+     * This method should be called when the transfer is completed or aborted.
+     */
+    void endTransfer() {
+        if (transferSize_) {
+            ring_.consumeCommit(transferSize_);
+            transferSize_ = 0;
+        }
+    }
+
+    /**
+     * Cancels a transfer that couldn't be started. The data will be sent with the next transfer.
+     */
+    void cancelTransfer() {
+        if (transferSize_) {
+            ring_.consumeCommit(0, transferSize_);
+            transferSize_ = 0;
+        }
+    }
+
+    bool isTransferring() const {
+        return transferSize_;
+    }
+
+private:
+    services::RingBuffer<uint8_t> ring_;
+    size_t maxTransferSize_;
+    volatile size_t transferSize_;
+};
+
+} // particle
+
+extern "C" {
+#endif // defined(__cplusplus)
+
+/**
+ * C interface of the transmit buffer used by the USB CDC driver.
+ */
+void usb_cdc_tx_buffer_init(uint8_t* buf, size_t size, size_t max_transfer_size);
+void usb_cdc_tx_buffer_reset(void);
+size_t usb_cdc_tx_buffer_write(const uint8_t* data, size_t size);
+size_t usb_cdc_tx_buffer_space(void);
+size_t usb_cdc_tx_buffer_pending(void);
+const uint8_t* usb_cdc_tx_buffer_begin_transfer(size_t* size);
+void usb_cdc_tx_buffer_end_transfer(void);
+void usb_cdc_tx_buffer_cancel_transfer(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif // defined(__cplusplus)
@@ -39,6 +39,7 @@ LOG_SOURCE_CATEGORY("hal.usb.cdc");
 #include "app_usbd_serial_num.h"
 #include "app_fifo.h"
 #include "usb_hal_cdc.h"
+#include "usb_cdc_tx_buffer.h"
 #include "deviceid_hal.h"
 #include "bytes2hexbuf.h"
 #include "hal_platform.h"
@@ -77,7 +78,6 @@ typedef struct {
     usb_mode_t              mode;
 
     app_fifo_t              rx_fifo;
-    app_fifo_t              tx_fifo;
 
     volatile bool           com_opened;
     volatile bool           transmitting;
@@ -98,8 +98,10 @@ static usb_instance_t m_usb_instance = {0};
 // Rx buffer length must by multiple of NRF_DRV_USBD_EPSIZE.
 #define READ_SIZE       (NRF_DRV_USBD_EPSIZE * 2)
 static char m_rx_buffer[READ_SIZE];
-#define SEND_SIZE       NRF_DRV_USBD_EPSIZE
-static char             m_tx_buffer[SEND_SIZE];
+// Maximum size of an IN transfer. The data is sent directly from the TX buffer, and the driver
+// splits the transfer into packets
+#define SEND_SIZE       (NRF_DRV_USBD_EPSIZE * 8)
+static char             m_zlp_buffer[1];
 
 static void cdc_acm_user_ev_handler(app_usbd_class_inst_t const * p_inst,
                                     app_usbd_cdc_acm_user_event_t event);
@@ -117,14 +119,10 @@ APP_USBD_CDC_ACM_GLOBAL_DEF(m_app_cdc_acm,
 );
 
 #define FIFO_LENGTH(p_fifo)     fifo_length(p_fifo)  /**< Macro for calculating the FIFO length. */
-#define IS_FIFO_FULL(p_fifo)    fifo_full(p_fifo)
 static __INLINE uint32_t fifo_length(app_fifo_t * p_fifo) {
     uint32_t tmp = p_fifo->read_pos;
     return p_fifo->write_pos - tmp;
 }
-static __INLINE bool fifo_full(app_fifo_t * p_fifo) {
-    return (FIFO_LENGTH(p_fifo) > p_fifo->buf_size_mask);
-}
 
 static void reset_rx_tx_state(void) {
     m_usb_instance.rx_done = false;
@@ -132,7 +130,7 @@ static void reset_rx_tx_state(void) {
     m_usb_instance.transmitting = false;
     m_usb_instance.tx_failed = 0;
     m_usb_instance.rx_state = false;
-    app_fifo_flush(&m_usb_instance.tx_fifo);
+    usb_cdc_tx_buffer_reset();
     app_fifo_flush(&m_usb_instance.rx_fifo);
 }
 
@@ -202,7 +200,7 @@ static void usb_cdc_change_port_state(bool state)
         m_usb_instance.com_opened = state;
 
         if (state) {
-            app_fifo_flush(&m_usb_instance.tx_fifo);
+            usb_cdc_tx_buffer_reset();
             m_app_cdc_acm.specific.p_data->ctx.line_state |= APP_USBD_CDC_ACM_LINE_STATE_DTR;
             usb_cdc_schedule_rx();
         } else {
@@ -210,6 +208,7 @@ static void usb_cdc_change_port_state(bool state)
             // aborts transfers!
             m_usb_instance.tx_failed = 0;
             m_usb_instance.transmitting = false;
+            usb_cdc_tx_buffer_end_transfer();
         }
     }
 }
@@ -226,21 +225,25 @@ static void usb_cdc_schedule_tx() {
         // Send ZLP, otherwise the Nordic SDK
         // will disallow us to schedule any transfers in the closed state
         m_app_cdc_acm.specific.p_data->ctx.line_state |= APP_USBD_CDC_ACM_LINE_STATE_DTR;
-        app_usbd_cdc_acm_write(&m_app_cdc_acm, m_tx_buffer, 0);
+        app_usbd_cdc_acm_write(&m_app_cdc_acm, m_zlp_buffer, 0);
         m_app_cdc_acm.specific.p_data->ctx.line_state = cache;
     }
 
-    if (m_usb_instance.com_opened && !m_usb_instance.transmitting && FIFO_LENGTH(&m_usb_instance.tx_fifo) > 0) {
+    if (m_usb_instance.com_opened && !m_usb_instance.transmitting) {
+        // The transfer is set up directly on the TX buffer, which is located in RAM, so the driver
+        // doesn't need to copy the data into an endpoint buffer
         size_t to_send = 0;
-        uint8_t data;
-        while ((to_send < SEND_SIZE) && app_fifo_get(&m_usb_instance.tx_fifo, &data) == NRF_SUCCESS) {
-            m_tx_buffer[to_send++] = data;
+        const uint8_t* data = usb_cdc_tx_buffer_begin_transfer(&to_send);
+        if (!data) {
+            return;
         }
 
         m_usb_instance.tx_failed = 0;
         m_app_cdc_acm.specific.p_data->ctx.line_state |= APP_USBD_CDC_ACM_LINE_STATE_DTR;
-        if (app_usbd_cdc_acm_write(&m_app_cdc_acm, m_tx_buffer, to_send) == NRF_SUCCESS) {
+        if (app_usbd_cdc_acm_write(&m_app_cdc_acm, data, to_send) == NRF_SUCCESS) {
             m_usb_instance.transmitting = true;
+        } else {
+            usb_cdc_tx_buffer_cancel_transfer();
         }
         m_app_cdc_acm.specific.p_data->ctx.line_state = cache;
     }
@@ -272,6 +275,8 @@ static void cdc_acm_user_ev_handler(app_usbd_class_inst_t const * p_inst,
             break;
         }
         case APP_USBD_CDC_ACM_USER_EVT_TX_DONE: {
+            // All packets of the transfer have been sent
+            usb_cdc_tx_buffer_end_transfer();
             m_usb_instance.transmitting = false;
             m_usb_instance.tx_failed = 0;
 
@@ -336,6 +341,7 @@ static void usbd_user_ev_handler(app_usbd_event_type_t event)
             nrf_drv_usbd_ep_abort(CDC_ACM_DATA_EPIN);
             nrf_drv_usbd_ep_abort(CDC_ACM_DATA_EPOUT);
             m_usb_instance.transmitting = false;
+            usb_cdc_tx_buffer_end_transfer();
             m_usb_instance.rx_state = false;
             // Required so that we can restart rx transfers after waking up
             m_app_cdc_acm.specific.p_data->ctx.rx_transfer[0].p_buf = NULL;
@@ -479,9 +485,10 @@ int usb_uart_init(uint8_t *rx_buf, uint16_t rx_buf_size, uint8_t *tx_buf, uint16
         return -1;
     }
 
-    if (app_fifo_init(&m_usb_instance.tx_fifo, tx_buf, tx_buf_size)) {
+    if (!tx_buf || !tx_buf_size) {
         return -2;
     }
+    usb_cdc_tx_buffer_init(tx_buf, tx_buf_size, SEND_SIZE);
 
     app_usbd_class_inst_t const * class_cdc_acm = app_usbd_cdc_acm_class_inst_get(&m_app_cdc_acm);
     ret = app_usbd_class_append(class_cdc_acm);
@@ -515,14 +522,21 @@ int usb_uart_send(uint8_t data[], uint16_t size) {
         return -1;
     }
 
-    for (int i = 0; i < size; i++) {
-        // wait until tx fifo is available
-        while (IS_FIFO_FULL(&m_usb_instance.tx_fifo)) {
+    size_t written = 0;
+    for (;;) {
+        // The buffer state is shared with the USBD interrupt handler
+        int st = HAL_disable_irq();
+        written += usb_cdc_tx_buffer_write(data + written, size - written);
+        HAL_enable_irq(st);
+        if (written == size) {
+            break;
+        }
+        // wait until tx buffer is available
+        while (usb_cdc_tx_buffer_space() == 0) {
             if (!usb_hal_is_connected() || !usb_will_preempt()) {
                 return -1;
             }
         }
-        SPARK_ASSERT(app_fifo_put(&m_usb_instance.tx_fifo, data[i]) == NRF_SUCCESS);
     }
 
     // NOTE: we only care and report about how many bytes were actually put into the transmit buffer
@@ -624,14 +638,14 @@ void usb_uart_flush_tx_data(void) {
     if (!usb_will_preempt()) {
         return;
     }
-    while(usb_hal_is_connected() && FIFO_LENGTH(&m_usb_instance.tx_fifo) != 0 && m_usb_instance.transmitting) {
+    while(usb_hal_is_connected() && usb_cdc_tx_buffer_pending() != 0 && m_usb_instance.transmitting) {
         // Wait
     }
 }
 
 int usb_uart_available_tx_data(void) {
     if (usb_hal_is_connected()) {
-        return m_usb_instance.tx_fifo.buf_size_mask - FIFO_LENGTH(&m_usb_instance.tx_fifo) + 1;
+        return usb_cdc_tx_buffer_space();
     }
     return -1;
 }
@@ -36,7 +36,7 @@ bool validUserModuleInfoAtIndex(uint8_t index, module_info_t* info) {
         return false;
     }
 
-    if (!FLASH_VerifyCRC32(FLASH_INTERNAL, bounds->start_address, FLASH_ModuleLength(FLASH_INTERNAL, bounds->start_address))) {
+    if (!verify_module_crc32_cached(bounds->start_address, FLASH_ModuleLength(FLASH_INTERNAL, bounds->start_address))) {
         return false;
     }
 
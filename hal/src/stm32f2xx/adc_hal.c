@@ -236,4 +236,12 @@ int hal_adc_sleep(bool sleep, void* reserved) {
         hal_adc_dma_init();
     }
     return SYSTEM_ERROR_NONE;
-}
\ No newline at end of file
+}
+
+int hal_adc_stream_start(const hal_adc_stream_config* conf, void* reserved) {
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int hal_adc_stream_stop(void* reserved) {
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
@@ -24,6 +24,7 @@
  */
 
 #include "adc_hal.h"
+#include "system_error.h"
 
 void hal_adc_set_sample_time(uint8_t ADC_SampleTime)
 {
@@ -50,3 +51,13 @@ int hal_adc_sleep(bool sleep, void* reserved)
 {
     return 0;
 }
+
+int hal_adc_stream_start(const hal_adc_stream_config* conf, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int hal_adc_stream_stop(void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
@@ -29,3 +29,7 @@ int hal_storage_write(hal_storage_id id, uintptr_t addr, const uint8_t* buf, siz
 int hal_storage_erase(hal_storage_id id, uintptr_t addr, size_t size) {
     return SYSTEM_ERROR_NOT_FOUND;
 }
+
+int hal_storage_get_region_info(hal_storage_region_id id, hal_storage_region_info* info, void* reserved) {
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
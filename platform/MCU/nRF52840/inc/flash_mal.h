@@ -91,18 +91,24 @@ extern "C" {
 
 #    define EXTERNAL_FLASH_RESERVED_ADDRESS             (EXTERNAL_FLASH_FAC_ADDRESS + EXTERNAL_FLASH_FAC_LENGTH)
 #    define EXTERNAL_FLASH_RESERVED_XIP_ADDRESS         (EXTERNAL_FLASH_RESERVED_ADDRESS + EXTERNAL_FLASH_XIP_BASE)
-#    define EXTERNAL_FLASH_RESERVED_LENGTH              (292*1024)
+     /* Also used to back up the user firmware when updating the bootloader via MBR */
+#    define EXTERNAL_FLASH_RESERVED_LENGTH              (64*1024)
+
+     /* Read-only asset bundle, updated via OTA as a MODULE_FUNCTION_RESOURCE module */
+#    define EXTERNAL_FLASH_ASSET_ADDRESS                (EXTERNAL_FLASH_RESERVED_ADDRESS + EXTERNAL_FLASH_RESERVED_LENGTH)
+#    define EXTERNAL_FLASH_ASSET_XIP_ADDRESS            (EXTERNAL_FLASH_ASSET_ADDRESS + EXTERNAL_FLASH_XIP_BASE)
+#    define EXTERNAL_FLASH_ASSET_LENGTH                 (228*1024)
 
 #    define EXTERNAL_FLASH_OTA_LENGTH                   (1500*1024)
      /* External Flash memory address where Factory programmed core firmware is located */
      /* External Flash memory address where OTA upgraded core firmware will be saved */
-#    define EXTERNAL_FLASH_OTA_ADDRESS                  ((uint32_t)(EXTERNAL_FLASH_RESERVED_ADDRESS + EXTERNAL_FLASH_RESERVED_LENGTH))
+#    define EXTERNAL_FLASH_OTA_ADDRESS                  ((uint32_t)(EXTERNAL_FLASH_ASSET_ADDRESS + EXTERNAL_FLASH_ASSET_LENGTH))
 #    define EXTERNAL_FLASH_OTA_XIP_ADDRESS              (EXTERNAL_FLASH_OTA_ADDRESS + EXTERNAL_FLASH_XIP_BASE)
 
 #    if PLATFORM_ID == PLATFORM_TRACKER || PLATFORM_ID == PLATFORM_B5SOM
-         static_assert((EXTERNAL_FLASH_SYSTEM_STORE + EXTERNAL_FLASH_RESERVED1_LENGTH + EXTERNAL_FLASH_FAC_LENGTH + EXTERNAL_FLASH_RESERVED_LENGTH + EXTERNAL_FLASH_OTA_LENGTH) == EXTERNAL_FLASH_SIZE, "External flash size is incorrect!");
+         static_assert((EXTERNAL_FLASH_SYSTEM_STORE + EXTERNAL_FLASH_RESERVED1_LENGTH + EXTERNAL_FLASH_FAC_LENGTH + EXTERNAL_FLASH_RESERVED_LENGTH + EXTERNAL_FLASH_ASSET_LENGTH + EXTERNAL_FLASH_OTA_LENGTH) == EXTERNAL_FLASH_SIZE, "External flash size is incorrect!");
 #    else
-         static_assert((EXTERNAL_FLASH_SYSTEM_STORE + EXTERNAL_FLASH_FAC_LENGTH + EXTERNAL_FLASH_RESERVED_LENGTH + EXTERNAL_FLASH_OTA_LENGTH) == EXTERNAL_FLASH_SIZE, "External flash size is incorrect!");
+         static_assert((EXTERNAL_FLASH_SYSTEM_STORE + EXTERNAL_FLASH_FAC_LENGTH + EXTERNAL_FLASH_RESERVED_LENGTH + EXTERNAL_FLASH_ASSET_LENGTH + EXTERNAL_FLASH_OTA_LENGTH) == EXTERNAL_FLASH_SIZE, "External flash size is incorrect!");
 #    endif // PLATFORM_ID == PLATFORM_TRACKER
 #endif /* USE_SERIAL_FLASH */
 
@@ -53,6 +53,7 @@
 #define CEIL_DIV(A, B)        (((A) + (B) - 1) / (B))
 
 #define COPY_BLOCK_SIZE 256
+#define FLASH_VERIFY_CRC_BUFFER_SIZE 1024
 
 static bool flash_read(flash_device_t dev, uintptr_t addr, uint8_t* buf, size_t size) {
     bool ok = false;
@@ -880,7 +881,8 @@ bool FLASH_VerifyCRC32(uint8_t flashDeviceID, uint32_t startAddress, uint32_t le
 #ifdef USE_SERIAL_FLASH
     else if(flashDeviceID == FLASH_SERIAL && length > 0)
     {
-        uint8_t serialFlashData[4]; // FIXME: Use XIP or a larger buffer
+        // Reading in large blocks amortizes the QSPI command overhead of each read
+        uint8_t serialFlashData[FLASH_VERIFY_CRC_BUFFER_SIZE];
         hal_exflash_read((startAddress + length), serialFlashData, 4);
         uint32_t expectedCRC = (uint32_t)(serialFlashData[3] | (serialFlashData[2] << 8) | (serialFlashData[1] << 16) | (serialFlashData[0] << 24));
 
@@ -893,7 +895,9 @@ bool FLASH_VerifyCRC32(uint8_t flashDeviceID, uint32_t startAddress, uint32_t le
             if (len > sizeof(serialFlashData)) {
                 len = sizeof(serialFlashData);
             }
-            hal_exflash_read(startAddress, serialFlashData, len);
+            if (hal_exflash_read(startAddress, serialFlashData, len) != 0) {
+                return false;
+            }
 
             computedCRC = Compute_CRC32(serialFlashData, len, &computedCRC);
 
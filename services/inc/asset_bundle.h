@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "endian_util.h"
+#include "hash_util.h"
+#include "system_error.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace particle {
+
+/**
+ * Read-only asset bundle.
+ *
+ * The bundle is a contiguous image with the index in front of the data, so that an asset can be
+ * located without reading anything but the index. All integer fields are little-endian:
+ *
+ * - Header (`AssetBundleHeader`).
+ * - Index: `assetCount` entries (`AssetBundleEntry`) sorted by the name hash.
+ * - String table: asset names, not null-terminated.
+ * - Asset data: each asset is aligned on a 4-byte boundary.
+ *
+ * Bundles are generated by `build/pack_assets.py`.
+ */
+const uint32_t ASSET_BUNDLE_MAGIC = 0x31424150; // "PAB1"
+const uint16_t ASSET_BUNDLE_VERSION = 1;
+
+struct __attribute__((packed)) AssetBundleHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize; // Size of this structure
+    uint32_t assetCount;
+    uint32_t indexSize; // Size of the header, index and string table
+    uint32_t totalSize; // Size of the bundle
+};
+
+struct __attribute__((packed)) AssetBundleEntry {
+    uint32_t nameHash;
+    uint32_t nameOffset; // Relative to the start of the bundle
+    uint32_t dataOffset; // Relative to the start of the bundle
+    uint32_t dataSize;
+    uint16_t nameSize;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(AssetBundleHeader) == 20, "Invalid size of AssetBundleHeader");
+static_assert(sizeof(AssetBundleEntry) == 20, "Invalid size of AssetBundleEntry");
+
+/**
+ * Location of an asset in storage.
+ *
+ * The data is not copied anywhere: it can be read directly from the storage at the given address,
+ * or accessed via memory mapping if the storage supports it.
+ */
+struct AssetHandle {
+    uintptr_t address;
+    size_t size;
+};
+
+/**
+ * Reader for asset bundles.
+ *
+ * The reader keeps no copy of the index: a lookup is a binary search that reads individual index
+ * entries from storage.
+ */
+class AssetBundleReader {
+public:
+    /**
+     * Storage read function. Returns a negative result code in case of an error.
+     */
+    typedef int (*ReadFn)(uintptr_t addr, uint8_t* buf, size_t size);
+
+    AssetBundleReader() :
+            read_(nullptr),
+            addr_(0),
+            headerSize_(0),
+            count_(0),
+            indexSize_(0),
+            totalSize_(0) {
+    }
+
+    /**
+     * Validates the bundle header.
+     *
+     * @param addr Start address of the bundle.
+     * @param maxSize Size of the storage region containing the bundle.
+     * @param read Storage read function.
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int init(uintptr_t addr, size_t maxSize, ReadFn read) {
+        read_ = nullptr;
+        AssetBundleHeader h = {};
+        if (maxSize < sizeof(h)) {
+            return SYSTEM_ERROR_NOT_FOUND;
+        }
+        int r = read(addr, (uint8_t*)&h, sizeof(h));
+        if (r < 0) {
+            return r;
+        }
+        if (littleEndianToNative(h.magic) != ASSET_BUNDLE_MAGIC) {
+            return SYSTEM_ERROR_NOT_FOUND;
+        }
+        const size_t headerSize = littleEndianToNative(h.headerSize);
+        const size_t count = littleEndianToNative(h.assetCount);
+        const size_t indexSize = littleEndianToNative(h.indexSize);
+        const size_t totalSize = littleEndianToNative(h.totalSize);
+        if (littleEndianToNative(h.version) != ASSET_BUNDLE_VERSION || headerSize < sizeof(h) ||
+                headerSize > maxSize || count > (maxSize - headerSize) / sizeof(AssetBundleEntry) ||
+                indexSize < headerSize + count * sizeof(AssetBundleEntry) || indexSize > totalSize ||
+                totalSize > maxSize) {
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        read_ = read;
+        addr_ = addr;
+        headerSize_ = headerSize;
+        count_ = count;
+        indexSize_ = indexSize;
+        totalSize_ = totalSize;
+        return 0;
+    }
+
+    /**
+     * Finds an asset by name.
+     *
+     * @param name Asset name.
+     * @param[out] handle Asset location.
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int find(const char* name, AssetHandle* handle) const {
+        return find(name, strlen(name), handle);
+    }
+
+    int find(const char* name, size_t nameSize, AssetHandle* handle) const {
+        if (!read_) {
+            return SYSTEM_ERROR_INVALID_STATE;
+        }
+        const uint32_t hash = nameHash(name, nameSize);
+        // Find the first entry with a matching hash
+        size_t first = 0;
+        size_t last = count_;
+        while (first < last) {
+            const size_t i = first + (last - first) / 2;
+            uint32_t h = 0;
+            int r = read_(entryAddress(i), (uint8_t*)&h, sizeof(h));
+            if (r < 0) {
+                return r;
+            }
+            if (littleEndianToNative(h) < hash) {
+                first = i + 1;
+            } else {
+                last = i;
+            }
+        }
+        for (size_t i = first; i < count_; ++i) {
+            AssetBundleEntry e = {};
+            int r = readEntry(i, &e);
+            if (r < 0) {
+                return r;
+            }
+            if (e.nameHash != hash) {
+                break;
+            }
+            if (e.nameSize != nameSize) {
+                continue;
+            }
+            r = compareName(e, name);
+            if (r < 0) {
+                return r;
+            }
+            if (r > 0) {
+                if (handle) {
+                    handle->address = addr_ + e.dataOffset;
+                    handle->size = e.dataSize;
+                }
+                return 0;
+            }
+        }
+        return SYSTEM_ERROR_NOT_FOUND;
+    }
+
+    /**
+     * Gets an asset by its position in the index.
+     *
+     * @param index Asset index.
+     * @param[out] handle Asset location.
+     * @param[out] name Buffer for the asset name. The name is truncated and null-terminated if
+     *        the buffer is too small.
+     * @param nameSize Size of the name buffer.
+     * @return Length of the asset name, or a negative result code in case of an error.
+     */
+    int get(size_t index, AssetHandle* handle, char* name = nullptr, size_t nameSize = 0) const {
+        if (!read_) {
+            return SYSTEM_ERROR_INVALID_STATE;
+        }
+        if (index >= count_) {
+            return SYSTEM_ERROR_OUT_OF_RANGE;
+        }
+        AssetBundleEntry e = {};
+        int r = readEntry(index, &e);
+        if (r < 0) {
+            return r;
+        }
+        if (name && nameSize > 0) {
+            const size_t n = (e.nameSize < nameSize) ? e.nameSize : nameSize - 1;
+            r = read_(addr_ + e.nameOffset, (uint8_t*)name, n);
+            if (r < 0) {
+                return r;
+            }
+            name[n] = '\0';
+        }
+        if (handle) {
+            handle->address = addr_ + e.dataOffset;
+            handle->size = e.dataSize;
+        }
+        return e.nameSize;
+    }
+
+    size_t count() const {
+        return count_;
+    }
+
+    size_t size() const {
+        return totalSize_;
+    }
+
+    bool isValid() const {
+        return read_;
+    }
+
+    /**
+     * Computes a hash of the asset name (FNV-1a).
+     */
+    static uint32_t nameHash(const char* name, size_t size) {
+        return fnv1a_update(FNV1A_INIT, name, size);
+    }
+
+private:
+    ReadFn read_;
+    uintptr_t addr_;
+    size_t headerSize_;
+    size_t count_;
+    size_t indexSize_;
+    size_t totalSize_;
+
+    uintptr_t entryAddress(size_t index) const {
+        return addr_ + headerSize_ + index * sizeof(AssetBundleEntry);
+    }
+
+    int readEntry(size_t index, AssetBundleEntry* e) const {
+        int r = read_(entryAddress(index), (uint8_t*)e, sizeof(AssetBundleEntry));
+        if (r < 0) {
+            return r;
+        }
+        e->nameHash = littleEndianToNative(e->nameHash);
+        e->nameOffset = littleEndianToNative(e->nameOffset);
+        e->dataOffset = littleEndianToNative(e->dataOffset);
+        e->dataSize = littleEndianToNative(e->dataSize);
+        e->nameSize = littleEndianToNative(e->nameSize);
+        if (e->nameOffset > indexSize_ || e->nameSize > indexSize_ - e->nameOffset ||
+                e->dataOffset < indexSize_ || e->dataOffset > totalSize_ || e->dataSize > totalSize_ - e->dataOffset) {
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        return 0;
+    }
+
+    // Returns 1 if the names match, 0 if they don't, or a negative result code in case of an error
+    int compareName(const AssetBundleEntry& e, const char* name) const {
+        uint8_t buf[32];
+        size_t offs = 0;
+        while (offs < e.nameSize) {
+            size_t n = e.nameSize - offs;
+            if (n > sizeof(buf)) {
+                n = sizeof(buf);
+            }
+            int r = read_(addr_ + e.nameOffset + offs, buf, n);
+            if (r < 0) {
+                return r;
+            }
+            if (memcmp(buf, name + offs, n) != 0) {
+                return 0;
+            }
+            offs += n;
+        }
+        return 1;
+    }
+};
+
+} // namespace particle
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Computes the CRC-32 (IEEE 802.3) of a buffer.
+ *
+ * The checksum of a large block of data can be computed in chunks by passing the result of the
+ * previous call as `crc`. Pass 0 for the first chunk.
+ *
+ * The implementation processes 8 bytes at a time using the slicing-by-8 algorithm, except in the
+ * bootloader, which uses the byte-at-a-time algorithm to save flash space.
+ */
+uint32_t crc32_update(uint32_t crc, const void* data, size_t size);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
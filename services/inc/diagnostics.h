@@ -58,6 +58,12 @@
 #define DIAG_NAME_CLOUD_TRANSMITTED_MESSAGES "coap:transmit"
 #define DIAG_NAME_CLOUD_COAP_ROUND_TRIP "coap:roundtrip"
 #define DIAG_NAME_CLOUD_RATE_LIMITED_EVENTS "pub:limit"
+#define DIAG_NAME_CLOUD_PIGGYBACKED_RESPONSES "coap:piggyback"
+#define DIAG_NAME_NETWORK_DNS_CACHE_HITS "net:dns:hit"
+#define DIAG_NAME_NETWORK_DNS_CACHE_MISSES "net:dns:miss"
+#define DIAG_NAME_NETWORK_DNS_CACHE_SIZE "net:dns:size"
+#define DIAG_NAME_CLOUD_CONNECTION_TIME "cloud:conntime"
+#define DIAG_NAME_CLOUD_WARM_RECONNECTS "cloud:warmconn"
 #define DIAG_NAME_SYSTEM_TOTAL_RAM "sys:tram"
 #define DIAG_NAME_SYSTEM_USED_RAM "sys:uram"
 
@@ -95,11 +101,16 @@ typedef enum diag_id {
     DIAG_ID_NETWORK_CELLULAR_CELL_GLOBAL_IDENTITY_MOBILE_NETWORK_CODE = 41, // net:cell:cgi:mnc
     DIAG_ID_NETWORK_CELLULAR_CELL_GLOBAL_IDENTITY_LOCATION_AREA_CODE = 42, // net:cell:cgi:lac
     DIAG_ID_NETWORK_CELLULAR_CELL_GLOBAL_IDENTITY_CELL_ID = 43, // net:cell:cgi:ci
+    DIAG_ID_NETWORK_DNS_CACHE_HITS = 45, // net:dns:hit
+    DIAG_ID_NETWORK_DNS_CACHE_MISSES = 46, // net:dns:miss
+    DIAG_ID_NETWORK_DNS_CACHE_SIZE = 47, // net:dns:size
     DIAG_ID_CLOUD_CONNECTION_STATUS = 10, // cloud:stat
     DIAG_ID_CLOUD_CONNECTION_ERROR_CODE = 13, // cloud:err
     DIAG_ID_CLOUD_DISCONNECTS = 14, // cloud:dconn
     DIAG_ID_CLOUD_CONNECTION_ATTEMPTS = 29, // cloud:connatt
     DIAG_ID_CLOUD_DISCONNECTION_REASON = 30, // cloud:dconnrsn
+    DIAG_ID_CLOUD_CONNECTION_TIME = 48, // cloud:conntime
+    DIAG_ID_CLOUD_WARM_RECONNECTS = 49, // cloud:warmconn
     DIAG_ID_CLOUD_RETRANSMITTED_MESSAGES = 21, // coap:retransmit
     DIAG_ID_CLOUD_UNACKNOWLEDGED_MESSAGES = 22, // coap:unack
     DIAG_ID_CLOUD_TRANSMITTED_MESSAGES = 23, // coap:transmit
@@ -107,6 +118,7 @@ typedef enum diag_id {
     DIAG_ID_SYSTEM_TOTAL_RAM = 25, // sys:tram
     DIAG_ID_SYSTEM_USED_RAM = 26, // sys:uram
     DIAG_ID_CLOUD_COAP_ROUND_TRIP = 31, // coap:roundtrip
+    DIAG_ID_CLOUD_PIGGYBACKED_RESPONSES = 44, // coap:piggyback
     DIAG_ID_USER = 32768 // Base value for application-specific source IDs
 } diag_id;
 
@@ -149,6 +161,14 @@ typedef struct diag_source_get_cmd_data {
     size_t data_size; // Buffer size
 } diag_source_get_cmd_data;
 
+// Value of an integer data source
+typedef struct diag_value {
+    uint16_t id; // Source ID
+    uint16_t type; // Data type
+    int32_t value; // Current value. Unsigned values are stored as is
+    int error; // Result code returned by the data source
+} diag_value;
+
 // Registers a new data source. Note that in order for the data source to be registered, the service
 // needs to be in its initial stopped state
 int diag_register_source(const diag_source* src, void* reserved);
@@ -161,6 +181,11 @@ int diag_enum_sources(diag_enum_sources_callback callback, size_t* count, void*
 // is not started
 int diag_get_source(uint16_t id, const diag_source** src, void* reserved);
 
+// Reads the values of all integer data sources in one pass. The `total` argument receives the
+// number of integer data sources, which can be greater than `count`. This function returns an error
+// if the service is not started
+int diag_snapshot(diag_value* values, size_t count, size_t* total, void* reserved);
+
 // Issues a service command
 int diag_command(int cmd, void* data, void* reserved);
 
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Initial value of the FNV-1a hash.
+ */
+#define FNV1A_INIT ((uint32_t)2166136261u)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Computes the 32-bit FNV-1a hash of a buffer.
+ *
+ * The hash of several buffers can be computed by passing the result of the previous call as
+ * `hash`. Pass `FNV1A_INIT` for the first buffer.
+ *
+ * The hash is fast to compute and is meant for lookup tables. It's not suitable for detecting
+ * data corruption; use `crc32_update()` for that.
+ */
+static inline uint32_t fnv1a_update(uint32_t hash, const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <type_traits>
+#include <utility>
+#include <new>
+#include <cstddef>
+
+namespace particle {
+
+template<typename SignatureT, size_t Capacity = sizeof(void*) * 3>
+class InplaceFunction;
+
+/**
+ * A `std::function`-like wrapper that stores the callable object in an internal buffer.
+ *
+ * The wrapper never allocates memory. Callables that don't fit into the buffer are rejected at
+ * compile time.
+ */
+template<typename R, typename... ArgsT, size_t Capacity>
+class InplaceFunction<R(ArgsT...), Capacity> {
+public:
+    static const size_t CAPACITY = Capacity;
+
+    InplaceFunction() :
+            ops_(nullptr) {
+    }
+
+    InplaceFunction(std::nullptr_t) :
+            InplaceFunction() {
+    }
+
+    template<typename F, typename FnT = typename std::decay<F>::type,
+            typename = typename std::enable_if<!std::is_same<FnT, InplaceFunction>::value>::type>
+    InplaceFunction(F&& fn) :
+            InplaceFunction() {
+        assign<FnT>(std::forward<F>(fn));
+    }
+
+    InplaceFunction(const InplaceFunction& fn) :
+            ops_(fn.ops_) {
+        if (ops_) {
+            ops_->copy(&buf_, &fn.buf_);
+        }
+    }
+
+    InplaceFunction(InplaceFunction&& fn) :
+            ops_(fn.ops_) {
+        if (ops_) {
+            ops_->move(&buf_, &fn.buf_);
+            fn.ops_ = nullptr;
+        }
+    }
+
+    ~InplaceFunction() {
+        reset();
+    }
+
+    R operator()(ArgsT... args) const {
+        return ops_->invoke(&buf_, std::forward<ArgsT>(args)...);
+    }
+
+    InplaceFunction& operator=(const InplaceFunction& fn) {
+        if (this != &fn) {
+            reset();
+            if (fn.ops_) {
+                fn.ops_->copy(&buf_, &fn.buf_);
+                ops_ = fn.ops_;
+            }
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& fn) {
+        if (this != &fn) {
+            reset();
+            if (fn.ops_) {
+                fn.ops_->move(&buf_, &fn.buf_);
+                ops_ = fn.ops_;
+                fn.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(std::nullptr_t) {
+        reset();
+        return *this;
+    }
+
+    template<typename F, typename FnT = typename std::decay<F>::type,
+            typename = typename std::enable_if<!std::is_same<FnT, InplaceFunction>::value>::type>
+    InplaceFunction& operator=(F&& fn) {
+        reset();
+        assign<FnT>(std::forward<F>(fn));
+        return *this;
+    }
+
+    explicit operator bool() const {
+        return ops_;
+    }
+
+private:
+    typedef typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type Storage;
+
+    struct Ops {
+        R(*invoke)(const void* fn, ArgsT&&... args);
+        void(*copy)(void* dest, const void* src);
+        void(*move)(void* dest, void* src); // Destroys the source object
+        void(*destroy)(void* fn);
+    };
+
+    template<typename FnT>
+    struct OpsImpl {
+        static R invoke(const void* fn, ArgsT&&... args) {
+            // The stored object is mutable, as with std::function
+            return (*const_cast<FnT*>(static_cast<const FnT*>(fn)))(std::forward<ArgsT>(args)...);
+        }
+
+        static void copy(void* dest, const void* src) {
+            new(dest) FnT(*static_cast<const FnT*>(src));
+        }
+
+        static void move(void* dest, void* src) {
+            new(dest) FnT(std::move(*static_cast<FnT*>(src)));
+            static_cast<FnT*>(src)->~FnT();
+        }
+
+        static void destroy(void* fn) {
+            static_cast<FnT*>(fn)->~FnT();
+        }
+
+        static const Ops OPS;
+    };
+
+    Storage buf_;
+    const Ops* ops_;
+
+    template<typename FnT, typename F>
+    void assign(F&& fn) {
+        static_assert(sizeof(FnT) <= Capacity, "Callable object is too large");
+        static_assert(alignof(FnT) <= alignof(Storage), "Callable object has unsupported alignment");
+        if (!isNull(fn)) {
+            new(&buf_) FnT(std::forward<F>(fn));
+            ops_ = &OpsImpl<FnT>::OPS;
+        }
+    }
+
+    void reset() {
+        if (ops_) {
+            // Clear the pointer first in case the destructor of the callable resets this function
+            const auto ops = ops_;
+            ops_ = nullptr;
+            ops->destroy(&buf_);
+        }
+    }
+
+    template<typename T>
+    static bool isNull(T* ptr) {
+        return !ptr;
+    }
+
+    template<typename T, typename C>
+    static bool isNull(T C::* ptr) {
+        return !ptr;
+    }
+
+    template<typename T>
+    static bool isNull(const T&) {
+        return false;
+    }
+};
+
+template<typename R, typename... ArgsT, size_t Capacity>
+const size_t InplaceFunction<R(ArgsT...), Capacity>::CAPACITY;
+
+template<typename R, typename... ArgsT, size_t Capacity>
+template<typename FnT>
+const typename InplaceFunction<R(ArgsT...), Capacity>::Ops InplaceFunction<R(ArgsT...), Capacity>::OpsImpl<FnT>::OPS = {
+    &OpsImpl<FnT>::invoke,
+    &OpsImpl<FnT>::copy,
+    &OpsImpl<FnT>::move,
+    &OpsImpl<FnT>::destroy
+};
+
+} // namespace particle
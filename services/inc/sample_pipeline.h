@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace particle {
+
+/**
+ * Filtering and decimation of interleaved multi-channel samples.
+ *
+ * Each channel is processed independently. If filter coefficients are provided, every N-th output
+ * of an FIR filter is kept, where N is the decimation factor; the filter is only evaluated for the
+ * samples that are kept. Otherwise, every N input samples are averaged.
+ *
+ * The pipeline doesn't depend on the ADC hardware and can process blocks of any size. The state
+ * of the filters is carried over between the blocks.
+ */
+class SamplePipeline {
+public:
+    static const size_t MAX_CHANNELS = 8;
+    static const size_t MAX_FILTER_TAPS = 64;
+    static const unsigned MAX_DECIMATION = 1024;
+    // Number of fractional bits in the filter coefficients (Q15)
+    static const unsigned FILTER_COEFF_FRAC_BITS = 15;
+
+    SamplePipeline();
+
+    /**
+     * Initializes the pipeline.
+     *
+     * @param channelCount Number of channels.
+     * @param decimation Decimation factor.
+     * @param coeffs FIR filter coefficients in the Q15 format, or `nullptr`.
+     * @param tapCount Number of filter coefficients.
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int init(size_t channelCount, unsigned decimation = 1, const int16_t* coeffs = nullptr, size_t tapCount = 0);
+
+    /**
+     * Processes a block of samples.
+     *
+     * `in` and `out` may point to the same buffer.
+     *
+     * @param in Interleaved input samples.
+     * @param count Number of input samples. Must be a multiple of the number of channels.
+     * @param out Buffer for the interleaved output samples. The buffer needs to be large enough to
+     *        store `count / decimation + channelCount` samples.
+     * @return Number of output samples.
+     */
+    size_t process(const int16_t* in, size_t count, int16_t* out);
+
+    /**
+     * Returns the maximum number of output samples for a block of the given size.
+     */
+    size_t maxOutputSize(size_t count) const {
+        return count / decimation_ + channelCount_;
+    }
+
+    /**
+     * Resets the state of the filters.
+     */
+    void reset();
+
+    size_t channelCount() const {
+        return channelCount_;
+    }
+
+    unsigned decimation() const {
+        return decimation_;
+    }
+
+    // This class is non-copyable
+    SamplePipeline(const SamplePipeline&) = delete;
+    SamplePipeline& operator=(const SamplePipeline&) = delete;
+
+private:
+    struct Channel {
+        int32_t sum; // Sum of the input samples since the last output sample
+        unsigned pos; // Index of the oldest sample in the filter history
+    };
+
+    Channel channels_[MAX_CHANNELS];
+    std::unique_ptr<int16_t[]> coeffs_;
+    std::unique_ptr<int16_t[]> history_; // Filter history of each channel
+    size_t channelCount_;
+    size_t tapCount_;
+    unsigned decimation_;
+    unsigned phase_; // Number of input samples per channel since the last output sample
+
+    int16_t filter(size_t channel) const;
+};
+
+} // namespace particle
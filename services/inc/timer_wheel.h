@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "system_tick_hal.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace particle {
+
+/**
+ * Hierarchical timing wheel.
+ *
+ * The wheel consists of `LEVEL_COUNT` levels of `SLOT_COUNT` slots each. A slot at level N covers
+ * `SLOT_COUNT^N` ticks. Entries that are due further in the future are stored at higher levels and
+ * are moved to lower levels as the time advances. Adding and removing an entry takes constant
+ * time; advancing the time skips empty slots with the help of a per-level occupancy bitmap.
+ *
+ * Entries are intrusive and are never allocated or copied by the wheel. The wheel is not
+ * thread-safe.
+ */
+class TimerWheel {
+public:
+    static const unsigned LEVEL_BITS = 6;
+    static const unsigned SLOT_COUNT = 1 << LEVEL_BITS;
+    static const unsigned LEVEL_COUNT = 4;
+    // Maximum number of ticks an entry can be scheduled ahead without being rescheduled
+    static const system_tick_t MAX_DELAY = ((system_tick_t)1 << (LEVEL_BITS * LEVEL_COUNT)) - 1;
+
+    struct Entry {
+        Entry* next;
+        Entry** pprev; // Pointer to the `next` field of the previous entry, or to the list head
+        system_tick_t expiry;
+
+        Entry() :
+                next(nullptr),
+                pprev(nullptr),
+                expiry(0) {
+        }
+    };
+
+    /**
+     * Constructs a wheel.
+     *
+     * @param now Current time in ticks.
+     */
+    explicit TimerWheel(system_tick_t now = 0);
+
+    /**
+     * Schedules an entry.
+     *
+     * If the entry is already scheduled, it's rescheduled. An entry that is due at or before the
+     * current time expires on the next tick.
+     *
+     * @param entry Entry.
+     * @param expiry Expiration time in ticks.
+     */
+    void add(Entry* entry, system_tick_t expiry);
+
+    /**
+     * Cancels an entry. Does nothing if the entry is not scheduled.
+     */
+    void remove(Entry* entry);
+
+    /**
+     * Advances the time and returns an expired entry.
+     *
+     * The returned entry is no longer scheduled. Entries are returned in the order of their
+     * expiration times, rounded to a tick. Entries that are due at the same tick are returned in
+     * an unspecified order.
+     *
+     * @param now Current time in ticks.
+     * @return Expired entry or `nullptr` if there are no expired entries.
+     */
+    Entry* pop(system_tick_t now);
+
+    /**
+     * Returns the time at which `pop()` needs to be called next.
+     *
+     * The returned time is never later than the expiration time of any scheduled entry, but may be
+     * earlier if the entries need to be moved between the levels of the wheel.
+     *
+     * @param time Time in ticks.
+     * @return `false` if there are no scheduled entries.
+     */
+    bool nextExpiry(system_tick_t* time) const;
+
+    /**
+     * Returns `true` if the entry is scheduled.
+     */
+    static bool isScheduled(const Entry* entry) {
+        return entry->pprev;
+    }
+
+    /**
+     * Returns the number of scheduled entries.
+     */
+    size_t size() const {
+        return count_;
+    }
+
+    /**
+     * Returns the time up to which the wheel has been advanced.
+     */
+    system_tick_t time() const {
+        return time_;
+    }
+
+private:
+    Entry* slots_[LEVEL_COUNT][SLOT_COUNT];
+    uint64_t occupied_[LEVEL_COUNT];
+    Entry* expired_; // Expired entries that have not been returned yet
+    system_tick_t time_;
+    size_t count_;
+
+    void insert(Entry* entry, system_tick_t minDelay);
+    void advance(system_tick_t now);
+    void cascade(unsigned level);
+    void link(Entry** head, Entry* entry);
+    void unlink(Entry* entry);
+};
+
+} // namespace particle
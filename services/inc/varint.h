@@ -111,4 +111,22 @@ constexpr size_t maxUnsignedVarintSize() {
     return (sizeof(T) * 8 + 6) / 7;
 }
 
+/**
+ * Map a signed integer to an unsigned one so that values with a small absolute value have a small
+ * varint encoding.
+ *
+ * The zigzag format is described here:
+ * https://developers.google.com/protocol-buffers/docs/encoding#signed-integers
+ */
+inline uint32_t encodeZigZag(int32_t val) {
+    return ((uint32_t)val << 1) ^ (uint32_t)(val >> 31);
+}
+
+/**
+ * Reverse the mapping performed by `encodeZigZag()`.
+ */
+inline int32_t decodeZigZag(uint32_t val) {
+    return (int32_t)((val >> 1) ^ (~(val & 1) + 1));
+}
+
 } // particle
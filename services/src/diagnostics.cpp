@@ -22,11 +22,15 @@
 #include "system_error.h"
 
 #include <algorithm>
+#include <memory>
 
 namespace {
 
 using namespace spark;
 
+// Maximum size of the table mapping IDs of the system data sources to their indices
+const unsigned MAX_LOOKUP_TABLE_SIZE = 256;
+
 class Diagnostics {
 public:
     int registerSource(const diag_source* src) {
@@ -65,8 +69,8 @@ public:
         if (!started_) {
             return SYSTEM_ERROR_INVALID_STATE;
         }
-        const int index = indexForId(id);
-        if (index >= srcs_.size() || srcs_.at(index)->id != id) {
+        const int index = findIndex(id);
+        if (index < 0) {
             return SYSTEM_ERROR_NOT_FOUND;
         }
         if (src) {
@@ -75,16 +79,50 @@ public:
         return SYSTEM_ERROR_NONE;
     }
 
+    int snapshot(diag_value* values, size_t count, size_t* total) {
+        if (!started_) {
+            return SYSTEM_ERROR_INVALID_STATE;
+        }
+        // The registry can't be modified once the service is started, so it's safe to access it
+        // without locking
+        size_t n = 0;
+        for (const diag_source* src: srcs_) {
+            if (src->type != DIAG_TYPE_INT && src->type != DIAG_TYPE_UINT) {
+                continue;
+            }
+            if (n < count) {
+                diag_value& v = values[n];
+                v.id = src->id;
+                v.type = src->type;
+                v.value = 0;
+                // Both types are 32-bit integers
+                diag_source_get_cmd_data d = { sizeof(diag_source_get_cmd_data), 0 /* reserved */, &v.value,
+                        sizeof(v.value) };
+                v.error = src->callback(src, DIAG_SOURCE_CMD_GET, &d);
+            }
+            ++n;
+        }
+        if (total) {
+            *total = n;
+        }
+        return SYSTEM_ERROR_NONE;
+    }
+
     int command(int cmd, void* data) {
         switch (cmd) {
 #if PLATFORM_ID == 3
         case DIAG_SERVICE_CMD_RESET:
             srcs_.clear();
+            lookup_.reset();
+            lookupSize_ = 0;
             started_ = 0;
             break;
 #endif
         case DIAG_SERVICE_CMD_START:
-            started_ = 1;
+            if (!started_) {
+                freeze();
+                started_ = 1;
+            }
             break;
         default:
             return SYSTEM_ERROR_NOT_SUPPORTED;
@@ -98,14 +136,55 @@ public:
     }
 
 private:
-    Vector<const diag_source*> srcs_;
+    Vector<const diag_source*> srcs_; // Sorted by ID
+    std::unique_ptr<uint8_t[]> lookup_; // Indices of the system data sources plus one
+    unsigned lookupSize_;
     volatile uint8_t started_;
 
     Diagnostics() :
+            lookupSize_(0),
             started_(0) { // The service is stopped initially
         srcs_.reserve(32);
     }
 
+    // Compacts the registry and builds a lookup table for the system data sources, whose IDs are
+    // allocated sequentially
+    void freeze() {
+        srcs_.trimToSize();
+        if (srcs_.isEmpty() || srcs_.size() >= 0xff) {
+            return;
+        }
+        unsigned size = 0;
+        for (const diag_source* src: srcs_) {
+            if (src->id >= MAX_LOOKUP_TABLE_SIZE) {
+                break;
+            }
+            size = src->id + 1;
+        }
+        if (!size) {
+            return;
+        }
+        lookup_.reset(new(std::nothrow) uint8_t[size]());
+        if (!lookup_) {
+            return; // Fall back to binary search
+        }
+        for (int i = 0; i < srcs_.size() && srcs_.at(i)->id < size; ++i) {
+            lookup_[srcs_.at(i)->id] = i + 1;
+        }
+        lookupSize_ = size;
+    }
+
+    int findIndex(uint16_t id) const {
+        if (id < lookupSize_) {
+            return (int)lookup_[id] - 1;
+        }
+        const int index = indexForId(id);
+        if (index >= srcs_.size() || srcs_.at(index)->id != id) {
+            return -1;
+        }
+        return index;
+    }
+
     int indexForId(uint16_t id) const {
         return std::distance(srcs_.begin(), std::lower_bound(srcs_.begin(), srcs_.end(), id,
                 [](const diag_source* src, uint16_t id) {
@@ -128,6 +207,10 @@ int diag_get_source(uint16_t id, const diag_source** src, void* reserved) {
     return Diagnostics::instance()->getSource(id, src);
 }
 
+int diag_snapshot(diag_value* values, size_t count, size_t* total, void* reserved) {
+    return Diagnostics::instance()->snapshot(values, count, total);
+}
+
 int diag_command(int cmd, void* data, void* reserved) {
     return Diagnostics::instance()->command(cmd, data);
 }
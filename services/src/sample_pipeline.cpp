@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sample_pipeline.h"
+
+#include "system_error.h"
+#include "check.h"
+
+#include <cstring>
+
+namespace particle {
+
+namespace {
+
+inline int16_t saturate(int64_t val) {
+    if (val > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (val < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return val;
+}
+
+// Divides with rounding to the nearest integer
+inline int32_t divRound(int32_t val, int32_t div) {
+    return (val >= 0) ? (val + div / 2) / div : (val - div / 2) / div;
+}
+
+} // namespace
+
+const size_t SamplePipeline::MAX_CHANNELS;
+const size_t SamplePipeline::MAX_FILTER_TAPS;
+const unsigned SamplePipeline::MAX_DECIMATION;
+const unsigned SamplePipeline::FILTER_COEFF_FRAC_BITS;
+
+SamplePipeline::SamplePipeline() :
+        channels_(),
+        channelCount_(0),
+        tapCount_(0),
+        decimation_(1),
+        phase_(0) {
+}
+
+int SamplePipeline::init(size_t channelCount, unsigned decimation, const int16_t* coeffs, size_t tapCount) {
+    CHECK_TRUE(channelCount > 0 && channelCount <= MAX_CHANNELS, SYSTEM_ERROR_INVALID_ARGUMENT);
+    CHECK_TRUE(decimation > 0 && decimation <= MAX_DECIMATION, SYSTEM_ERROR_INVALID_ARGUMENT);
+    CHECK_TRUE(tapCount <= MAX_FILTER_TAPS && (coeffs || !tapCount), SYSTEM_ERROR_INVALID_ARGUMENT);
+    std::unique_ptr<int16_t[]> c;
+    std::unique_ptr<int16_t[]> h;
+    if (tapCount > 0) {
+        c.reset(new(std::nothrow) int16_t[tapCount]);
+        h.reset(new(std::nothrow) int16_t[tapCount * channelCount]);
+        CHECK_TRUE(c && h, SYSTEM_ERROR_NO_MEMORY);
+        memcpy(c.get(), coeffs, tapCount * sizeof(int16_t));
+    }
+    coeffs_ = std::move(c);
+    history_ = std::move(h);
+    channelCount_ = channelCount;
+    tapCount_ = tapCount;
+    decimation_ = decimation;
+    reset();
+    return 0;
+}
+
+size_t SamplePipeline::process(const int16_t* in, size_t count, int16_t* out) {
+    size_t n = 0;
+    for (size_t i = 0; i + channelCount_ <= count; i += channelCount_) {
+        const bool emit = (++phase_ == decimation_);
+        for (size_t j = 0; j < channelCount_; ++j) {
+            // The output index never exceeds the input index, so the samples can be processed in place
+            const int16_t x = in[i + j];
+            Channel& ch = channels_[j];
+            if (tapCount_ > 0) {
+                history_[j * tapCount_ + ch.pos] = x;
+                if (++ch.pos == tapCount_) {
+                    ch.pos = 0;
+                }
+                if (emit) {
+                    out[n++] = filter(j);
+                }
+            } else {
+                ch.sum += x;
+                if (emit) {
+                    out[n++] = divRound(ch.sum, decimation_);
+                    ch.sum = 0;
+                }
+            }
+        }
+        if (emit) {
+            phase_ = 0;
+        }
+    }
+    return n;
+}
+
+void SamplePipeline::reset() {
+    for (size_t i = 0; i < MAX_CHANNELS; ++i) {
+        channels_[i].sum = 0;
+        channels_[i].pos = 0;
+    }
+    if (history_) {
+        memset(history_.get(), 0, tapCount_ * channelCount_ * sizeof(int16_t));
+    }
+    phase_ = 0;
+}
+
+int16_t SamplePipeline::filter(size_t channel) const {
+    const int16_t* const h = history_.get() + channel * tapCount_;
+    const unsigned pos = channels_[channel].pos;
+    // The most recent sample is multiplied by the first coefficient
+    int64_t acc = 0;
+    size_t k = 0;
+    for (size_t i = pos; i > 0; --i) {
+        acc += (int32_t)coeffs_[k++] * h[i - 1];
+    }
+    for (size_t i = tapCount_; i > pos; --i) {
+        acc += (int32_t)coeffs_[k++] * h[i - 1];
+    }
+    return saturate((acc + (1 << (FILTER_COEFF_FRAC_BITS - 1))) >> FILTER_COEFF_FRAC_BITS);
+}
+
+} // namespace particle
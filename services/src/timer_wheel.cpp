@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "timer_wheel.h"
+
+#include <cstring>
+
+namespace particle {
+
+namespace {
+
+const unsigned SLOT_MASK = TimerWheel::SLOT_COUNT - 1;
+
+inline uint64_t rotateRight(uint64_t val, unsigned n) {
+    n &= 63;
+    return n ? (val >> n) | (val << (64 - n)) : val;
+}
+
+} // namespace
+
+const unsigned TimerWheel::LEVEL_BITS;
+const unsigned TimerWheel::SLOT_COUNT;
+const unsigned TimerWheel::LEVEL_COUNT;
+const system_tick_t TimerWheel::MAX_DELAY;
+
+TimerWheel::TimerWheel(system_tick_t now) :
+        expired_(nullptr),
+        time_(now),
+        count_(0) {
+    memset(slots_, 0, sizeof(slots_));
+    memset(occupied_, 0, sizeof(occupied_));
+}
+
+void TimerWheel::add(Entry* entry, system_tick_t expiry) {
+    if (isScheduled(entry)) {
+        unlink(entry);
+    }
+    entry->expiry = expiry;
+    insert(entry, 1 /* minDelay */);
+    ++count_;
+}
+
+void TimerWheel::remove(Entry* entry) {
+    if (isScheduled(entry)) {
+        unlink(entry);
+    }
+}
+
+TimerWheel::Entry* TimerWheel::pop(system_tick_t now) {
+    if (!expired_) {
+        advance(now);
+    }
+    const auto entry = expired_;
+    if (entry) {
+        unlink(entry);
+    }
+    return entry;
+}
+
+bool TimerWheel::nextExpiry(system_tick_t* time) const {
+    if (expired_) {
+        *time = time_;
+        return true;
+    }
+    if (!count_) {
+        return false;
+    }
+    system_tick_t minDelay = 0;
+    for (unsigned level = 0; level < LEVEL_COUNT; ++level) {
+        if (!occupied_[level]) {
+            continue;
+        }
+        // Number of slots between the current slot and the next occupied slot at this level
+        const unsigned shift = level * LEVEL_BITS;
+        const unsigned index = (time_ >> shift) & SLOT_MASK;
+        const unsigned n = __builtin_ctzll(rotateRight(occupied_[level], index + 1)) + 1;
+        // Entries at higher levels need to be moved when the time reaches the slot's boundary
+        const system_tick_t t = (((time_ >> shift) + n) << shift);
+        const system_tick_t delay = t - time_;
+        if (!minDelay || delay < minDelay) {
+            minDelay = delay;
+        }
+    }
+    *time = time_ + minDelay;
+    return true;
+}
+
+void TimerWheel::insert(Entry* entry, system_tick_t minDelay) {
+    system_tick_t delay = entry->expiry - time_;
+    if ((int32_t)delay < (int32_t)minDelay) {
+        delay = minDelay; // Overdue
+    } else if (delay > MAX_DELAY) {
+        delay = MAX_DELAY; // The entry will be rescheduled when it reaches a lower level
+    }
+    unsigned level = 0;
+    while (level < LEVEL_COUNT - 1 && delay >= ((system_tick_t)1 << ((level + 1) * LEVEL_BITS))) {
+        ++level;
+    }
+    const unsigned index = ((time_ + delay) >> (level * LEVEL_BITS)) & SLOT_MASK;
+    link(&slots_[level][index], entry);
+    occupied_[level] |= (uint64_t)1 << index;
+}
+
+void TimerWheel::advance(system_tick_t now) {
+    while (!expired_ && (int32_t)(now - time_) > 0) {
+        // Jump straight to the next tick at which there's something to do
+        system_tick_t t = 0;
+        if (!nextExpiry(&t) || (int32_t)(now - t) < 0) {
+            time_ = now;
+            break;
+        }
+        time_ = t;
+        if (!(time_ & SLOT_MASK)) {
+            for (unsigned level = 1; level < LEVEL_COUNT; ++level) {
+                cascade(level);
+                if ((time_ >> (level * LEVEL_BITS)) & SLOT_MASK) {
+                    break;
+                }
+            }
+        }
+        const unsigned index = time_ & SLOT_MASK;
+        const auto entry = slots_[0][index];
+        if (entry) {
+            expired_ = entry;
+            entry->pprev = &expired_;
+            slots_[0][index] = nullptr;
+            occupied_[0] &= ~((uint64_t)1 << index);
+        }
+    }
+}
+
+void TimerWheel::cascade(unsigned level) {
+    const unsigned index = (time_ >> (level * LEVEL_BITS)) & SLOT_MASK;
+    auto entry = slots_[level][index];
+    slots_[level][index] = nullptr;
+    occupied_[level] &= ~((uint64_t)1 << index);
+    while (entry) {
+        const auto next = entry->next;
+        // Entries that are due at the current tick are moved to the current slot at level 0
+        insert(entry, 0 /* minDelay */);
+        entry = next;
+    }
+}
+
+void TimerWheel::link(Entry** head, Entry* entry) {
+    entry->next = *head;
+    if (entry->next) {
+        entry->next->pprev = &entry->next;
+    }
+    entry->pprev = head;
+    *head = entry;
+}
+
+void TimerWheel::unlink(Entry* entry) {
+    Entry** const pprev = entry->pprev;
+    *pprev = entry->next;
+    if (entry->next) {
+        entry->next->pprev = pprev;
+    }
+    entry->next = nullptr;
+    entry->pprev = nullptr;
+    --count_;
+    // Update the occupancy bitmap if the entry was the last one in its slot
+    Entry** const slots = &slots_[0][0];
+    if (!*pprev && pprev >= slots && pprev < slots + LEVEL_COUNT * SLOT_COUNT) {
+        const size_t n = pprev - slots;
+        occupied_[n / SLOT_COUNT] &= ~((uint64_t)1 << (n % SLOT_COUNT));
+    }
+}
+
+} // namespace particle
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "system_error.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+
+namespace particle {
+
+/**
+ * Open addressing hash table mapping precomputed key hashes to indices in an array of items.
+ *
+ * The index doesn't store the keys: `find()` takes a predicate that compares the key of a candidate
+ * item with the key being looked up. Up to 255 items are supported, which matches `append_list`.
+ */
+class HashIndex {
+public:
+    static const size_t MAX_ITEMS = 255;
+
+    HashIndex() :
+            slots_(nullptr),
+            capacity_(0),
+            count_(0) {
+    }
+
+    ~HashIndex() {
+        free(slots_);
+    }
+
+    /**
+     * Adds an item to the index.
+     *
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int add(uint32_t hash, size_t index) {
+        if (index >= MAX_ITEMS) {
+            return SYSTEM_ERROR_TOO_LARGE;
+        }
+        // Keep the load factor below 3/4
+        if ((count_ + 1) * 4 > capacity_ * 3) {
+            const int r = grow();
+            if (r < 0) {
+                return r;
+            }
+        }
+        insert(hash, index);
+        ++count_;
+        return 0;
+    }
+
+    /**
+     * Finds an item.
+     *
+     * @param hash Key hash.
+     * @param match Predicate invoked with the index of each candidate item.
+     * @return Item index, or -1 if the item is not found.
+     */
+    template<typename F>
+    int find(uint32_t hash, F match) const {
+        if (!capacity_) {
+            return -1;
+        }
+        for (size_t i = hash & (capacity_ - 1);; i = (i + 1) & (capacity_ - 1)) {
+            const Slot& s = slots_[i];
+            if (s.index == EMPTY) {
+                return -1;
+            }
+            if (s.hash == hash && match((size_t)s.index)) {
+                return s.index;
+            }
+        }
+    }
+
+    void clear() {
+        free(slots_);
+        slots_ = nullptr;
+        capacity_ = 0;
+        count_ = 0;
+    }
+
+    size_t size() const {
+        return count_;
+    }
+
+private:
+    struct Slot {
+        uint32_t hash;
+        uint8_t index;
+    };
+
+    static const uint8_t EMPTY = 0xff;
+    static const size_t MIN_CAPACITY = 8;
+
+    Slot* slots_;
+    size_t capacity_; // Always a power of 2
+    size_t count_;
+
+    int grow() {
+        const size_t capacity = capacity_ ? capacity_ * 2 : MIN_CAPACITY;
+        const auto slots = (Slot*)malloc(capacity * sizeof(Slot));
+        if (!slots) {
+            return SYSTEM_ERROR_NO_MEMORY;
+        }
+        for (size_t i = 0; i < capacity; ++i) {
+            slots[i].index = EMPTY;
+        }
+        Slot* const oldSlots = slots_;
+        const size_t oldCapacity = capacity_;
+        slots_ = slots;
+        capacity_ = capacity;
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (oldSlots[i].index != EMPTY) {
+                insert(oldSlots[i].hash, oldSlots[i].index);
+            }
+        }
+        free(oldSlots);
+        return 0;
+    }
+
+    void insert(uint32_t hash, size_t index) {
+        size_t i = hash & (capacity_ - 1);
+        while (slots_[i].index != EMPTY) {
+            i = (i + 1) & (capacity_ - 1);
+        }
+        slots_[i].hash = hash;
+        slots_[i].index = index;
+    }
+};
+
+} // namespace particle
@@ -179,9 +179,14 @@ const uint32_t PUBLISH_EVENT_FLAG_WITH_ACK = 0x8;
  * This is a stop-gap solution until all synchronous APIs return futures, allowing asynchronous operation.
  */
 const uint32_t PUBLISH_EVENT_FLAG_ASYNC = EventType::ASYNC;
+/**
+ * The event is sent ahead of other queued events if the publish rate limit has been reached.
+ */
+const uint32_t PUBLISH_EVENT_FLAG_PRIORITY = 0x80;
 
 
 PARTICLE_STATIC_ASSERT(publish_no_ack_flag_matches, PUBLISH_EVENT_FLAG_NO_ACK==EventType::NO_ACK);
+PARTICLE_STATIC_ASSERT(publish_priority_flag_matches, PUBLISH_EVENT_FLAG_PRIORITY==EventType::PRIORITY);
 
 typedef void (*EventHandler)(const char* name, const char* data);
 
@@ -277,6 +282,22 @@ typedef struct {
  *
  */
 int spark_publish_vitals(system_tick_t period_s, void *reserved);
+
+/**
+ * @brief Configure the history of vitals
+ *
+ * When enabled, the system samples its diagnostic data periodically and keeps the samples
+ * in RAM. The samples are sent in a delta-encoded form along with the next vitals message.
+ *
+ * @param[in] period_s The sampling period in seconds. If 0, the history is disabled
+ * @param[in] depth The maximum number of samples to keep
+ * @param[in,out] reserved Reserved for future use.
+ *
+ * @returns \p system_error_t result code
+ * @retval \p system_error_t::SYSTEM_ERROR_NONE
+ * @retval \p system_error_t::SYSTEM_ERROR_NO_MEMORY
+ */
+int spark_vitals_history(system_tick_t period_s, size_t depth, void *reserved);
 bool spark_send_event(const char* name, const char* data, int ttl, uint32_t flags, void* reserved);
 bool spark_subscribe(const char *eventName, EventHandler handler, void* handler_data,
         Spark_Subscription_Scope_TypeDef scope, const char* deviceID, void* reserved);
@@ -61,6 +61,7 @@ typedef enum ctrl_request_type {
     CTRL_REQUEST_SET_STARTUP_MODE = 75,
     CTRL_REQUEST_LOG_CONFIG = 80,
     CTRL_REQUEST_GET_MODULE_INFO = 90,
+    CTRL_REQUEST_GET_SYSTEM_DESCRIBE = 91,
     CTRL_REQUEST_DIAGNOSTIC_INFO = 100,
     // CTRL_REQUEST_WIFI_SET_ANTENNA = 110,
     // CTRL_REQUEST_WIFI_GET_ANTENNA = 111,
@@ -54,6 +54,7 @@ DYNALIB_FN(15, system_cloud, spark_set_random_seed_from_cloud_handler, int(void
 DYNALIB_FN(16, system_cloud, spark_publish_vitals, int(system_tick_t, void*))
 DYNALIB_FN(17, system_cloud, spark_cloud_disconnect, int(const spark_cloud_disconnect_options*, void*))
 DYNALIB_FN(18, system_cloud, spark_get_connection_property, int(unsigned, void*, size_t*, void*))
+DYNALIB_FN(19, system_cloud, spark_vitals_history, int(system_tick_t, size_t, void*))
 
 DYNALIB_END(system_cloud)
 
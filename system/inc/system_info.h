@@ -111,11 +111,53 @@ bool append_system_version_info(particle::Appender* appender);
 
 bool system_module_info(appender_fn appender, void* append_data, void* reserved=NULL);
 
+/**
+ * Cursor value indicating that the system describe document has been read completely.
+ */
+#define SYSTEM_MODULE_INFO_CURSOR_END ((uint32_t)0xffffffff)
+
+/**
+ * Reads a chunk of the system describe document generated by `system_module_info()`.
+ *
+ * The document is generated incrementally, so that it can be transferred in parts without buffering
+ * it entirely.
+ *
+ * @param info System info (see `system_info_get_unstable()`). The same info should be used to read
+ *        all chunks of the document.
+ * @param cursor Position in the document. Should be set to 0 to read the first chunk. On return, set to
+ *        the position of the next chunk or `SYSTEM_MODULE_INFO_CURSOR_END`.
+ * @param buf Destination buffer.
+ * @param size Buffer size.
+ * @param reserved Reserved argument (should be set to NULL).
+ * @return Number of bytes written to the buffer, or a negative result code in case of an error.
+ */
+int system_module_info_read(const hal_system_info_t* info, uint32_t* cursor, char* buf, size_t size, void* reserved);
+
+/**
+ * Computes the checksum of the system describe document generated by `system_module_info()`.
+ *
+ * The checksum can be used to detect that the document has changed between reading its chunks.
+ *
+ * @param info System info (see `system_info_get_unstable()`).
+ * @param[out] checksum CRC-32 of the document.
+ * @param reserved Reserved argument (should be set to NULL).
+ * @return 0 on success, or a negative result code in case of an error.
+ */
+int system_module_info_checksum(const hal_system_info_t* info, uint32_t* checksum, void* reserved);
+
 // These functions are exported through dynalib but may be unstable due to the usage
 // of internal structures.
 int system_info_get_unstable(hal_system_info_t* info, uint32_t flags, void* reserved);
 int system_info_free_unstable(hal_system_info_t* info, void* reserved);
 
+/**
+ * Flags for `system_format_diag_data()`.
+ */
+typedef enum system_format_diag_flag {
+    SYSTEM_FORMAT_DIAG_BINARY = 0x01, ///< Binary format.
+    SYSTEM_FORMAT_DIAG_HISTORY = 0x02 ///< Delta-encoded history of samples (see `VitalsHistory`).
+} system_format_diag_flag;
+
 /**
  * Formats the diagnostic data using an appender function.
  *
@@ -20,6 +20,8 @@
 #if SYSTEM_CONTROL_ENABLED
 
 #include "system_update.h"
+#include "system_info.h"
+#include "firmware_update.h"
 #include "system_network.h"
 #include "common.h"
 
@@ -37,6 +39,7 @@
 #include "miniz.h"
 #endif // HAL_PLATFORM_COMPRESSED_BINARIES
 #include "scope_guard.h"
+#include "endian_util.h"
 #include "check.h"
 
 #include "platforms.h"
@@ -56,6 +59,42 @@ using namespace common;
 
 namespace {
 
+// Maximum size of a chunk of the system describe document sent in a single reply
+const size_t SYSTEM_DESCRIBE_CHUNK_SIZE = 512;
+
+// System info used to generate the system describe document that is being read in chunks
+struct SystemDescribe {
+    std::unique_ptr<hal_system_info_t> info;
+    uint32_t checksum = 0;
+    unsigned updateCount = 0;
+
+    int init(unsigned count) {
+        reset();
+        std::unique_ptr<hal_system_info_t> i(new(std::nothrow) hal_system_info_t());
+        CHECK_TRUE(i, SYSTEM_ERROR_NO_MEMORY);
+        i->size = sizeof(hal_system_info_t);
+        i->flags = HAL_SYSTEM_INFO_FLAGS_CLOUD;
+        HAL_System_Info(i.get(), true /* construct */, nullptr);
+        const int r = system_module_info_checksum(i.get(), &checksum, nullptr);
+        if (r < 0) {
+            HAL_System_Info(i.get(), false, nullptr);
+            return r;
+        }
+        info = std::move(i);
+        updateCount = count;
+        return 0;
+    }
+
+    void reset() {
+        if (info) {
+            HAL_System_Info(info.get(), false, nullptr);
+            info.reset();
+        }
+    }
+};
+
+SystemDescribe g_describe;
+
 // TODO: Move handling of compressed firmware binaries to the common system code
 struct FirmwareUpdate {
     FileTransfer::Descriptor descr; // File transfer descriptor
@@ -323,6 +362,54 @@ int getModuleInfo(ctrl_request* req) {
     return 0;
 }
 
+int getSystemDescribe(ctrl_request* req) {
+    // The system describe document is read in chunks. The request contains the position of the chunk
+    // and the checksum of the document returned with the previous chunk, or no data for the first chunk.
+    // The reply contains the position of the next chunk and the checksum of the document, followed by
+    // the chunk data. SYSTEM_MODULE_INFO_CURSOR_END is returned as the next position for the last chunk.
+    // If the document has changed since the previous chunk was read, the request fails with
+    // SYSTEM_ERROR_INVALID_STATE and the host needs to start over. All values are encoded as 32-bit
+    // little-endian integers
+    uint32_t cursor = 0;
+    uint32_t checksum = 0;
+    if (req->request_size > 0) {
+        CHECK_TRUE(req->request_size == sizeof(cursor) + sizeof(checksum), SYSTEM_ERROR_INVALID_ARGUMENT);
+        memcpy(&cursor, req->request_data, sizeof(cursor));
+        cursor = littleEndianToNative(cursor);
+        memcpy(&checksum, req->request_data + sizeof(cursor), sizeof(checksum));
+        checksum = littleEndianToNative(checksum);
+    }
+    // The system info is kept until the last chunk is read, so that the document and its checksum are
+    // generated only once per read. It's discarded if the modules may have changed in the meantime
+    const auto update = system::FirmwareUpdate::instance();
+    if (g_describe.info && (update->isRunning() || update->updateCount() != g_describe.updateCount)) {
+        g_describe.reset();
+    }
+    if (req->request_size == 0) {
+        CHECK(g_describe.init(update->updateCount()));
+    } else if (!g_describe.info || checksum != g_describe.checksum) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    const size_t headerSize = sizeof(cursor) + sizeof(checksum);
+    CHECK(system_ctrl_alloc_reply_data(req, headerSize + SYSTEM_DESCRIBE_CHUNK_SIZE, nullptr));
+    const int n = system_module_info_read(g_describe.info.get(), &cursor, req->reply_data + headerSize,
+            SYSTEM_DESCRIBE_CHUNK_SIZE, nullptr);
+    if (n < 0) {
+        system_ctrl_alloc_reply_data(req, 0, nullptr);
+        g_describe.reset();
+        return n;
+    }
+    const uint32_t currentChecksum = nativeToLittleEndian(g_describe.checksum);
+    if (cursor == SYSTEM_MODULE_INFO_CURSOR_END) {
+        g_describe.reset();
+    }
+    cursor = nativeToLittleEndian(cursor);
+    memcpy(req->reply_data, &cursor, sizeof(cursor));
+    memcpy(req->reply_data + sizeof(cursor), &currentChecksum, sizeof(currentChecksum));
+    req->reply_size = headerSize + n;
+    return 0;
+}
+
 } // namespace particle::control
 
 } // namespace particle
@@ -29,6 +29,7 @@ int cancelFirmwareUpdateRequest(ctrl_request* req);
 int firmwareUpdateDataRequest(ctrl_request* req);
 
 int getModuleInfo(ctrl_request* req);
+int getSystemDescribe(ctrl_request* req);
 
 } // namespace particle::control
 
@@ -105,6 +105,7 @@ struct TransferState {
 } // namespace detail
 
 FirmwareUpdate::FirmwareUpdate() :
+        updateCount_(0),
         updating_(false),
         ledOverridden_(false) {
 }
@@ -170,6 +171,7 @@ int FirmwareUpdate::startUpdate(size_t fileSize, const char* fileHash, size_t* p
         }
         SPARK_FLASH_UPDATE = 1; // TODO: Get rid of legacy state variables
         updating_ = true;
+        ++updateCount_;
         // Generate a system event
         fileDesc_ = FileTransfer::Descriptor();
         fileDesc_.file_length = fileSize;
@@ -429,6 +431,7 @@ void FirmwareUpdate::endUpdate(bool ok) {
     }
     SPARK_FLASH_UPDATE = 0;
     updating_ = false;
+    ++updateCount_;
     system_notify_event(firmware_update, ok ? firmware_update_complete : firmware_update_failed, &fileDesc_);
 }
 
@@ -82,6 +82,14 @@ public:
      * @return `true` if a firmware update is in progress.
      */
     bool isRunning() const;
+    /**
+     * Get the number of firmware updates that have been started or finished.
+     *
+     * The counter changes whenever the modules on the device may have changed.
+     *
+     * @return Counter value.
+     */
+    unsigned updateCount() const;
     /**
      * Get the singleton instance of this class.
      */
@@ -89,6 +97,7 @@ public:
 
 private:
     FileTransfer::Descriptor fileDesc_; // File descriptor (used for compatibility with legacy system events)
+    unsigned updateCount_; // Number of updates that have been started or finished
     bool updating_; // Whether an update is in progress
     bool ledOverridden_; // FIXME
 
@@ -110,6 +119,10 @@ inline bool FirmwareUpdate::isRunning() const {
     return updating_;
 }
 
+inline unsigned FirmwareUpdate::updateCount() const {
+    return updateCount_;
+}
+
 } // namespace system
 
 } // namespace particle
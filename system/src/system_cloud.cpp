@@ -26,6 +26,8 @@
  */
 
 #include <cstdarg>
+#include <algorithm>
+#include <atomic>
 
 #include "logging.h"
 #include "protocol_defs.h"
@@ -35,6 +37,7 @@
 #include "system_cloud.h"
 #include "system_cloud_internal.h"
 #include "system_publish_vitals.h"
+#include "system_vitals_history.h"
 #include "system_task.h"
 #include "system_threading.h"
 #include "system_update.h"
@@ -44,6 +47,8 @@
 #include "events.h"
 #include "deviceid_hal.h"
 #include "system_mode.h"
+#include "timer_hal.h"
+#include "check.h"
 
 #if PLATFORM_THREADING
 #include "spark_wiring_timer.h"
@@ -63,6 +68,28 @@ VitalsPublisher<Timer> _vitals;
 VitalsPublisher<NullTimer> _vitals;
 #endif // PLATFORM_THREADING
 
+#if PLATFORM_THREADING
+std::unique_ptr<Timer> _vitalsSampler;
+
+std::atomic_bool _vitalsSamplePending(false);
+
+ISRTaskQueue::Task _vitalsSampleTask([](ISRTaskQueue::Task* task) {
+    _vitalsSamplePending = false;
+    VitalsHistory::instance()->sample(HAL_Timer_Get_Milli_Seconds());
+});
+
+void sampleVitals()
+{
+    // Sample the diagnostic data on the system thread. The task can only be queued once, so a tick
+    // is skipped if the previous sample hasn't been taken yet
+    if (_vitalsSamplePending.exchange(true))
+    {
+        return;
+    }
+    SystemISRTaskQueue.enqueue(&_vitalsSampleTask);
+}
+#endif // PLATFORM_THREADING
+
 // These properties are forwarded to the protocol instance as is
 static_assert(SPARK_CLOUD_PING_INTERVAL == (int)protocol::Connection::PING,
         "The value of SPARK_CLOUD_PING_INTERVAL has changed");
@@ -118,6 +145,32 @@ int spark_publish_vitals(system_tick_t period_s_, void* reserved_)
     return result;
 }
 
+int spark_vitals_history(system_tick_t period_s, size_t depth, void* reserved)
+{
+    SYSTEM_THREAD_CONTEXT_SYNC(spark_vitals_history(period_s, depth, reserved));
+#if PLATFORM_THREADING
+    _vitalsSampler.reset();
+#endif // PLATFORM_THREADING
+    const auto history = VitalsHistory::instance();
+    if (!period_s || !depth)
+    {
+        return history->init(0);
+    }
+    // Samples that don't fit in a vitals message are sent with the next one, so keeping more of
+    // them would only waste RAM
+    CHECK(history->init(std::min(depth, VitalsHistory::MAX_DEPTH)));
+#if PLATFORM_THREADING
+    _vitalsSampler.reset(new (std::nothrow) Timer(period_s * 1000, sampleVitals, false));
+    if (!_vitalsSampler)
+    {
+        history->init(0);
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+    _vitalsSampler->start();
+#endif // PLATFORM_THREADING
+    return 0;
+}
+
 bool spark_subscribe(const char *eventName, EventHandler handler, void* handler_data,
         Spark_Subscription_Scope_TypeDef scope, const char* deviceID, void* reserved)
 {
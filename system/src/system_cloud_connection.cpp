@@ -100,6 +100,11 @@ int SessionConnection::load(const ServerAddress& addr)
     return -1;
 }
 
+bool SessionConnection::isValid(const ServerAddress& addr) const
+{
+    return address.ss_family != AF_UNSPEC && server_address_checksum == compute_session_checksum(addr);
+}
+
 int SessionConnection::discard()
 {
     LOG(INFO, "Discarding session data");
@@ -118,7 +123,7 @@ int SessionConnection::save(const ServerAddress& addr)
 #endif /* HAL_PLATFORM_CLOUD_UDP */
 
 // Same return value as connect(), -1 on error
-int spark_cloud_socket_connect()
+int spark_cloud_socket_connect(bool reuse_session_address)
 {
     system_cloud_disconnect(false);
 
@@ -170,7 +175,13 @@ int spark_cloud_socket_connect()
     }
 
 #if HAL_PLATFORM_CLOUD_UDP
-    g_system_cloud_session_data.load(server_addr);
+    if (!reuse_session_address || !g_system_cloud_session_data.isValid(server_addr)) {
+        g_system_cloud_session_data.load(server_addr);
+    } else {
+        LOG(INFO, "Reusing cloud server address and port from the current session");
+    }
+#else
+    (void)reuse_session_address;
 #endif /* HAL_PLATFORM_CLOUD_UDP */
 
     int r = system_cloud_connect(udp ? IPPROTO_UDP : IPPROTO_TCP, &server_addr,
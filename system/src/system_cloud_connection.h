@@ -53,7 +53,13 @@ sock_handle_t system_cloud_get_socket_handle();
  * and system upgrades.
  */
 void spark_cloud_udp_port_set(uint16_t port);
-int spark_cloud_socket_connect(void);
+/**
+ * Connects the cloud socket.
+ *
+ * @param reuse_session_address Reuse the server address of the current session if it's still valid
+ *        instead of reloading the session data from the persistent storage.
+ */
+int spark_cloud_socket_connect(bool reuse_session_address=false);
 int spark_cloud_socket_disconnect(bool graceful=true);
 uint8_t spark_cloud_socket_closed();
 
@@ -98,6 +104,7 @@ struct SessionConnection
     uint32_t server_address_checksum;
 
     int load(const ServerAddress& addr);
+    bool isValid(const ServerAddress& addr) const;
     int discard();
     int save(const ServerAddress& addr);
 };
@@ -31,6 +31,7 @@
 #include "spark_wiring_string.h"
 #include "spark_protocol_functions.h"
 #include "append_list.h"
+#include "hash_index.h"
 #include "core_hal.h"
 #include "deviceid_hal.h"
 #include "ota_flash_hal.h"
@@ -52,6 +53,7 @@
 #include "system_cloud_connection.h"
 #include "system_network_internal.h"
 #include "str_util.h"
+#include "hash_util.h"
 #include "scope_guard.h"
 #if HAL_PLATFORM_MUXER_MAY_NEED_DELAY_IN_TX
 #include "network/ncp/cellular/ncp.h"
@@ -62,6 +64,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <algorithm>
 
 using namespace particle;
 using namespace particle::system;
@@ -240,11 +243,33 @@ ProtocolFacade* system_cloud_protocol_instance(void)
 static append_list<User_Var_Lookup_Table_t> vars(5);
 static append_list<User_Func_Lookup_Table_t> funcs(5);
 
+// Hash tables mapping the registered keys to the list indices. If an item couldn't be added to
+// the index due to a memory allocation error, the lookups fall back to a linear scan
+static HashIndex var_index;
+static HashIndex func_index;
+
+/**
+ * Computes a hash of a variable or function key (FNV-1a).
+ */
+static uint32_t key_hash(const char* key, size_t max_length)
+{
+    return fnv1a_update(FNV1A_INIT, key, strnlen(key, max_length));
+}
+
 User_Var_Lookup_Table_t* find_var_by_key(const char* varKey)
 {
+    const uint32_t hash = key_hash(varKey, USER_VAR_KEY_LENGTH);
+    const auto match = [varKey](size_t i) {
+        return 0 == strncmp(vars[i].userVarKey, varKey, USER_VAR_KEY_LENGTH);
+    };
+    if (var_index.size() == vars.size())
+    {
+        const int i = var_index.find(hash, match);
+        return (i >= 0) ? &vars[i] : NULL;
+    }
     for (int i = vars.size(); i-->0; )
     {
-        if (0 == strncmp(vars[i].userVarKey, varKey, USER_VAR_KEY_LENGTH))
+        if (vars[i].userVarKeyHash == hash && match(i))
         {
             return &vars[i];
         }
@@ -286,11 +311,15 @@ User_Var_Lookup_Table_t* find_var_by_key_or_add(const char* varKey, const void*
 		}
 	}
 	memcpy(item.userVarKey, varKey, USER_VAR_KEY_LENGTH);
+	item.userVarKeyHash = key_hash(varKey, USER_VAR_KEY_LENGTH);
 
     User_Var_Lookup_Table_t* result = find_var_by_key(varKey);
 
     if (!result) {
     	result = add_if_sufficient_describe(vars, varKey, "variable", item);
+    	if (result) {
+    		var_index.add(item.userVarKeyHash, result - &vars[0]);
+    	}
     }
     else {
     	*result = item;
@@ -300,9 +329,18 @@ User_Var_Lookup_Table_t* find_var_by_key_or_add(const char* varKey, const void*
 
 User_Func_Lookup_Table_t* find_func_by_key(const char* funcKey)
 {
+    const uint32_t hash = key_hash(funcKey, USER_FUNC_KEY_LENGTH);
+    const auto match = [funcKey](size_t i) {
+        return 0 == strncmp(funcs[i].userFuncKey, funcKey, USER_FUNC_KEY_LENGTH);
+    };
+    if (func_index.size() == funcs.size())
+    {
+        const int i = func_index.find(hash, match);
+        return (i >= 0) ? &funcs[i] : NULL;
+    }
     for (int i = funcs.size(); i-->0; )
     {
-        if (0 == strncmp(funcs[i].userFuncKey, funcKey, USER_FUNC_KEY_LENGTH))
+        if (funcs[i].userFuncKeyHash == hash && match(i))
         {
             return &funcs[i];
         }
@@ -316,6 +354,7 @@ User_Func_Lookup_Table_t* find_func_by_key_or_add(const char* funcKey, const clo
 	item.pUserFunc = desc->fn;
 	item.pUserFuncData = desc->data;
     memcpy(item.userFuncKey, desc->funcKey, USER_FUNC_KEY_LENGTH);
+    item.userFuncKeyHash = key_hash(desc->funcKey, USER_FUNC_KEY_LENGTH);
 
     User_Func_Lookup_Table_t* result = find_func_by_key(funcKey);
     if (result) {
@@ -323,6 +362,9 @@ User_Func_Lookup_Table_t* find_func_by_key_or_add(const char* funcKey, const clo
     }
     else {
     	result = add_if_sufficient_describe(funcs, funcKey, "function", item);
+    	if (result) {
+    		func_index.add(item.userFuncKeyHash, result - &funcs[0]);
+    	}
     }
     return result;
 }
@@ -395,6 +437,8 @@ uint32_t compute_describe_system_checksum()
     hal_system_info_t info;
     memset(&info, 0, sizeof(info));
     info.size = sizeof(info);
+    // Only the module hashes are needed here
+    info.flags = HAL_SYSTEM_INFO_FLAGS_SKIP_INTEGRITY;
     HAL_System_Info(&info, true, NULL);
 	uint32_t checksum = info.platform_id;
 	for (int i=0; i<info.module_count; i++)
@@ -771,38 +815,69 @@ void getUserVarResult(int error, int type, void* data, size_t size, SparkDescrip
     callback(error, type, data, size, context);
 }
 
+// Snapshot of a fixed-size variable value that is passed between threads by value
+struct FixedSizeVariableValue {
+    union {
+        uint32_t i;
+        double d;
+        bool b;
+    };
+};
+
+void getFixedSizeUserVarResult(int type, FixedSizeVariableValue value, size_t size,
+        SparkDescriptor::GetVariableCallback callback, void* context) {
+    SYSTEM_THREAD_CONTEXT_ASYNC(getFixedSizeUserVarResult(type, value, size, callback, context));
+    // The callback doesn't take the ownership over values of fixed-size types
+    callback(ProtocolError::NO_ERROR, type, &value, size, context);
+}
+
+bool isFixedSizeVariableType(Spark_Data_TypeDef type) {
+    return type == CLOUD_VAR_BOOLEAN || type == CLOUD_VAR_INT || type == CLOUD_VAR_DOUBLE;
+}
+
 void getUserVarImpl(User_Var_Lookup_Table_t* item, SparkDescriptor::GetVariableCallback callback, void* context)
 {
     APPLICATION_THREAD_CONTEXT_ASYNC(getUserVarImpl(item, callback, context));
+    const auto type = protocolVariableType(item->userVarType); // Spark_Data_TypeDef -> SparkReturnType::Enum
     size_t size = 0;
     void* copy = nullptr;
     NAMED_SCOPE_GUARD(copyGuard, {
         free(copy);
     });
+    const void* data = nullptr;
     if (item->copy) {
         const int result = item->copy(item->userVar, &copy, &size);
         if (result < 0) {
             getUserVarResult(ProtocolError::NO_MEMORY, 0 /* type */, nullptr /* data */, 0 /* size */, callback, context);
             return;
         }
+        data = copy;
     } else {
-        const void* data = nullptr;
         if (item->update) {
             data = item->update(item->userVarKey, item->userVarType, item->userVar, nullptr);
         } else {
             data = item->userVar;
         }
         size = variableDataSize(data, item->userVarType);
-        if (size > 0) {
-            copy = malloc(size);
-            if (!copy) {
-                getUserVarResult(ProtocolError::NO_MEMORY, 0, nullptr, 0, callback, context);
-                return;
-            }
-            memcpy(copy, data, size);
+    }
+    if (isFixedSizeVariableType(item->userVarType)) {
+        // Values of fixed-size types are passed by value and don't need to be copied to the heap
+        FixedSizeVariableValue value = {};
+        size = std::min(size, sizeof(value));
+        if (data) {
+            memcpy(&value, data, size);
         }
+        getFixedSizeUserVarResult(type, value, size, callback, context);
+        return;
+    }
+    if (!copy && size > 0) {
+        copy = malloc(size);
+        if (!copy) {
+            getUserVarResult(ProtocolError::NO_MEMORY, 0, nullptr, 0, callback, context);
+            return;
+        }
+        memcpy(copy, data, size);
     }
-    const auto type = protocolVariableType(item->userVarType); // Spark_Data_TypeDef -> SparkReturnType::Enum
     getUserVarResult(ProtocolError::NO_ERROR, type, copy, size, callback, context);
     copyGuard.dismiss();
 }
@@ -821,7 +896,7 @@ void userFuncScheduleImpl(User_Func_Lookup_Table_t* item, const char* paramStrin
 {
     int result = item->pUserFunc(item->pUserFuncData, paramString, NULL);
     if (freeParamString)
-        delete paramString;
+        free((void*)paramString);
     // run the cloud return on the system thread again
     SYSTEM_THREAD_CONTEXT_ASYNC(callback((const void*)long(result), SparkReturnType::INT));
     callback((const void*)long(result), SparkReturnType::INT);
@@ -835,12 +910,18 @@ int userFuncSchedule(const char *funcKey, const char *paramString, SparkDescript
         return -1;
 
 #if PLATFORM_THREADING
-    paramString = strdup(paramString);      // ensure we have a copy since the oriignal isn't guaranteed to be available once this function returns.
-    APPLICATION_THREAD_CONTEXT_ASYNC_RESULT(userFuncScheduleImpl(item, paramString, true, callback), 0);
-    userFuncScheduleImpl(item, paramString, true, callback);
-#else
-    userFuncScheduleImpl(item, paramString, false, callback);
+    if (ApplicationThread.isStarted() && !APPLICATION_THREAD_CURRENT())
+    {
+        // The argument points into the protocol's message buffer, which is reused as soon as this
+        // function returns, so the application thread needs its own copy
+        const char* arg = strdup(paramString);
+        if (!arg)
+            return -1;
+        APPLICATION_THREAD_CONTEXT_ASYNC_RESULT(userFuncScheduleImpl(item, arg, true, callback), 0);
+    }
 #endif
+    // The function is invoked synchronously, so the borrowed argument can be passed as is
+    userFuncScheduleImpl(item, paramString, false, callback);
     return 0;
 }
 
@@ -51,6 +51,7 @@ struct User_Var_Lookup_Table_t
     const void *userVar;
     Spark_Data_TypeDef userVarType;
     char userVarKey[USER_VAR_KEY_LENGTH+1];
+    uint32_t userVarKeyHash; // Computed when the variable is registered
 
     const void* (*update)(const char* name, Spark_Data_TypeDef varType, const void* var, void* reserved);
     int (*copy)(const void* var, void** data, size_t* size);
@@ -62,6 +63,7 @@ struct User_Func_Lookup_Table_t
     void* pUserFuncData;
     cloud_function_t pUserFunc;
     char userFuncKey[USER_FUNC_KEY_LENGTH+1];
+    uint32_t userFuncKeyHash; // Computed when the function is registered
 };
 
 
@@ -87,7 +89,9 @@ public:
             disconnReason_(DIAG_ID_CLOUD_DISCONNECTION_REASON, DIAG_NAME_CLOUD_DISCONNECTION_REASON, CLOUD_DISCONNECT_REASON_NONE),
             disconnCount_(DIAG_ID_CLOUD_DISCONNECTS, DIAG_NAME_CLOUD_DISCONNECTS),
             connCount_(DIAG_ID_CLOUD_CONNECTION_ATTEMPTS, DIAG_NAME_CLOUD_CONNECTION_ATTEMPTS),
-            lastError_(DIAG_ID_CLOUD_CONNECTION_ERROR_CODE, DIAG_NAME_CLOUD_CONNECTION_ERROR_CODE) {
+            lastError_(DIAG_ID_CLOUD_CONNECTION_ERROR_CODE, DIAG_NAME_CLOUD_CONNECTION_ERROR_CODE),
+            connTime_(DIAG_ID_CLOUD_CONNECTION_TIME, DIAG_NAME_CLOUD_CONNECTION_TIME),
+            warmReconnCount_(DIAG_ID_CLOUD_WARM_RECONNECTS, DIAG_NAME_CLOUD_WARM_RECONNECTS) {
     }
 
     CloudDiagnostics& status(Status status) {
@@ -120,6 +124,17 @@ public:
         return *this;
     }
 
+    // Time in milliseconds it took to establish the last cloud connection
+    CloudDiagnostics& connectionTime(system_tick_t time) {
+        connTime_ = time;
+        return *this;
+    }
+
+    CloudDiagnostics& warmReconnect() {
+        ++warmReconnCount_;
+        return *this;
+    }
+
     static CloudDiagnostics* instance();
 
 private:
@@ -130,6 +145,8 @@ private:
     SimpleUnsignedIntegerDiagnosticData disconnCount_;
     SimpleUnsignedIntegerDiagnosticData connCount_;
     SimpleIntegerDiagnosticData lastError_;
+    SimpleUnsignedIntegerDiagnosticData connTime_;
+    SimpleUnsignedIntegerDiagnosticData warmReconnCount_;
 };
 
 class CloudConnectionSettings {
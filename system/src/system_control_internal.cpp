@@ -196,6 +196,10 @@ void SystemControl::processRequest(ctrl_request* req, ControlRequestChannel* /*
         setResult(req, control::getModuleInfo(req));
         break;
     }
+    case CTRL_REQUEST_GET_SYSTEM_DESCRIBE: {
+        setResult(req, control::getSystemDescribe(req));
+        break;
+    }
     case CTRL_REQUEST_DIAGNOSTIC_INFO: {
         if (req->request_size > 0) {
             // TODO: Querying a part of the diagnostic data is not supported
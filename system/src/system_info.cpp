@@ -21,7 +21,13 @@
 #include "spark_wiring_json.h"
 #include "spark_wiring_diagnostics.h"
 #include "spark_macros.h"
+#include "system_vitals_history.h"
+#include "crc32_util.h"
+#include "spark_descriptor.h"
+#include "timer_hal.h"
 #include <cstdio>
+#include <algorithm>
+#include <memory>
 
 namespace {
 
@@ -125,30 +131,41 @@ protected:
 		return *reinterpret_cast<T*>(fmt);
 	}
 
-	static int formatSourceData(const diag_source* src, void* fmt) {
-		return formatter(fmt).formatSource(src);
-	}
-
-	int formatSource(const diag_source* src) {
+	int formatValue(const diag_value& v) {
 		T& fmt = formatter();
-		if (!fmt.isSourceOk(src)) {
-			return 0;
+		bool ok = false;
+		if (v.error != 0) {
+			ok = fmt.formatValueError(v.id, v.error);
+		} else if (v.type == DIAG_TYPE_INT) {
+			ok = fmt.formatValueInt(v.id, (AbstractIntegerDiagnosticData::IntType)v.value);
+		} else if (v.type == DIAG_TYPE_UINT) {
+			ok = fmt.formatValueUnsignedInt(v.id, (AbstractUnsignedIntegerDiagnosticData::IntType)v.value);
+		} else {
+			return SYSTEM_ERROR_NOT_SUPPORTED;
+		}
+		if (!ok) {
+			return SYSTEM_ERROR_TOO_LARGE;
 		}
+		return 0;
+	}
+
+	static int getValue(uint16_t id, diag_value* v) {
+		const diag_source* src = nullptr;
+		CHECK(diag_get_source(id, &src, nullptr));
+		v->id = src->id;
+		v->type = src->type;
+		v->value = 0;
 		switch (src->type) {
 		case DIAG_TYPE_INT: {
 			AbstractIntegerDiagnosticData::IntType val = 0;
-			const int ret = AbstractIntegerDiagnosticData::get(src, val);
-			if ((ret == 0 && !fmt.formatSourceInt(src, val)) || (ret != 0 && !fmt.formatSourceError(src, ret))) {
-				return SYSTEM_ERROR_TOO_LARGE;
-			}
+			v->error = AbstractIntegerDiagnosticData::get(src, val);
+			v->value = val;
 			break;
 		}
 		case DIAG_TYPE_UINT: {
 			AbstractUnsignedIntegerDiagnosticData::IntType val = 0;
-			const int ret = AbstractUnsignedIntegerDiagnosticData::get(src, val);
-			if ((ret == 0 && !fmt.formatSourceUnsignedInt(src, val)) || (ret != 0 && !fmt.formatSourceError(src, ret))) {
-				return SYSTEM_ERROR_TOO_LARGE;
-			}
+			v->error = AbstractUnsignedIntegerDiagnosticData::get(src, val);
+			v->value = val;
 			break;
 		}
 		default:
@@ -164,21 +181,22 @@ protected:
 		if (id) {
 			// Dump specified data sources
 			for (size_t i = 0; i < count; ++i) {
-				const diag_source* src = nullptr;
-				int ret = diag_get_source(id[i], &src, nullptr);
-				if (ret != 0) {
-					return ret;
-				}
-				ret = formatter.formatSource(src);
-				if (ret != 0) {
-					return ret;
-				}
+				diag_value v = {};
+				CHECK(getValue(id[i], &v));
+				CHECK(formatter.formatValue(v));
 			}
 		} else {
-			// Dump all data sources
-			const int ret = diag_enum_sources(formatSourceData, nullptr, &formatter, nullptr);
-			if (ret != 0) {
-				return ret;
+			// Dump all data sources. The values are read in one pass
+			size_t total = 0;
+			CHECK(diag_snapshot(nullptr, 0, &total, nullptr));
+			std::unique_ptr<diag_value[]> values;
+			if (total > 0) {
+				values.reset(new(std::nothrow) diag_value[total]);
+				CHECK_TRUE(values, SYSTEM_ERROR_NO_MEMORY);
+				CHECK(diag_snapshot(values.get(), total, &total, nullptr));
+			}
+			for (size_t i = 0; i < total; ++i) {
+				CHECK(formatter.formatValue(values[i]));
 			}
 		}
 		if (!formatter.closeDocument()) {
@@ -212,26 +230,44 @@ public:
 		return json.isOk();
 	}
 
-	bool formatSourceError(const diag_source* src, int error) {
-		json.name(src->name);
+	bool formatValueError(uint16_t id, int error) {
+		const char* name = sourceName(id);
+		if (!name) {
+			return true;
+		}
+		json.name(name);
 		json.beginObject();
 		json.name("err").value(error);
 		json.endObject();
 		return json.isOk();
 	}
 
-	inline bool isSourceOk(const diag_source* src) {
-	    return (src->name);
+	inline bool formatValueInt(uint16_t id, AbstractIntegerDiagnosticData::IntType val) {
+		const char* name = sourceName(id);
+		if (!name) {
+			return true;
+		}
+		json.name(name).value(val);
+		return json.isOk();
 	}
 
-	inline bool formatSourceInt(const diag_source* src, AbstractIntegerDiagnosticData::IntType val) {
-		json.name(src->name).value(val);
+	inline bool formatValueUnsignedInt(uint16_t id, AbstractUnsignedIntegerDiagnosticData::IntType val) {
+		const char* name = sourceName(id);
+		if (!name) {
+			return true;
+		}
+		json.name(name).value(val);
 		return json.isOk();
 	}
 
-	inline bool formatSourceUnsignedInt(const diag_source* src, AbstractUnsignedIntegerDiagnosticData::IntType val) {
-		json.name(src->name).value(val);
-		return json.isOk();
+private:
+	// Sources without a name are not included in the JSON document
+	static const char* sourceName(uint16_t id) {
+		const diag_source* src = nullptr;
+		if (diag_get_source(id, &src, nullptr) != 0) {
+			return nullptr;
+		}
+		return src->name;
 	}
 };
 
@@ -259,21 +295,17 @@ public:
 	/**
 	 *
 	 */
-	bool formatSourceError(const diag_source* src, int error) {
-		static_assert(sizeof(src->id)==2, "expected diagnostic id to be 16-bits");
-		return data.write(decltype(src->id)(src->id | 1<<15)) && data.write(int32_t(error));
+	bool formatValueError(uint16_t id, int error) {
+		static_assert(sizeof(diag_source::id)==2, "expected diagnostic id to be 16-bits");
+		return data.write(uint16_t(id | 1<<15)) && data.write(int32_t(error));
 	}
 
-	inline bool isSourceOk(const diag_source* src) {
-	    return true;
+	inline bool formatValueInt(uint16_t id, AbstractIntegerDiagnosticData::IntType val) {
+		return data.write(id) && data.write(val);
 	}
 
-	inline bool formatSourceInt(const diag_source* src, AbstractIntegerDiagnosticData::IntType val) {
-		return data.write(src->id) && data.write(val);
-	}
-
-	inline bool formatSourceUnsignedInt(const diag_source* src, AbstractUnsignedIntegerDiagnosticData::IntType val) {
-		return data.write(src->id) && data.write(val);
+	inline bool formatValueUnsignedInt(uint16_t id, AbstractUnsignedIntegerDiagnosticData::IntType val) {
+		return data.write(id) && data.write(val);
 	}
 
 };
@@ -324,33 +356,199 @@ bool module_info_to_json(AppendJson& json, const hal_module_t* module, uint32_t
     return json.isOk();
 }
 
-bool system_info_to_json(appender_fn append, void* append_data, hal_system_info_t& system)
+namespace {
+
+/*
+ * The system describe document is generated as a sequence of units: the platform ID, one unit per
+ * key-value pair, the beginning of the module array, one unit per module, and the end of the module
+ * array. Each unit is small and can be regenerated independently, which allows producing the document
+ * in chunks of an arbitrary size without buffering it entirely.
+ */
+bool is_module_described(const hal_module_t& module)
+{
+    if (!is_module_function_valid((module_function_t)module.info.module_function)) {
+        // Skip modules that do not contain binary at all, otherwise we easily overflow
+        // system describe message
+        return false;
+    }
+    if (module.bounds.store == MODULE_STORE_FACTORY && (module.validity_result & MODULE_VALIDATION_INTEGRITY) == 0) {
+        // Specifically skip factory modules that do not look valid
+        return false;
+    }
+    return true;
+}
+
+inline unsigned describe_unit_count(const hal_system_info_t& system)
+{
+    return system.key_value_count + system.module_count + 3;
+}
+
+bool describe_unit_to_json(appender_fn append, void* append_data, const hal_system_info_t& system, unsigned unit,
+        bool* module_written)
 {
     AppendJson json(append, append_data);
-    json.name("p").value(system.platform_id);
-    for (unsigned i = 0; i < system.key_value_count; i++) {
-        json.name(system.key_values[i].key).value(system.key_values[i].value);
+    if (unit == 0) {
+        json.name("p").value(system.platform_id);
+        return json.isOk();
     }
-    // Modules
-    json.name("m");
-    json.beginArray();
-    for (unsigned i=0; i<system.module_count; i++) {
-        const hal_module_t& module = system.modules[i];
-        if (!is_module_function_valid((module_function_t)module.info.module_function)) {
-            // Skip modules that do not contain binary at all, otherwise we easily overflow
-            // system describe message
-            continue;
+    --unit;
+    if (unit < system.key_value_count) {
+        if (!append(append_data, (const uint8_t*)",", 1)) {
+            return false;
+        }
+        json.name(system.key_values[unit].key).value(system.key_values[unit].value);
+        return json.isOk();
+    }
+    unit -= system.key_value_count;
+    if (unit == 0) {
+        if (!append(append_data, (const uint8_t*)",", 1)) {
+            return false;
+        }
+        json.name("m").beginArray();
+        return json.isOk();
+    }
+    --unit;
+    if (unit < system.module_count) {
+        const hal_module_t& module = system.modules[unit];
+        if (!is_module_described(module)) {
+            return true;
         }
-        if (module.bounds.store == MODULE_STORE_FACTORY && (module.validity_result & MODULE_VALIDATION_INTEGRITY) == 0) {
-            // Specifically skip factory modules that do not look valid
-            continue;
+        if (*module_written && !append(append_data, (const uint8_t*)",", 1)) {
+            return false;
         }
-        module_info_to_json(json, &module, 0);
+        *module_written = true;
+        return module_info_to_json(json, &module, 0);
     }
     json.endArray();
     return json.isOk();
 }
 
+// Appender that copies a window of the generated data to a buffer
+class WindowAppender {
+public:
+    WindowAppender(char* buf, size_t size, size_t offset) :
+            buf_(buf),
+            size_(size),
+            offset_(offset),
+            written_(0),
+            total_(0) {
+    }
+
+    size_t written() const {
+        return written_;
+    }
+
+    size_t total() const {
+        return total_;
+    }
+
+    static bool callback(void* appender, const uint8_t* data, size_t size) {
+        const auto self = static_cast<WindowAppender*>(appender);
+        const size_t begin = self->offset_ + self->written_;
+        if (self->total_ + size > begin && self->written_ < self->size_) {
+            const size_t skip = (begin > self->total_) ? begin - self->total_ : 0;
+            const size_t n = std::min(size - skip, self->size_ - self->written_);
+            memcpy(self->buf_ + self->written_, data + skip, n);
+            self->written_ += n;
+        }
+        self->total_ += size;
+        return true;
+    }
+
+private:
+    char* buf_;
+    size_t size_;
+    size_t offset_;
+    size_t written_;
+    size_t total_;
+};
+
+// Appender that computes the checksum of the generated data
+class Crc32Appender {
+public:
+    Crc32Appender() :
+            crc_(0) {
+    }
+
+    uint32_t crc() const {
+        return crc_;
+    }
+
+    static bool callback(void* appender, const uint8_t* data, size_t size) {
+        const auto self = static_cast<Crc32Appender*>(appender);
+        self->crc_ = crc32_update(self->crc_, data, size);
+        return true;
+    }
+
+private:
+    uint32_t crc_;
+};
+
+// Layout of a cursor value
+const unsigned DESCRIBE_CURSOR_UNIT_BITS = 15;
+const unsigned DESCRIBE_CURSOR_OFFSET_BITS = 16;
+const uint32_t DESCRIBE_CURSOR_UNIT_MASK = (1 << DESCRIBE_CURSOR_UNIT_BITS) - 1;
+const uint32_t DESCRIBE_CURSOR_OFFSET_MASK = (1 << DESCRIBE_CURSOR_OFFSET_BITS) - 1;
+const uint32_t DESCRIBE_CURSOR_MODULE_WRITTEN = 0x80000000;
+
+} // anonymous
+
+bool system_info_to_json(appender_fn append, void* append_data, const hal_system_info_t& system)
+{
+    bool module_written = false;
+    const unsigned count = describe_unit_count(system);
+    for (unsigned unit = 0; unit < count; ++unit) {
+        if (!describe_unit_to_json(append, append_data, system, unit, &module_written)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int system_module_info_read(const hal_system_info_t* info, uint32_t* cursor, char* buf, size_t size, void* reserved)
+{
+    CHECK_TRUE(info && cursor && buf && size > 0, SYSTEM_ERROR_INVALID_ARGUMENT);
+    if (*cursor == SYSTEM_MODULE_INFO_CURSOR_END) {
+        return 0;
+    }
+    unsigned unit = *cursor & DESCRIBE_CURSOR_UNIT_MASK;
+    size_t offset = (*cursor >> DESCRIBE_CURSOR_UNIT_BITS) & DESCRIBE_CURSOR_OFFSET_MASK;
+    bool module_written = *cursor & DESCRIBE_CURSOR_MODULE_WRITTEN;
+    const unsigned count = describe_unit_count(*info);
+    size_t n = 0;
+    while (n < size && unit < count) {
+        WindowAppender appender(buf + n, size - n, offset);
+        bool unit_module_written = module_written;
+        CHECK_TRUE(describe_unit_to_json(WindowAppender::callback, &appender, *info, unit, &unit_module_written),
+                SYSTEM_ERROR_INTERNAL);
+        n += appender.written();
+        if (appender.total() > offset + appender.written()) {
+            // The buffer is full
+            offset += appender.written();
+            break;
+        }
+        module_written = unit_module_written;
+        offset = 0;
+        ++unit;
+    }
+    if (unit >= count) {
+        *cursor = SYSTEM_MODULE_INFO_CURSOR_END;
+    } else {
+        CHECK_TRUE(unit <= DESCRIBE_CURSOR_UNIT_MASK && offset <= DESCRIBE_CURSOR_OFFSET_MASK, SYSTEM_ERROR_TOO_LARGE);
+        *cursor = unit | (offset << DESCRIBE_CURSOR_UNIT_BITS) | (module_written ? DESCRIBE_CURSOR_MODULE_WRITTEN : 0);
+    }
+    return n;
+}
+
+int system_module_info_checksum(const hal_system_info_t* info, uint32_t* checksum, void* reserved)
+{
+    CHECK_TRUE(info && checksum, SYSTEM_ERROR_INVALID_ARGUMENT);
+    Crc32Appender appender;
+    CHECK_TRUE(system_info_to_json(Crc32Appender::callback, &appender, *info), SYSTEM_ERROR_INTERNAL);
+    *checksum = appender.crc();
+    return 0;
+}
+
 bool system_module_info(appender_fn append, void* append_data, void* reserved)
 {
     hal_system_info_t info;
@@ -386,7 +584,17 @@ bool append_system_version_info(Appender* appender)
 
 int system_format_diag_data(const uint16_t* id, size_t count, unsigned flags, appender_fn append, void* append_data,
         void* reserved) {
-	if (flags & 1) {
+	if (flags & SYSTEM_FORMAT_DIAG_HISTORY) {
+		const auto history = particle::system::VitalsHistory::instance();
+		if (id || !history->isEnabled()) {
+			return SYSTEM_ERROR_NOT_SUPPORTED;
+		}
+		// Include the current values
+		const auto now = HAL_Timer_Get_Milli_Seconds();
+		CHECK(history->sample(now));
+		return history->format(append, append_data, now);
+	}
+	else if (flags & SYSTEM_FORMAT_DIAG_BINARY) {
 		AppendData data(append, append_data);
 		BinaryDiagnosticsFormatter fmt(data);
 	    return fmt.format(id, count, flags);
@@ -399,6 +607,27 @@ int system_format_diag_data(const uint16_t* id, size_t count, unsigned flags, ap
 }
 
 bool system_metrics(appender_fn appender, void* append_data, uint32_t flags, uint32_t page, void* reserved) {
+    const auto history = particle::system::VitalsHistory::instance();
+    if ((flags & SYSTEM_FORMAT_DIAG_BINARY) && history->isEnabled()) {
+        const auto opts = static_cast<const SparkAppendMetricsOptions*>(reserved);
+        const bool peek = opts && (opts->flags & SparkAppendMetricsOptions::PEEK);
+        const size_t maxSize = opts ? opts->max_size : 0;
+        const auto now = HAL_Timer_Get_Milli_Seconds();
+        // Include the current values
+        if (!peek && history->sample(now) < 0) {
+            return false;
+        }
+        size_t count = 0;
+        if (history->format(appender, append_data, now, maxSize, &count) < 0) {
+            return false;
+        }
+        if (!peek) {
+            // The samples that have been handed over to the protocol layer are folded into the
+            // base snapshot. The rest of them will be sent with the next message
+            history->discard(count);
+        }
+        return true;
+    }
     const int ret = system_format_diag_data(nullptr, 0, flags, appender, append_data, nullptr);
     return ret == 0;
 }
@@ -27,6 +27,10 @@
 #include "spark_wiring_ticks.h"
 #include "system_network_diagnostics.h"
 
+#if HAL_PLATFORM_LWIP
+#include "netdb_hal.h"
+#endif
+
 #if Wiring_WiFi
 #include "spark_wiring_wifi.h"
 #include "system_network_wifi.h"
@@ -359,6 +363,38 @@ public:
     }
 } g_networkCellularCellGlobalIdentityCellIdDiagnosticData;
 #endif // HAL_PLATFORM_CELLULAR
+
+#if HAL_PLATFORM_LWIP
+class NetworkDnsCacheDiagnosticData : public AbstractUnsignedIntegerDiagnosticData
+{
+public:
+    NetworkDnsCacheDiagnosticData(uint16_t id, const char* name, uint32_t netdb_cache_stats::*field)
+        : AbstractUnsignedIntegerDiagnosticData(id, name),
+          field_(field)
+    {
+    }
+
+    virtual int get(IntType& val)
+    {
+        netdb_cache_stats stats = {};
+        stats.size = sizeof(stats);
+        CHECK(netdb_get_cache_stats(&stats, nullptr));
+        val = stats.*field_;
+
+        return SYSTEM_ERROR_NONE;
+    }
+
+private:
+    uint32_t netdb_cache_stats::*field_;
+};
+
+NetworkDnsCacheDiagnosticData g_networkDnsCacheHitsDiagnosticData(DIAG_ID_NETWORK_DNS_CACHE_HITS,
+        DIAG_NAME_NETWORK_DNS_CACHE_HITS, &netdb_cache_stats::hits);
+NetworkDnsCacheDiagnosticData g_networkDnsCacheMissesDiagnosticData(DIAG_ID_NETWORK_DNS_CACHE_MISSES,
+        DIAG_NAME_NETWORK_DNS_CACHE_MISSES, &netdb_cache_stats::misses);
+NetworkDnsCacheDiagnosticData g_networkDnsCacheSizeDiagnosticData(DIAG_ID_NETWORK_DNS_CACHE_SIZE,
+        DIAG_NAME_NETWORK_DNS_CACHE_SIZE, &netdb_cache_stats::entries);
+#endif // HAL_PLATFORM_LWIP
 } // namespace
 
 #endif // Wiring_Network
@@ -209,11 +209,49 @@ static const system_tick_t NETWORK_RESET_TIMEOUT_ON_CLOUD_CONNECTION_ERRORS = 5
  */
 static uint8_t cloud_failed_connection_attempts = 0;
 
+/**
+ * Set if an established cloud connection was lost due to a network or communication error. The
+ * next connection attempt is a warm reconnection: it reuses the server address of the current
+ * session and is made as soon as the device has an IP address. The flag is cleared if the attempt
+ * fails, in which case the regular connection sequence is used.
+ */
+static bool cloud_warm_reconnect = false;
+
+/**
+ * Timestamp (millis) of the first connection attempt since the device was last connected to the
+ * cloud. Used to measure the connection time.
+ */
+static system_tick_t cloud_connect_start = 0;
+static bool cloud_connect_timing = false;
+
 inline uint8_t in_cloud_backoff_period()
 {
     return (HAL_Timer_Get_Milli_Seconds()-cloud_backoff_start)<backoff_period(cloud_failed_connection_attempts);
 }
 
+/**
+ * Returns true if the network is ready for a cloud connection attempt.
+ */
+static bool cloud_network_ready()
+{
+    if (network_ready(0, 0, 0)) {
+        return true;
+    }
+#if HAL_PLATFORM_IFAPI && HAL_PLATFORM_CLOUD_UDP
+    // A warm reconnection doesn't need DNS, so there's no need to wait until the DNS servers are
+    // configured
+    if (cloud_warm_reconnect) {
+        const auto family = ((const sockaddr*)&g_system_cloud_session_data.address)->sa_family;
+        if (family == AF_INET) {
+            return network_ready(NETWORK_INTERFACE_ALL, NETWORK_READY_TYPE_IPV4, nullptr);
+        } else if (family == AF_INET6) {
+            return network_ready(NETWORK_INTERFACE_ALL, NETWORK_READY_TYPE_IPV6, nullptr);
+        }
+    }
+#endif // HAL_PLATFORM_IFAPI && HAL_PLATFORM_CLOUD_UDP
+    return false;
+}
+
 void handle_cloud_errors()
 {
     if (Spark_Error_Count == 0) {
@@ -273,6 +311,10 @@ void handle_cfod()
 
 void cloud_connection_failed()
 {
+    if (cloud_warm_reconnect) {
+        LOG(WARN, "Warm reconnection failed");
+        cloud_warm_reconnect = false;
+    }
     if (cloud_failed_connection_attempts<255)
         cloud_failed_connection_attempts++;
     cloud_backoff_start = HAL_Timer_Get_Milli_Seconds();
@@ -291,7 +333,7 @@ void cloud_connection_failed()
 
 void establish_cloud_connection()
 {
-    if (network_ready(0, 0, 0) && !SPARK_WLAN_SLEEP && !SPARK_CLOUD_SOCKETED)
+    if (cloud_network_ready() && !SPARK_WLAN_SLEEP && !SPARK_CLOUD_SOCKETED)
     {
         LED_SIGNAL_START(CLOUD_CONNECTING, NORMAL);
         if (in_cloud_backoff_period())
@@ -308,12 +350,16 @@ void establish_cloud_connection()
         spark_cloud_udp_port_set(provider_data.port);
 #endif // PLATFORM_ID==PLATFORM_ELECTRON_PRODUCTION
 
-        INFO("Cloud: connecting");
+        INFO("Cloud: connecting%s", cloud_warm_reconnect ? " (warm)" : "");
         const auto diag = CloudDiagnostics::instance();
         diag->status(CloudDiagnostics::CONNECTING);
         system_notify_event(cloud_status, cloud_status_connecting);
         diag->connectionAttempt();
-        int connect_result = spark_cloud_socket_connect();
+        if (!cloud_connect_timing) {
+            cloud_connect_start = HAL_Timer_Get_Milli_Seconds();
+            cloud_connect_timing = true;
+        }
+        int connect_result = spark_cloud_socket_connect(cloud_warm_reconnect);
         if (connect_result >= 0)
         {
             SPARK_CLOUD_SOCKETED = 1;
@@ -378,11 +424,23 @@ void handle_cloud_connection(bool force_events)
                 if (!Spark_Communication_Loop()) {
                     err = protocol::MESSAGE_TIMEOUT;
                 } else {
-                    INFO("Cloud connected");
+                    const auto diag = CloudDiagnostics::instance();
+                    if (cloud_connect_timing) {
+                        const system_tick_t connect_time = HAL_Timer_Get_Milli_Seconds() - cloud_connect_start;
+                        INFO("Cloud connected in %u ms", (unsigned)connect_time);
+                        diag->connectionTime(connect_time);
+                        cloud_connect_timing = false;
+                    } else {
+                        INFO("Cloud connected");
+                    }
+                    if (cloud_warm_reconnect) {
+                        diag->warmReconnect();
+                        cloud_warm_reconnect = false;
+                    }
                     SPARK_CLOUD_CONNECTED = 1;
                     SPARK_CLOUD_HANDSHAKE_NOTIFY_DONE = 0;
                     cloud_failed_connection_attempts = 0;
-                    CloudDiagnostics::instance()->status(CloudDiagnostics::CONNECTED);
+                    diag->status(CloudDiagnostics::CONNECTED);
                     system_notify_event(cloud_status, cloud_status_connected);
                     if (system_mode() == SAFE_MODE) {
 /* FIXME: there should be macro that checks for NetworkManager availability */
@@ -603,6 +661,19 @@ void cloud_disconnect(unsigned flags, cloud_disconnect_reason cloudReason, netwo
         // Get disconnection options
         const auto opts = CloudConnectionSettings::instance()->takePendingDisconnectOptions();
         const bool graceful = (flags & CLOUD_DISCONNECT_GRACEFULLY) && opts.graceful();
+        // A connection that was lost due to an error can be quickly reestablished using the current
+        // session. A warm reconnection that is interrupted by another network error is retried
+        if ((SPARK_CLOUD_CONNECTED || cloud_warm_reconnect) && !opts.clearSession() &&
+                (cloudReason == CLOUD_DISCONNECT_REASON_ERROR || cloudReason == CLOUD_DISCONNECT_REASON_NETWORK_DISCONNECT)) {
+            cloud_warm_reconnect = true;
+        } else {
+            cloud_warm_reconnect = false;
+        }
+        if (cloudReason != CLOUD_DISCONNECT_REASON_ERROR && cloudReason != CLOUD_DISCONNECT_REASON_NETWORK_DISCONNECT &&
+                cloudReason != CLOUD_DISCONNECT_REASON_UNKNOWN && cloudReason != CLOUD_DISCONNECT_REASON_NONE) {
+            // The connection is closed intentionally, stop measuring the connection time
+            cloud_connect_timing = false;
+        }
         if (SPARK_CLOUD_CONNECTED) {
             if (graceful) {
                 // Notify the cloud that we're about to disconnect
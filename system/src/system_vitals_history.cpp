@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "system_vitals_history.h"
+
+#include "varint.h"
+#include "check.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace particle {
+
+namespace system {
+
+namespace {
+
+// Average size of an encoded sample. Used to estimate the size of the ring buffer
+const size_t AVG_SAMPLE_SIZE = 24;
+
+// Maximum size of an encoded sample
+const size_t MAX_SAMPLE_SIZE = maxUnsignedVarintSize<uint32_t>() * 2 +
+        VitalsHistory::MAX_SOURCES * (maxUnsignedVarintSize<uint32_t>() * 2);
+
+class SampleWriter {
+public:
+    explicit SampleWriter(uint8_t* buf) :
+            buf_(buf),
+            size_(0) {
+    }
+
+    void writeVarint(uint32_t val) {
+        size_ += encodeUnsignedVarint((char*)buf_ + size_, maxUnsignedVarintSize<uint32_t>(), val);
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    uint8_t* buf_;
+    size_t size_;
+};
+
+size_t varintSize(uint32_t val) {
+    size_t n = 1;
+    while (val >= 0x80) {
+        val >>= 7;
+        ++n;
+    }
+    return n;
+}
+
+bool appendVarint(appender_fn append, void* appendData, uint32_t val) {
+    char buf[maxUnsignedVarintSize<uint32_t>()];
+    const int n = encodeUnsignedVarint(buf, sizeof(buf), val);
+    return append(appendData, (const uint8_t*)buf, n);
+}
+
+} // namespace
+
+const size_t VitalsHistory::MAX_SOURCES;
+const size_t VitalsHistory::MAX_DEPTH;
+const uint8_t VitalsHistory::FORMAT_VERSION;
+
+VitalsHistory::VitalsHistory() :
+        bufSize_(0),
+        depth_(0),
+        head_(0),
+        size_(0),
+        count_(0),
+        srcCount_(0),
+        baseTime_(0),
+        lastTime_(0) {
+}
+
+int VitalsHistory::init(size_t depth, size_t bufferSize) {
+    buf_.reset();
+    bufSize_ = 0;
+    depth_ = 0;
+    head_ = 0;
+    size_ = 0;
+    count_ = 0;
+    srcCount_ = 0;
+    if (depth == 0) {
+        return 0;
+    }
+    if (bufferSize == 0) {
+        bufferSize = depth * AVG_SAMPLE_SIZE;
+    }
+    // Make sure the buffer can hold at least one sample. The buffer is never filled completely,
+    // so that the end of the data can be told apart from its start
+    bufferSize = std::max(bufferSize, MAX_SAMPLE_SIZE + 1);
+    buf_.reset(new(std::nothrow) uint8_t[bufferSize]);
+    CHECK_TRUE(buf_, SYSTEM_ERROR_NO_MEMORY);
+    bufSize_ = bufferSize;
+    depth_ = depth;
+    return 0;
+}
+
+int VitalsHistory::sample(system_tick_t time) {
+    CHECK_TRUE(buf_, SYSTEM_ERROR_INVALID_STATE);
+    diag_value values[MAX_SOURCES];
+    size_t count = 0;
+    CHECK(diag_snapshot(values, MAX_SOURCES, &count, nullptr));
+    return addSample(time, values, std::min(count, MAX_SOURCES));
+}
+
+int VitalsHistory::addSample(system_tick_t time, const diag_value* values, size_t count) {
+    CHECK_TRUE(buf_, SYSTEM_ERROR_INVALID_STATE);
+    if (count_ == 0 && srcCount_ == 0) {
+        baseTime_ = time;
+        lastTime_ = time;
+    }
+    struct Change {
+        uint8_t index;
+        int32_t delta;
+    };
+    Change changes[MAX_SOURCES];
+    size_t changed = 0;
+    size_t hint = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (values[i].error != 0) {
+            continue;
+        }
+        const int index = findSource(values[i].id, hint);
+        if (index < 0) {
+            continue; // Too many sources
+        }
+        hint = index + 1;
+        Source& src = srcs_[index];
+        if (src.last != values[i].value && changed < MAX_SOURCES) {
+            // Unsigned wrap-around yields the shortest difference between the values
+            changes[changed].index = index;
+            changes[changed].delta = (int32_t)((uint32_t)values[i].value - (uint32_t)src.last);
+            src.last = values[i].value;
+            ++changed;
+        }
+    }
+    // Sources are usually reported in the order of their indices already
+    std::sort(changes, changes + changed, [](const Change& a, const Change& b) {
+        return a.index < b.index;
+    });
+    uint8_t buf[MAX_SAMPLE_SIZE];
+    SampleWriter w(buf);
+    w.writeVarint(time - lastTime_);
+    w.writeVarint(changed);
+    int prevIndex = -1;
+    for (size_t i = 0; i < changed; ++i) {
+        w.writeVarint(changes[i].index - prevIndex - 1);
+        w.writeVarint(encodeZigZag(changes[i].delta));
+        prevIndex = changes[i].index;
+    }
+    const size_t size = w.size();
+    while (count_ > 0 && (count_ >= depth_ || bufSize_ - size_ <= size)) {
+        evict();
+    }
+    const size_t offs = (head_ + size_) % bufSize_;
+    const size_t n = std::min(size, bufSize_ - offs);
+    memcpy(buf_.get() + offs, buf, n);
+    memcpy(buf_.get(), buf + n, size - n);
+    size_ += size;
+    ++count_;
+    lastTime_ = time;
+    return 0;
+}
+
+int VitalsHistory::format(appender_fn append, void* appendData, system_tick_t now, size_t maxSize,
+        size_t* count) const {
+    // Determine how many samples fit
+    size_t headerSize = sizeof(uint16_t) + sizeof(FORMAT_VERSION) + varintSize(srcCount_);
+    for (size_t i = 0; i < srcCount_; ++i) {
+        headerSize += varintSize(srcs_[i].id) + varintSize(encodeZigZag(srcs_[i].base));
+    }
+    headerSize += varintSize(now - baseTime_);
+    size_t sampleCount = 0;
+    size_t dataSize = 0;
+    size_t offs = head_;
+    while (sampleCount < count_) {
+        size_t offs2 = offs;
+        const size_t n = skipSample(&offs2);
+        if (maxSize && headerSize + varintSize(sampleCount + 1) + dataSize + n > maxSize) {
+            break;
+        }
+        offs = offs2;
+        dataSize += n;
+        ++sampleCount;
+    }
+    CHECK_TRUE(!maxSize || headerSize + varintSize(sampleCount) + dataSize <= maxSize, SYSTEM_ERROR_TOO_LARGE);
+    const uint16_t idSize = 0;
+    CHECK_TRUE(append(appendData, (const uint8_t*)&idSize, sizeof(idSize)), SYSTEM_ERROR_TOO_LARGE);
+    CHECK_TRUE(append(appendData, &FORMAT_VERSION, sizeof(FORMAT_VERSION)), SYSTEM_ERROR_TOO_LARGE);
+    CHECK_TRUE(appendVarint(append, appendData, srcCount_), SYSTEM_ERROR_TOO_LARGE);
+    for (size_t i = 0; i < srcCount_; ++i) {
+        CHECK_TRUE(appendVarint(append, appendData, srcs_[i].id), SYSTEM_ERROR_TOO_LARGE);
+        CHECK_TRUE(appendVarint(append, appendData, encodeZigZag(srcs_[i].base)), SYSTEM_ERROR_TOO_LARGE);
+    }
+    CHECK_TRUE(appendVarint(append, appendData, now - baseTime_), SYSTEM_ERROR_TOO_LARGE);
+    CHECK_TRUE(appendVarint(append, appendData, sampleCount), SYSTEM_ERROR_TOO_LARGE);
+    if (dataSize > 0) {
+        const size_t n = std::min(dataSize, bufSize_ - head_);
+        CHECK_TRUE(append(appendData, buf_.get() + head_, n), SYSTEM_ERROR_TOO_LARGE);
+        if (n < dataSize) {
+            CHECK_TRUE(append(appendData, buf_.get(), dataSize - n), SYSTEM_ERROR_TOO_LARGE);
+        }
+    }
+    if (count) {
+        *count = sampleCount;
+    }
+    return 0;
+}
+
+void VitalsHistory::discard(size_t count) {
+    count = std::min(count, count_);
+    for (size_t i = 0; i < count; ++i) {
+        evict();
+    }
+}
+
+void VitalsHistory::clear() {
+    for (size_t i = 0; i < srcCount_; ++i) {
+        srcs_[i].base = srcs_[i].last;
+    }
+    baseTime_ = lastTime_;
+    head_ = 0;
+    size_ = 0;
+    count_ = 0;
+}
+
+VitalsHistory* VitalsHistory::instance() {
+    static VitalsHistory history;
+    return &history;
+}
+
+int VitalsHistory::findSource(uint16_t id, size_t hint) {
+    if (hint < srcCount_ && srcs_[hint].id == id) {
+        return hint;
+    }
+    for (size_t i = 0; i < srcCount_; ++i) {
+        if (srcs_[i].id == id) {
+            return i;
+        }
+    }
+    if (srcCount_ == MAX_SOURCES) {
+        return -1;
+    }
+    // New sources start at 0 in the base snapshot
+    Source& src = srcs_[srcCount_];
+    src.id = id;
+    src.base = 0;
+    src.last = 0;
+    return srcCount_++;
+}
+
+void VitalsHistory::evict() {
+    size_t offs = head_;
+    baseTime_ += readVarint(&offs);
+    const size_t changed = readVarint(&offs);
+    size_t index = 0;
+    for (size_t i = 0; i < changed; ++i) {
+        index += readVarint(&offs);
+        srcs_[index].base = (int32_t)((uint32_t)srcs_[index].base + (uint32_t)decodeZigZag(readVarint(&offs)));
+        ++index;
+    }
+    const size_t size = (offs >= head_) ? offs - head_ : offs + bufSize_ - head_;
+    head_ = offs % bufSize_;
+    size_ -= size;
+    --count_;
+}
+
+size_t VitalsHistory::skipSample(size_t* offs) const {
+    const size_t start = *offs;
+    readVarint(offs); // Time
+    const size_t changed = readVarint(offs);
+    for (size_t i = 0; i < changed * 2; ++i) {
+        readVarint(offs);
+    }
+    return (*offs >= start) ? *offs - start : *offs + bufSize_ - start;
+}
+
+uint32_t VitalsHistory::readVarint(size_t* offs) const {
+    uint32_t val = 0;
+    unsigned shift = 0;
+    uint8_t b = 0;
+    do {
+        b = buf_[*offs];
+        *offs = (*offs + 1) % bufSize_;
+        val |= (uint32_t)(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return val;
+}
+
+} // namespace system
+
+} // namespace particle
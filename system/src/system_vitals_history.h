@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "appender.h"
+#include "diagnostics.h"
+#include "system_tick_hal.h"
+
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace particle {
+
+namespace system {
+
+/**
+ * In-RAM history of periodic diagnostic samples.
+ *
+ * Samples are stored in a ring buffer in a delta-encoded form: each sample contains only the
+ * sources that have changed since the previous sample. When the oldest sample is evicted, its
+ * changes are folded into the base snapshot, so the history can always be reconstructed.
+ *
+ * Serialized format (all integers are varints unless noted otherwise):
+ *
+ * - `uint16_t` 0 (native byte order). The legacy binary format starts with the size of a source
+ *   ID, which is never 0.
+ * - `uint8_t` format version (`FORMAT_VERSION`).
+ * - Number of sources, followed by the ID and zigzag-encoded base value of each source.
+ * - Age of the base snapshot in milliseconds.
+ * - Number of samples, followed by the samples. A sample is encoded as the time in milliseconds
+ *   since the previous sample or the base snapshot, the number of changed sources, and a pair of
+ *   values for each changed source: the difference between the source's index and the index of
+ *   the previous changed source minus one, and the zigzag-encoded difference between the new and
+ *   old values of the source. Changed sources are sorted by index.
+ */
+class VitalsHistory {
+public:
+    static const size_t MAX_SOURCES = 48;
+    /**
+     * Maximum depth of the history used by the system. A full history of typical samples needs
+     * to fit in a single vitals message.
+     */
+    static const size_t MAX_DEPTH = 24;
+    static const uint8_t FORMAT_VERSION = 1;
+
+    VitalsHistory();
+
+    /**
+     * Allocates the ring buffer.
+     *
+     * @param depth Maximum number of samples. If 0, the buffer is freed.
+     * @param bufferSize Size of the ring buffer. If 0, the size is estimated based on the depth.
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int init(size_t depth, size_t bufferSize = 0);
+
+    /**
+     * Records the current values of all registered diagnostic sources.
+     */
+    int sample(system_tick_t time);
+
+    /**
+     * Records a sample.
+     *
+     * @param time Sample time.
+     * @param values Values of the sources. The order of the sources should be consistent across
+     *        the samples. Values with a non-zero error code are ignored.
+     * @param count Number of values.
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int addSample(system_tick_t time, const diag_value* values, size_t count);
+
+    /**
+     * Serializes the history.
+     *
+     * If the size of the serialized data is limited, only as many of the oldest samples as fit
+     * are serialized.
+     *
+     * @param append Appender function.
+     * @param appendData Opaque data passed to the appender function.
+     * @param now Current time.
+     * @param maxSize Maximum size of the serialized data, or 0 if the size is not limited.
+     * @param[out] count Number of serialized samples.
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int format(appender_fn append, void* appendData, system_tick_t now, size_t maxSize = 0,
+            size_t* count = nullptr) const;
+
+    /**
+     * Discards the oldest samples. The samples are folded into the base snapshot.
+     *
+     * @param count Number of samples.
+     */
+    void discard(size_t count);
+
+    /**
+     * Discards all samples. The most recent values become the new base snapshot.
+     */
+    void clear();
+
+    size_t sampleCount() const {
+        return count_;
+    }
+
+    size_t dataSize() const {
+        return size_;
+    }
+
+    size_t sourceCount() const {
+        return srcCount_;
+    }
+
+    bool isEnabled() const {
+        return (bool)buf_;
+    }
+
+    /**
+     * Returns the instance used by the system for vitals publishing.
+     */
+    static VitalsHistory* instance();
+
+    // This class is non-copyable
+    VitalsHistory(const VitalsHistory&) = delete;
+    VitalsHistory& operator=(const VitalsHistory&) = delete;
+
+private:
+    struct Source {
+        uint16_t id;
+        int32_t base; // Value in the base snapshot
+        int32_t last; // Value in the most recent sample
+    };
+
+    Source srcs_[MAX_SOURCES];
+    std::unique_ptr<uint8_t[]> buf_;
+    size_t bufSize_;
+    size_t depth_;
+    size_t head_; // Offset of the oldest sample
+    size_t size_; // Number of bytes used
+    size_t count_; // Number of samples
+    size_t srcCount_;
+    system_tick_t baseTime_;
+    system_tick_t lastTime_;
+
+    int findSource(uint16_t id, size_t hint);
+    void evict();
+    size_t skipSample(size_t* offs) const;
+    uint32_t readVarint(size_t* offs) const;
+};
+
+} // namespace system
+
+} // namespace particle
@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "system_vitals_history.h"
+#include "diagnostics.h"
+#include "varint.h"
+
+#include <catch2/catch.hpp>
+
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace particle;
+using namespace particle::system;
+
+namespace {
+
+typedef std::map<uint16_t, int32_t> Values;
+
+struct Sample {
+    system_tick_t time;
+    Values values;
+
+    bool operator==(const Sample& s) const {
+        return time == s.time && values == s.values;
+    }
+};
+
+class Decoder {
+public:
+    explicit Decoder(const std::string& data) :
+            d_(data),
+            offs_(0) {
+    }
+
+    // Reconstructs the samples. The time of each sample is relative to the time of formatting
+    std::vector<Sample> decode(system_tick_t now, Values* base = nullptr) {
+        REQUIRE(d_.size() >= 3);
+        REQUIRE(d_[0] == 0);
+        REQUIRE(d_[1] == 0);
+        REQUIRE((uint8_t)d_[2] == VitalsHistory::FORMAT_VERSION);
+        offs_ = 3;
+        const uint32_t srcCount = readVarint();
+        std::vector<uint16_t> ids;
+        Values vals;
+        for (uint32_t i = 0; i < srcCount; ++i) {
+            const uint16_t id = readVarint();
+            ids.push_back(id);
+            vals[id] = decodeZigZag(readVarint());
+        }
+        if (base) {
+            *base = vals;
+        }
+        system_tick_t time = now - readVarint();
+        const uint32_t count = readVarint();
+        std::vector<Sample> samples;
+        for (uint32_t i = 0; i < count; ++i) {
+            time += readVarint();
+            const uint32_t changed = readVarint();
+            uint32_t index = 0;
+            for (uint32_t j = 0; j < changed; ++j) {
+                index += readVarint();
+                REQUIRE(index < ids.size());
+                auto& v = vals[ids[index]];
+                v = (int32_t)((uint32_t)v + (uint32_t)decodeZigZag(readVarint()));
+                ++index;
+            }
+            samples.push_back({ time, vals });
+        }
+        CHECK(offs_ == d_.size());
+        return samples;
+    }
+
+private:
+    std::string d_;
+    size_t offs_;
+
+    uint32_t readVarint() {
+        uint32_t v = 0;
+        const int n = decodeUnsignedVarint(d_.data() + offs_, d_.size() - offs_, &v);
+        REQUIRE(n > 0);
+        offs_ += n;
+        return v;
+    }
+};
+
+bool appendToString(void* data, const uint8_t* buf, size_t size) {
+    static_cast<std::string*>(data)->append((const char*)buf, size);
+    return true;
+}
+
+std::string format(const VitalsHistory& h, system_tick_t now, size_t maxSize = 0, size_t* count = nullptr) {
+    std::string s;
+    REQUIRE(h.format(appendToString, &s, now, maxSize, count) == 0);
+    return s;
+}
+
+int addSample(VitalsHistory* h, system_tick_t time, const Values& values) {
+    std::vector<diag_value> v;
+    for (const auto& p: values) {
+        v.push_back({ p.first, DIAG_TYPE_INT, p.second, 0 });
+    }
+    return h->addSample(time, v.data(), v.size());
+}
+
+// Diagnostic sources returned by diag_snapshot()
+std::vector<diag_source> g_sources;
+Values g_values;
+
+int getSourceValue(const diag_source* src, int cmd, void* data) {
+    REQUIRE(cmd == DIAG_SOURCE_CMD_GET);
+    const auto d = static_cast<diag_source_get_cmd_data*>(data);
+    if (!d->data) {
+        d->data_size = sizeof(int32_t);
+        return 0;
+    }
+    const auto it = g_values.find(src->id);
+    if (it == g_values.end()) {
+        return SYSTEM_ERROR_NOT_FOUND;
+    }
+    memcpy(d->data, &it->second, sizeof(int32_t));
+    d->data_size = sizeof(int32_t);
+    return 0;
+}
+
+void addSource(uint16_t id, diag_type type) {
+    diag_source src = {};
+    src.size = sizeof(src);
+    src.id = id;
+    src.type = type;
+    src.callback = getSourceValue;
+    g_sources.push_back(src);
+}
+
+} // namespace
+
+extern "C" int diag_snapshot(diag_value* values, size_t count, size_t* total, void* reserved) {
+    for (size_t i = 0; i < g_sources.size() && i < count; ++i) {
+        const diag_source& src = g_sources[i];
+        diag_value& v = values[i];
+        v.id = src.id;
+        v.type = src.type;
+        diag_source_get_cmd_data d = { sizeof(diag_source_get_cmd_data), 0, &v.value, sizeof(v.value) };
+        v.error = src.callback(&src, DIAG_SOURCE_CMD_GET, &d);
+    }
+    if (total) {
+        *total = g_sources.size();
+    }
+    return 0;
+}
+
+TEST_CASE("VitalsHistory") {
+    VitalsHistory h;
+
+    SECTION("fails if not initialized") {
+        CHECK(!h.isEnabled());
+        CHECK(addSample(&h, 0, {{ 1, 1 }}) == SYSTEM_ERROR_INVALID_STATE);
+        CHECK(h.sample(0) == SYSTEM_ERROR_INVALID_STATE);
+    }
+
+    SECTION("reconstructs the samples") {
+        REQUIRE(h.init(10) == 0);
+        CHECK(h.isEnabled());
+        const std::vector<Sample> samples = {
+            { 1000, {{ 1, 10 }, { 2, -5 }, { 7, 1000000 }} },
+            { 2000, {{ 1, 10 }, { 2, -4 }, { 7, 1000000 }} },
+            { 3000, {{ 1, 11 }, { 2, -4 }, { 7, 999990 }} },
+            { 4500, {{ 1, 11 }, { 2, -4 }, { 7, 999990 }} }
+        };
+        for (const auto& s: samples) {
+            REQUIRE(addSample(&h, s.time, s.values) == 0);
+        }
+        CHECK(h.sampleCount() == 4);
+        CHECK(h.sourceCount() == 3);
+        Decoder d(format(h, 5000));
+        CHECK(d.decode(5000) == samples);
+    }
+
+    SECTION("encodes only the changed sources") {
+        REQUIRE(h.init(10) == 0);
+        Values v;
+        for (uint16_t id = 1; id <= 30; ++id) {
+            v[id] = id * 1000;
+        }
+        REQUIRE(addSample(&h, 0, v) == 0);
+        const size_t first = h.dataSize();
+        v[5] += 1;
+        v[20] -= 1;
+        REQUIRE(addSample(&h, 1000, v) == 0);
+        // Time, count and 2 pairs of single-byte varints
+        CHECK(h.dataSize() - first == 2 + 1 + 4);
+        REQUIRE(addSample(&h, 2000, v) == 0);
+        CHECK(h.dataSize() - first == 2 + 1 + 4 + 2 + 1);
+    }
+
+    SECTION("handles wrap-around of the values") {
+        REQUIRE(h.init(10) == 0);
+        const std::vector<Sample> samples = {
+            { 0, {{ 1, std::numeric_limits<int32_t>::min() }, { 2, -1 /* UINT32_MAX */ }} },
+            { 10, {{ 1, std::numeric_limits<int32_t>::max() }, { 2, 0 }} },
+            { 20, {{ 1, 0 }, { 2, std::numeric_limits<int32_t>::min() }} }
+        };
+        for (const auto& s: samples) {
+            REQUIRE(addSample(&h, s.time, s.values) == 0);
+        }
+        Decoder d(format(h, 20));
+        CHECK(d.decode(20) == samples);
+    }
+
+    SECTION("handles sources that appear later or are reported out of order") {
+        REQUIRE(h.init(10) == 0);
+        REQUIRE(addSample(&h, 0, {{ 3, 3 }}) == 0);
+        std::vector<diag_value> v = {{ 5, DIAG_TYPE_INT, 5, 0 }, { 1, DIAG_TYPE_INT, 1, 0 }, { 3, DIAG_TYPE_INT, 4, 0 }};
+        REQUIRE(h.addSample(10, v.data(), v.size()) == 0);
+        Decoder d(format(h, 10));
+        const std::vector<Sample> expected = {
+            { 0, {{ 1, 0 }, { 3, 3 }, { 5, 0 }} },
+            { 10, {{ 1, 1 }, { 3, 4 }, { 5, 5 }} }
+        };
+        CHECK(d.decode(10) == expected);
+    }
+
+    SECTION("evicts the oldest samples when the depth is exceeded") {
+        REQUIRE(h.init(3) == 0);
+        std::vector<Sample> samples;
+        for (int i = 0; i < 10; ++i) {
+            samples.push_back({ (system_tick_t)i * 100, {{ 1, i * i }, { 2, 100 - i }, { 3, i / 3 }} });
+            REQUIRE(addSample(&h, samples.back().time, samples.back().values) == 0);
+        }
+        CHECK(h.sampleCount() == 3);
+        Decoder d(format(h, 2000));
+        Values base;
+        CHECK(d.decode(2000, &base) == std::vector<Sample>(samples.end() - 3, samples.end()));
+        CHECK(base == samples[6].values);
+    }
+
+    SECTION("evicts the oldest samples when the buffer is full") {
+        REQUIRE(h.init(1000, 1) == 0); // Minimum buffer size
+        std::vector<Sample> samples;
+        for (int i = 0; i < 200; ++i) {
+            Values v;
+            for (uint16_t id = 1; id <= VitalsHistory::MAX_SOURCES; ++id) {
+                v[id] = i * (id % 2 ? 100000 : -3);
+            }
+            samples.push_back({ (system_tick_t)i * 60000, v });
+            REQUIRE(addSample(&h, samples.back().time, samples.back().values) == 0);
+        }
+        const size_t count = h.sampleCount();
+        CHECK(count > 0);
+        CHECK(count < 200);
+        Decoder d(format(h, samples.back().time));
+        CHECK(d.decode(samples.back().time) == std::vector<Sample>(samples.end() - count, samples.end()));
+    }
+
+    SECTION("ignores sources exceeding the limit") {
+        REQUIRE(h.init(10) == 0);
+        Values v;
+        for (uint16_t id = 1; id <= VitalsHistory::MAX_SOURCES + 5; ++id) {
+            v[id] = id;
+        }
+        REQUIRE(addSample(&h, 0, v) == 0);
+        CHECK(h.sourceCount() == VitalsHistory::MAX_SOURCES);
+    }
+
+    SECTION("clear() makes the latest values the new base") {
+        REQUIRE(h.init(10) == 0);
+        REQUIRE(addSample(&h, 0, {{ 1, 1 }, { 2, 2 }}) == 0);
+        REQUIRE(addSample(&h, 100, {{ 1, 3 }, { 2, 2 }}) == 0);
+        h.clear();
+        CHECK(h.sampleCount() == 0);
+        CHECK(h.dataSize() == 0);
+        Values base;
+        Decoder d1(format(h, 150));
+        CHECK(d1.decode(150, &base).empty());
+        CHECK(base == Values({{ 1, 3 }, { 2, 2 }}));
+        REQUIRE(addSample(&h, 200, {{ 1, 3 }, { 2, 5 }}) == 0);
+        Decoder d2(format(h, 200));
+        const std::vector<Sample> expected = { { 200, {{ 1, 3 }, { 2, 5 }} } };
+        CHECK(d2.decode(200) == expected);
+    }
+
+    SECTION("format() includes only the oldest samples that fit in the maximum size") {
+        // Full-depth history with all sources changing in every sample
+        REQUIRE(h.init(VitalsHistory::MAX_DEPTH, 16384) == 0);
+        std::vector<Sample> samples;
+        for (size_t i = 0; i < VitalsHistory::MAX_DEPTH; ++i) {
+            Values v;
+            for (uint16_t id = 1; id <= VitalsHistory::MAX_SOURCES; ++id) {
+                v[id] = (i + 1) * id * 100000;
+            }
+            samples.push_back({ (system_tick_t)i * 60000, v });
+            REQUIRE(addSample(&h, samples.back().time, samples.back().values) == 0);
+        }
+        REQUIRE(h.sampleCount() == VitalsHistory::MAX_DEPTH);
+        const system_tick_t now = samples.back().time;
+        const size_t maxSize = 1024;
+        CHECK(format(h, now).size() > maxSize);
+        size_t count = 0;
+        const auto s1 = format(h, now, maxSize, &count);
+        CHECK(s1.size() <= maxSize);
+        CHECK(count > 0);
+        CHECK(count < VitalsHistory::MAX_DEPTH);
+        Decoder d1(s1);
+        CHECK(d1.decode(now) == std::vector<Sample>(samples.begin(), samples.begin() + count));
+        // The remaining samples are sent next time
+        h.discard(count);
+        CHECK(h.sampleCount() == VitalsHistory::MAX_DEPTH - count);
+        size_t count2 = 0;
+        Decoder d2(format(h, now, 0, &count2));
+        CHECK(count2 == VitalsHistory::MAX_DEPTH - count);
+        Values base;
+        CHECK(d2.decode(now, &base) == std::vector<Sample>(samples.begin() + count, samples.end()));
+        CHECK(base == samples[count - 1].values);
+    }
+
+    SECTION("format() fails if not even the base snapshot fits in the maximum size") {
+        REQUIRE(h.init(10) == 0);
+        REQUIRE(addSample(&h, 0, {{ 1, 1 }, { 2, 2 }}) == 0);
+        std::string s;
+        CHECK(h.format(appendToString, &s, 0, 4) == SYSTEM_ERROR_TOO_LARGE);
+        CHECK(s.empty());
+    }
+
+    SECTION("samples the registered diagnostic sources") {
+        g_sources.clear();
+        addSource(10, DIAG_TYPE_INT);
+        addSource(20, DIAG_TYPE_UINT);
+        addSource(30, DIAG_TYPE_INT); // Fails to provide a value
+        g_values = {{ 10, -7 }, { 20, 42 }};
+        REQUIRE(h.init(5) == 0);
+        REQUIRE(h.sample(1000) == 0);
+        g_values[20] = 43;
+        REQUIRE(h.sample(2000) == 0);
+        Decoder d(format(h, 2000));
+        const std::vector<Sample> expected = {
+            { 1000, {{ 10, -7 }, { 20, 42 }} },
+            { 2000, {{ 10, -7 }, { 20, 43 }} }
+        };
+        CHECK(d.decode(2000) == expected);
+    }
+
+    SECTION("a minute of history takes a fraction of the size of full snapshots") {
+        REQUIRE(h.init(60) == 0);
+        Values v;
+        for (uint16_t id = 1; id <= 30; ++id) {
+            v[id] = id * 12345;
+        }
+        for (int i = 0; i < 60; ++i) {
+            v[2] += 100; // Uptime-like counter
+            if (i % 10 == 0) {
+                v[7] -= 1;
+            }
+            REQUIRE(addSample(&h, i * 1000, v) == 0);
+        }
+        CHECK(h.sampleCount() == 60);
+        // Legacy binary format: 4 bytes of header and 6 bytes per source
+        const size_t fullSize = 4 + 30 * 6;
+        CHECK(format(h, 60000).size() < fullSize * 60 / 10);
+    }
+}
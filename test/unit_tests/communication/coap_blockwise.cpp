@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "coap_blockwise.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+
+using namespace particle;
+using namespace particle::protocol;
+
+namespace {
+
+const size_t BLOCK_SIZE = 16;
+
+// Generates a payload that differs in every block
+std::string makePayload(size_t size) {
+    std::string s;
+    for (size_t i = 0; i < size; ++i) {
+        s += (char)('a' + (i / BLOCK_SIZE) % 26);
+    }
+    return s;
+}
+
+int receiveBlock(CoapBlockReceiver& r, const std::string& payload, unsigned num, const std::string& key = "fn") {
+    const size_t offs = num * BLOCK_SIZE;
+    const size_t size = std::min(BLOCK_SIZE, payload.size() - offs);
+    const bool more = offs + size < payload.size();
+    return r.receive(key.data(), key.size(), num, more, BLOCK_SIZE, payload.data() + offs, size);
+}
+
+std::unique_ptr<char[]> copyPayload(const std::string& payload) {
+    std::unique_ptr<char[]> d(new char[payload.size()]);
+    memcpy(d.get(), payload.data(), payload.size());
+    return d;
+}
+
+} // namespace
+
+TEST_CASE("CoapBlockReceiver") {
+    CoapBlockReceiver r(1024);
+
+    SECTION("reassembles a payload received in order") {
+        const auto payload = makePayload(BLOCK_SIZE * 3 + 5);
+        CHECK(receiveBlock(r, payload, 0) == 0);
+        CHECK(receiveBlock(r, payload, 1) == 0);
+        CHECK(receiveBlock(r, payload, 2) == 0);
+        CHECK(r.isActive());
+        REQUIRE(receiveBlock(r, payload, 3) == 1);
+        CHECK(r.size() == payload.size());
+        CHECK(std::string(r.data()) == payload);
+    }
+
+    SECTION("reassembles a payload received out of order") {
+        const auto payload = makePayload(BLOCK_SIZE * 5);
+        CHECK(receiveBlock(r, payload, 2) == 0);
+        CHECK(receiveBlock(r, payload, 4) == 0); // Last block
+        CHECK(receiveBlock(r, payload, 0) == 0);
+        CHECK(receiveBlock(r, payload, 3) == 0);
+        REQUIRE(receiveBlock(r, payload, 1) == 1);
+        CHECK(std::string(r.data()) == payload);
+    }
+
+    SECTION("ignores duplicate blocks") {
+        const auto payload = makePayload(BLOCK_SIZE * 2 + 1);
+        CHECK(receiveBlock(r, payload, 0) == 0);
+        CHECK(receiveBlock(r, payload, 0) == 0);
+        CHECK(receiveBlock(r, payload, 1) == 0);
+        CHECK(receiveBlock(r, payload, 1) == 0);
+        REQUIRE(receiveBlock(r, payload, 2) == 1);
+        CHECK(std::string(r.data()) == payload);
+    }
+
+    SECTION("rejects a block that is out of the receiver window") {
+        const auto payload = makePayload(BLOCK_SIZE * (BLOCK1_RECEIVE_WINDOW_SIZE + 2));
+        CHECK(receiveBlock(r, payload, BLOCK1_RECEIVE_WINDOW_SIZE) == SYSTEM_ERROR_NOT_ENOUGH_DATA);
+        CHECK(!r.isActive());
+        CHECK(receiveBlock(r, payload, 1) == 0);
+        CHECK(receiveBlock(r, payload, BLOCK1_RECEIVE_WINDOW_SIZE) == SYSTEM_ERROR_NOT_ENOUGH_DATA);
+        // The window moves as the blocks are received in sequence
+        CHECK(receiveBlock(r, payload, 0) == 0);
+        CHECK(receiveBlock(r, payload, BLOCK1_RECEIVE_WINDOW_SIZE) == 0);
+        for (unsigned i = 2; i < BLOCK1_RECEIVE_WINDOW_SIZE; ++i) {
+            REQUIRE(receiveBlock(r, payload, i) == 0);
+        }
+        REQUIRE(receiveBlock(r, payload, BLOCK1_RECEIVE_WINDOW_SIZE + 1) == 1);
+        CHECK(std::string(r.data()) == payload);
+    }
+
+    SECTION("rejects a change of the block size in the middle of a transfer") {
+        const auto payload = makePayload(BLOCK_SIZE * 4);
+        CHECK(receiveBlock(r, payload, 0) == 0);
+        CHECK(r.receive("fn", 2, 1, true, BLOCK_SIZE * 2, payload.data(), BLOCK_SIZE * 2) == SYSTEM_ERROR_NOT_ENOUGH_DATA);
+    }
+
+    SECTION("starts a new transfer when a block of another payload is received") {
+        const auto payload1 = makePayload(BLOCK_SIZE * 3);
+        const auto payload2 = std::string(BLOCK_SIZE + 1, 'x');
+        CHECK(receiveBlock(r, payload1, 0, "fn1") == 0);
+        CHECK(receiveBlock(r, payload2, 0, "fn2") == 0);
+        REQUIRE(receiveBlock(r, payload2, 1, "fn2") == 1);
+        CHECK(std::string(r.data()) == payload2);
+    }
+
+    SECTION("fails if the payload is too large") {
+        CoapBlockReceiver r2(BLOCK_SIZE * 2);
+        const auto payload = makePayload(BLOCK_SIZE * 2 + 1);
+        CHECK(receiveBlock(r2, payload, 0) == 0);
+        CHECK(receiveBlock(r2, payload, 1) == 0);
+        CHECK(receiveBlock(r2, payload, 2) == SYSTEM_ERROR_TOO_LARGE);
+    }
+
+    SECTION("rejects a block that is smaller than the block size unless it's the last one") {
+        CHECK(r.receive("fn", 2, 0, true, BLOCK_SIZE, "abc", 3) == SYSTEM_ERROR_BAD_DATA);
+        REQUIRE(r.receive("fn", 2, 0, false, BLOCK_SIZE, "abc", 3) == 1);
+        CHECK(std::string(r.data()) == "abc");
+    }
+}
+
+TEST_CASE("CoapBlockSender") {
+    CoapBlockSender s;
+    const auto payload = makePayload(BLOCK_SIZE * (BLOCK1_SEND_WINDOW_SIZE + 2) + 3);
+    const unsigned blockCount = BLOCK1_SEND_WINDOW_SIZE + 3;
+    REQUIRE(s.init(copyPayload(payload), payload.size(), BLOCK_SIZE) == 0);
+    CHECK(s.isActive());
+
+    // Sends the blocks within the window and returns the number of blocks sent
+    unsigned nextId = 100;
+    std::string received;
+    auto sendBlocks = [&]() {
+        unsigned n = 0;
+        while (s.hasNextBlock()) {
+            unsigned num = 0;
+            const char* data = nullptr;
+            size_t size = 0;
+            bool more = false;
+            s.nextBlock(&num, &data, &size, &more);
+            CHECK(more == (num + 1 < blockCount));
+            received.resize(std::max(received.size(), num * BLOCK_SIZE + size));
+            received.replace(num * BLOCK_SIZE, size, data, size);
+            s.blockSent(nextId + num);
+            ++n;
+        }
+        return n;
+    };
+
+    SECTION("limits the number of blocks in flight") {
+        CHECK(sendBlocks() == BLOCK1_SEND_WINDOW_SIZE);
+        CHECK(s.findBlock(nextId + BLOCK1_SEND_WINDOW_SIZE) == SYSTEM_ERROR_NOT_FOUND);
+        // Acknowledge the blocks out of order
+        REQUIRE(s.findBlock(nextId + 1) == 1);
+        CHECK(s.blockAcked(1) == 0);
+        CHECK(sendBlocks() == 0); // Block 0 is still in flight
+        REQUIRE(s.findBlock(nextId) == 0);
+        CHECK(s.blockAcked(0) == 0);
+        CHECK(s.findBlock(nextId) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(sendBlocks() == 2);
+    }
+
+    SECTION("sends the last block once all other blocks are acknowledged") {
+        CHECK(sendBlocks() == BLOCK1_SEND_WINDOW_SIZE);
+        for (unsigned i = 0; i < BLOCK1_SEND_WINDOW_SIZE; ++i) {
+            REQUIRE(s.blockAcked(i) == 0);
+        }
+        CHECK(sendBlocks() == 2);
+        CHECK(s.blockAcked(BLOCK1_SEND_WINDOW_SIZE + 1) == 0);
+        CHECK(sendBlocks() == 0);
+        CHECK(s.blockAcked(BLOCK1_SEND_WINDOW_SIZE) == 0);
+        CHECK(sendBlocks() == 1);
+        CHECK(s.blockAcked(blockCount - 1) == 1);
+        CHECK(received == payload);
+    }
+
+    SECTION("rejects an invalid block size") {
+        CHECK(s.init(copyPayload(payload), payload.size(), BLOCK_SIZE + 1) == SYSTEM_ERROR_INVALID_ARGUMENT);
+    }
+}
@@ -436,6 +436,51 @@ TEST_CASE("CoapMessageDecoder") {
             CHECK(it == CoapOptionIterator());
         }
     }
+    SECTION("decodes block options correctly") {
+        auto d = makeDecoder();
+        unsigned num = 0;
+        bool more = false;
+        size_t size = 0;
+        SECTION("first block") {
+            auto buf = std::string("\x42\x45\x04\xd2\xaa\xbb\xd0\x0a", 8);
+            CHECK(d.decode(buf.data(), buf.size()) == 8);
+            CHECK(d.blockOption(CoapOption::BLOCK2, &num, &more, &size) == 0);
+            CHECK(num == 0);
+            CHECK(!more);
+            CHECK(size == 16);
+        }
+        SECTION("block with more flag") {
+            auto buf = std::string("\x42\x45\x04\xd2\xaa\xbb\xd1\x0a\x1d", 9);
+            CHECK(d.decode(buf.data(), buf.size()) == 9);
+            CHECK(d.blockOption(CoapOption::BLOCK2, &num, &more, &size) == 0);
+            CHECK(num == 1);
+            CHECK(more);
+            CHECK(size == 512);
+        }
+        SECTION("largest block number") {
+            auto buf = std::string("\x42\x45\x04\xd2\xaa\xbb\xd3\x0e\xff\xff\xf6", 11);
+            CHECK(d.decode(buf.data(), buf.size()) == 11);
+            CHECK(d.blockOption(CoapOption::BLOCK1, &num, &more, &size) == 0);
+            CHECK(num == MAX_COAP_BLOCK_NUMBER);
+            CHECK(!more);
+            CHECK(size == 1024);
+        }
+        SECTION("missing option") {
+            auto buf = std::string("\x42\x45\x04\xd2\xaa\xbb\xd1\x0a\x1d", 9);
+            CHECK(d.decode(buf.data(), buf.size()) == 9);
+            CHECK(d.blockOption(CoapOption::BLOCK1, &num, &more, &size) == SYSTEM_ERROR_NOT_FOUND);
+        }
+        SECTION("reserved block size") {
+            auto buf = std::string("\x42\x45\x04\xd2\xaa\xbb\xd1\x0a\x07", 9);
+            CHECK(d.decode(buf.data(), buf.size()) == 9);
+            CHECK(d.blockOption(CoapOption::BLOCK2, &num, &more, &size) == SYSTEM_ERROR_BAD_DATA);
+        }
+        SECTION("option value is too long") {
+            auto buf = std::string("\x42\x45\x04\xd2\xaa\xbb\xd4\x0a\x00\x00\x00\x10", 12);
+            CHECK(d.decode(buf.data(), buf.size()) == 12);
+            CHECK(d.blockOption(CoapOption::BLOCK2, &num, &more, &size) == SYSTEM_ERROR_BAD_DATA);
+        }
+    }
     SECTION("decodes payload data correctly") {
         auto d = makeDecoder();
         SECTION("empty") {
@@ -457,6 +457,37 @@ TEST_CASE("CoapMessageEncoder") {
             CHECK(memcmp(buf, "\x42\x45\x04\xd2\xaa\xbb\x11\x61\x21\x62\x11\x63\x10\x21\x01\x11\x64\x31\x65\x11\x02\x21\x03\x11\x66\x21\x04\x31\x67\xd1\x02\x68\x41\x69\xd1\x08\x05\xff\x78", 39) == 0);
         }
     }
+    SECTION("encodes block options correctly") {
+        char buf[32] = {};
+        auto e = makeEncoder(buf, sizeof(buf));
+        e.type(CoapType::CON);
+        e.code(CoapCode::CONTENT);
+        e.id(1234);
+        e.token("\xaa\xbb", 2);
+        SECTION("first block") {
+            e.blockOption(CoapOption::BLOCK2, 0, false, 16);
+            CHECK(e.encode() == 8);
+            CHECK(std::string(buf, 8) == std::string("\x42\x45\x04\xd2\xaa\xbb\xd0\x0a", 8));
+        }
+        SECTION("block with more flag") {
+            e.blockOption(CoapOption::BLOCK2, 1, true, 512);
+            CHECK(e.encode() == 9);
+            CHECK(std::string(buf, 9) == std::string("\x42\x45\x04\xd2\xaa\xbb\xd1\x0a\x1d", 9));
+        }
+        SECTION("largest block number") {
+            e.blockOption(CoapOption::BLOCK1, MAX_COAP_BLOCK_NUMBER, false, 1024);
+            CHECK(e.encode() == 11);
+            CHECK(std::string(buf, 11) == std::string("\x42\x45\x04\xd2\xaa\xbb\xd3\x0e\xff\xff\xf6", 11));
+        }
+        SECTION("invalid block size") {
+            e.blockOption(CoapOption::BLOCK2, 0, false, 100);
+            CHECK(e.encode() == SYSTEM_ERROR_INVALID_ARGUMENT);
+        }
+        SECTION("invalid block number") {
+            e.blockOption(CoapOption::BLOCK2, MAX_COAP_BLOCK_NUMBER + 1, false, 16);
+            CHECK(e.encode() == SYSTEM_ERROR_OUT_OF_RANGE);
+        }
+    }
     SECTION("encodes payload data correctly") {
         char buf[2048] = {};
         auto e = makeEncoder(buf, sizeof(buf));
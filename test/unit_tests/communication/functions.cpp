@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "functions.h"
+#include "buffer_message_channel.h"
+
+#include "util/coap_message.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace particle::protocol;
+using namespace particle::protocol::test;
+
+namespace {
+
+template<size_t N>
+class TestChannel: public BufferMessageChannel<N> {
+public:
+    std::vector<std::vector<uint8_t>> sent;
+
+    ProtocolError send(Message& msg) override {
+        sent.push_back(std::vector<uint8_t>(msg.buf(), msg.buf() + msg.length()));
+        // Clobber the unused part of the buffer, as the encryption layer would
+        std::fill(msg.buf(), msg.buf() + msg.capacity(), 0xaa);
+        return NO_ERROR;
+    }
+
+    ProtocolError receive(Message& msg) override {
+        return NO_ERROR;
+    }
+
+    ProtocolError command(MessageChannel::Command cmd, void* arg) override {
+        return NO_ERROR;
+    }
+
+    bool is_unreliable() override {
+        return true;
+    }
+
+    ProtocolError establish() override {
+        return NO_ERROR;
+    }
+
+    ProtocolError notify_established() override {
+        return NO_ERROR;
+    }
+
+    void notify_client_messages_processed() override {
+    }
+
+    AppStateDescriptor cached_app_state_descriptor() const override {
+        return AppStateDescriptor();
+    }
+
+    void reset() override {
+    }
+
+    // Creates a function call message that occupies the first `size` bytes of the buffer
+    void receiveCall(Message& msg, const std::string& key, const std::string* arg, size_t size = 0) {
+        std::vector<uint8_t> d = { 0x41, 0x02, 0x12, 0x34, 0xab, 0xb1, 'f' };
+        if (key.size() >= 13) {
+            d.push_back(0x0d);
+            d.push_back(key.size() - 13);
+        } else {
+            d.push_back(key.size());
+        }
+        d.insert(d.end(), key.begin(), key.end());
+        if (arg) {
+            if (arg->size() >= 269) {
+                d.push_back(0x4e);
+                d.push_back((arg->size() - 269) >> 8);
+                d.push_back((arg->size() - 269) & 0xff);
+            } else if (arg->size() >= 13) {
+                d.push_back(0x4d);
+                d.push_back(arg->size() - 13);
+            } else {
+                d.push_back(0x40 | arg->size());
+            }
+            d.insert(d.end(), arg->begin(), arg->end());
+        }
+        REQUIRE(this->create(msg) == NO_ERROR);
+        REQUIRE(d.size() <= msg.capacity());
+        std::fill(msg.buf(), msg.buf() + msg.capacity(), 0xff);
+        memcpy(msg.buf(), d.data(), d.size());
+        msg.set_length(size ? size : d.size());
+    }
+
+    // Creates a function call message carrying a block of the argument
+    void receiveBlock(Message& msg, const std::string& key, const std::string& arg, unsigned num, size_t blockSize = 16) {
+        const size_t offs = num * blockSize;
+        const size_t n = std::min(blockSize, arg.size() - offs);
+        const bool more = offs + n < arg.size();
+        const auto d = CoapMessage()
+                .type(CoapType::CON)
+                .code(CoapCode::POST)
+                .id(0x1234)
+                .token("\xab", 1)
+                .option(CoapOption::URI_PATH, std::string("f"))
+                .option(CoapOption::URI_PATH, key)
+                .option(CoapOption::BLOCK1, (unsigned)encodeCoapBlockOption(num, more, blockSize))
+                .payload(arg.substr(offs, n))
+                .encode();
+        REQUIRE(this->create(msg) == NO_ERROR);
+        REQUIRE(d.size() <= msg.capacity());
+        memcpy(msg.buf(), d.data(), d.size());
+        msg.set_length(d.size());
+    }
+};
+
+std::string g_key;
+std::string g_arg;
+int g_calls = 0;
+
+int callFunction(const char* key, const char* arg, SparkDescriptor::FunctionResultCallback callback, void* reserved) {
+    g_key = key;
+    g_arg = arg;
+    ++g_calls;
+    return 0;
+}
+
+uint8_t ackCode(const std::vector<uint8_t>& msg) {
+    REQUIRE(msg.size() >= 4);
+    return msg[1];
+}
+
+CoapMessage decodeAck(const std::vector<uint8_t>& msg) {
+    const auto m = CoapMessage::decode((const char*)msg.data(), msg.size());
+    REQUIRE(m.type() == CoapType::ACK);
+    REQUIRE(m.id() == 0x1234);
+    return m;
+}
+
+} // namespace
+
+TEST_CASE("Functions") {
+    Functions functions;
+    Message msg;
+    g_key.clear();
+    g_arg.clear();
+    g_calls = 0;
+
+    SECTION("passes the key and argument to the callback") {
+        TestChannel<256> channel;
+        const std::string arg = "argument";
+        channel.receiveCall(msg, "fn", &arg);
+        REQUIRE(functions.handle_function_call(0xab, 0x1234, msg, channel, callFunction) == NO_ERROR);
+        CHECK(g_calls == 1);
+        CHECK(g_key == "fn");
+        CHECK(g_arg == "argument");
+        REQUIRE(channel.sent.size() == 1);
+        CHECK(ackCode(channel.sent[0]) == 0x00);
+    }
+
+    SECTION("supports extended option lengths") {
+        TestChannel<1024> channel;
+        const std::string key(64, 'k');
+        const std::string arg1(200, 'a');
+        channel.receiveCall(msg, key, &arg1);
+        REQUIRE(functions.handle_function_call(0xab, 0x1234, msg, channel, callFunction) == NO_ERROR);
+        CHECK(g_key == key);
+        CHECK(g_arg == arg1);
+        const std::string arg2(700, 'b');
+        channel.receiveCall(msg, "fn", &arg2);
+        REQUIRE(functions.handle_function_call(0xab, 0x1234, msg, channel, callFunction) == NO_ERROR);
+        CHECK(g_key == "fn");
+        CHECK(g_arg == arg2);
+    }
+
+    SECTION("handles a call without an argument") {
+        TestChannel<256> channel;
+        channel.receiveCall(msg, "fn", nullptr);
+        REQUIRE(functions.handle_function_call(0xab, 0x1234, msg, channel, callFunction) == NO_ERROR);
+        CHECK(g_key == "fn");
+        CHECK(g_arg == "");
+    }
+
+    SECTION("fails if there's no room for the ACK") {
+        TestChannel<7 + 1 + 3 + 2 + 20> channel;
+        const std::string arg(20, 'x');
+        channel.receiveCall(msg, "abc", &arg);
+        REQUIRE(msg.length() == msg.capacity());
+        CHECK(functions.handle_function_call(0xab, 0x1234, msg, channel, callFunction) == INSUFFICIENT_STORAGE);
+        CHECK(g_calls == 0);
+    }
+
+    SECTION("rejects a truncated argument") {
+        TestChannel<256> channel;
+        const std::string arg = "argument";
+        channel.receiveCall(msg, "fn", &arg, 7 + 1 + 2 + 1 + 4); // Only 4 bytes of the argument
+        REQUIRE(functions.handle_function_call(0xab, 0x1234, msg, channel, callFunction) == NO_ERROR);
+        REQUIRE(channel.sent.size() == 1);
+        CHECK(ackCode(channel.sent[0]) == RESPONSE_CODE(4,00));
+        CHECK(g_arg == "argu");
+    }
+
+    SECTION("reassembles an argument received in blocks") {
+        TestChannel<256> channel;
+        const std::string arg(16 * 3 + 5, 'a');
+        for (unsigned i = 0; i < 3; ++i) {
+            channel.receiveBlock(msg, "fn", arg, i);
+            REQUIRE(functions.handle_function_call(0xab, 0x1234, msg, channel, callFunction) == NO_ERROR);
+            REQUIRE(channel.sent.size() == i + 1);
+            const auto ack = decodeAck(channel.sent[i]);
+            CHECK(ack.code() == CoapCode::CONTINUE);
+            CHECK(ack.token() == "\xab");
+            CHECK(ack.option(CoapOption::BLOCK1).toUInt() == (unsigned)encodeCoapBlockOption(i, true, 16));
+        }
+        CHECK(g_calls == 0);
+        channel.receiveBlock(msg, "fn", arg, 3);
+        REQUIRE(functions.handle_function_call(0xab, 0x1234, msg, channel, callFunction) == NO_ERROR);
+        REQUIRE(channel.sent.size() == 4);
+        CHECK(ackCode(channel.sent[3]) == 0x00);
+        CHECK(g_calls == 1);
+        CHECK(g_key == "fn");
+        CHECK(g_arg == arg);
+    }
+
+    SECTION("reassembles an argument received in blocks out of order") {
+        TestChannel<256> channel;
+        std::string arg;
+        for (char c = 'a'; c < 'e'; ++c) {
+            arg += std::string(16, c);
+        }
+        for (unsigned i: { 3, 1, 0 }) {
+            channel.receiveBlock(msg, "fn", arg, i);
+            REQUIRE(functions.handle_function_call(0xab, 0x1234, msg, channel, callFunction) == NO_ERROR);
+            CHECK(decodeAck(channel.sent.back()).code() == CoapCode::CONTINUE);
+        }
+        CHECK(g_calls == 0);
+        channel.receiveBlock(msg, "fn", arg, 2);
+        REQUIRE(functions.handle_function_call(0xab, 0x1234, msg, channel, callFunction) == NO_ERROR);
+        CHECK(g_calls == 1);
+        CHECK(g_arg == arg);
+    }
+
+    SECTION("responds with 4.08 to a block that can't be processed without the preceding blocks") {
+        TestChannel<256> channel;
+        const std::string arg(16 * (BLOCK1_RECEIVE_WINDOW_SIZE + 1), 'a');
+        channel.receiveBlock(msg, "fn", arg, BLOCK1_RECEIVE_WINDOW_SIZE);
+        REQUIRE(functions.handle_function_call(0xab, 0x1234, msg, channel, callFunction) == NO_ERROR);
+        REQUIRE(channel.sent.size() == 1);
+        CHECK(decodeAck(channel.sent[0]).code() == CoapCode::REQUEST_ENTITY_INCOMPLETE);
+        CHECK(g_calls == 0);
+    }
+
+    SECTION("responds with 4.13 if the argument is too large") {
+        TestChannel<256> channel;
+        const std::string arg(MAX_BLOCKWISE_FUNCTION_ARG_LENGTH + 1, 'a');
+        const unsigned last = MAX_BLOCKWISE_FUNCTION_ARG_LENGTH / 16;
+        // The first block that exceeds the maximum size can only be received once the window reaches it
+        for (unsigned i = 0; i < last; ++i) {
+            channel.receiveBlock(msg, "fn", arg, i);
+            REQUIRE(functions.handle_function_call(0xab, 0x1234, msg, channel, callFunction) == NO_ERROR);
+        }
+        channel.receiveBlock(msg, "fn", arg, last);
+        REQUIRE(functions.handle_function_call(0xab, 0x1234, msg, channel, callFunction) == NO_ERROR);
+        const auto ack = decodeAck(channel.sent.back());
+        CHECK(ack.code() == CoapCode::REQUEST_ENTITY_TOO_LARGE);
+        CHECK(ack.option(CoapOption::SIZE1).toUInt() == MAX_BLOCKWISE_FUNCTION_ARG_LENGTH);
+        CHECK(g_calls == 0);
+    }
+}
@@ -18,76 +18,349 @@
  */
 
 #include "publisher.h"
+#include "protocol.h"
+
+#include "util/coap_message_channel.h"
 
 #include <catch2/catch.hpp>
 
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace particle;
 using namespace particle::protocol;
+using namespace particle::protocol::test;
+
+system_tick_t millis() {
+    return 0;
+}
+
+class TestProtocol: public Protocol {
+public:
+    explicit TestProtocol(MessageChannel& channel) :
+            Protocol(channel) {
+        SparkCallbacks callbacks = {};
+        callbacks.size = sizeof(callbacks);
+        callbacks.millis = ::millis;
+        SparkDescriptor descriptor = {};
+        descriptor.size = sizeof(descriptor);
+        Protocol::init(callbacks, descriptor);
+    }
+
+    size_t build_hello(Message& message, uint16_t flags) override {
+        return 0;
+    }
+
+    int command(ProtocolCommands::Enum command, uint32_t value, const void* data) override {
+        return 0;
+    }
+
+    void init(const char* id, const SparkKeys& keys, const SparkCallbacks& callbacks, const SparkDescriptor& descriptor) override {
+    }
+
+    int get_status(protocol_status* status) const override {
+        status->flags = 0;
+        return 0;
+    }
+};
+
+struct Result {
+    bool done = false;
+    int error = 0;
+};
+
+void completionCallback(int error, const void* data, void* callbackData, void* reserved) {
+    const auto r = static_cast<Result*>(callbackData);
+    r->done = true;
+    r->error = error;
+}
+
+// Returns the names of the events sent to the channel
+std::vector<std::string> sentEvents(CoapMessageChannel& channel) {
+    std::vector<std::string> names;
+    while (channel.hasMessages()) {
+        const auto m = channel.receiveMessage();
+        const auto uri = m.options(CoapOption::URI_PATH);
+        REQUIRE(uri.size() >= 2);
+        REQUIRE(uri[0].toString() == "E");
+        std::string name = uri[1].toString();
+        for (size_t i = 2; i < uri.size(); ++i) {
+            name += '/' + uri[i].toString();
+        }
+        names.push_back(name);
+    }
+    return names;
+}
+
+std::string makeEventData(size_t size) {
+    std::string s;
+    for (size_t i = 0; i < size; ++i) {
+        s += (char)('a' + i % 26);
+    }
+    return s;
+}
+
+} // namespace
+
+TEST_CASE("Publisher") {
+    CoapMessageChannel channel;
+    TestProtocol protocol(channel);
+    Publisher publisher(&protocol);
+    system_tick_t now = 100000;
+
+    auto publish = [&](const char* name, int flags = 0, CompletionHandler handler = CompletionHandler()) {
+        return publisher.send_event(channel, name, "data", 60, EventType::PRIVATE, flags, now,
+                std::move(handler));
+    };
+
+    const size_t blockSize = coapBlockSizeFloor(protocol.get_max_event_data_size() - MAX_EVENT_BLOCK_OPTIONS_SIZE);
+    const auto largeData = makeEventData(blockSize * 6 + 100);
+
+    // Receives the blocks sent by the device and acknowledges them in reverse order. Returns the
+    // number of blocks received
+    std::string blockData;
+    auto ackBlocks = [&](CoAPCode::Enum code = (CoAPCode::Enum)CoapCode::CONTINUE) {
+        std::vector<CoapMessage> msgs;
+        while (channel.hasMessages()) {
+            msgs.push_back(channel.receiveMessage());
+        }
+        for (auto it = msgs.rbegin(); it != msgs.rend(); ++it) {
+            const auto& m = *it;
+            REQUIRE(m.type() == CoapType::CON);
+            const auto uri = m.options(CoapOption::URI_PATH);
+            REQUIRE(uri.size() == 2);
+            CHECK(uri[1].toString() == "big");
+            unsigned num = 0;
+            bool more = false;
+            size_t size = 0;
+            REQUIRE(decodeCoapBlockOption(m.option(CoapOption::BLOCK1).toUInt(), &num, &more, &size) == 0);
+            CHECK(size == blockSize);
+            CHECK(m.hasOption(CoapOption::SIZE1) == (num == 0));
+            blockData.resize(std::max(blockData.size(), num * size + m.payload().size()));
+            blockData.replace(num * size, m.payload().size(), m.payload());
+            REQUIRE(publisher.response_ack(channel, m.id(), more ? code : CoAPCode::CHANGED, now) == NO_ERROR);
+        }
+        return msgs.size();
+    };
+
+    SECTION("sends a burst of application events immediately") {
+        for (unsigned i = 0; i < Publisher::USER_EVENT_BURST; ++i) {
+            REQUIRE(publish("app") == NO_ERROR);
+        }
+        CHECK(sentEvents(channel).size() == Publisher::USER_EVENT_BURST);
+        CHECK(publisher.queued_event_count() == 0);
+    }
+
+    SECTION("queues application events once the burst is used up and sends them as tokens refill") {
+        for (unsigned i = 0; i < Publisher::USER_EVENT_BURST; ++i) {
+            REQUIRE(publish("app") == NO_ERROR);
+        }
+        sentEvents(channel);
+        REQUIRE(publish("a1") == NO_ERROR);
+        REQUIRE(publish("a2") == NO_ERROR);
+        CHECK(!channel.hasMessages());
+        CHECK(publisher.queued_event_count() == 2);
+        now += Publisher::USER_EVENT_INTERVAL - 1;
+        REQUIRE(publisher.process(channel, now) == NO_ERROR);
+        CHECK(!channel.hasMessages());
+        now += 1;
+        REQUIRE(publisher.process(channel, now) == NO_ERROR);
+        CHECK(sentEvents(channel) == std::vector<std::string>({ "a1" }));
+        now += Publisher::USER_EVENT_INTERVAL;
+        REQUIRE(publisher.process(channel, now) == NO_ERROR);
+        CHECK(sentEvents(channel) == std::vector<std::string>({ "a2" }));
+        CHECK(publisher.queued_event_count() == 0);
+    }
+
+    SECTION("keeps queued events ahead of new ones") {
+        for (unsigned i = 0; i < Publisher::USER_EVENT_BURST; ++i) {
+            REQUIRE(publish("app") == NO_ERROR);
+        }
+        sentEvents(channel);
+        REQUIRE(publish("a1") == NO_ERROR);
+        // A token is available, but the queued event needs to be sent first
+        now += Publisher::USER_EVENT_INTERVAL;
+        REQUIRE(publish("a2") == NO_ERROR);
+        CHECK(!channel.hasMessages());
+        REQUIRE(publisher.process(channel, now) == NO_ERROR);
+        CHECK(sentEvents(channel) == std::vector<std::string>({ "a1" }));
+        CHECK(publisher.queued_event_count() == 1);
+    }
+
+    SECTION("completes the handler of a queued event when it's sent") {
+        for (unsigned i = 0; i < Publisher::USER_EVENT_BURST; ++i) {
+            REQUIRE(publish("app") == NO_ERROR);
+        }
+        Result r;
+        REQUIRE(publish("a1", 0, CompletionHandler(completionCallback, &r)) == NO_ERROR);
+        CHECK(!r.done);
+        now += Publisher::USER_EVENT_INTERVAL;
+        REQUIRE(publisher.process(channel, now) == NO_ERROR);
+        CHECK(r.done);
+        CHECK(r.error == SYSTEM_ERROR_NONE);
+    }
+
+    SECTION("rejects an event only when the queue is full") {
+        for (unsigned i = 0; i < Publisher::USER_EVENT_BURST + Publisher::MAX_QUEUED_EVENTS; ++i) {
+            REQUIRE(publish("app") == NO_ERROR);
+        }
+        CHECK(publisher.queued_event_count() == Publisher::MAX_QUEUED_EVENTS);
+        Result r;
+        CompletionHandler h(completionCallback, &r);
+        CHECK(publisher.send_event(channel, "app", "data", 60, EventType::PRIVATE, 0, now, std::move(h)) ==
+                BANDWIDTH_EXCEEDED);
+        CHECK(!r.done); // The caller still owns the handler
+        CHECK(h);
+        h.setError(SYSTEM_ERROR_LIMIT_EXCEEDED);
+        // The queue drains at the refill rate
+        now += Publisher::USER_EVENT_INTERVAL;
+        REQUIRE(publisher.process(channel, now) == NO_ERROR);
+        CHECK(publisher.queued_event_count() == Publisher::MAX_QUEUED_EVENTS - 1);
+        CHECK(publish("app") == NO_ERROR);
+    }
+
+    SECTION("sends priority events ahead of queued normal events") {
+        for (unsigned i = 0; i < Publisher::USER_EVENT_BURST; ++i) {
+            REQUIRE(publish("app") == NO_ERROR);
+        }
+        sentEvents(channel);
+        REQUIRE(publish("n1") == NO_ERROR);
+        REQUIRE(publish("n2") == NO_ERROR);
+        REQUIRE(publish("p1", EventType::PRIORITY) == NO_ERROR);
+        REQUIRE(publish("p2", EventType::PRIORITY) == NO_ERROR);
+        for (int i = 0; i < 4; ++i) {
+            now += Publisher::USER_EVENT_INTERVAL;
+            REQUIRE(publisher.process(channel, now) == NO_ERROR);
+        }
+        CHECK(sentEvents(channel) == std::vector<std::string>({ "p1", "p2", "n1", "n2" }));
+    }
+
+    SECTION("a priority event displaces the most recent normal event when the queue is full") {
+        for (unsigned i = 0; i < Publisher::USER_EVENT_BURST; ++i) {
+            REQUIRE(publish("app") == NO_ERROR);
+        }
+        sentEvents(channel);
+        Result r;
+        for (unsigned i = 0; i < Publisher::MAX_QUEUED_EVENTS - 1; ++i) {
+            REQUIRE(publish("n") == NO_ERROR);
+        }
+        REQUIRE(publish("last", 0, CompletionHandler(completionCallback, &r)) == NO_ERROR);
+        REQUIRE(publish("p", EventType::PRIORITY) == NO_ERROR);
+        CHECK(r.done);
+        CHECK(r.error == SYSTEM_ERROR_LIMIT_EXCEEDED);
+        CHECK(publisher.queued_event_count() == Publisher::MAX_QUEUED_EVENTS);
+        now += Publisher::USER_EVENT_INTERVAL;
+        REQUIRE(publisher.process(channel, now) == NO_ERROR);
+        CHECK(sentEvents(channel) == std::vector<std::string>({ "p" }));
+    }
+
+    SECTION("system and application events have separate budgets") {
+        for (unsigned i = 0; i < Publisher::USER_EVENT_BURST; ++i) {
+            REQUIRE(publish("app") == NO_ERROR);
+        }
+        REQUIRE(publish("app") == NO_ERROR);
+        CHECK(publisher.queued_event_count() == 1);
+        sentEvents(channel);
+        // A rate limited application event doesn't hold back system events
+        for (unsigned i = 0; i < Publisher::SYSTEM_EVENT_BURST; ++i) {
+            REQUIRE(publish("particle/test") == NO_ERROR);
+        }
+        CHECK(sentEvents(channel).size() == Publisher::SYSTEM_EVENT_BURST);
+        REQUIRE(publish("spark/test") == NO_ERROR);
+        CHECK(!channel.hasMessages());
+        CHECK(publisher.queued_event_count() == 2);
+        now += Publisher::SYSTEM_EVENT_INTERVAL;
+        REQUIRE(publisher.process(channel, now) == NO_ERROR);
+        CHECK(sentEvents(channel) == std::vector<std::string>({ "spark/test" }));
+        // The bucket refills completely in about a minute
+        now += 60000;
+        for (unsigned i = 0; i < Publisher::SYSTEM_EVENT_BURST; ++i) {
+            REQUIRE(publish("particle/test") == NO_ERROR);
+        }
+        REQUIRE(publisher.process(channel, now) == NO_ERROR);
+        CHECK(sentEvents(channel).size() == Publisher::SYSTEM_EVENT_BURST + 1);
+        CHECK(publisher.queued_event_count() == 0);
+    }
+
+    SECTION("handles the wrap-around of the tick counter") {
+        now = (system_tick_t)-500;
+        for (unsigned i = 0; i < Publisher::USER_EVENT_BURST; ++i) {
+            REQUIRE(publish("app") == NO_ERROR);
+        }
+        REQUIRE(publish("a1") == NO_ERROR);
+        sentEvents(channel);
+        now += Publisher::USER_EVENT_INTERVAL;
+        REQUIRE(publisher.process(channel, now) == NO_ERROR);
+        CHECK(sentEvents(channel) == std::vector<std::string>({ "a1" }));
+    }
+
+    SECTION("reset() cancels the queued events") {
+        for (unsigned i = 0; i < Publisher::USER_EVENT_BURST; ++i) {
+            REQUIRE(publish("app") == NO_ERROR);
+        }
+        Result r;
+        REQUIRE(publish("a1", 0, CompletionHandler(completionCallback, &r)) == NO_ERROR);
+        publisher.reset();
+        CHECK(r.done);
+        CHECK(r.error == SYSTEM_ERROR_CANCELLED);
+        CHECK(publisher.queued_event_count() == 0);
+    }
+
+    SECTION("sends event data that doesn't fit in a single message in blocks") {
+        Result r;
+        REQUIRE(publisher.send_event(channel, "big", largeData.c_str(), 60, EventType::PRIVATE, 0, now,
+                CompletionHandler(completionCallback, &r)) == NO_ERROR);
+        CHECK(publisher.is_sending_blocks());
+        // Other events wait until all blocks are acknowledged
+        REQUIRE(publish("small") == NO_ERROR);
+        CHECK(publisher.queued_event_count() == 1);
+        size_t blockCount = 0;
+        unsigned n = 0;
+        while ((n = ackBlocks())) {
+            CHECK(n <= BLOCK1_SEND_WINDOW_SIZE);
+            blockCount += n;
+        }
+        CHECK(blockCount == 7);
+        CHECK(blockData == largeData);
+        CHECK(r.done);
+        CHECK(r.error == SYSTEM_ERROR_NONE);
+        CHECK(!publisher.is_sending_blocks());
+        now += Publisher::USER_EVENT_INTERVAL;
+        REQUIRE(publisher.process(channel, now) == NO_ERROR);
+        CHECK(sentEvents(channel) == std::vector<std::string>({ "small" }));
+    }
+
+    SECTION("fails the event if a block is rejected") {
+        Result r;
+        REQUIRE(publisher.send_event(channel, "big", largeData.c_str(), 60, EventType::PRIVATE, 0, now,
+                CompletionHandler(completionCallback, &r)) == NO_ERROR);
+        ackBlocks(CoAPCode::REQUEST_ENTITY_TOO_LARGE);
+        CHECK(r.done);
+        CHECK(r.error == SYSTEM_ERROR_TOO_LARGE);
+        CHECK(!publisher.is_sending_blocks());
+    }
+
+    SECTION("fails the event if the blocks are not acknowledged in time") {
+        Result r;
+        REQUIRE(publisher.send_event(channel, "big", largeData.c_str(), 60, EventType::PRIVATE, 0, now,
+                CompletionHandler(completionCallback, &r)) == NO_ERROR);
+        now += SEND_EVENT_ACK_TIMEOUT - 1;
+        REQUIRE(publisher.process(channel, now) == NO_ERROR);
+        CHECK(!r.done);
+        now += 1;
+        REQUIRE(publisher.process(channel, now) == NO_ERROR);
+        CHECK(r.done);
+        CHECK(r.error == SYSTEM_ERROR_TIMEOUT);
+    }
 
-SCENARIO("publisher")
-{
-	GIVEN("a publisher")
-	{
-		Protocol* protocol = nullptr;
-		Publisher publisher(protocol);
-
-		WHEN("4 application events are sent within 1 second")
-		{
-			REQUIRE(publisher.is_rate_limited(false, 1000)==false);
-			REQUIRE(publisher.is_rate_limited(false, 1200)==false);
-			REQUIRE(publisher.is_rate_limited(false, 1400)==false);
-			REQUIRE(publisher.is_rate_limited(false, 1600)==false);
-
-			const system_tick_t next_app_event = 5000;  // 1000ms + 4s
-			THEN("application events until 4 seconds have elapsed are rate limited")
-			{
-				for (system_tick_t i=1600; i<next_app_event; i+=100) {
-					REQUIRE(publisher.is_rate_limited(false, i)==true);
-				}
-			}
-
-			THEN("an application event after 4 seconds have elapsed is not rate limited")
-			{
-				REQUIRE(publisher.is_rate_limited(false, next_app_event)==false);
-			}
-		}
-
-		WHEN("255 system events are sent in less than a minute")
-		{
-			for (int i=0; i<255; i++) {
-				INFO("The counter is " << i);
-				REQUIRE(publisher.is_rate_limited(true, i)==false);
-			}
-
-			THEN("all system events until the next minute begins are rate limited")
-			{
-				for (int i=1000; i<60*1000; i+=1000) {
-					INFO("The counter is " << i);
-					REQUIRE(publisher.is_rate_limited(true, i)==true);
-				}
-
-				// it's only approximately 1 minute, the cutoff is 64k milliseconds
-				for (int i=60000; i<65536; i+=8) {
-					INFO("The counter is " << i);
-					REQUIRE(publisher.is_rate_limited(true, i)==true);
-				}
-
-				AND_THEN("system events in the next minute are not rate limited")
-				{
-					for (int i=65536; i<65536+255; i++) {
-						INFO("The counter is " << i);
-						REQUIRE(publisher.is_rate_limited(true, i)==false);
-					}
-				}
-			}
-
-			THEN("application events are still rate limited after a burst of 4")
-			{
-				REQUIRE(publisher.is_rate_limited(false, 1000)==false);
-				REQUIRE(publisher.is_rate_limited(false, 1000)==false);
-				REQUIRE(publisher.is_rate_limited(false, 1000)==false);
-				REQUIRE(publisher.is_rate_limited(false, 1000)==false);
-				REQUIRE(publisher.is_rate_limited(false, 1000)==true);
-			}
-		}
-	}
+    SECTION("reset() cancels the event being sent in blocks") {
+        Result r;
+        REQUIRE(publisher.send_event(channel, "big", largeData.c_str(), 60, EventType::PRIVATE, 0, now,
+                CompletionHandler(completionCallback, &r)) == NO_ERROR);
+        publisher.reset();
+        CHECK(r.done);
+        CHECK(r.error == SYSTEM_ERROR_CANCELLED);
+    }
 }
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "response_scheduler.h"
+#include "messages.h"
+
+#include "forward_message_channel.h"
+#include "util/coap_message_channel.h"
+
+#include <catch2/catch.hpp>
+
+namespace {
+
+using namespace particle::protocol;
+using namespace particle::protocol::test;
+
+system_tick_t g_millis = 0;
+
+system_tick_t millis() {
+    return g_millis;
+}
+
+class Scheduler: public ResponseScheduler {
+public:
+    explicit Scheduler(MessageChannel& channel) :
+            ResponseScheduler(channel),
+            channel_(channel) {
+        init(millis);
+    }
+
+    // Defers the ACK for a request received from the server
+    ProtocolError defer(message_id_t id, token_t token) {
+        Message msg;
+        REQUIRE(channel_.create(msg) == NO_ERROR);
+        return defer_ack(msg, id, token);
+    }
+
+    // Sends a separate response with the given token
+    ProtocolError respond(token_t token) {
+        Message msg;
+        REQUIRE(channel_.create(msg) == NO_ERROR);
+        msg.set_length(Messages::separate_response(msg.buf(), 0 /* message_id */, token, CoAPCode::CONTENT, true));
+        return send_response(msg, token);
+    }
+
+private:
+    MessageChannel& channel_;
+};
+
+} // namespace
+
+TEST_CASE("ResponseScheduler") {
+    CoapMessageChannel coapChannel;
+    ForwardMessageChannel channel(coapChannel);
+    Scheduler scheduler(channel);
+    g_millis = 1000;
+
+    SECTION("piggybacks a response on the ACK if it's ready within the window") {
+        REQUIRE(scheduler.defer(0x1234, 0xab) == NO_ERROR);
+        CHECK(!coapChannel.hasMessages());
+        CHECK(scheduler.has_pending_ack(0x1234));
+        g_millis += ResponseScheduler::DEFAULT_ACK_WINDOW - 1;
+        REQUIRE(scheduler.process() == NO_ERROR);
+        CHECK(!coapChannel.hasMessages());
+        REQUIRE(scheduler.respond(0xab) == NO_ERROR);
+        auto m = coapChannel.receiveMessage();
+        CHECK(m.type() == CoapType::ACK);
+        CHECK(m.id() == 0x1234);
+        CHECK(m.token() == std::string(1, (char)0xab));
+        CHECK(m.code() == (unsigned)CoapCode::CONTENT);
+        CHECK(!coapChannel.hasMessages());
+        CHECK(scheduler.pending_ack_count() == 0);
+        CHECK(scheduler.stats().deferred_acks == 1);
+        CHECK(scheduler.stats().piggybacked_responses == 1);
+        CHECK(scheduler.stats().empty_acks == 0);
+    }
+
+    SECTION("sends an empty ACK when the window expires") {
+        REQUIRE(scheduler.defer(0x1234, 0xab) == NO_ERROR);
+        g_millis += ResponseScheduler::DEFAULT_ACK_WINDOW;
+        REQUIRE(scheduler.process() == NO_ERROR);
+        auto m = coapChannel.receiveMessage();
+        CHECK(m.type() == CoapType::ACK);
+        CHECK(m.id() == 0x1234);
+        CHECK(m.code() == (unsigned)CoapCode::EMPTY);
+        CHECK(!scheduler.has_pending_ack(0x1234));
+        // The response is sent as a separate message
+        REQUIRE(scheduler.respond(0xab) == NO_ERROR);
+        m = coapChannel.receiveMessage();
+        CHECK(m.type() == CoapType::CON);
+        CHECK(m.id() != 0x1234);
+        CHECK(m.code() == (unsigned)CoapCode::CONTENT);
+        CHECK(scheduler.stats().piggybacked_responses == 0);
+        CHECK(scheduler.stats().empty_acks == 1);
+    }
+
+    SECTION("sends the ACKs immediately if the window is 0") {
+        scheduler.set_window(0);
+        REQUIRE(scheduler.defer(0x1234, 0xab) == NO_ERROR);
+        auto m = coapChannel.receiveMessage();
+        CHECK(m.type() == CoapType::ACK);
+        CHECK(m.id() == 0x1234);
+        CHECK(scheduler.pending_ack_count() == 0);
+        CHECK(scheduler.stats().deferred_acks == 0);
+    }
+
+    SECTION("sends the oldest ACK when too many ACKs are held") {
+        for (size_t i = 0; i < ResponseScheduler::MAX_PENDING_ACKS; ++i) {
+            REQUIRE(scheduler.defer(i + 1, i + 1) == NO_ERROR);
+            ++g_millis;
+        }
+        CHECK(!coapChannel.hasMessages());
+        REQUIRE(scheduler.defer(100, 100) == NO_ERROR);
+        auto m = coapChannel.receiveMessage();
+        CHECK(m.type() == CoapType::ACK);
+        CHECK(m.id() == 1);
+        CHECK(!coapChannel.hasMessages());
+        CHECK(scheduler.pending_ack_count() == ResponseScheduler::MAX_PENDING_ACKS);
+        // The remaining ACKs expire in the order in which they were deferred
+        g_millis += ResponseScheduler::DEFAULT_ACK_WINDOW;
+        REQUIRE(scheduler.process() == NO_ERROR);
+        for (unsigned id: { 2, 3, 4, 100 }) {
+            m = coapChannel.receiveMessage();
+            CHECK(m.id() == id);
+        }
+        CHECK(scheduler.stats().empty_acks == ResponseScheduler::MAX_PENDING_ACKS + 1);
+    }
+
+    SECTION("doesn't hold two ACKs for requests with the same token") {
+        REQUIRE(scheduler.defer(1, 0xab) == NO_ERROR);
+        REQUIRE(scheduler.defer(2, 0xab) == NO_ERROR);
+        auto m = coapChannel.receiveMessage();
+        CHECK(m.type() == CoapType::ACK);
+        CHECK(m.id() == 2);
+        CHECK(scheduler.pending_ack_count() == 1);
+    }
+
+    SECTION("sends a response with an unknown token as is") {
+        REQUIRE(scheduler.defer(0x1234, 0xab) == NO_ERROR);
+        REQUIRE(scheduler.respond(0xcd) == NO_ERROR);
+        auto m = coapChannel.receiveMessage();
+        CHECK(m.type() == CoapType::CON);
+        CHECK(m.token() == std::string(1, (char)0xcd));
+        CHECK(scheduler.has_pending_ack(0x1234));
+    }
+
+    SECTION("flushes a held ACK on request") {
+        REQUIRE(scheduler.defer(0x1234, 0xab) == NO_ERROR);
+        REQUIRE(scheduler.flush(0x4321) == NO_ERROR);
+        CHECK(!coapChannel.hasMessages());
+        REQUIRE(scheduler.flush(0x1234) == NO_ERROR);
+        auto m = coapChannel.receiveMessage();
+        CHECK(m.type() == CoapType::ACK);
+        CHECK(m.id() == 0x1234);
+        CHECK(!scheduler.has_pending_ack(0x1234));
+    }
+
+    SECTION("flushes all held ACKs on request") {
+        REQUIRE(scheduler.defer(1, 1) == NO_ERROR);
+        REQUIRE(scheduler.defer(2, 2) == NO_ERROR);
+        REQUIRE(scheduler.flush() == NO_ERROR);
+        for (unsigned id: { 1, 2 }) {
+            auto m = coapChannel.receiveMessage();
+            CHECK(m.type() == CoapType::ACK);
+            CHECK(m.id() == id);
+        }
+        CHECK(!coapChannel.hasMessages());
+        CHECK(scheduler.pending_ack_count() == 0);
+    }
+
+    SECTION("keeps the ACK window when initialized") {
+        scheduler.set_window(10);
+        scheduler.init(millis);
+        CHECK(scheduler.window() == 10);
+    }
+
+    SECTION("reset() discards the held ACKs") {
+        REQUIRE(scheduler.defer(0x1234, 0xab) == NO_ERROR);
+        scheduler.reset();
+        g_millis += ResponseScheduler::DEFAULT_ACK_WINDOW;
+        REQUIRE(scheduler.process() == NO_ERROR);
+        CHECK(!coapChannel.hasMessages());
+    }
+}
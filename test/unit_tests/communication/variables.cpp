@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "protocol.h"
+#include "variables.h"
+
+#include "util/coap_message_channel.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+
+namespace {
+
+using namespace particle::protocol;
+using namespace particle::protocol::test;
+
+std::string g_value;
+
+const void* getVariable(const char* key) {
+    return (g_value.empty() || strcmp(key, "var") != 0) ? nullptr : g_value.c_str();
+}
+
+SparkReturnType::Enum variableType(const char* key) {
+    return SparkReturnType::STRING;
+}
+
+system_tick_t millis() {
+    return 0;
+}
+
+class TestProtocol: public Protocol {
+public:
+    explicit TestProtocol(MessageChannel& channel) :
+            Protocol(channel) {
+        SparkCallbacks callbacks = {};
+        callbacks.size = sizeof(callbacks);
+        callbacks.millis = ::millis;
+        SparkDescriptor descriptor = {};
+        descriptor.size = sizeof(descriptor);
+        descriptor.get_variable = getVariable;
+        descriptor.variable_type = variableType;
+        Protocol::init(callbacks, descriptor);
+    }
+
+    size_t build_hello(Message& message, uint16_t flags) override {
+        return 0;
+    }
+
+    int command(ProtocolCommands::Enum command, uint32_t value, const void* data) override {
+        return 0;
+    }
+
+    void init(const char* id, const SparkKeys& keys, const SparkCallbacks& callbacks, const SparkDescriptor& descriptor) override {
+    }
+
+    int get_status(protocol_status* status) const override {
+        status->flags = 0;
+        return 0;
+    }
+};
+
+// Sends a variable request to the device and returns the response
+CoapMessage requestVariable(CoapMessageChannel& channel, Variables& vars, int blockNum = -1, unsigned blockSzx = 0) {
+    auto m = CoapMessage().type(CoapType::CON).code(CoapCode::GET).id(0x1234).token("\x01", 1)
+            .option(CoapOption::URI_PATH, "v").option(CoapOption::URI_PATH, "var");
+    if (blockNum >= 0) {
+        m.option(CoapOption::BLOCK2, ((unsigned)blockNum << 4) | blockSzx);
+    }
+    channel.sendMessage(std::move(m));
+    Message msg;
+    REQUIRE(channel.receive(msg) == NO_ERROR);
+    REQUIRE(vars.handle_request(msg, 0x01 /* token */, 0x1234 /* id */) == NO_ERROR);
+    const auto resp = channel.receiveMessage();
+    CHECK(!channel.hasMessages());
+    return resp;
+}
+
+} // namespace
+
+TEST_CASE("Variables") {
+    CoapMessageChannel channel;
+    TestProtocol protocol(channel);
+    Variables vars(&protocol);
+    g_value = std::string(2000, ' ');
+    for (size_t i = 0; i < g_value.size(); ++i) {
+        g_value[i] = 'a' + i % 26;
+    }
+
+    SECTION("truncates a large value if the request has no Block2 option") {
+        const auto resp = requestVariable(channel, vars);
+        CHECK(resp.code() == (unsigned)CoapCode::CONTENT);
+        CHECK(!resp.hasOption(CoapOption::BLOCK2));
+        CHECK(resp.payload() == g_value.substr(0, protocol.get_max_variable_value_size()));
+    }
+
+    SECTION("sends a value in blocks if the request has a Block2 option") {
+        // Request 256-byte blocks (SZX = 4)
+        auto resp = requestVariable(channel, vars, 0, 4);
+        CHECK(resp.type() == CoapType::ACK); // Piggybacked response
+        CHECK(resp.id() == 0x1234);
+        CHECK(resp.code() == (unsigned)CoapCode::CONTENT);
+        CHECK(resp.option(CoapOption::BLOCK2).toUInt() == 0x0c); // NUM = 0, M = 1, SZX = 4
+        CHECK(resp.option(CoapOption::SIZE2).toUInt() == 2000);
+        CHECK(resp.payload() == g_value.substr(0, 256));
+        resp = requestVariable(channel, vars, 3, 4);
+        CHECK(resp.option(CoapOption::BLOCK2).toUInt() == 0x3c); // NUM = 3, M = 1, SZX = 4
+        CHECK(!resp.hasOption(CoapOption::SIZE2));
+        CHECK(resp.payload() == g_value.substr(768, 256));
+        resp = requestVariable(channel, vars, 7, 4);
+        CHECK(resp.option(CoapOption::BLOCK2).toUInt() == 0x74); // NUM = 7, M = 0, SZX = 4
+        CHECK(resp.payload() == g_value.substr(1792));
+    }
+
+    SECTION("limits the block size to the maximum size of a variable value") {
+        // Request 1024-byte blocks (SZX = 6)
+        const auto resp = requestVariable(channel, vars, 0, 6);
+        const size_t size = coapBlockSizeFloor(protocol.get_max_variable_value_size() - MAX_VARIABLE_BLOCK_OPTIONS_SIZE);
+        REQUIRE(size < 1024);
+        CHECK(resp.payload() == g_value.substr(0, size));
+    }
+
+    SECTION("renumbers a block if it's sent using a smaller block size") {
+        const size_t size = coapBlockSizeFloor(protocol.get_max_variable_value_size() - MAX_VARIABLE_BLOCK_OPTIONS_SIZE);
+        REQUIRE(size < 1024);
+        // Request the second 1024-byte block (SZX = 6)
+        const auto resp = requestVariable(channel, vars, 1, 6);
+        unsigned num = 0;
+        bool more = false;
+        size_t respSize = 0;
+        REQUIRE(decodeCoapBlockOption(resp.option(CoapOption::BLOCK2).toUInt(), &num, &more, &respSize) == 0);
+        CHECK(respSize == size);
+        CHECK(num == 1024 / size);
+        CHECK(more);
+        CHECK(!resp.hasOption(CoapOption::SIZE2));
+        CHECK(resp.payload() == g_value.substr(1024, size));
+    }
+
+    SECTION("rejects a request for a block past the end of the value") {
+        const auto resp = requestVariable(channel, vars, 8, 4);
+        CHECK(resp.type() == CoapType::ACK);
+        CHECK(resp.code() == (unsigned)CoapCode::BAD_OPTION);
+    }
+
+    SECTION("sends a small value in a single block") {
+        g_value = "abc";
+        const auto resp = requestVariable(channel, vars, 0, 4);
+        CHECK(resp.option(CoapOption::BLOCK2).toUInt() == 0x04); // NUM = 0, M = 0, SZX = 4
+        CHECK(resp.option(CoapOption::SIZE2).toUInt() == 3);
+        CHECK(resp.payload() == "abc");
+    }
+}
@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define CATCH_CONFIG_MAIN
+
+#include "ble_scan_util.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace particle::ble;
+
+namespace {
+
+struct AdStructure {
+    uint8_t type;
+    std::string data;
+};
+
+std::vector<AdStructure> parse(const std::string& adv) {
+    std::vector<AdStructure> v;
+    forEachAdStructure((const uint8_t*)adv.data(), adv.size(), [&](uint8_t type, const uint8_t* data, size_t size) {
+        v.push_back({ type, std::string((const char*)data, size) });
+        return true;
+    });
+    return v;
+}
+
+// Advertising data captured from an iBeacon
+const std::string IBEACON_ADV(
+        "\x02\x01\x06" // Flags
+        "\x1a\xff\x4c\x00\x02\x15\xe2\xc5\x6d\xb5\xdf\xfb\x48\xd2\xb0\x60\xd0\xf5\xa7\x10\x96\xe0\x00\x01\x00\x02\xc5", // Manufacturer specific data
+        30);
+
+// Advertising data captured from an Eddystone-URL beacon
+const std::string EDDYSTONE_ADV(
+        "\x02\x01\x06" // Flags
+        "\x03\x03\xaa\xfe" // Complete list of 16-bit service UUIDs
+        "\x0e\x16\xaa\xfe\x10\xeb\x03\x70\x61\x72\x74\x69\x63\x6c\x65\x07", // Service data
+        22);
+
+// Scan response data captured from an Argon
+const std::string ARGON_SR(
+        "\x11\x07\x7b\xe3\x27\x74\x7b\xf8\x15\xac\xdd\x49\xa9\x13\x00\x00\x72\xf5" // Complete list of 128-bit service UUIDs
+        "\x0b\x09\x41\x72\x67\x6f\x6e\x2d\x41\x42\x43\x44", // Complete local name
+        30);
+
+const uint8_t ADDR1[BLE_SIG_ADDR_LEN] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06 };
+const uint8_t ADDR2[BLE_SIG_ADDR_LEN] = { 0x11, 0x12, 0x13, 0x14, 0x15, 0x16 };
+
+} // unnamed
+
+TEST_CASE("forEachAdStructure()") {
+    SECTION("parses captured advertising data") {
+        auto v = parse(IBEACON_ADV);
+        REQUIRE(v.size() == 2);
+        CHECK(v[0].type == BLE_SIG_AD_TYPE_FLAGS);
+        CHECK(v[0].data == std::string("\x06", 1));
+        CHECK(v[1].type == BLE_SIG_AD_TYPE_MANUFACTURER_SPECIFIC_DATA);
+        CHECK(v[1].data.size() == 25);
+        CHECK(v[1].data.substr(0, 4) == std::string("\x4c\x00\x02\x15", 4));
+
+        v = parse(EDDYSTONE_ADV);
+        REQUIRE(v.size() == 3);
+        CHECK(v[1].type == BLE_SIG_AD_TYPE_16BIT_SERVICE_UUID_COMPLETE);
+        CHECK(v[1].data == std::string("\xaa\xfe", 2));
+        CHECK(v[2].type == BLE_SIG_AD_TYPE_SERVICE_DATA);
+        CHECK(v[2].data.size() == 13);
+
+        v = parse(ARGON_SR);
+        REQUIRE(v.size() == 2);
+        CHECK(v[0].type == BLE_SIG_AD_TYPE_128BIT_SERVICE_UUID_COMPLETE);
+        CHECK(v[0].data.size() == BLE_SIG_UUID_128BIT_LEN);
+        CHECK(v[1].type == BLE_SIG_AD_TYPE_COMPLETE_LOCAL_NAME);
+        CHECK(v[1].data == "Argon-ABCD");
+    }
+
+    SECTION("stops at a truncated AD structure") {
+        auto v = parse(EDDYSTONE_ADV.substr(0, EDDYSTONE_ADV.size() - 1));
+        REQUIRE(v.size() == 2);
+        CHECK(v[1].type == BLE_SIG_AD_TYPE_16BIT_SERVICE_UUID_COMPLETE);
+    }
+
+    SECTION("stops at a zero length field") {
+        auto v = parse(std::string("\x02\x01\x06\x00\x03\x03\xaa\xfe", 8));
+        REQUIRE(v.size() == 1);
+        CHECK(v[0].type == BLE_SIG_AD_TYPE_FLAGS);
+    }
+
+    SECTION("handles empty data") {
+        CHECK(parse(std::string()).empty());
+        CHECK(forEachAdStructure(nullptr, 0, [](uint8_t, const uint8_t*, size_t) { return true; }));
+    }
+
+    SECTION("can be stopped by the callback") {
+        int n = 0;
+        bool ok = forEachAdStructure((const uint8_t*)IBEACON_ADV.data(), IBEACON_ADV.size(), [&](uint8_t, const uint8_t*, size_t) {
+            ++n;
+            return false;
+        });
+        CHECK(!ok);
+        CHECK(n == 1);
+    }
+}
+
+TEST_CASE("ScanDedupTable") {
+    ScanDedupTable<4> t;
+    const auto h1 = fnv1a_update(FNV1A_INIT, IBEACON_ADV.data(), IBEACON_ADV.size());
+    const auto h2 = fnv1a_update(FNV1A_INIT, EDDYSTONE_ADV.data(), EDDYSTONE_ADV.size());
+    REQUIRE(h1 != h2);
+
+    SECTION("reports new and unchanged peers") {
+        CHECK(t.update(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC, -60, h1) == ScanDedupResult::NEW);
+        CHECK(t.update(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC, -60, h1) == ScanDedupResult::UNCHANGED);
+        CHECK(t.update(ADDR2, BLE_SIG_ADDR_TYPE_PUBLIC, -60, h1) == ScanDedupResult::NEW);
+        CHECK(t.size() == 2);
+        auto e = t.find(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC);
+        REQUIRE(e != nullptr);
+        CHECK(e->count == 2);
+    }
+
+    SECTION("distinguishes address types") {
+        CHECK(t.update(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC, -60, h1) == ScanDedupResult::NEW);
+        CHECK(t.update(ADDR1, BLE_SIG_ADDR_TYPE_RANDOM_STATIC, -60, h1) == ScanDedupResult::NEW);
+        CHECK(t.find(ADDR2, BLE_SIG_ADDR_TYPE_PUBLIC) == nullptr);
+    }
+
+    SECTION("reports changed advertising data") {
+        CHECK(t.update(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC, -60, h1) == ScanDedupResult::NEW);
+        CHECK(t.update(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC, -60, h2) == ScanDedupResult::CHANGED);
+        CHECK(t.update(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC, -60, h2) == ScanDedupResult::UNCHANGED);
+    }
+
+    SECTION("ignores RSSI changes by default") {
+        CHECK(t.update(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC, -60, h1) == ScanDedupResult::NEW);
+        CHECK(t.update(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC, -20, h1) == ScanDedupResult::UNCHANGED);
+    }
+
+    SECTION("reports changes of the average RSSI exceeding the threshold") {
+        t.rssiThreshold(10);
+        CHECK(t.update(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC, -80, h1) == ScanDedupResult::NEW);
+        // A single outlier doesn't move the average far enough
+        CHECK(t.update(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC, -50, h1) == ScanDedupResult::UNCHANGED);
+        CHECK(t.update(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC, -80, h1) == ScanDedupResult::UNCHANGED);
+        ScanDedupResult r = ScanDedupResult::UNCHANGED;
+        int n = 0;
+        while (r == ScanDedupResult::UNCHANGED && n < 10) {
+            r = t.update(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC, -40, h1);
+            ++n;
+        }
+        CHECK(r == ScanDedupResult::CHANGED);
+        auto e = t.find(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC);
+        REQUIRE(e != nullptr);
+        CHECK(e->reportedRssi >= -70);
+        CHECK(e->reportedRssi < -40);
+        // The reported value becomes the new reference
+        CHECK(t.update(ADDR1, BLE_SIG_ADDR_TYPE_PUBLIC, e->reportedRssi, h1) == ScanDedupResult::UNCHANGED);
+    }
+
+    SECTION("evicts the least recently seen peer when the table is full") {
+        uint8_t addr[BLE_SIG_ADDR_LEN] = {};
+        for (size_t i = 0; i < t.capacity(); ++i) {
+            addr[0] = i;
+            CHECK(t.update(addr, BLE_SIG_ADDR_TYPE_PUBLIC, -60, h1) == ScanDedupResult::NEW);
+        }
+        CHECK(t.size() == t.capacity());
+        // Peer 0 is seen again, so peer 1 becomes the least recently seen one
+        addr[0] = 0;
+        CHECK(t.update(addr, BLE_SIG_ADDR_TYPE_PUBLIC, -60, h2) == ScanDedupResult::CHANGED);
+        addr[0] = 0xff;
+        CHECK(t.update(addr, BLE_SIG_ADDR_TYPE_PUBLIC, -60, h1) == ScanDedupResult::NEW);
+        CHECK(t.size() == t.capacity());
+        addr[0] = 1;
+        CHECK(t.find(addr, BLE_SIG_ADDR_TYPE_PUBLIC) == nullptr);
+        // All other peers are still known
+        for (size_t i = 0; i < t.capacity(); ++i) {
+            addr[0] = (i == 1) ? 0xff : i;
+            CHECK(t.find(addr, BLE_SIG_ADDR_TYPE_PUBLIC) != nullptr);
+        }
+        t.clear();
+        CHECK(t.size() == 0);
+        CHECK(t.find(addr, BLE_SIG_ADDR_TYPE_PUBLIC) == nullptr);
+    }
+
+    SECTION("keeps all peers reachable when evicting entries repeatedly") {
+        ScanDedupTable<16> t2;
+        uint8_t addr[BLE_SIG_ADDR_LEN] = {};
+        for (unsigned i = 0; i < 200; ++i) {
+            addr[0] = i;
+            addr[1] = i * 7;
+            CHECK(t2.update(addr, BLE_SIG_ADDR_TYPE_PUBLIC, -60, h1) == ScanDedupResult::NEW);
+            // The last 16 peers are always known
+            for (unsigned j = (i >= 15) ? i - 15 : 0; j <= i; ++j) {
+                addr[0] = j;
+                addr[1] = j * 7;
+                CHECK(t2.find(addr, BLE_SIG_ADDR_TYPE_PUBLIC) != nullptr);
+            }
+        }
+        CHECK(t2.size() == t2.capacity());
+    }
+}
+
+TEST_CASE("ScanFilterMatcher") {
+    ScanFilterMatcher m;
+    const auto matchAdv = [&m](const std::string& adv, const std::string& sr = std::string(), int8_t rssi = -60,
+            const uint8_t* addr = ADDR1) {
+        return m.match(addr, BLE_SIG_ADDR_TYPE_PUBLIC, rssi, (const uint8_t*)adv.data(), adv.size(),
+                (const uint8_t*)sr.data(), sr.size());
+    };
+
+    SECTION("an empty filter matches any device") {
+        CHECK(matchAdv(IBEACON_ADV));
+        CHECK(matchAdv(std::string()));
+    }
+
+    SECTION("matches the RSSI range") {
+        m.minRssi(-70);
+        m.maxRssi(-40);
+        CHECK(matchAdv(IBEACON_ADV, std::string(), -70));
+        CHECK(matchAdv(IBEACON_ADV, std::string(), -40));
+        CHECK(!matchAdv(IBEACON_ADV, std::string(), -71));
+        CHECK(!matchAdv(IBEACON_ADV, std::string(), -39));
+    }
+
+    SECTION("matches the address") {
+        REQUIRE(m.addAddress(ADDR2, BLE_SIG_ADDR_TYPE_PUBLIC));
+        CHECK(!matchAdv(IBEACON_ADV));
+        CHECK(matchAdv(IBEACON_ADV, std::string(), -60, ADDR2));
+        CHECK(!m.match(ADDR2, BLE_SIG_ADDR_TYPE_RANDOM_STATIC, -60, nullptr, 0, nullptr, 0));
+    }
+
+    SECTION("matches the name in the scan response data") {
+        REQUIRE(m.addName("Xenon", 5));
+        REQUIRE(m.addName("Argon-ABCD", 10));
+        CHECK(matchAdv(EDDYSTONE_ADV, ARGON_SR));
+        CHECK(!matchAdv(EDDYSTONE_ADV));
+        m.clear();
+        REQUIRE(m.addName("Argon", 5));
+        CHECK(!matchAdv(EDDYSTONE_ADV, ARGON_SR));
+    }
+
+    SECTION("matches 16-bit and 128-bit service UUIDs") {
+        REQUIRE(m.addServiceUuid16(0xfeaa));
+        CHECK(matchAdv(EDDYSTONE_ADV));
+        CHECK(!matchAdv(IBEACON_ADV, ARGON_SR));
+        m.clear();
+        const uint8_t uuid[BLE_SIG_UUID_128BIT_LEN] = { 0x7b, 0xe3, 0x27, 0x74, 0x7b, 0xf8, 0x15, 0xac, 0xdd, 0x49,
+                0xa9, 0x13, 0x00, 0x00, 0x72, 0xf5 };
+        REQUIRE(m.addServiceUuid128(uuid));
+        CHECK(matchAdv(IBEACON_ADV, ARGON_SR));
+        CHECK(!matchAdv(EDDYSTONE_ADV));
+    }
+
+    SECTION("matches the appearance") {
+        REQUIRE(m.addAppearance(BLE_SIG_APPEARANCE_GENERIC_PHONE));
+        const std::string adv("\x03\x19\x40\x00", 4);
+        CHECK(matchAdv(adv));
+        CHECK(!matchAdv(IBEACON_ADV));
+        // A device without the appearance field matches the unknown appearance
+        REQUIRE(m.addAppearance(BLE_SIG_APPEARANCE_UNKNOWN));
+        CHECK(matchAdv(IBEACON_ADV));
+    }
+
+    SECTION("matches the custom data") {
+        const std::string data = IBEACON_ADV.substr(5);
+        m.customData((const uint8_t*)data.data(), data.size());
+        CHECK(matchAdv(IBEACON_ADV));
+        CHECK(!matchAdv(EDDYSTONE_ADV));
+        m.customData((const uint8_t*)data.data(), data.size() - 1);
+        CHECK(!matchAdv(IBEACON_ADV));
+    }
+
+    SECTION("requires all kinds of criteria to match") {
+        REQUIRE(m.addServiceUuid16(0xfeaa));
+        REQUIRE(m.addName("Argon-ABCD", 10));
+        CHECK(!matchAdv(EDDYSTONE_ADV));
+        CHECK(!matchAdv(IBEACON_ADV, ARGON_SR));
+        CHECK(matchAdv(EDDYSTONE_ADV, ARGON_SR));
+    }
+}
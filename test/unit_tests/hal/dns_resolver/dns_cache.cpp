@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dns_cache.h"
+
+#include <catch2/catch.hpp>
+
+#include <sys/socket.h>
+#include <cstring>
+
+using namespace particle;
+
+namespace {
+
+const uint8_t ADDR1[4] = { 192, 0, 2, 1 };
+const uint8_t ADDR2[4] = { 192, 0, 2, 2 };
+const uint8_t ADDR6[16] = { 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+
+} // namespace
+
+TEST_CASE("DnsCache") {
+    DnsCache cache;
+    uint8_t addr[DNS_CACHE_MAX_ADDRESS_SIZE] = {};
+
+    SECTION("returns a cached address until it expires") {
+        CHECK(cache.find("example.com", AF_INET, 0, addr) == DnsCache::MISS);
+        REQUIRE(cache.put("example.com", AF_INET, ADDR1, sizeof(ADDR1), 60, 1000) == 0);
+        CHECK(cache.find("example.com", AF_INET, 1000, addr) == DnsCache::HIT);
+        CHECK(memcmp(addr, ADDR1, sizeof(ADDR1)) == 0);
+        CHECK(cache.find("example.com", AF_INET, 60999, addr) == DnsCache::HIT);
+        CHECK(cache.find("example.com", AF_INET, 61000, addr) == DnsCache::MISS);
+        const auto s = cache.stats();
+        CHECK(s.hits == 2);
+        CHECK(s.misses == 2);
+        CHECK(s.entries == 0);
+    }
+
+    SECTION("keeps separate entries for each address family") {
+        REQUIRE(cache.put("example.com", AF_INET, ADDR1, sizeof(ADDR1), 60, 0) == 0);
+        CHECK(cache.find("example.com", AF_INET6, 0, addr) == DnsCache::MISS);
+        REQUIRE(cache.put("example.com", AF_INET6, ADDR6, sizeof(ADDR6), 60, 0) == 0);
+        CHECK(cache.find("example.com", AF_INET6, 0, addr) == DnsCache::HIT);
+        CHECK(memcmp(addr, ADDR6, sizeof(ADDR6)) == 0);
+        CHECK(cache.find("example.com", AF_INET, 0, addr) == DnsCache::HIT);
+        CHECK(memcmp(addr, ADDR1, sizeof(ADDR1)) == 0);
+        CHECK(cache.stats().entries == 2);
+    }
+
+    SECTION("compares host names case-insensitively") {
+        REQUIRE(cache.put("Example.COM", AF_INET, ADDR1, sizeof(ADDR1), 60, 0) == 0);
+        CHECK(cache.find("example.com", AF_INET, 0, addr) == DnsCache::HIT);
+    }
+
+    SECTION("replaces an existing entry") {
+        REQUIRE(cache.put("example.com", AF_INET, ADDR1, sizeof(ADDR1), 60, 0) == 0);
+        REQUIRE(cache.put("example.com", AF_INET, ADDR2, sizeof(ADDR2), 60, 0) == 0);
+        CHECK(cache.find("example.com", AF_INET, 0, addr) == DnsCache::HIT);
+        CHECK(memcmp(addr, ADDR2, sizeof(ADDR2)) == 0);
+        CHECK(cache.stats().entries == 1);
+    }
+
+    SECTION("caches negative answers") {
+        REQUIRE(cache.putNegative("example.com", AF_INET, 30, 0) == 0);
+        CHECK(cache.find("example.com", AF_INET, 29999, addr) == DnsCache::NEGATIVE);
+        CHECK(cache.find("example.com", AF_INET, 30000, addr) == DnsCache::MISS);
+        CHECK(cache.stats().negativeHits == 1);
+    }
+
+    SECTION("clamps the TTL") {
+        REQUIRE(cache.put("a.com", AF_INET, ADDR1, sizeof(ADDR1), 0, 0) == 0);
+        REQUIRE(cache.put("b.com", AF_INET, ADDR1, sizeof(ADDR1), 86400, 0) == 0);
+        REQUIRE(cache.putNegative("c.com", AF_INET, 86400, 0) == 0);
+        CHECK(cache.find("a.com", AF_INET, DnsCache::MIN_TTL * 1000 - 1, addr) == DnsCache::HIT);
+        CHECK(cache.find("a.com", AF_INET, DnsCache::MIN_TTL * 1000, addr) == DnsCache::MISS);
+        CHECK(cache.find("b.com", AF_INET, DnsCache::MAX_TTL * 1000 - 1, addr) == DnsCache::HIT);
+        CHECK(cache.find("b.com", AF_INET, DnsCache::MAX_TTL * 1000, addr) == DnsCache::MISS);
+        CHECK(cache.find("c.com", AF_INET, DnsCache::MAX_NEGATIVE_TTL * 1000 - 1, addr) == DnsCache::NEGATIVE);
+        CHECK(cache.find("c.com", AF_INET, DnsCache::MAX_NEGATIVE_TTL * 1000, addr) == DnsCache::MISS);
+    }
+
+    SECTION("evicts the least recently used entry when full") {
+        char name[16] = {};
+        for (unsigned i = 0; i < DnsCache::MAX_ENTRIES; ++i) {
+            snprintf(name, sizeof(name), "%u.com", i);
+            REQUIRE(cache.put(name, AF_INET, ADDR1, sizeof(ADDR1), 60, i) == 0);
+        }
+        // Touch the oldest entry so that the second oldest one gets evicted
+        CHECK(cache.find("0.com", AF_INET, 100, addr) == DnsCache::HIT);
+        REQUIRE(cache.put("new.com", AF_INET, ADDR1, sizeof(ADDR1), 60, 101) == 0);
+        CHECK(cache.stats().entries == DnsCache::MAX_ENTRIES);
+        CHECK(cache.find("1.com", AF_INET, 102, addr) == DnsCache::MISS);
+        CHECK(cache.find("0.com", AF_INET, 102, addr) == DnsCache::HIT);
+        CHECK(cache.find("new.com", AF_INET, 102, addr) == DnsCache::HIT);
+    }
+
+    SECTION("reports a hot entry for prefetching once before it expires") {
+        bool prefetch = false;
+        REQUIRE(cache.put("example.com", AF_INET, ADDR1, sizeof(ADDR1), 80, 0) == 0);
+        CHECK(cache.find("example.com", AF_INET, 1000, addr, &prefetch) == DnsCache::HIT);
+        CHECK_FALSE(prefetch);
+        CHECK(cache.find("example.com", AF_INET, 2000, addr, &prefetch) == DnsCache::HIT);
+        CHECK_FALSE(prefetch);
+        // Less than 1/8 of the TTL is left
+        CHECK(cache.find("example.com", AF_INET, 71000, addr, &prefetch) == DnsCache::HIT);
+        CHECK(prefetch);
+        CHECK(cache.find("example.com", AF_INET, 72000, addr, &prefetch) == DnsCache::HIT);
+        CHECK_FALSE(prefetch);
+        cache.cancelPrefetch("example.com", AF_INET);
+        CHECK(cache.find("example.com", AF_INET, 73000, addr, &prefetch) == DnsCache::HIT);
+        CHECK(prefetch);
+        CHECK(cache.stats().prefetches == 2);
+    }
+
+    SECTION("doesn't prefetch an entry that is rarely used") {
+        bool prefetch = false;
+        REQUIRE(cache.put("example.com", AF_INET, ADDR1, sizeof(ADDR1), 80, 0) == 0);
+        CHECK(cache.find("example.com", AF_INET, 71000, addr, &prefetch) == DnsCache::HIT);
+        CHECK_FALSE(prefetch);
+    }
+}
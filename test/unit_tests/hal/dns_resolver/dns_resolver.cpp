@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dns_resolver.h"
+#include "system_error.h"
+#include "hal_stubs.h"
+
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch.hpp>
+
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstring>
+
+using namespace particle;
+
+namespace {
+
+// A DNS server listening on the loopback interface
+class TestDnsServer {
+public:
+    struct Record {
+        std::string ipv4;
+        std::string ipv6;
+        uint32_t ttl = 300;
+        uint32_t negativeTtl = 30;
+        unsigned rcode = 0;
+    };
+
+    TestDnsServer() :
+            sock_(-1),
+            queries_(0),
+            stop_(false) {
+        sock_ = socket(AF_INET, SOCK_DGRAM, 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(sock_, (const struct sockaddr*)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr_);
+        getsockname(sock_, (struct sockaddr*)&addr_, &len);
+        thread_ = std::thread([this]() {
+            run();
+        });
+    }
+
+    ~TestDnsServer() {
+        stop_ = true;
+        thread_.join();
+        close(sock_);
+    }
+
+    void set(const std::string& name, const Record& rec) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        records_[name] = rec;
+    }
+
+    unsigned queries() const {
+        return queries_;
+    }
+
+    const struct sockaddr* address() const {
+        return (const struct sockaddr*)&addr_;
+    }
+
+private:
+    std::map<std::string, Record> records_;
+    std::mutex mutex_;
+    std::thread thread_;
+    struct sockaddr_in addr_;
+    int sock_;
+    std::atomic<unsigned> queries_;
+    std::atomic<bool> stop_;
+
+    void run() {
+        while (!stop_) {
+            struct pollfd pfd = {};
+            pfd.fd = sock_;
+            pfd.events = POLLIN;
+            if (poll(&pfd, 1, 10) <= 0) {
+                continue;
+            }
+            uint8_t buf[512];
+            struct sockaddr_storage from = {};
+            socklen_t fromLen = sizeof(from);
+            const ssize_t n = recvfrom(sock_, buf, sizeof(buf), 0, (struct sockaddr*)&from, &fromLen);
+            if (n < 12) {
+                continue;
+            }
+            ++queries_;
+            const auto resp = respond(buf, n);
+            if (!resp.empty()) {
+                sendto(sock_, resp.data(), resp.size(), 0, (const struct sockaddr*)&from, fromLen);
+            }
+        }
+    }
+
+    std::vector<uint8_t> respond(const uint8_t* query, size_t size) {
+        // Parse the question
+        std::string name;
+        size_t offs = 12;
+        while (offs < size && query[offs]) {
+            if (!name.empty()) {
+                name += '.';
+            }
+            name.append((const char*)query + offs + 1, query[offs]);
+            offs += query[offs] + 1;
+        }
+        ++offs;
+        if (offs + 4 > size) {
+            return std::vector<uint8_t>();
+        }
+        const uint16_t type = (query[offs] << 8) | query[offs + 1];
+        offs += 4;
+        Record rec;
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            const auto it = records_.find(name);
+            if (it != records_.end()) {
+                rec = it->second;
+                found = true;
+            }
+        }
+        std::vector<uint8_t> resp(query, query + offs);
+        resp[2] = 0x81; // QR, RD
+        resp[3] = 0x80; // RA
+        resp[6] = resp[7] = resp[8] = resp[9] = resp[10] = resp[11] = 0;
+        if (!found) {
+            resp[3] |= 3; // NXDOMAIN
+            appendSoa(&resp, 300, 30);
+            return resp;
+        }
+        if (rec.rcode) {
+            resp[3] |= rec.rcode;
+            return resp;
+        }
+        uint8_t addr[16] = {};
+        if (type == 1 && !rec.ipv4.empty()) {
+            inet_pton(AF_INET, rec.ipv4.c_str(), addr);
+            appendAnswer(&resp, type, rec.ttl, addr, 4);
+        } else if (type == 28 && !rec.ipv6.empty()) {
+            inet_pton(AF_INET6, rec.ipv6.c_str(), addr);
+            appendAnswer(&resp, type, rec.ttl, addr, 16);
+        } else {
+            appendSoa(&resp, 300, rec.negativeTtl);
+        }
+        return resp;
+    }
+
+    static void appendUInt16(std::vector<uint8_t>* v, uint16_t val) {
+        v->push_back(val >> 8);
+        v->push_back(val & 0xff);
+    }
+
+    static void appendUInt32(std::vector<uint8_t>* v, uint32_t val) {
+        appendUInt16(v, val >> 16);
+        appendUInt16(v, val & 0xffff);
+    }
+
+    static void appendAnswer(std::vector<uint8_t>* resp, uint16_t type, uint32_t ttl, const uint8_t* addr,
+            size_t size) {
+        (*resp)[7] = 1; // ANCOUNT
+        appendUInt16(resp, 0xc00c); // Pointer to the name in the question
+        appendUInt16(resp, type);
+        appendUInt16(resp, 1);
+        appendUInt32(resp, ttl);
+        appendUInt16(resp, size);
+        resp->insert(resp->end(), addr, addr + size);
+    }
+
+    static void appendSoa(std::vector<uint8_t>* resp, uint32_t ttl, uint32_t minimum) {
+        (*resp)[9] = 1; // NSCOUNT
+        appendUInt16(resp, 0xc00c);
+        appendUInt16(resp, 6); // SOA
+        appendUInt16(resp, 1);
+        appendUInt32(resp, ttl);
+        appendUInt16(resp, 2 + 2 + 20);
+        appendUInt16(resp, 0xc00c); // MNAME
+        appendUInt16(resp, 0xc00c); // RNAME
+        for (unsigned i = 0; i < 4; ++i) {
+            appendUInt32(resp, 0); // SERIAL, REFRESH, RETRY, EXPIRE
+        }
+        appendUInt32(resp, minimum);
+    }
+};
+
+std::string toString(const DnsAddress& addr) {
+    char str[INET6_ADDRSTRLEN] = {};
+    inet_ntop(addr.family, addr.addr, str, sizeof(str));
+    return str;
+}
+
+// Returns the address of a closed port on the loopback interface
+struct sockaddr_in deadServerAddress() {
+    const int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(sock, (const struct sockaddr*)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(sock, (struct sockaddr*)&addr, &len);
+    close(sock);
+    return addr;
+}
+
+} // namespace
+
+TEST_CASE("DnsResolver") {
+    TestDnsServer server;
+    TestDnsServer::Record rec;
+    rec.ipv4 = "192.0.2.1";
+    rec.ipv6 = "2001:db8::1";
+    server.set("example.com", rec);
+
+    DnsResolver resolver;
+    DnsAddress addrs[2] = {};
+
+    SECTION("fails if there are no servers") {
+        CHECK(resolver.resolve("example.com", AF_INET, addrs, 2) == SYSTEM_ERROR_INVALID_STATE);
+    }
+
+    REQUIRE(resolver.addServer(server.address()) == 0);
+
+    SECTION("queries both address families at once and returns the IPv6 address first") {
+        REQUIRE(resolver.resolve("example.com", AF_UNSPEC, addrs, 2) == 2);
+        CHECK(addrs[0].family == AF_INET6);
+        CHECK(toString(addrs[0]) == "2001:db8::1");
+        CHECK(addrs[1].family == AF_INET);
+        CHECK(toString(addrs[1]) == "192.0.2.1");
+        CHECK(server.queries() == 2);
+    }
+
+    SECTION("answers repeated lookups from the cache") {
+        REQUIRE(resolver.resolve("example.com", AF_INET, addrs, 2) == 1);
+        REQUIRE(resolver.resolve("EXAMPLE.com", AF_INET, addrs, 2) == 1);
+        CHECK(toString(addrs[0]) == "192.0.2.1");
+        CHECK(server.queries() == 1);
+        const auto s = resolver.cacheStats();
+        CHECK(s.hits == 1);
+        CHECK(s.misses == 1);
+        CHECK(s.entries == 1);
+    }
+
+    SECTION("queries the server again when the answer expires") {
+        rec.ttl = 10;
+        server.set("example.com", rec);
+        REQUIRE(resolver.resolve("example.com", AF_INET, addrs, 2) == 1);
+        advanceTime(10000);
+        REQUIRE(resolver.resolve("example.com", AF_INET, addrs, 2) == 1);
+        CHECK(server.queries() == 2);
+    }
+
+    SECTION("caches negative answers") {
+        CHECK(resolver.resolve("missing.com", AF_INET, addrs, 2) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(resolver.resolve("missing.com", AF_INET, addrs, 2) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(server.queries() == 1);
+        CHECK(resolver.cacheStats().negativeHits == 1);
+        advanceTime(30000);
+        CHECK(resolver.resolve("missing.com", AF_INET, addrs, 2) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(server.queries() == 2);
+    }
+
+    SECTION("returns the addresses of one family if the other has none") {
+        TestDnsServer::Record rec4;
+        rec4.ipv4 = "192.0.2.4";
+        server.set("ipv4only.com", rec4);
+        REQUIRE(resolver.resolve("ipv4only.com", AF_UNSPEC, addrs, 2) == 1);
+        CHECK(toString(addrs[0]) == "192.0.2.4");
+        // The missing AAAA record is cached as well
+        REQUIRE(resolver.resolve("ipv4only.com", AF_UNSPEC, addrs, 2) == 1);
+        CHECK(server.queries() == 2);
+    }
+
+    SECTION("tries the next server if a server fails") {
+        TestDnsServer server2;
+        server2.set("example.com", rec);
+        TestDnsServer::Record failed;
+        failed.rcode = 2; // SERVFAIL
+        server.set("example.com", failed);
+        REQUIRE(resolver.addServer(server2.address()) == 0);
+        REQUIRE(resolver.resolve("example.com", AF_INET, addrs, 2) == 1);
+        CHECK(toString(addrs[0]) == "192.0.2.1");
+        CHECK(server.queries() == 1);
+        CHECK(server2.queries() == 1);
+        // Server failures are not cached
+        CHECK(resolver.cacheStats().entries == 1);
+    }
+
+    SECTION("fails if a server doesn't respond") {
+        resolver.clearServers();
+        const auto addr = deadServerAddress();
+        REQUIRE(resolver.addServer((const struct sockaddr*)&addr) == 0);
+        CHECK(resolver.resolve("example.com", AF_INET, addrs, 2) < 0);
+        CHECK(resolver.cacheStats().entries == 0);
+    }
+
+    SECTION("can resolve a host name in steps") {
+        DnsResolver::Request req;
+        REQUIRE(resolver.lookup(&req, "example.com", AF_INET) == 1);
+        // The queries are sent to the servers that were configured at the time of the lookup
+        resolver.clearServers();
+        DnsResolver::query(&req);
+        REQUIRE(resolver.complete(&req, addrs, 2) == 1);
+        CHECK(toString(addrs[0]) == "192.0.2.1");
+        CHECK(server.queries() == 1);
+        DnsResolver::Request req2;
+        REQUIRE(resolver.lookup(&req2, "example.com", AF_INET) == 0);
+        REQUIRE(resolver.complete(&req2, addrs, 2) == 1);
+        CHECK(toString(addrs[0]) == "192.0.2.1");
+        CHECK(server.queries() == 1);
+    }
+
+    SECTION("refreshes a hot entry before it expires") {
+        rec.ttl = 80;
+        server.set("example.com", rec);
+        REQUIRE(resolver.resolve("example.com", AF_INET, addrs, 2) == 1);
+        REQUIRE(resolver.resolve("example.com", AF_INET, addrs, 2) == 1);
+        REQUIRE(resolver.resolve("example.com", AF_INET, addrs, 2) == 1);
+        CHECK(server.queries() == 1);
+        rec.ipv4 = "192.0.2.2";
+        server.set("example.com", rec);
+        advanceTime(71000);
+        // The cached address is returned while the prefetch query is in flight
+        REQUIRE(resolver.resolve("example.com", AF_INET, addrs, 2) == 1);
+        CHECK(toString(addrs[0]) == "192.0.2.1");
+        for (unsigned i = 0; i < 100 && server.queries() < 2; ++i) {
+            usleep(10000);
+        }
+        usleep(50000);
+        resolver.process();
+        CHECK(server.queries() == 2);
+        advanceTime(9000);
+        REQUIRE(resolver.resolve("example.com", AF_INET, addrs, 2) == 1);
+        CHECK(toString(addrs[0]) == "192.0.2.2");
+        CHECK(server.queries() == 2);
+        CHECK(resolver.cacheStats().prefetches == 1);
+    }
+}
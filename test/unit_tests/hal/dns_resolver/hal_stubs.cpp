@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "socket_hal_posix.h"
+#include "rng_hal.h"
+#include "timer_hal.h"
+#include "hal_stubs.h"
+
+#include <unistd.h>
+#include <chrono>
+#include <random>
+
+namespace {
+
+system_tick_t g_timeOffset = 0;
+
+} // namespace
+
+void advanceTime(system_tick_t ms) {
+    g_timeOffset += ms;
+}
+
+system_tick_t HAL_Timer_Get_Milli_Seconds() {
+    const auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(t).count() + g_timeOffset;
+}
+
+uint32_t HAL_RNG_GetRandomNumber() {
+    static std::mt19937 gen;
+    return gen();
+}
+
+// The socket functions are forwarded to the host's sockets
+
+int sock_socket(int domain, int type, int protocol) {
+    return ::socket(domain, type, protocol);
+}
+
+int sock_close(int s) {
+    return ::close(s);
+}
+
+ssize_t sock_sendto(int s, const void* dataptr, size_t size, int flags, const struct sockaddr* to, socklen_t tolen) {
+    return ::sendto(s, dataptr, size, flags, to, tolen);
+}
+
+ssize_t sock_recvfrom(int s, void* mem, size_t len, int flags, struct sockaddr* from, socklen_t* fromlen) {
+    return ::recvfrom(s, mem, len, flags, from, fromlen);
+}
+
+int sock_poll(struct pollfd* fds, nfds_t nfds, int timeout) {
+    return ::poll(fds, nfds, timeout);
+}
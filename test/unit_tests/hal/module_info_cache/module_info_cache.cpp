@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define CATCH_CONFIG_MAIN
+
+#include "module_info_cache.h"
+
+#include <catch2/catch.hpp>
+
+#include <map>
+
+using namespace particle;
+
+namespace {
+
+const uint16_t TEST_PLATFORM_ID = 12;
+
+const module_bounds_t BOOTLOADER_BOUNDS = { 0x10000, 0x00000, 0x10000, MODULE_FUNCTION_BOOTLOADER, 0, MODULE_STORE_MAIN,
+        HAL_PLATFORM_MCU_DEFAULT, MODULE_BOUNDS_LOC_INTERNAL_FLASH };
+const module_bounds_t SYSTEM_PART1_BOUNDS = { 0x80000, 0x10000, 0x90000, MODULE_FUNCTION_SYSTEM_PART, 1, MODULE_STORE_MAIN,
+        HAL_PLATFORM_MCU_DEFAULT, MODULE_BOUNDS_LOC_INTERNAL_FLASH };
+const module_bounds_t SYSTEM_PART2_BOUNDS = { 0x40000, 0x90000, 0xd0000, MODULE_FUNCTION_SYSTEM_PART, 2, MODULE_STORE_MAIN,
+        HAL_PLATFORM_MCU_DEFAULT, MODULE_BOUNDS_LOC_INTERNAL_FLASH };
+const module_bounds_t USER_BOUNDS = { 0x20000, 0xd0000, 0xf0000, MODULE_FUNCTION_USER_PART, 1, MODULE_STORE_MAIN,
+        HAL_PLATFORM_MCU_DEFAULT, MODULE_BOUNDS_LOC_INTERNAL_FLASH };
+const module_bounds_t FACTORY_BOUNDS = { 0x20000, 0x100000, 0x120000, MODULE_FUNCTION_USER_PART, 1, MODULE_STORE_FACTORY,
+        HAL_PLATFORM_MCU_DEFAULT, MODULE_BOUNDS_LOC_EXTERNAL_FLASH };
+
+const module_bounds_t* const MODULE_BOUNDS[] = { &BOOTLOADER_BOUNDS, &SYSTEM_PART1_BOUNDS, &SYSTEM_PART2_BOUNDS,
+        &USER_BOUNDS, &FACTORY_BOUNDS };
+const size_t MODULE_COUNT = sizeof(MODULE_BOUNDS) / sizeof(MODULE_BOUNDS[0]);
+
+module_info_t moduleInfo(const module_bounds_t& bounds, uint16_t version, size_t size = 0x1000) {
+    module_info_t info = {};
+    info.module_start_address = (const void*)(uintptr_t)bounds.start_address;
+    info.module_end_address = (const void*)(uintptr_t)(bounds.start_address + size);
+    info.module_version = version;
+    info.platform_id = TEST_PLATFORM_ID;
+    info.module_function = bounds.module_function;
+    info.module_index = bounds.module_index;
+    return info;
+}
+
+// The fields of module_info_t are packed, so the dependencies are assigned by value
+module_dependency_t dependency(const module_bounds_t& bounds, uint16_t version) {
+    module_dependency_t dep = {};
+    dep.module_function = bounds.module_function;
+    dep.module_index = bounds.module_index;
+    dep.module_version = version;
+    return dep;
+}
+
+// In-memory module storage
+class TestReader: public ModuleReader {
+public:
+    std::map<const module_bounds_t*, module_info_t> modules;
+    std::map<const module_bounds_t*, bool> corrupted;
+    std::map<const module_bounds_t*, uint32_t> crcs;
+    VerifiedModuleList* verifiedModules = nullptr;
+    unsigned infoReads = 0;
+    unsigned integrityChecks = 0;
+
+    int readInfo(const module_bounds_t* bounds, hal_module_t* module) override {
+        ++infoReads;
+        const auto it = modules.find(bounds);
+        if (it == modules.end()) {
+            return SYSTEM_ERROR_NOT_FOUND;
+        }
+        module->info = it->second;
+        return 0;
+    }
+
+    int readSuffix(const module_bounds_t* bounds, hal_module_t* module) override {
+        const auto it = crcs.find(bounds);
+        module->crc.crc32 = (it != crcs.end()) ? it->second : 0x12345678;
+        return 0;
+    }
+
+    bool verifyIntegrity(const module_bounds_t* bounds, const module_info_t* info) override {
+        ++integrityChecks;
+        return !corrupted[bounds];
+    }
+
+    bool isVerified(const module_bounds_t* bounds, const hal_module_t* module) override {
+        return verifiedModules && verifiedModules->has(bounds->start_address, moduleLength(module->info), module->crc.crc32);
+    }
+
+    void verified(const module_bounds_t* bounds, const hal_module_t* module) override {
+        if (verifiedModules) {
+            verifiedModules->add(bounds->start_address, moduleLength(module->info), module->crc.crc32);
+        }
+    }
+
+    static uint32_t moduleLength(const module_info_t& info) {
+        return (uintptr_t)info.module_end_address - (uintptr_t)info.module_start_address;
+    }
+};
+
+const unsigned BASIC_CHECKS = MODULE_VALIDATION_RANGE | MODULE_VALIDATION_DEPENDENCIES | MODULE_VALIDATION_PLATFORM;
+
+} // namespace
+
+TEST_CASE("ModuleInfoCache") {
+    TestReader reader;
+    reader.modules[&BOOTLOADER_BOUNDS] = moduleInfo(BOOTLOADER_BOUNDS, 1000);
+    auto sys1 = moduleInfo(SYSTEM_PART1_BOUNDS, 3000);
+    sys1.dependency = dependency(BOOTLOADER_BOUNDS, 1000);
+    reader.modules[&SYSTEM_PART1_BOUNDS] = sys1;
+    auto sys2 = moduleInfo(SYSTEM_PART2_BOUNDS, 3000);
+    sys2.dependency = dependency(SYSTEM_PART1_BOUNDS, 3000);
+    reader.modules[&SYSTEM_PART2_BOUNDS] = sys2;
+    auto user = moduleInfo(USER_BOUNDS, 6);
+    user.dependency = dependency(SYSTEM_PART2_BOUNDS, 2000);
+    reader.modules[&USER_BOUNDS] = user;
+    ModuleInfoCache cache(&reader, MODULE_BOUNDS, MODULE_COUNT, TEST_PLATFORM_ID);
+
+    SECTION("reads the module headers only once") {
+        hal_module_t m = {};
+        for (size_t i = 0; i < 3; ++i) {
+            for (size_t j = 0; j < MODULE_COUNT - 1; ++j) {
+                REQUIRE(cache.getModule(j, &m, MODULE_VALIDATION_INTEGRITY));
+                CHECK(m.validity_result == (BASIC_CHECKS | MODULE_VALIDATION_INTEGRITY));
+            }
+        }
+        CHECK(reader.infoReads == MODULE_COUNT);
+        CHECK(reader.integrityChecks == MODULE_COUNT - 1);
+    }
+
+    SECTION("doesn't verify the integrity unless requested") {
+        hal_module_t m = {};
+        REQUIRE(cache.getModule(3, &m, 0));
+        CHECK(m.validity_checked == BASIC_CHECKS);
+        CHECK(m.validity_result == BASIC_CHECKS);
+        CHECK(m.bounds.start_address == USER_BOUNDS.start_address);
+        CHECK(m.info.module_version == 6);
+        CHECK(reader.integrityChecks == 0);
+    }
+
+    SECTION("reports a module that failed the integrity check") {
+        reader.corrupted[&SYSTEM_PART2_BOUNDS] = true;
+        hal_module_t m = {};
+        REQUIRE(cache.getModule(2, &m, MODULE_VALIDATION_INTEGRITY));
+        CHECK(m.validity_result == BASIC_CHECKS);
+    }
+
+    SECTION("fails for a missing module") {
+        hal_module_t m = {};
+        CHECK(!cache.getModule(4, &m, 0));
+        CHECK(m.bounds.start_address == FACTORY_BOUNDS.start_address);
+        CHECK(m.validity_result == 0);
+    }
+
+    SECTION("validates the module range and platform") {
+        auto info = moduleInfo(USER_BOUNDS, 6, 0x30000); // Too large
+        reader.modules[&USER_BOUNDS] = info;
+        hal_module_t m = {};
+        CHECK(!cache.getModule(3, &m, 0));
+        CHECK(!(m.validity_result & MODULE_VALIDATION_RANGE));
+        info = moduleInfo(USER_BOUNDS, 6);
+        info.platform_id = TEST_PLATFORM_ID + 1;
+        reader.modules[&USER_BOUNDS] = info;
+        cache.invalidateAll();
+        REQUIRE(cache.getModule(3, &m, 0));
+        CHECK(m.validity_result == (BASIC_CHECKS & ~MODULE_VALIDATION_PLATFORM));
+    }
+
+    SECTION("checks the module dependencies") {
+        auto info = reader.modules[&USER_BOUNDS];
+        CHECK(cache.checkDependencies(&info, false));
+        info.dependency = dependency(SYSTEM_PART2_BOUNDS, 4000);
+        CHECK(!cache.checkDependencies(&info, false));
+        // The dependencies of a user module are optional if requested
+        CHECK(cache.checkDependencies(&info, true));
+        // Second dependency
+        info = reader.modules[&USER_BOUNDS];
+        info.dependency2 = dependency(BOOTLOADER_BOUNDS, 1001);
+        CHECK(!cache.checkDependencies(&info, false));
+        // Unknown dependency
+        info = reader.modules[&USER_BOUNDS];
+        info.dependency.module_index = 3;
+        CHECK(!cache.checkDependencies(&info, false));
+        CHECK(reader.infoReads == MODULE_COUNT);
+    }
+
+    SECTION("checks if a system module update would break the dependencies of other modules") {
+        // An older system-part1 doesn't satisfy the dependency of system-part2
+        auto info = moduleInfo(SYSTEM_PART1_BOUNDS, 2000);
+        const module_bounds_t otaBounds = { 0x80000, 0x200000, 0x280000, MODULE_FUNCTION_NONE, 0, MODULE_STORE_SCRATCHPAD,
+                HAL_PLATFORM_MCU_ANY, MODULE_BOUNDS_LOC_EXTERNAL_FLASH };
+        CHECK(!cache.checkDependenciesFull(&info, &otaBounds));
+        info.module_version = 3000;
+        CHECK(cache.checkDependenciesFull(&info, &otaBounds));
+        // The check doesn't apply to other module types
+        info = moduleInfo(USER_BOUNDS, 1);
+        CHECK(cache.checkDependenciesFull(&info, &otaBounds));
+        CHECK(reader.integrityChecks == 0);
+    }
+
+    SECTION("reads a module again after its region is invalidated") {
+        hal_module_t m = {};
+        REQUIRE(cache.getModule(3, &m, MODULE_VALIDATION_INTEGRITY));
+        CHECK(reader.infoReads == MODULE_COUNT);
+        // Different flash
+        cache.invalidate(MODULE_BOUNDS_LOC_EXTERNAL_FLASH, USER_BOUNDS.start_address, 0x100);
+        REQUIRE(cache.getModule(3, &m, MODULE_VALIDATION_INTEGRITY));
+        CHECK(reader.infoReads == MODULE_COUNT);
+        // Update the user module
+        reader.modules[&USER_BOUNDS] = moduleInfo(USER_BOUNDS, 7);
+        reader.corrupted[&USER_BOUNDS] = true;
+        cache.invalidate(MODULE_BOUNDS_LOC_INTERNAL_FLASH, USER_BOUNDS.start_address + 0x100, 0x100);
+        REQUIRE(cache.getModule(3, &m, MODULE_VALIDATION_INTEGRITY));
+        CHECK(m.info.module_version == 7);
+        CHECK(!(m.validity_result & MODULE_VALIDATION_INTEGRITY));
+        CHECK(reader.infoReads == MODULE_COUNT + 1);
+        CHECK(reader.integrityChecks == 2);
+    }
+
+    SECTION("shares the integrity check results with getModule()") {
+        reader.corrupted[&SYSTEM_PART2_BOUNDS] = true;
+        bool valid = false;
+        REQUIRE(cache.checkIntegrity(MODULE_BOUNDS_LOC_INTERNAL_FLASH, USER_BOUNDS.start_address, &valid) == 0);
+        CHECK(valid);
+        REQUIRE(cache.checkIntegrity(MODULE_BOUNDS_LOC_INTERNAL_FLASH, SYSTEM_PART2_BOUNDS.start_address, &valid) == 0);
+        CHECK(!valid);
+        CHECK(reader.integrityChecks == 2);
+        hal_module_t m = {};
+        REQUIRE(cache.getModule(3, &m, MODULE_VALIDATION_INTEGRITY));
+        CHECK((m.validity_result & MODULE_VALIDATION_INTEGRITY));
+        REQUIRE(cache.checkIntegrity(MODULE_BOUNDS_LOC_INTERNAL_FLASH, USER_BOUNDS.start_address, &valid) == 0);
+        CHECK(valid);
+        CHECK(reader.integrityChecks == 2);
+        // Missing module
+        REQUIRE(cache.checkIntegrity(MODULE_BOUNDS_LOC_EXTERNAL_FLASH, FACTORY_BOUNDS.start_address, &valid) == 0);
+        CHECK(!valid);
+        // No module is expected at this address
+        CHECK(cache.checkIntegrity(MODULE_BOUNDS_LOC_INTERNAL_FLASH, USER_BOUNDS.start_address + 0x100, &valid) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(cache.checkIntegrity(MODULE_BOUNDS_LOC_EXTERNAL_FLASH, USER_BOUNDS.start_address, &valid) == SYSTEM_ERROR_NOT_FOUND);
+    }
+
+    SECTION("reuses the integrity check results that were recorded before a reset") {
+        VerifiedModuleList::Data data;
+        memset(&data, 0xa5, sizeof(data)); // Retained memory contains garbage after a cold boot
+        VerifiedModuleList verified(&data);
+        CHECK(verified.size() == 0);
+        reader.verifiedModules = &verified;
+        reader.corrupted[&SYSTEM_PART2_BOUNDS] = true;
+        hal_module_t m = {};
+        for (size_t i = 0; i < MODULE_COUNT - 1; ++i) {
+            REQUIRE(cache.getModule(i, &m, MODULE_VALIDATION_INTEGRITY));
+        }
+        CHECK(reader.integrityChecks == MODULE_COUNT - 1);
+        CHECK(verified.size() == MODULE_COUNT - 2); // The corrupted module is not recorded
+        // Simulate a reset
+        ModuleInfoCache cache2(&reader, MODULE_BOUNDS, MODULE_COUNT, TEST_PLATFORM_ID);
+        for (size_t i = 0; i < MODULE_COUNT - 1; ++i) {
+            REQUIRE(cache2.getModule(i, &m, MODULE_VALIDATION_INTEGRITY));
+            CHECK((bool)(m.validity_result & MODULE_VALIDATION_INTEGRITY) == (i != 2));
+        }
+        CHECK(reader.integrityChecks == MODULE_COUNT);
+        // A module with a different stored CRC is verified again
+        reader.crcs[&USER_BOUNDS] = 0x87654321;
+        reader.corrupted[&USER_BOUNDS] = true;
+        ModuleInfoCache cache3(&reader, MODULE_BOUNDS, MODULE_COUNT, TEST_PLATFORM_ID);
+        REQUIRE(cache3.getModule(3, &m, MODULE_VALIDATION_INTEGRITY));
+        CHECK(!(m.validity_result & MODULE_VALIDATION_INTEGRITY));
+        CHECK(reader.integrityChecks == MODULE_COUNT + 1);
+        // A module of a different length is verified again
+        reader.modules[&BOOTLOADER_BOUNDS] = moduleInfo(BOOTLOADER_BOUNDS, 1000, 0x2000);
+        ModuleInfoCache cache4(&reader, MODULE_BOUNDS, MODULE_COUNT, TEST_PLATFORM_ID);
+        REQUIRE(cache4.getModule(0, &m, MODULE_VALIDATION_INTEGRITY));
+        CHECK(reader.integrityChecks == MODULE_COUNT + 2);
+    }
+
+    SECTION("finds the module info by function and index") {
+        module_info_t info = {};
+        REQUIRE(cache.findModuleInfo(MODULE_FUNCTION_SYSTEM_PART, 2, HAL_PLATFORM_MCU_ANY, &info) == 0);
+        CHECK(info.module_start_address == (const void*)(uintptr_t)SYSTEM_PART2_BOUNDS.start_address);
+        CHECK(cache.findModuleInfo(MODULE_FUNCTION_SYSTEM_PART, 3, HAL_PLATFORM_MCU_ANY, &info) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(cache.findBounds(MODULE_FUNCTION_USER_PART, 1, HAL_PLATFORM_MCU_DEFAULT) == &USER_BOUNDS);
+    }
+}
+
+TEST_CASE("VerifiedModuleList") {
+    VerifiedModuleList::Data data = {};
+    VerifiedModuleList list(&data);
+
+    SECTION("ignores corrupted data") {
+        list.add(0x1000, 0x100, 1);
+        REQUIRE(list.has(0x1000, 0x100, 1));
+        data.entries[0].crc = 2;
+        CHECK(!list.has(0x1000, 0x100, 2));
+        CHECK(!list.has(0x1000, 0x100, 1));
+        CHECK(list.size() == 0);
+        list.add(0x2000, 0x100, 1);
+        CHECK(list.size() == 1);
+        CHECK(list.has(0x2000, 0x100, 1));
+    }
+
+    SECTION("matches the address, length and stored CRC of a module") {
+        list.add(0x1000, 0x100, 1);
+        CHECK(list.has(0x1000, 0x100, 1));
+        CHECK(!list.has(0x1000, 0x100, 2));
+        CHECK(!list.has(0x1000, 0x200, 1));
+        CHECK(!list.has(0x2000, 0x100, 1));
+    }
+
+    SECTION("replaces the module stored at the same address") {
+        list.add(0x1000, 0x100, 1);
+        list.add(0x1000, 0x200, 2);
+        CHECK(list.size() == 1);
+        CHECK(!list.has(0x1000, 0x100, 1));
+        CHECK(list.has(0x1000, 0x200, 2));
+    }
+
+    SECTION("removes the oldest module when full") {
+        for (size_t i = 0; i < MODULE_INFO_CACHE_MAX_MODULES + 1; ++i) {
+            list.add(0x1000 * (i + 1), 0x100, i);
+        }
+        CHECK(list.size() == MODULE_INFO_CACHE_MAX_MODULES);
+        CHECK(!list.has(0x1000, 0x100, 0));
+        CHECK(list.has(0x2000, 0x100, 1));
+        CHECK(list.has(0x1000 * (MODULE_INFO_CACHE_MAX_MODULES + 1), 0x100, MODULE_INFO_CACHE_MAX_MODULES));
+    }
+
+    SECTION("removes the modules overlapping with a written region") {
+        list.add(0x1000, 0x100, 1);
+        list.add(0x2000, 0x100, 2);
+        list.add(0x3000, 0x100, 3);
+        list.remove(0x1100 + 4, 0xf00 - 4);
+        CHECK(list.size() == 3);
+        // The stored CRC follows the end of the module
+        list.remove(0x1100, 4);
+        CHECK(list.size() == 2);
+        CHECK(!list.has(0x1000, 0x100, 1));
+        list.remove(0x2fff, 2);
+        CHECK(list.size() == 1);
+        CHECK(list.has(0x2000, 0x100, 2));
+        list.clear();
+        CHECK(list.size() == 0);
+    }
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// Stub for the parts of the gsm0710muxer library used by the channel scheduler
+
+namespace gsm0710 {
+
+enum GsmError {
+    GSM0710_ERROR_NONE = 0,
+    GSM0710_ERROR_UNKNOWN = -1,
+    GSM0710_ERROR_FLOW_CONTROL = -8
+};
+
+} // gsm0710
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define CATCH_CONFIG_MAIN
+
+#include "channel_scheduler.h"
+
+#include <catch2/catch.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace particle;
+
+namespace {
+
+const uint8_t AT_CHANNEL = 1;
+const uint8_t PPP_CHANNEL = 2;
+
+// Simulated muxer with two channel endpoints on the remote side
+class TestMuxer {
+public:
+    struct Frame {
+        uint8_t channel;
+        std::string data;
+    };
+
+    std::vector<Frame> frames;
+    std::vector<std::string> events;
+    bool remoteFlowControl[3] = {};
+    size_t maxFrameSize = 64;
+    int error = 0;
+    std::function<void()> onWrite;
+
+    int writeChannel(uint8_t channel, const uint8_t* data, size_t size) {
+        if (error) {
+            return error;
+        }
+        if (remoteFlowControl[channel]) {
+            return gsm0710::GSM0710_ERROR_FLOW_CONTROL;
+        }
+        REQUIRE(size <= maxFrameSize);
+        frames.push_back({ channel, std::string((const char*)data, size) });
+        if (onWrite) {
+            onWrite();
+        }
+        return 0;
+    }
+
+    int suspendChannel(uint8_t channel) {
+        events.push_back("suspend " + std::to_string(channel));
+        return 0;
+    }
+
+    int resumeChannel(uint8_t channel) {
+        events.push_back("resume " + std::to_string(channel));
+        return 0;
+    }
+
+    size_t getMaxFrameSize() const {
+        return maxFrameSize;
+    }
+
+    // Returns the data received by the remote endpoint of a channel
+    std::string received(uint8_t channel) const {
+        std::string s;
+        for (const auto& f: frames) {
+            if (f.channel == channel) {
+                s += f.data;
+            }
+        }
+        return s;
+    }
+
+    // Returns the order in which the channels were served
+    std::string order() const {
+        std::string s;
+        for (const auto& f: frames) {
+            s += (f.channel == AT_CHANNEL) ? 'A' : 'P';
+        }
+        return s;
+    }
+};
+
+struct NoLock {
+    void lock() {
+    }
+
+    void unlock() {
+    }
+};
+
+typedef MuxerChannelScheduler<TestMuxer, NoLock> Scheduler;
+
+std::string data(char c, size_t size) {
+    return std::string(size, c);
+}
+
+} // namespace
+
+TEST_CASE("MuxerChannelScheduler") {
+    TestMuxer muxer;
+    Scheduler sched(&muxer);
+    REQUIRE(sched.addChannel(AT_CHANNEL, 256, 90, 32) == 0);
+    REQUIRE(sched.addChannel(PPP_CHANNEL, 1024, 0, 64) == 0);
+
+    SECTION("passes data through when the link is idle") {
+        REQUIRE(sched.write(AT_CHANNEL, "AT\r\n", 4) == 4);
+        CHECK(muxer.received(AT_CHANNEL) == "AT\r\n");
+        CHECK(sched.txPending(AT_CHANNEL) == 0);
+    }
+
+    SECTION("splits data into frames of the maximum size") {
+        const auto d = data('p', 150);
+        REQUIRE(sched.write(PPP_CHANNEL, d.data(), d.size()) == 150);
+        REQUIRE(muxer.frames.size() == 3);
+        CHECK(muxer.frames[0].data.size() == 64);
+        CHECK(muxer.frames[2].data.size() == 22);
+        CHECK(muxer.received(PPP_CHANNEL) == d);
+    }
+
+    SECTION("interleaves the channels according to their weights") {
+        // Queue AT data while a PPP burst is being sent
+        const auto at = data('a', 64);
+        bool queued = false;
+        muxer.onWrite = [&]() {
+            if (!queued) {
+                queued = true;
+                REQUIRE(sched.write(AT_CHANNEL, at.data(), at.size()) == 64);
+            }
+        };
+        const auto ppp = data('p', 320);
+        REQUIRE(sched.write(PPP_CHANNEL, ppp.data(), ppp.size()) == 320);
+        // The AT channel gets 32 bytes after each 64 bytes of PPP data instead of waiting for the entire burst
+        CHECK(muxer.order() == "PAPAPPP");
+        CHECK(muxer.received(PPP_CHANNEL) == ppp);
+        CHECK(muxer.received(AT_CHANNEL) == at);
+    }
+
+    SECTION("keeps data of a channel suspended by the remote side and sends other channels") {
+        muxer.remoteFlowControl[PPP_CHANNEL] = true;
+        const auto ppp = data('p', 100);
+        REQUIRE(sched.write(PPP_CHANNEL, ppp.data(), ppp.size()) == 100);
+        REQUIRE(sched.write(AT_CHANNEL, "AT\r\n", 4) == 4);
+        CHECK(muxer.order() == "A");
+        CHECK(sched.txPending(PPP_CHANNEL) == 100);
+        MuxerChannelStats stats = {};
+        REQUIRE(sched.stats(PPP_CHANNEL, &stats) == 0);
+        CHECK(stats.txStalls == 1);
+        // Retrying a stalled channel is not counted as another stall
+        REQUIRE(sched.process() == 0);
+        REQUIRE(sched.process() == 0);
+        REQUIRE(sched.stats(PPP_CHANNEL, &stats) == 0);
+        CHECK(stats.txStalls == 1);
+        muxer.remoteFlowControl[PPP_CHANNEL] = false;
+        REQUIRE(sched.process() == 0);
+        CHECK(muxer.received(PPP_CHANNEL) == ppp);
+        CHECK(sched.txPending(PPP_CHANNEL) == 0);
+        muxer.remoteFlowControl[PPP_CHANNEL] = true;
+        REQUIRE(sched.write(PPP_CHANNEL, ppp.data(), ppp.size()) == 100);
+        REQUIRE(sched.stats(PPP_CHANNEL, &stats) == 0);
+        CHECK(stats.txStalls == 2);
+    }
+
+    SECTION("reports the queued data as written if the muxer fails") {
+        muxer.error = gsm0710::GSM0710_ERROR_UNKNOWN;
+        REQUIRE(sched.write(AT_CHANNEL, "AT\r\n", 4) == 4);
+        CHECK(sched.txPending(AT_CHANNEL) == 4);
+        CHECK(sched.process() == gsm0710::GSM0710_ERROR_UNKNOWN);
+        muxer.error = 0;
+        REQUIRE(sched.process() == 0);
+        CHECK(muxer.received(AT_CHANNEL) == "AT\r\n");
+    }
+
+    SECTION("queues a frame entirely or not at all if partial writes are not allowed") {
+        muxer.remoteFlowControl[PPP_CHANNEL] = true;
+        const auto d = data('p', 1000);
+        REQUIRE(sched.write(PPP_CHANNEL, d.data(), d.size(), false) == 1000);
+        CHECK(sched.write(PPP_CHANNEL, d.data(), d.size(), false) == 0);
+        CHECK(sched.availForWrite(PPP_CHANNEL) == 24);
+        CHECK(sched.write(PPP_CHANNEL, d.data(), d.size()) == 24);
+    }
+
+    SECTION("suspends a channel when its receive credit is low and resumes it when the data is consumed") {
+        REQUIRE(sched.received(AT_CHANNEL, 50) == 0);
+        CHECK(muxer.events.empty());
+        CHECK(sched.rxCredit(AT_CHANNEL) == 40);
+        // Credit <= 1/3 of the buffer
+        REQUIRE(sched.received(AT_CHANNEL, 20) == 0);
+        CHECK(sched.suspended(AT_CHANNEL));
+        REQUIRE(sched.received(AT_CHANNEL, 20, 5) == 0);
+        CHECK(sched.rxCredit(AT_CHANNEL) == 0);
+        REQUIRE(sched.consumed(AT_CHANNEL, 30) == 0);
+        CHECK(sched.suspended(AT_CHANNEL));
+        // Credit >= 1/2 of the buffer
+        REQUIRE(sched.consumed(AT_CHANNEL, 15) == 0);
+        CHECK(!sched.suspended(AT_CHANNEL));
+        CHECK(muxer.events == std::vector<std::string>({ "suspend 1", "resume 1" }));
+        MuxerChannelStats stats = {};
+        REQUIRE(sched.stats(AT_CHANNEL, &stats) == 0);
+        CHECK(stats.rxBytes == 90);
+        CHECK(stats.rxDropped == 5);
+        CHECK(stats.suspends == 1);
+    }
+
+    SECTION("doesn't apply flow control to a channel without receive accounting") {
+        REQUIRE(sched.received(PPP_CHANNEL, 10000) == 0);
+        CHECK(!sched.suspended(PPP_CHANNEL));
+        CHECK(muxer.events.empty());
+    }
+
+    SECTION("reset() discards the queued data") {
+        muxer.remoteFlowControl[PPP_CHANNEL] = true;
+        REQUIRE(sched.write(PPP_CHANNEL, "abc", 3) == 3);
+        sched.reset();
+        muxer.remoteFlowControl[PPP_CHANNEL] = false;
+        REQUIRE(sched.process() == 0);
+        CHECK(muxer.frames.empty());
+        CHECK(sched.availForWrite(PPP_CHANNEL) == 1024);
+    }
+
+    SECTION("fails for an unknown channel") {
+        CHECK(sched.write(3, "abc", 3) == SYSTEM_ERROR_NOT_FOUND);
+    }
+}
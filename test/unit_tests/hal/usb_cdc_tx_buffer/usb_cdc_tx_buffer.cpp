@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define CATCH_CONFIG_MAIN
+
+#include "usb_cdc_tx_buffer.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <random>
+
+using namespace particle;
+
+namespace {
+
+const size_t BUFFER_SIZE = 16;
+const size_t MAX_TRANSFER_SIZE = 8;
+
+size_t write(UsbCdcTxBuffer* buf, const std::string& data) {
+    return buf->write((const uint8_t*)data.data(), data.size());
+}
+
+std::string transfer(UsbCdcTxBuffer* buf) {
+    size_t size = 0;
+    const auto data = buf->beginTransfer(&size);
+    if (!data) {
+        return std::string();
+    }
+    return std::string((const char*)data, size);
+}
+
+} // namespace
+
+TEST_CASE("UsbCdcTxBuffer") {
+    uint8_t mem[BUFFER_SIZE] = {};
+    UsbCdcTxBuffer buf;
+    buf.init(mem, sizeof(mem), MAX_TRANSFER_SIZE);
+
+    SECTION("write() copies as much data as fits into the buffer") {
+        CHECK(buf.space() == BUFFER_SIZE);
+        CHECK(buf.pending() == 0);
+        CHECK(write(&buf, "0123456789") == 10);
+        CHECK(buf.space() == 6);
+        CHECK(buf.pending() == 10);
+        CHECK(write(&buf, "abcdefghij") == 6);
+        CHECK(buf.space() == 0);
+        CHECK(buf.pending() == BUFFER_SIZE);
+        CHECK(write(&buf, "x") == 0);
+    }
+
+    SECTION("a transfer is sent directly from the buffer and is limited to the maximum transfer size") {
+        REQUIRE(write(&buf, "0123456789") == 10);
+        size_t size = 0;
+        const auto data = buf.beginTransfer(&size);
+        CHECK(data == mem);
+        CHECK(size == MAX_TRANSFER_SIZE);
+        CHECK(buf.isTransferring());
+        CHECK(transfer(&buf).empty()); // Only one transfer at a time
+        buf.endTransfer();
+        CHECK(!buf.isTransferring());
+        CHECK(buf.pending() == 2);
+        CHECK(transfer(&buf) == "89");
+        buf.endTransfer();
+        CHECK(buf.pending() == 0);
+        CHECK(transfer(&buf).empty());
+    }
+
+    SECTION("data can be written while a transfer is in progress") {
+        REQUIRE(write(&buf, "01234567") == 8);
+        REQUIRE(transfer(&buf) == "01234567");
+        // The data of the ongoing transfer still occupies the buffer
+        CHECK(buf.space() == 8);
+        CHECK(buf.pending() == 8);
+        CHECK(write(&buf, "abcdefghij") == 8);
+        CHECK(buf.space() == 0);
+        buf.endTransfer();
+        CHECK(buf.space() == 8);
+        CHECK(buf.pending() == 8);
+        CHECK(transfer(&buf) == "abcdefgh");
+    }
+
+    SECTION("a transfer doesn't wrap around the end of the buffer") {
+        REQUIRE(write(&buf, "0123456789abcd") == 14);
+        REQUIRE(transfer(&buf) == "01234567");
+        buf.endTransfer();
+        REQUIRE(transfer(&buf) == "89abcd");
+        buf.endTransfer();
+        CHECK(write(&buf, "ABCDEFGH") == 8);
+        CHECK(buf.pending() == 8);
+        CHECK(transfer(&buf) == "AB");
+        buf.endTransfer();
+        CHECK(transfer(&buf) == "CDEFGH");
+        buf.endTransfer();
+        CHECK(buf.pending() == 0);
+        CHECK(buf.space() == BUFFER_SIZE);
+    }
+
+    SECTION("cancelTransfer() keeps the data in the buffer") {
+        REQUIRE(write(&buf, "0123") == 4);
+        REQUIRE(transfer(&buf) == "0123");
+        buf.cancelTransfer();
+        CHECK(!buf.isTransferring());
+        CHECK(buf.pending() == 4);
+        CHECK(transfer(&buf) == "0123");
+    }
+
+    SECTION("reset() discards all data") {
+        REQUIRE(write(&buf, "0123456789") == 10);
+        REQUIRE(transfer(&buf) == "01234567");
+        buf.reset();
+        CHECK(!buf.isTransferring());
+        CHECK(buf.pending() == 0);
+        CHECK(buf.space() == BUFFER_SIZE);
+        CHECK(transfer(&buf).empty());
+    }
+
+    SECTION("data is sent in the order in which it was written") {
+        std::mt19937 gen(1);
+        std::string in, out;
+        for (int i = 0; i < 1000; ++i) {
+            std::string s(gen() % (BUFFER_SIZE + 4), 'x');
+            for (auto& c: s) {
+                c = 'a' + gen() % 26;
+            }
+            const size_t space = buf.space();
+            const size_t n = write(&buf, s);
+            CHECK(n == std::min(s.size(), space));
+            in += s.substr(0, n);
+            if (!buf.isTransferring()) {
+                out += transfer(&buf);
+            }
+            if (gen() % 2) {
+                buf.endTransfer();
+            }
+        }
+        buf.endTransfer();
+        while (buf.pending()) {
+            out += transfer(&buf);
+            buf.endTransfer();
+        }
+        CHECK(out == in);
+    }
+}
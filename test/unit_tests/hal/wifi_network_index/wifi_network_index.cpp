@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define CATCH_CONFIG_MAIN
+
+#include "wifi_network_index.h"
+#include "system_error.h"
+
+#include "mock/filesystem.h"
+
+#include <catch2/catch.hpp>
+#include <hippomocks.h>
+
+#include <string>
+#include <vector>
+
+using namespace particle;
+
+namespace {
+
+const char* const INDEX_FILE = "wifi_index.bin";
+
+WifiScanResult ap(const char* ssid, int rssi) {
+    return WifiScanResult().ssid(ssid).rssi(rssi);
+}
+
+std::vector<std::string> ssids(const Vector<WifiScanResult>& aps) {
+    std::vector<std::string> v;
+    for (const auto& ap: aps) {
+        v.push_back(ap.ssid());
+    }
+    return v;
+}
+
+} // namespace
+
+TEST_CASE("WifiNetworkIndex") {
+    MockRepository mocks;
+    test::Filesystem fs(&mocks);
+    WifiNetworkIndex index(INDEX_FILE);
+
+    SECTION("load()") {
+        SECTION("returns SYSTEM_ERROR_NOT_FOUND if the file doesn't exist") {
+            CHECK(index.load() == SYSTEM_ERROR_NOT_FOUND);
+            CHECK(index.size() == 0);
+        }
+        SECTION("ignores a file with incompatible contents") {
+            fs.writeFile(INDEX_FILE, std::string("\x04\x00\x00\x00""abcd", 8));
+            CHECK(index.load() == SYSTEM_ERROR_NOT_FOUND);
+            CHECK(index.size() == 0);
+        }
+        SECTION("restores the saved state") {
+            REQUIRE(index.add("a") == 0);
+            REQUIRE(index.add("b") == 0);
+            REQUIRE(index.add("c") == 0);
+            REQUIRE(index.priority("c", 5) == 0);
+            index.connected("b");
+            REQUIRE(index.save() == 0);
+            WifiNetworkIndex index2(INDEX_FILE);
+            REQUIRE(index2.load() == 0);
+            CHECK(index2.size() == 3);
+            CHECK(index2.priority("c") == 5);
+            CHECK(index2.priority("a") == 0);
+            Vector<WifiScanResult> aps = { ap("a", -40), ap("b", -80), ap("c", -90) };
+            index2.sortCandidates(&aps);
+            CHECK(ssids(aps) == std::vector<std::string>({ "c", "b", "a" }));
+        }
+    }
+
+    SECTION("save()") {
+        SECTION("doesn't write the file if the index is not modified") {
+            CHECK(index.save() == 0);
+            CHECK(!fs.hasFile(INDEX_FILE));
+            REQUIRE(index.add("a") == 0);
+            CHECK(index.isModified());
+            CHECK(index.save() == 0);
+            CHECK(!index.isModified());
+            CHECK(fs.hasFile(INDEX_FILE));
+        }
+        SECTION("doesn't mark the index modified until a network is considered failing") {
+            REQUIRE(index.add("a") == 0);
+            REQUIRE(index.save() == 0);
+            for (unsigned i = 1; i < WifiNetworkIndex::MAX_FAILURES; ++i) {
+                index.connectionFailed("a");
+                CHECK(!index.isModified());
+            }
+            index.connectionFailed("a");
+            CHECK(index.isModified());
+        }
+        SECTION("doesn't mark the index modified when reconnecting to the same network") {
+            REQUIRE(index.add("a") == 0);
+            REQUIRE(index.add("b") == 0);
+            index.connected("a");
+            REQUIRE(index.save() == 0);
+            index.connected("a");
+            CHECK(!index.isModified());
+            index.connectionFailed("a");
+            index.connected("a");
+            CHECK(!index.isModified());
+            index.connected("b");
+            CHECK(index.isModified());
+            REQUIRE(index.save() == 0);
+            index.connected("a");
+            CHECK(index.isModified());
+        }
+        SECTION("marks the index modified when a failing network is connected to") {
+            REQUIRE(index.add("a") == 0);
+            index.connected("a");
+            for (unsigned i = 0; i < WifiNetworkIndex::MAX_FAILURES; ++i) {
+                index.connectionFailed("a");
+            }
+            REQUIRE(index.save() == 0);
+            index.connected("a");
+            CHECK(index.isModified());
+        }
+    }
+
+    SECTION("add()") {
+        SECTION("doesn't add the same network twice") {
+            REQUIRE(index.add("a") == 0);
+            REQUIRE(index.add("a") == 0);
+            CHECK(index.size() == 1);
+        }
+        SECTION("fails if the index is full") {
+            for (unsigned i = 0; i < MAX_CONFIGURED_WIFI_NETWORK_COUNT; ++i) {
+                REQUIRE(index.add(std::to_string(i).c_str()) == 0);
+            }
+            CHECK(index.add("a") == SYSTEM_ERROR_LIMIT_EXCEEDED);
+        }
+        SECTION("rejects invalid SSIDs") {
+            CHECK(index.add("") == SYSTEM_ERROR_INVALID_ARGUMENT);
+            CHECK(index.add(std::string(MAX_SSID_SIZE + 1, 'a').c_str()) == SYSTEM_ERROR_INVALID_ARGUMENT);
+            CHECK(index.add(std::string(MAX_SSID_SIZE, 'a').c_str()) == 0);
+        }
+    }
+
+    SECTION("priority()") {
+        REQUIRE(index.add("a") == 0);
+        REQUIRE(index.save() == 0);
+        CHECK(index.priority("a") == 0);
+        REQUIRE(index.priority("a", 0) == 0);
+        CHECK(!index.isModified());
+        REQUIRE(index.priority("a", 255) == 0);
+        CHECK(index.isModified());
+        CHECK(index.priority("a") == 255);
+        CHECK(index.priority("a", 256) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(index.priority("a", -1) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(index.priority("b", 1) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(index.priority("b") == SYSTEM_ERROR_NOT_FOUND);
+    }
+
+    SECTION("sync()") {
+        REQUIRE(index.add("a") == 0);
+        REQUIRE(index.add("b") == 0);
+        Vector<WifiNetworkConfig> networks;
+        networks.append(WifiNetworkConfig().ssid("b"));
+        networks.append(WifiNetworkConfig().ssid("c"));
+        REQUIRE(index.sync(networks) == 0);
+        CHECK(index.size() == 2);
+        CHECK(!index.has("a"));
+        CHECK(index.has("b"));
+        CHECK(index.has("c"));
+    }
+
+    SECTION("sortCandidates()") {
+        REQUIRE(index.add("a") == 0);
+        REQUIRE(index.add("b") == 0);
+        REQUIRE(index.add("c") == 0);
+        SECTION("removes unknown networks and orders by RSSI by default") {
+            Vector<WifiScanResult> aps = { ap("x", -30), ap("a", -70), ap("b", -50), ap("c", -60) };
+            index.sortCandidates(&aps);
+            CHECK(ssids(aps) == std::vector<std::string>({ "b", "c", "a" }));
+        }
+        SECTION("prefers the most recently connected networks") {
+            index.connected("a");
+            index.connected("c");
+            Vector<WifiScanResult> aps = { ap("a", -70), ap("b", -50), ap("c", -60), ap("c", -40) };
+            index.sortCandidates(&aps);
+            CHECK(ssids(aps) == std::vector<std::string>({ "c", "c", "a", "b" }));
+            CHECK(aps.at(0).rssi() == -40);
+        }
+        SECTION("prefers networks with a higher priority") {
+            index.connected("a");
+            REQUIRE(index.priority("b", 1) == 0);
+            Vector<WifiScanResult> aps = { ap("a", -40), ap("b", -80), ap("c", -60) };
+            index.sortCandidates(&aps);
+            CHECK(ssids(aps) == std::vector<std::string>({ "b", "a", "c" }));
+        }
+        SECTION("prefers a network with a higher priority over a more recently connected one") {
+            index.connected("b");
+            index.connected("c");
+            index.connected("a");
+            REQUIRE(index.priority("b", 2) == 0);
+            REQUIRE(index.priority("c", 1) == 0);
+            Vector<WifiScanResult> aps = { ap("a", -40), ap("b", -80), ap("c", -60) };
+            index.sortCandidates(&aps);
+            CHECK(ssids(aps) == std::vector<std::string>({ "b", "c", "a" }));
+            CHECK(strcmp(index.mostPreferred(), "b") == 0);
+        }
+        SECTION("tries failing networks last") {
+            index.connected("a");
+            for (unsigned i = 0; i < WifiNetworkIndex::MAX_FAILURES; ++i) {
+                index.connectionFailed("a");
+            }
+            Vector<WifiScanResult> aps = { ap("a", -40), ap("b", -80), ap("c", -60) };
+            index.sortCandidates(&aps);
+            CHECK(ssids(aps) == std::vector<std::string>({ "c", "b", "a" }));
+            index.connected("a");
+            index.sortCandidates(&aps);
+            CHECK(ssids(aps) == std::vector<std::string>({ "a", "c", "b" }));
+        }
+    }
+
+    SECTION("leastPreferred()") {
+        CHECK(index.leastPreferred() == nullptr);
+        REQUIRE(index.add("a") == 0);
+        REQUIRE(index.add("b") == 0);
+        REQUIRE(index.add("c") == 0);
+        index.connected("c");
+        index.connected("a");
+        CHECK(strcmp(index.leastPreferred(), "b") == 0);
+        REQUIRE(index.priority("b", 1) == 0);
+        CHECK(strcmp(index.leastPreferred(), "c") == 0);
+    }
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define CATCH_CONFIG_MAIN
+
+#include "wifi_scan_util.h"
+#include "wifi_network_index.h"
+#include "esp32_scan_parser.h"
+#include "system_error.h"
+
+#include "mock/filesystem.h"
+
+#include <catch2/catch.hpp>
+#include <hippomocks.h>
+
+#include <string>
+#include <vector>
+
+using namespace particle;
+
+namespace {
+
+// AT+CWLAP response recorded in an office building
+const char* const CWLAP_TRANSCRIPT[] = {
+    "+CWLAP:(3,\"Office\",-67,\"a4:2b:b0:d1:10:01\",1)",
+    "+CWLAP:(4,\"Guest\",-48,\"a4:2b:b0:d1:10:02\",1)",
+    "+CWLAP:(3,\"DIRECT-7C-HP OfficeJet\",-71,\"fa:da:0c:4e:7c:11\",6)",
+    "+CWLAP:(3,\"Office\",-55,\"a4:2b:b0:d1:20:01\",6)",
+    "+CWLAP:(0,\"\",-80,\"a4:2b:b0:d1:20:03\",6)",
+    "+CWLAP:(3,\"Lab, 2nd floor\",-60,\"3c:84:6a:11:22:33\",11)",
+    "+CWLAP:(3,\"Home\",-82,\"10:fe:ed:00:00:01\",11)",
+    "+CWLAP:(4,\"Guest\",-73,\"a4:2b:b0:d1:20:02\",6)",
+    "+CWLAP:(3,\"Office\",-88,\"a4:2b:b0:d1:30:01\",11)",
+    "+CWLAP:(3,\"Printer\",-90,\"invalid\",11)"
+};
+
+const size_t CWLAP_TRANSCRIPT_SIZE = sizeof(CWLAP_TRANSCRIPT) / sizeof(CWLAP_TRANSCRIPT[0]);
+
+struct ByRssi {
+    bool operator()(const WifiScanResult& ap1, const WifiScanResult& ap2) const {
+        return ap1.rssi() > ap2.rssi();
+    }
+};
+
+class ByIndex {
+public:
+    explicit ByIndex(const WifiNetworkIndex* index) :
+            index_(index) {
+    }
+
+    bool operator()(const WifiScanResult& ap1, const WifiScanResult& ap2) const {
+        return index_->isPreferred(ap1, ap2);
+    }
+
+private:
+    const WifiNetworkIndex* index_;
+};
+
+std::vector<WifiScanResult> parseTranscript() {
+    std::vector<WifiScanResult> aps;
+    for (size_t i = 0; i < CWLAP_TRANSCRIPT_SIZE; ++i) {
+        WifiScanResult ap;
+        if (parseEsp32ScanResult(CWLAP_TRANSCRIPT[i], &ap) == 0) {
+            aps.push_back(std::move(ap));
+        }
+    }
+    return aps;
+}
+
+template<typename T>
+std::vector<std::string> ssidsAndRssi(const T& aps) {
+    std::vector<std::string> v;
+    for (const auto& ap: aps) {
+        v.push_back(std::string(ap.ssid()) + "/" + std::to_string(ap.rssi()));
+    }
+    return v;
+}
+
+} // namespace
+
+TEST_CASE("parseEsp32ScanResult()") {
+    SECTION("parses a scan result") {
+        WifiScanResult ap;
+        REQUIRE(parseEsp32ScanResult(CWLAP_TRANSCRIPT[0], &ap) == 0);
+        CHECK(strcmp(ap.ssid(), "Office") == 0);
+        CHECK(ap.security() == WifiSecurity::WPA2_PSK);
+        CHECK(ap.rssi() == -67);
+        CHECK(ap.channel() == 1);
+        const MacAddress bssid = { { 0xa4, 0x2b, 0xb0, 0xd1, 0x10, 0x01 } };
+        CHECK(ap.bssid() == bssid);
+    }
+    SECTION("parses a hidden network") {
+        WifiScanResult ap;
+        REQUIRE(parseEsp32ScanResult(CWLAP_TRANSCRIPT[4], &ap) == 0);
+        CHECK(strcmp(ap.ssid(), "") == 0);
+        CHECK(ap.security() == WifiSecurity::NONE);
+    }
+    SECTION("rejects lines that can't be parsed") {
+        WifiScanResult ap;
+        CHECK(parseEsp32ScanResult(CWLAP_TRANSCRIPT[5], &ap) == SYSTEM_ERROR_BAD_DATA); // ',' in the SSID
+        CHECK(parseEsp32ScanResult(CWLAP_TRANSCRIPT[9], &ap) == SYSTEM_ERROR_BAD_DATA); // Invalid BSSID
+        CHECK(parseEsp32ScanResult("OK", &ap) == SYSTEM_ERROR_BAD_DATA);
+        CHECK(parseEsp32ScanResult("+CWLAP:(3,\"012345678901234567890123456789012\",-60,\"3c:84:6a:11:22:33\",11)",
+                &ap) == SYSTEM_ERROR_BAD_DATA); // SSID is too long
+    }
+    SECTION("parses the recorded transcript") {
+        CHECK(parseTranscript().size() == CWLAP_TRANSCRIPT_SIZE - 2);
+    }
+}
+
+TEST_CASE("WifiScanTopK") {
+    SECTION("keeps the best results in a stream of scan results") {
+        WifiScanTopK<3, ByRssi> topK;
+        for (auto& ap: parseTranscript()) {
+            topK.add(std::move(ap));
+            CHECK(topK.size() <= 3);
+        }
+        topK.sort();
+        CHECK(ssidsAndRssi(topK) == std::vector<std::string>({ "Guest/-48", "Office/-55", "Office/-67" }));
+    }
+    SECTION("drops results that are worse than all kept results") {
+        WifiScanTopK<2, ByRssi> topK;
+        CHECK(topK.add(WifiScanResult().ssid("a").rssi(-50)));
+        CHECK(topK.add(WifiScanResult().ssid("b").rssi(-60)));
+        CHECK(!topK.add(WifiScanResult().ssid("c").rssi(-70)));
+        CHECK(topK.add(WifiScanResult().ssid("d").rssi(-40)));
+        topK.sort();
+        CHECK(ssidsAndRssi(topK) == std::vector<std::string>({ "d/-40", "a/-50" }));
+    }
+    SECTION("can be empty") {
+        WifiScanTopK<2, ByRssi> topK;
+        topK.sort();
+        CHECK(topK.size() == 0);
+        CHECK(topK.begin() == topK.end());
+    }
+    SECTION("orders known networks by priority and connection history") {
+        MockRepository mocks;
+        test::Filesystem fs(&mocks);
+        WifiNetworkIndex index("wifi_index.bin");
+        REQUIRE(index.add("Office") == 0);
+        REQUIRE(index.add("Home") == 0);
+        REQUIRE(index.add("Guest") == 0);
+        index.connected("Guest");
+        index.connected("Home");
+        WifiScanTopK<3, ByIndex> topK((ByIndex(&index)));
+        for (auto& ap: parseTranscript()) {
+            if (index.has(ap.ssid())) {
+                topK.add(std::move(ap));
+            }
+        }
+        topK.sort();
+        CHECK(ssidsAndRssi(topK) == std::vector<std::string>({ "Home/-82", "Guest/-48", "Guest/-73" }));
+        REQUIRE(index.priority("Office", 1) == 0);
+        WifiScanTopK<3, ByIndex> topK2((ByIndex(&index)));
+        for (auto& ap: parseTranscript()) {
+            if (index.has(ap.ssid())) {
+                topK2.add(std::move(ap));
+            }
+        }
+        topK2.sort();
+        CHECK(ssidsAndRssi(topK2) == std::vector<std::string>({ "Office/-55", "Office/-67", "Office/-88" }));
+    }
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "asset_bundle.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace particle;
+
+namespace {
+
+struct Asset {
+    std::string name;
+    std::string data;
+    uint32_t hash;
+
+    Asset(std::string name, std::string data) :
+            name(name),
+            data(data),
+            hash(AssetBundleReader::nameHash(name.data(), name.size())) {
+    }
+
+    Asset(std::string name, std::string data, uint32_t hash) :
+            name(name),
+            data(data),
+            hash(hash) {
+    }
+};
+
+void append(std::string* s, const void* data, size_t size) {
+    s->append((const char*)data, size);
+}
+
+void align(std::string* s) {
+    s->resize((s->size() + 3) / 4 * 4, '\0');
+}
+
+// Builds a bundle in the same way as build/pack_assets.py does
+std::string pack(std::vector<Asset> assets) {
+    std::stable_sort(assets.begin(), assets.end(), [](const Asset& a, const Asset& b) {
+        return a.hash < b.hash;
+    });
+    std::string strings;
+    std::vector<uint32_t> nameOffs;
+    const size_t indexOffs = sizeof(AssetBundleHeader) + assets.size() * sizeof(AssetBundleEntry);
+    for (const auto& a: assets) {
+        nameOffs.push_back(indexOffs + strings.size());
+        strings += a.name;
+    }
+    const size_t indexSize = indexOffs + strings.size();
+    std::string data;
+    std::vector<uint32_t> dataOffs;
+    const size_t dataStart = (indexSize + 3) / 4 * 4;
+    for (const auto& a: assets) {
+        dataOffs.push_back(dataStart + data.size());
+        data += a.data;
+        align(&data);
+    }
+    std::string out;
+    AssetBundleHeader h = {};
+    h.magic = ASSET_BUNDLE_MAGIC;
+    h.version = ASSET_BUNDLE_VERSION;
+    h.headerSize = sizeof(h);
+    h.assetCount = assets.size();
+    h.indexSize = indexSize;
+    h.totalSize = dataStart + data.size();
+    append(&out, &h, sizeof(h));
+    for (size_t i = 0; i < assets.size(); ++i) {
+        AssetBundleEntry e = {};
+        e.nameHash = assets[i].hash;
+        e.nameOffset = nameOffs[i];
+        e.dataOffset = dataOffs[i];
+        e.dataSize = assets[i].data.size();
+        e.nameSize = assets[i].name.size();
+        append(&out, &e, sizeof(e));
+    }
+    out += strings;
+    align(&out);
+    out += data;
+    return out;
+}
+
+const uintptr_t BASE_ADDR = 0x1000;
+
+std::string g_storage;
+int g_readCount = 0;
+bool g_readFails = false;
+
+int readStorage(uintptr_t addr, uint8_t* buf, size_t size) {
+    ++g_readCount;
+    if (g_readFails) {
+        return SYSTEM_ERROR_FLASH_IO;
+    }
+    REQUIRE(addr >= BASE_ADDR);
+    REQUIRE(addr - BASE_ADDR + size <= g_storage.size());
+    memcpy(buf, g_storage.data() + addr - BASE_ADDR, size);
+    return 0;
+}
+
+std::string readAsset(const AssetHandle& h) {
+    return g_storage.substr(h.address - BASE_ADDR, h.size);
+}
+
+} // namespace
+
+TEST_CASE("AssetBundleReader") {
+    g_readCount = 0;
+    g_readFails = false;
+    AssetBundleReader r;
+
+    SECTION("finds assets by name") {
+        g_storage = pack({
+            { "cal/table1.bin", std::string("\x01\x02\x03", 3) },
+            { "cert.der", std::string(1000, 'c') },
+            { "weights", "abcdefgh" },
+            { "empty", "" }
+        });
+        REQUIRE(r.init(BASE_ADDR, g_storage.size(), readStorage) == 0);
+        CHECK(r.count() == 4);
+        CHECK(r.size() == g_storage.size());
+        AssetHandle h = {};
+        REQUIRE(r.find("cal/table1.bin", &h) == 0);
+        CHECK(h.address % 4 == 0);
+        CHECK(readAsset(h) == std::string("\x01\x02\x03", 3));
+        REQUIRE(r.find("cert.der", &h) == 0);
+        CHECK(readAsset(h) == std::string(1000, 'c'));
+        REQUIRE(r.find("weights", &h) == 0);
+        CHECK(readAsset(h) == "abcdefgh");
+        REQUIRE(r.find("empty", &h) == 0);
+        CHECK(h.size == 0);
+        CHECK(r.find("weight", &h) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(r.find("", &h) == SYSTEM_ERROR_NOT_FOUND);
+    }
+
+    SECTION("reads only a few index entries per lookup") {
+        std::vector<Asset> assets;
+        for (int i = 0; i < 256; ++i) {
+            assets.push_back({ "asset" + std::to_string(i), std::to_string(i) });
+        }
+        g_storage = pack(assets);
+        REQUIRE(r.init(BASE_ADDR, g_storage.size(), readStorage) == 0);
+        for (int i = 0; i < 256; ++i) {
+            g_readCount = 0;
+            AssetHandle h = {};
+            REQUIRE(r.find(("asset" + std::to_string(i)).c_str(), &h) == 0);
+            CHECK(readAsset(h) == std::to_string(i));
+            CHECK(g_readCount <= 11); // Binary search, entry and name
+        }
+    }
+
+    SECTION("distinguishes assets with colliding name hashes") {
+        const uint32_t hash = AssetBundleReader::nameHash("a", 1);
+        g_storage = pack({
+            { "b", "2", hash },
+            { "x", "4", hash - 1 },
+            { "a", "1", hash },
+            { "ab", "3", hash },
+            { "y", "5", hash + 1 }
+        });
+        REQUIRE(r.init(BASE_ADDR, g_storage.size(), readStorage) == 0);
+        AssetHandle h = {};
+        REQUIRE(r.find("a", &h) == 0);
+        CHECK(readAsset(h) == "1");
+        CHECK(r.find("c", &h) == SYSTEM_ERROR_NOT_FOUND);
+    }
+
+    SECTION("enumerates assets") {
+        g_storage = pack({
+            { "first", "1" },
+            { "a_much_longer_asset_name", "2" }
+        });
+        REQUIRE(r.init(BASE_ADDR, g_storage.size(), readStorage) == 0);
+        std::vector<std::string> names;
+        for (size_t i = 0; i < r.count(); ++i) {
+            char name[32] = {};
+            AssetHandle h = {};
+            int n = r.get(i, &h, name, sizeof(name));
+            REQUIRE(n == (int)strlen(name));
+            names.push_back(name);
+        }
+        std::sort(names.begin(), names.end());
+        CHECK(names == std::vector<std::string>({ "a_much_longer_asset_name", "first" }));
+        // Truncated name
+        for (size_t i = 0; i < r.count(); ++i) {
+            char name[4] = {};
+            int n = r.get(i, nullptr, name, sizeof(name));
+            REQUIRE(n > 0);
+            CHECK(strlen(name) == 3);
+        }
+        CHECK(r.get(2, nullptr) == SYSTEM_ERROR_OUT_OF_RANGE);
+    }
+
+    SECTION("rejects invalid bundles") {
+        g_storage = pack({ { "a", "1" } });
+        SECTION("erased flash") {
+            g_storage = std::string(g_storage.size(), '\xff');
+            CHECK(r.init(BASE_ADDR, g_storage.size(), readStorage) == SYSTEM_ERROR_NOT_FOUND);
+            CHECK(!r.isValid());
+        }
+        SECTION("region is too small") {
+            CHECK(r.init(BASE_ADDR, g_storage.size() - 1, readStorage) == SYSTEM_ERROR_BAD_DATA);
+            CHECK(r.init(BASE_ADDR, sizeof(AssetBundleHeader) - 1, readStorage) == SYSTEM_ERROR_NOT_FOUND);
+        }
+        SECTION("unsupported version") {
+            auto h = (AssetBundleHeader*)&g_storage[0];
+            h->version = ASSET_BUNDLE_VERSION + 1;
+            CHECK(r.init(BASE_ADDR, g_storage.size(), readStorage) == SYSTEM_ERROR_BAD_DATA);
+        }
+        SECTION("invalid asset count") {
+            auto h = (AssetBundleHeader*)&g_storage[0];
+            h->assetCount = 0xffffffff;
+            CHECK(r.init(BASE_ADDR, g_storage.size(), readStorage) == SYSTEM_ERROR_BAD_DATA);
+        }
+        SECTION("invalid entry") {
+            auto e = (AssetBundleEntry*)&g_storage[sizeof(AssetBundleHeader)];
+            e->dataSize = g_storage.size();
+            REQUIRE(r.init(BASE_ADDR, g_storage.size(), readStorage) == 0);
+            AssetHandle h = {};
+            CHECK(r.find("a", &h) == SYSTEM_ERROR_BAD_DATA);
+        }
+    }
+
+    SECTION("forwards storage errors") {
+        g_storage = pack({ { "a", "1" } });
+        REQUIRE(r.init(BASE_ADDR, g_storage.size(), readStorage) == 0);
+        g_readFails = true;
+        AssetHandle h = {};
+        CHECK(r.find("a", &h) == SYSTEM_ERROR_FLASH_IO);
+        CHECK(r.init(BASE_ADDR, g_storage.size(), readStorage) == SYSTEM_ERROR_FLASH_IO);
+    }
+
+    SECTION("fails if not initialized") {
+        AssetHandle h = {};
+        CHECK(r.find("a", &h) == SYSTEM_ERROR_INVALID_STATE);
+        CHECK(r.get(0, &h) == SYSTEM_ERROR_INVALID_STATE);
+    }
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "crc32_util.h"
+
+#include "util/random.h"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+
+using namespace particle;
+
+namespace {
+
+// Bitwise reference implementation
+uint32_t referenceCrc32(const std::string& data) {
+    uint32_t crc = 0xffffffff;
+    for (unsigned char c: data) {
+        crc ^= c;
+        for (int i = 0; i < 8; ++i) {
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+uint32_t crc32(const std::string& data) {
+    return crc32_update(0, data.data(), data.size());
+}
+
+} // namespace
+
+TEST_CASE("crc32_update()") {
+    SECTION("computes the standard check value") {
+        CHECK(crc32("123456789") == 0xcbf43926);
+        CHECK(crc32("") == 0);
+    }
+
+    SECTION("matches the reference implementation for data of various sizes") {
+        for (size_t size = 0; size < 100; ++size) {
+            const auto d = test::randString(size);
+            CHECK(crc32(d) == referenceCrc32(d));
+        }
+    }
+
+    SECTION("handles unaligned data") {
+        const auto d = test::randString(1000);
+        for (size_t offs = 1; offs < 8; ++offs) {
+            CHECK(crc32_update(0, d.data() + offs, d.size() - offs) == referenceCrc32(d.substr(offs)));
+        }
+    }
+
+    SECTION("can compute the checksum in chunks") {
+        const auto d = test::randString(1000);
+        uint32_t crc = 0;
+        size_t offs = 0;
+        for (size_t n: { 1, 3, 8, 13, 256, 719 }) {
+            crc = crc32_update(crc, d.data() + offs, n);
+            offs += n;
+        }
+        REQUIRE(offs == d.size());
+        CHECK(crc == referenceCrc32(d));
+    }
+}
+
+TEST_CASE("crc32_update() throughput", "[.][benchmark]") {
+    const auto d = test::randString(1024 * 1024);
+    const unsigned iterations = 100;
+    uint32_t crc = 0;
+    const auto t1 = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; ++i) {
+        crc = crc32_update(crc, d.data(), d.size());
+    }
+    const auto t2 = std::chrono::steady_clock::now();
+    const double sec = std::chrono::duration<double>(t2 - t1).count();
+    WARN("crc32_update(): " << (iterations / sec) << " MB/s (CRC: " << crc << ")");
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hash_util.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+
+namespace {
+
+uint32_t fnv1a(const std::string& data, uint32_t hash = FNV1A_INIT) {
+    return fnv1a_update(hash, data.data(), data.size());
+}
+
+} // unnamed
+
+TEST_CASE("fnv1a_update()") {
+    SECTION("computes the FNV-1a hash of a buffer") {
+        // Test vectors from the reference implementation
+        CHECK(fnv1a("") == 0x811c9dc5);
+        CHECK(fnv1a("a") == 0xe40c292c);
+        CHECK(fnv1a("foobar") == 0xbf9cf968);
+    }
+
+    SECTION("can hash the data in chunks") {
+        CHECK(fnv1a("bar", fnv1a("foo")) == fnv1a("foobar"));
+        CHECK(fnv1a("", fnv1a("foobar")) == fnv1a("foobar"));
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hash_index.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace particle;
+
+namespace {
+
+// Poor hash function to make collisions likely
+uint32_t hash(const std::string& s) {
+    return s.empty() ? 0 : (uint8_t)s[0];
+}
+
+class Index {
+public:
+    int add(const std::string& key) {
+        const int r = index_.add(hash(key), keys_.size());
+        if (r == 0) {
+            keys_.push_back(key);
+        }
+        return r;
+    }
+
+    int find(const std::string& key) const {
+        return index_.find(hash(key), [this, &key](size_t i) {
+            return keys_.at(i) == key;
+        });
+    }
+
+    size_t size() const {
+        return index_.size();
+    }
+
+private:
+    HashIndex index_;
+    std::vector<std::string> keys_;
+};
+
+} // namespace
+
+TEST_CASE("HashIndex") {
+    Index index;
+
+    SECTION("finds nothing in an empty index") {
+        CHECK(index.find("abc") == -1);
+    }
+
+    SECTION("finds the added items") {
+        REQUIRE(index.add("abc") == 0);
+        REQUIRE(index.add("def") == 0);
+        CHECK(index.find("abc") == 0);
+        CHECK(index.find("def") == 1);
+        CHECK(index.find("ghi") == -1);
+        CHECK(index.size() == 2);
+    }
+
+    SECTION("resolves collisions and keeps the items when growing") {
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(index.add("a" + std::to_string(i)) == 0);
+        }
+        for (int i = 0; i < 100; ++i) {
+            CHECK(index.find("a" + std::to_string(i)) == i);
+        }
+        CHECK(index.find("a100") == -1);
+        CHECK(index.find("b0") == -1);
+    }
+
+    SECTION("supports up to 255 items") {
+        for (size_t i = 0; i < HashIndex::MAX_ITEMS; ++i) {
+            REQUIRE(index.add(std::to_string(i)) == 0);
+        }
+        CHECK(index.add("x") == SYSTEM_ERROR_TOO_LARGE);
+        CHECK(index.find("254") == 254);
+    }
+}
@@ -28,4 +28,11 @@ int diag_enum_sources(diag_enum_sources_callback callback, size_t* count, void*
 
 int diag_get_source(uint16_t id, const diag_source** src, void* reserved) {
     return 0;
-}
\ No newline at end of file
+}
+
+int diag_snapshot(diag_value* values, size_t count, size_t* total, void* reserved) {
+    if (total) {
+        *total = 0;
+    }
+    return 0;
+}
@@ -545,3 +545,55 @@ TEST_CASE("system_module_info") {
     }
 
 }
+
+TEST_CASE("system_module_info_read") {
+    MockRepository mocks;
+    particle::test::SystemInfo systemInfo(&mocks);
+    JsonObjectAppenderWrapper appender;
+
+    using namespace particle::test;
+    systemInfo.setPlatformId(123);
+    for (unsigned i = 0; i < 5; i++) {
+        systemInfo.addModule(genValidOrNoneModuleFunction());
+        systemInfo.addKeyValue();
+    }
+    CHECK(system_module_info(appender.callback, &appender, nullptr));
+    const std::string expected(appender.buffer() + 1, appender.dataSize() - 1); // Skip '{'
+
+    hal_system_info_t info = {};
+    info.size = sizeof(info);
+    info.flags = HAL_SYSTEM_INFO_FLAGS_CLOUD;
+    REQUIRE(system_info_get_unstable(&info, 0, nullptr) == 0);
+
+    for (size_t chunkSize: { 1, 7, 64, 512 }) {
+        SECTION("chunk size " + std::to_string(chunkSize)) {
+            std::string data;
+            std::vector<char> buf(chunkSize);
+            uint32_t cursor = 0;
+            while (cursor != SYSTEM_MODULE_INFO_CURSOR_END) {
+                int r = system_module_info_read(&info, &cursor, buf.data(), buf.size(), nullptr);
+                REQUIRE(r >= 0);
+                REQUIRE((size_t)r <= chunkSize);
+                if (cursor != SYSTEM_MODULE_INFO_CURSOR_END) {
+                    REQUIRE(r > 0);
+                }
+                data.append(buf.data(), r);
+            }
+            CHECK(data == expected);
+            CHECK(system_module_info_read(&info, &cursor, buf.data(), buf.size(), nullptr) == 0);
+        }
+    }
+
+    SECTION("the checksum changes when the document changes") {
+        uint32_t checksum1 = 0;
+        REQUIRE(system_module_info_checksum(&info, &checksum1, nullptr) == 0);
+        uint32_t checksum2 = 0;
+        REQUIRE(system_module_info_checksum(&info, &checksum2, nullptr) == 0);
+        CHECK(checksum1 == checksum2);
+        info.platform_id = 124;
+        REQUIRE(system_module_info_checksum(&info, &checksum2, nullptr) == 0);
+        CHECK(checksum1 != checksum2);
+    }
+
+    system_info_free_unstable(&info, nullptr);
+}
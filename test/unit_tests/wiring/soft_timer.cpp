@@ -0,0 +1,228 @@
+#include "spark_wiring_soft_timer.h"
+#include "concurrent_hal.h"
+#include "hal_irq_flag.h"
+
+#include "catch2/catch.hpp"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <memory>
+
+namespace {
+
+using namespace particle;
+
+// The critical sections of the timer service are emulated with a global recursive mutex
+std::recursive_mutex* g_irqMutex = new std::recursive_mutex();
+
+struct Semaphore {
+    std::mutex mutex;
+    std::condition_variable cond;
+    unsigned count;
+    unsigned maxCount;
+};
+
+struct Thread {
+    std::thread thread;
+    std::thread::id id; // The ID of a detached thread can't be obtained via std::thread
+};
+
+template<typename PredT>
+bool waitFor(PredT pred, unsigned timeout = 1000) {
+    const auto t = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() >= t) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+} // namespace
+
+int HAL_disable_irq() {
+    g_irqMutex->lock();
+    return 0;
+}
+
+void HAL_enable_irq(int mask) {
+    g_irqMutex->unlock();
+}
+
+os_result_t os_thread_create(os_thread_t* result, const char* name, os_thread_prio_t priority, os_thread_fn_t fun,
+        void* thread_param, size_t stack_size) {
+    // The thread is never joined, as the timer service is never destroyed
+    const auto t = new Thread();
+    t->thread = std::thread(fun, thread_param);
+    t->id = t->thread.get_id();
+    t->thread.detach();
+    *result = t;
+    return 0;
+}
+
+bool os_thread_is_current(os_thread_t thread) {
+    return static_cast<Thread*>(thread)->id == std::this_thread::get_id();
+}
+
+os_result_t os_thread_exit(os_thread_t thread) {
+    return 0;
+}
+
+os_result_t os_thread_yield(void) {
+    std::this_thread::yield();
+    return 0;
+}
+
+int os_mutex_create(os_mutex_t* mutex) {
+    *mutex = new std::mutex();
+    return 0;
+}
+
+int os_mutex_lock(os_mutex_t mutex) {
+    static_cast<std::mutex*>(mutex)->lock();
+    return 0;
+}
+
+int os_mutex_unlock(os_mutex_t mutex) {
+    static_cast<std::mutex*>(mutex)->unlock();
+    return 0;
+}
+
+int os_semaphore_create(os_semaphore_t* semaphore, unsigned max_count, unsigned initial_count) {
+    const auto s = new Semaphore();
+    s->count = initial_count;
+    s->maxCount = max_count;
+    *semaphore = s;
+    return 0;
+}
+
+int os_semaphore_take(os_semaphore_t semaphore, system_tick_t timeout, bool reserved) {
+    const auto s = static_cast<Semaphore*>(semaphore);
+    std::unique_lock<std::mutex> lock(s->mutex);
+    const auto pred = [s]() {
+        return s->count > 0;
+    };
+    if (timeout == CONCURRENT_WAIT_FOREVER) {
+        s->cond.wait(lock, pred);
+    } else if (!s->cond.wait_for(lock, std::chrono::milliseconds(timeout), pred)) {
+        return -1;
+    }
+    --s->count;
+    return 0;
+}
+
+int os_semaphore_give(os_semaphore_t semaphore, bool reserved) {
+    const auto s = static_cast<Semaphore*>(semaphore);
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        if (s->count < s->maxCount) {
+            ++s->count;
+        }
+    }
+    s->cond.notify_one();
+    return 0;
+}
+
+TEST_CASE("SoftTimer") {
+    SECTION("a timer started on an idle service fires") {
+        std::atomic<int> count(0);
+        {
+            // Let the service thread go to sleep with no timers scheduled
+            SoftTimer t(1000, []() {}, true /* oneShot */);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        SoftTimer t(10, [&count]() {
+            ++count;
+        }, true /* oneShot */);
+        CHECK(t.start());
+        CHECK(waitFor([&count]() { return count == 1; }));
+        CHECK(!t.isActive());
+    }
+
+    SECTION("a timer that is due earlier wakes the service up") {
+        std::atomic<int> count1(0), count2(0);
+        SoftTimer t1(10000, [&count1]() {
+            ++count1;
+        }, true /* oneShot */);
+        SoftTimer t2(10, [&count2]() {
+            ++count2;
+        }, true /* oneShot */);
+        CHECK(t1.start());
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(t2.start());
+        CHECK(waitFor([&count2]() { return count2 == 1; }));
+        CHECK(count1 == 0);
+        CHECK(t1.isActive());
+        t1.stop();
+    }
+
+    SECTION("a periodic timer fires repeatedly until stopped") {
+        std::atomic<int> count(0);
+        SoftTimer t(5, [&count]() {
+            ++count;
+        });
+        CHECK(t.start());
+        CHECK(waitFor([&count]() { return count >= 3; }));
+        t.dispose();
+        const int n = count;
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        CHECK(count == n);
+    }
+
+    SECTION("a stopped timer doesn't fire") {
+        std::atomic<int> count(0);
+        SoftTimer t(20, [&count]() {
+            ++count;
+        }, true /* oneShot */);
+        CHECK(t.start());
+        CHECK(t.isActive());
+        CHECK(t.stop());
+        CHECK(!t.isActive());
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        CHECK(count == 0);
+    }
+
+    SECTION("a timer can be restarted and disposed of from its own callback") {
+        std::atomic<int> count(0);
+        SoftTimer* t = nullptr;
+        t = new SoftTimer(5, [&count, &t]() {
+            if (++count < 3) {
+                t->start();
+            } else {
+                delete t;
+            }
+        }, true /* oneShot */);
+        CHECK(t->start());
+        CHECK(waitFor([&count]() { return count == 3; }));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(count == 3);
+    }
+
+    SECTION("timers expire in order when many are started at once") {
+        std::mutex mutex;
+        std::vector<int> fired;
+        std::vector<std::unique_ptr<SoftTimer>> timers;
+        for (int i = 0; i < 100; ++i) {
+            timers.emplace_back(new SoftTimer(10 + (99 - i) * 2, [&mutex, &fired, i]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                fired.push_back(i);
+            }, true /* oneShot */));
+        }
+        for (auto& t: timers) {
+            CHECK(t->start());
+        }
+        CHECK(waitFor([&mutex, &fired]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return fired.size() == 100;
+        }));
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < fired.size(); ++i) {
+            CHECK(fired[i] == 99 - (int)i);
+        }
+    }
+}
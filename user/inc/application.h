@@ -61,6 +61,9 @@
 #include "spark_wiring_client.h"
 #include "spark_wiring_startup.h"
 #include "spark_wiring_timer.h"
+#include "spark_wiring_soft_timer.h"
+#include "spark_wiring_analog_stream.h"
+#include "spark_wiring_bus_queue.h"
 #include "spark_wiring_tcpclient.h"
 #include "spark_wiring_tcpserver.h"
 #include "spark_wiring_udp.h"
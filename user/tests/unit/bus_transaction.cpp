@@ -0,0 +1,240 @@
+#include "spark_wiring_bus_transaction.h"
+#include "system_error.h"
+
+#include "tools/catch.h"
+
+#include <vector>
+#include <string>
+
+using namespace particle;
+
+namespace {
+
+class TestDriver: public BusDriver {
+public:
+    std::vector<std::string> log;
+    int beginResult = 0;
+    size_t failStep = (size_t)-1;
+    std::function<void()> onBegin;
+
+    int begin(const BusTransaction& t) override {
+        log.push_back("begin:" + std::to_string(t.address));
+        if (onBegin) {
+            onBegin();
+        }
+        return beginResult;
+    }
+
+    int step(const BusTransaction& t, const BusStep& step) override {
+        log.push_back("step:" + std::to_string(step.type));
+        if (stepIndex++ == failStep) {
+            return SYSTEM_ERROR_IO;
+        }
+        if (step.type == BusStep::READ) {
+            for (size_t i = 0; i < step.size; ++i) {
+                step.rx[i] = i + 1;
+            }
+        }
+        return 0;
+    }
+
+    void end(const BusTransaction& t) override {
+        log.push_back("end");
+        stepIndex = 0;
+    }
+
+private:
+    size_t stepIndex = 0;
+};
+
+// Queue that doesn't process the transactions until explicitly requested
+class ManualQueue: public BusTransactionQueue {
+public:
+    explicit ManualQueue(BusDriver* driver) :
+            BusTransactionQueue(driver) {
+    }
+
+protected:
+    void notify() override {
+    }
+};
+
+typedef std::vector<std::pair<uint16_t, int>> Results;
+
+struct TestTransaction: BusTransaction {
+    Results* results;
+
+    TestTransaction(Results* results, uint16_t address, int8_t priority = 0, const BusStep* steps = nullptr, size_t stepCount = 0) :
+            BusTransaction(steps, stepCount, address, priority),
+            results(results) {
+        callback = completed;
+        callbackData = this;
+    }
+
+    static void completed(int error, const void* data, void* callbackData, void* reserved) {
+        const auto t = static_cast<TestTransaction*>(callbackData);
+        t->results->push_back(std::make_pair(t->address, error));
+    }
+};
+
+} // namespace
+
+TEST_CASE("BusTransactionQueue") {
+    TestDriver driver;
+    Results res;
+
+    SECTION("executes the steps of a transaction in order") {
+        BusTransactionQueue q(&driver);
+        const uint8_t cmd = 0x0f;
+        uint8_t data[2] = {};
+        const BusStep steps[] = {
+            BusStep::select(),
+            BusStep::write(&cmd, 1),
+            BusStep::read(data, sizeof(data)),
+            BusStep::deselect()
+        };
+        TestTransaction t(&res, 10, 0, steps, 4);
+        REQUIRE(q.submit(&t) == 0);
+        CHECK(driver.log == std::vector<std::string>({ "begin:10", "step:0", "step:2", "step:3", "step:1", "end" }));
+        CHECK(res == Results({ { 10, 0 } }));
+        CHECK(t.state == BusTransaction::DONE);
+        CHECK(data[0] == 1);
+        CHECK(data[1] == 2);
+    }
+
+    SECTION("executes transactions in the order of their priority") {
+        ManualQueue q(&driver);
+        TestTransaction t1(&res, 1, 0);
+        TestTransaction t2(&res, 2, 5);
+        TestTransaction t3(&res, 3, 0);
+        TestTransaction t4(&res, 4, 5);
+        TestTransaction t5(&res, 5, -1);
+        for (BusTransaction* t: { &t1, &t2, &t3, &t4, &t5 }) {
+            REQUIRE(q.submit(t) == 0);
+        }
+        CHECK(q.queued() == 5);
+        q.process();
+        CHECK(q.queued() == 0);
+        CHECK(res == Results({ { 2, 0 }, { 4, 0 }, { 1, 0 }, { 3, 0 }, { 5, 0 } }));
+    }
+
+    SECTION("stops executing the steps if one of them fails") {
+        BusTransactionQueue q(&driver);
+        const BusStep steps[] = { BusStep::select(), BusStep::delay(1), BusStep::deselect() };
+        TestTransaction t(&res, 1, 0, steps, 3);
+        driver.failStep = 1;
+        REQUIRE(q.submit(&t) == 0);
+        CHECK(driver.log == std::vector<std::string>({ "begin:1", "step:0", "step:5", "end" }));
+        CHECK(res == Results({ { 1, SYSTEM_ERROR_IO } }));
+        CHECK(t.result == SYSTEM_ERROR_IO);
+    }
+
+    SECTION("doesn't execute the steps if the bus cannot be acquired") {
+        BusTransactionQueue q(&driver);
+        const BusStep steps[] = { BusStep::select() };
+        TestTransaction t(&res, 1, 0, steps, 1);
+        driver.beginResult = SYSTEM_ERROR_TIMEOUT;
+        REQUIRE(q.submit(&t) == 0);
+        CHECK(driver.log == std::vector<std::string>({ "begin:1" }));
+        CHECK(res == Results({ { 1, SYSTEM_ERROR_TIMEOUT } }));
+    }
+
+    SECTION("cancels a queued transaction") {
+        ManualQueue q(&driver);
+        TestTransaction t1(&res, 1);
+        TestTransaction t2(&res, 2);
+        REQUIRE(q.submit(&t1) == 0);
+        REQUIRE(q.submit(&t2) == 0);
+        CHECK(q.submit(&t1) == SYSTEM_ERROR_BUSY);
+        CHECK(q.cancel(&t1) == 0);
+        CHECK(q.cancel(&t1) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(q.queued() == 1);
+        q.process();
+        CHECK(res == Results({ { 1, SYSTEM_ERROR_CANCELLED }, { 2, 0 } }));
+    }
+
+    SECTION("a running transaction cannot be cancelled") {
+        BusTransactionQueue q(&driver);
+        TestTransaction t(&res, 1);
+        int cancelResult = 0;
+        driver.onBegin = [&]() {
+            cancelResult = q.cancel(&t);
+        };
+        REQUIRE(q.submit(&t) == 0);
+        CHECK(cancelResult == SYSTEM_ERROR_BUSY);
+        CHECK(res == Results({ { 1, 0 } }));
+    }
+
+    SECTION("transactions submitted while the queue is being processed are executed by the same call") {
+        BusTransactionQueue q(&driver);
+        TestTransaction t1(&res, 1);
+        TestTransaction t2(&res, 2);
+        bool submitted = false;
+        driver.onBegin = [&]() {
+            if (!submitted) {
+                submitted = true;
+                CHECK(q.submit(&t2) == 0);
+                CHECK(res.empty());
+            }
+        };
+        REQUIRE(q.submit(&t1) == 0);
+        CHECK(res == Results({ { 1, 0 }, { 2, 0 } }));
+    }
+
+    SECTION("a transaction can be resubmitted from its completion callback") {
+        struct Ctx {
+            BusTransactionQueue* q;
+            BusTransaction t;
+            int count;
+        };
+        BusTransactionQueue q(&driver);
+        Ctx ctx = { &q, BusTransaction(nullptr, 0, 1), 0 };
+        ctx.t.callback = [](int error, const void* data, void* callbackData, void* reserved) {
+            const auto ctx = static_cast<Ctx*>(callbackData);
+            if (++ctx->count < 3) {
+                CHECK(ctx->q->submit(&ctx->t) == 0);
+            }
+        };
+        ctx.t.callbackData = &ctx;
+        REQUIRE(q.submit(&ctx.t) == 0);
+        CHECK(ctx.count == 3);
+        CHECK(driver.log == std::vector<std::string>({ "begin:1", "end", "begin:1", "end", "begin:1", "end" }));
+    }
+
+    SECTION("submitAsync() returns a future for the result of a transaction") {
+        ManualQueue q(&driver);
+        const BusStep steps[] = { BusStep::select() };
+        BusTransaction t1(steps, 1, 1);
+        BusTransaction t2(nullptr, 0, 2);
+        auto f1 = q.submitAsync(&t1);
+        auto f2 = q.submitAsync(&t2);
+        CHECK(!f1.isDone());
+        CHECK(q.submitAsync(&t1).error() == Error::BUSY);
+        driver.failStep = 0;
+        q.process();
+        REQUIRE(f1.isDone());
+        CHECK(f1.error() == Error::IO);
+        REQUIRE(f2.isDone());
+        CHECK(f2.isSucceeded());
+    }
+
+    SECTION("a transaction submitted via submitAsync() can be reused with submit()") {
+        ManualQueue q(&driver);
+        TestTransaction t(&res, 1);
+        auto f = q.submitAsync(&t);
+        q.process();
+        REQUIRE(f.isDone());
+        CHECK(f.isSucceeded());
+        CHECK(res == Results({ { 1, 0 } }));
+        CHECK((t.callback == TestTransaction::completed));
+        CHECK(t.callbackData == &t);
+        REQUIRE(q.submit(&t) == 0);
+        q.process();
+        CHECK(res == Results({ { 1, 0 }, { 1, 0 } }));
+        f = q.submitAsync(&t);
+        REQUIRE(q.cancel(&t) == 0);
+        REQUIRE(f.isDone());
+        CHECK(f.error() == Error::CANCELLED);
+        CHECK(res == Results({ { 1, 0 }, { 1, 0 }, { 1, SYSTEM_ERROR_CANCELLED } }));
+    }
+}
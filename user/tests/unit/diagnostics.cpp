@@ -535,6 +535,68 @@ TEST_CASE("Service API") {
         }
     }
 
+    SECTION("diag_get_source() with sparse and application-specific IDs") {
+        auto d1 = DiagSource(5).add();
+        auto d2 = DiagSource(31).add();
+        auto d3 = DiagSource(300).add(); // Not covered by the lookup table
+        auto d4 = DiagSource(DIAG_ID_USER + 1).add();
+        diag.start();
+        for (int id: { (int)d1.id(), (int)d2.id(), (int)d3.id(), (int)d4.id() }) {
+            const diag_source* d = nullptr;
+            REQUIRE(diag_get_source(id, &d, nullptr) == 0);
+            CHECK(d->id == id);
+        }
+        for (int id: { 0, 1, 6, 30, 32, 299, 301, (int)DIAG_ID_USER, (int)DIAG_ID_USER + 2 }) {
+            CHECK(diag_get_source(id, nullptr, nullptr) == SYSTEM_ERROR_NOT_FOUND);
+        }
+    }
+
+    SECTION("diag_snapshot()") {
+        auto d1 = DiagSource(1).type(DIAG_TYPE_INT).get([](GetData d) {
+            return d.setInt(-1234);
+        }).add();
+        auto d2 = DiagSource(2).type(DIAG_TYPE_UINT).get([](GetData d) {
+            return d.setUInt(0xffffffff);
+        }).add();
+        auto d3 = DiagSource(3).type(DIAG_TYPE_INT).get([](GetData) {
+            return SYSTEM_ERROR_UNKNOWN;
+        }).add();
+        auto d4 = DiagSource(4).type((diag_type)100).add(); // Not an integer source
+
+        SECTION("fails if the service is not started") {
+            diag_value v[4] = {};
+            CHECK(diag_snapshot(v, 4, nullptr, nullptr) == SYSTEM_ERROR_INVALID_STATE);
+        }
+
+        SECTION("reads the values of all integer data sources") {
+            diag.start();
+            diag_value v[4] = {};
+            size_t total = 0;
+            REQUIRE(diag_snapshot(v, 4, &total, nullptr) == 0);
+            REQUIRE(total == 3);
+            CHECK(v[0].id == 1);
+            CHECK(v[0].type == DIAG_TYPE_INT);
+            CHECK(v[0].value == -1234);
+            CHECK(v[0].error == 0);
+            CHECK(v[1].id == 2);
+            CHECK(v[1].type == DIAG_TYPE_UINT);
+            CHECK((uint32_t)v[1].value == 0xffffffff);
+            CHECK(v[2].id == 3);
+            CHECK(v[2].error == SYSTEM_ERROR_UNKNOWN);
+        }
+
+        SECTION("reports the total number of sources if the buffer is too small") {
+            diag.start();
+            diag_value v[1] = {};
+            size_t total = 0;
+            REQUIRE(diag_snapshot(v, 1, &total, nullptr) == 0);
+            CHECK(total == 3);
+            CHECK(v[0].id == 1);
+            REQUIRE(diag_snapshot(nullptr, 0, &total, nullptr) == 0);
+            CHECK(total == 3);
+        }
+    }
+
     SECTION("diag_command()") {
         SECTION("can be used to start the diagnostics service") {
             CHECK(diag_command(DIAG_SERVICE_CMD_START, nullptr, nullptr) == 0);
@@ -1,11 +1,13 @@
 #include "spark_wiring_json.h"
 #include "spark_wiring_print.h"
+#include "system_error.h"
 
 #include "tools/stream.h"
 #include "tools/buffer.h"
 
 #include <boost/variant.hpp>
 
+#include <chrono>
 #include <deque>
 #include <string>
 #include <cstdlib>
@@ -178,6 +180,130 @@ inline Checker check(const char *json) {
     return Checker(parse(json));
 }
 
+// Records events generated by JSONStreamReader as a string
+class EventRecorder: public JSONReaderHandler {
+public:
+    explicit EventRecorder(int stopAfter = -1) :
+            stopAfter_(stopAfter) {
+    }
+
+    virtual bool onEvent(JSONEvent event, const char *data, size_t size) override {
+        REQUIRE(strlen(data) == size);
+        switch (event) {
+        case JSON_EVENT_BEGIN_OBJECT:
+            s_ += "{";
+            break;
+        case JSON_EVENT_END_OBJECT:
+            s_ += "}";
+            break;
+        case JSON_EVENT_BEGIN_ARRAY:
+            s_ += "[";
+            break;
+        case JSON_EVENT_END_ARRAY:
+            s_ += "]";
+            break;
+        case JSON_EVENT_NAME:
+            s_ += "N(" + std::string(data, size) + ")";
+            break;
+        case JSON_EVENT_STRING:
+            s_ += "S(" + std::string(data, size) + ")";
+            break;
+        case JSON_EVENT_NUMBER:
+            s_ += "D(" + std::string(data, size) + ")";
+            break;
+        case JSON_EVENT_BOOL:
+            s_ += "B(" + std::string(data, size) + ")";
+            break;
+        case JSON_EVENT_NULL:
+            s_ += "Z";
+            break;
+        }
+        return stopAfter_ < 0 || --stopAfter_ > 0;
+    }
+
+    const std::string& events() const {
+        return s_;
+    }
+
+private:
+    std::string s_;
+    int stopAfter_;
+};
+
+// Parses a complete document with JSONStreamReader, feeding it in chunks of the specified size
+std::string readEvents(const std::string &json, size_t chunkSize = 0, int *error = nullptr) {
+    StaticJSONStreamReader<64> r;
+    EventRecorder h;
+    if (chunkSize == 0) {
+        chunkSize = json.size();
+    }
+    int ret = 0;
+    for (size_t offs = 0; offs < json.size() && ret >= 0; offs += chunkSize) {
+        ret = r.parse(json.data() + offs, std::min(chunkSize, json.size() - offs), &h);
+    }
+    if (ret >= 0) {
+        ret = r.finish(&h);
+    }
+    if (error) {
+        *error = ret;
+    } else {
+        REQUIRE(ret == 0);
+    }
+    return h.events();
+}
+
+int readError(const std::string &json) {
+    int error = 0;
+    readEvents(json, 0, &error);
+    return error;
+}
+
+// Input stream that returns data in chunks of the specified size
+class ChunkedStream: public Stream {
+public:
+    ChunkedStream(const std::string &data, size_t chunkSize) :
+            data_(data),
+            chunkSize_(chunkSize),
+            offs_(0) {
+    }
+
+    virtual int available() override {
+        return std::min(chunkSize_, data_.size() - offs_);
+    }
+
+    virtual int read() override {
+        return (offs_ < data_.size()) ? (uint8_t)data_[offs_++] : -1;
+    }
+
+    virtual int peek() override {
+        return (offs_ < data_.size()) ? (uint8_t)data_[offs_] : -1;
+    }
+
+    virtual void flush() override {
+    }
+
+    virtual size_t write(uint8_t c) override {
+        return 0;
+    }
+
+private:
+    std::string data_;
+    size_t chunkSize_, offs_;
+};
+
+std::string largeDocument(int count) {
+    std::string s = "{\"device\":\"e00fce68a1b2c3d4e5f6a7b8\",\"readings\":[";
+    for (int i = 0; i < count; ++i) {
+        if (i > 0) {
+            s += ",";
+        }
+        s += "{\"id\":" + std::to_string(i) + ",\"temp\":21.5,\"name\":\"sensor-" + std::to_string(i) +
+                "\",\"ok\":true,\"tags\":[\"a\",\"b\",null]}";
+    }
+    s += "],\"status\":{\"code\":200,\"message\":\"OK\"}}";
+    return s;
+}
+
 } // namespace
 
 namespace spark {
@@ -1117,3 +1243,185 @@ TEST_CASE("JSONBufferWriter") {
         CHECK(buf.isPaddingValid());
     }
 }
+
+TEST_CASE("JSONStreamReader") {
+    SECTION("generates events for all elements") {
+        CHECK(readEvents("null") == "Z");
+        CHECK(readEvents("true") == "B(true)");
+        CHECK(readEvents("-1.5e3") == "D(-1.5e3)");
+        CHECK(readEvents("\"abc\"") == "S(abc)");
+        CHECK(readEvents("[]") == "[]");
+        CHECK(readEvents("{}") == "{}");
+        CHECK(readEvents(" { \"a\" : [ 1 , false , null , { } , [ ] ] , \"b\" : { \"c\" : \"d\" } } ") ==
+                "{N(a)[D(1)B(false)Z{}[]]N(b){N(c)S(d)}}");
+    }
+
+    SECTION("produces the same events regardless of how the input is split") {
+        const std::string json = "{\"name\":\"a\\\"b\\u0041\\u00e9\",\"values\":[1,-2.5,true,false,null,{\"x\":[[]]}],"
+                "\"empty\":\"\",\"n\":12345}";
+        const std::string expected = readEvents(json);
+        CHECK(expected == "{N(name)S(a\"bA\\u00e9)N(values)[D(1)D(-2.5)B(true)B(false)Z{N(x)[[]]}]N(empty)S()N(n)D(12345)}");
+        for (size_t chunkSize = 1; chunkSize < json.size(); ++chunkSize) {
+            CHECK(readEvents(json, chunkSize) == expected);
+        }
+    }
+
+    SECTION("unescapes strings") {
+        CHECK(readEvents("\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"") == "S(\"\\/\b\f\n\r\t)");
+        CHECK(readEvents("{\"a\\nb\":1}") == "{N(a\nb)D(1)}");
+    }
+
+    SECTION("stops at the end of the top-level value") {
+        StaticJSONStreamReader<16> r;
+        EventRecorder h;
+        const std::string json = "[1,2] [3]";
+        CHECK(r.parse(json.data(), json.size(), &h) == 5);
+        CHECK(r.isDone());
+        CHECK(r.finish(&h) == 0);
+        CHECK(h.events() == "[D(1)D(2)]");
+        r.reset();
+        CHECK(!r.isDone());
+        CHECK(r.parse(json.data() + 5, json.size() - 5, &h) == 4);
+        CHECK(h.events() == "[D(1)D(2)][D(3)]");
+    }
+
+    SECTION("tracks the nesting depth") {
+        StaticJSONStreamReader<16> r;
+        CHECK(r.parse("{\"a\":[[", 7, nullptr) == 7);
+        CHECK(r.depth() == 3);
+        CHECK(r.parse("]]", 2, nullptr) == 2);
+        CHECK(r.depth() == 1);
+    }
+
+    SECTION("fails on invalid documents") {
+        CHECK(readError("") == SYSTEM_ERROR_BAD_DATA);
+        CHECK(readError("[1,2") == SYSTEM_ERROR_BAD_DATA);
+        CHECK(readError("\"abc") == SYSTEM_ERROR_BAD_DATA);
+        CHECK(readError("[1,]") == SYSTEM_ERROR_BAD_DATA);
+        CHECK(readError("[1 2]") == SYSTEM_ERROR_BAD_DATA);
+        CHECK(readError("{\"a\" 1}") == SYSTEM_ERROR_BAD_DATA);
+        CHECK(readError("{\"a\":1]") == SYSTEM_ERROR_BAD_DATA);
+        CHECK(readError("{1:2}") == SYSTEM_ERROR_BAD_DATA);
+        CHECK(readError("[nul]") == SYSTEM_ERROR_BAD_DATA);
+        CHECK(readError("tru") == SYSTEM_ERROR_BAD_DATA);
+        CHECK(readError("\"\\x\"") == SYSTEM_ERROR_BAD_DATA);
+        CHECK(readError("\"\\u00g0\"") == SYSTEM_ERROR_BAD_DATA);
+        CHECK(readError("\"" + std::string(64, 'a') + "\"") == SYSTEM_ERROR_TOO_LARGE);
+        CHECK(readError(std::string(JSONStreamReader::MAX_DEPTH + 1, '[')) == SYSTEM_ERROR_LIMIT_EXCEEDED);
+        CHECK(readEvents("\"" + std::string(63, 'a') + "\"") == "S(" + std::string(63, 'a') + ")");
+    }
+
+    SECTION("errors are sticky until reset") {
+        StaticJSONStreamReader<16> r;
+        CHECK(r.parse("[}", 2, nullptr) == SYSTEM_ERROR_BAD_DATA);
+        CHECK(r.parse("]", 1, nullptr) == SYSTEM_ERROR_BAD_DATA);
+        CHECK(r.finish(nullptr) == SYSTEM_ERROR_BAD_DATA);
+        r.reset();
+        CHECK(r.parse("[]", 2, nullptr) == 2);
+        CHECK(r.finish(nullptr) == 0);
+    }
+
+    SECTION("can be cancelled by the handler") {
+        StaticJSONStreamReader<16> r;
+        EventRecorder h(3);
+        CHECK(r.parse("[1,2,3,4]", 9, &h) == SYSTEM_ERROR_CANCELLED);
+        CHECK(h.events() == "[D(1)D(2)");
+    }
+
+    SECTION("reads available data from a stream") {
+        const std::string json = "{\"a\":[1,{\"b\":\"c\"}],\"d\":true}";
+        for (size_t chunkSize = 1; chunkSize <= json.size(); chunkSize += 7) {
+            ChunkedStream strm(json + "xyz", chunkSize);
+            StaticJSONStreamReader<16> r;
+            EventRecorder h;
+            CHECK(r.parse(strm, &h) == (int)json.size());
+            CHECK(r.isDone());
+            CHECK(h.events() == "{N(a)[D(1){N(b)S(c)}]N(d)B(true)}");
+            CHECK(strm.read() == 'x');
+        }
+        ChunkedStream strm("[1,", 2);
+        StaticJSONStreamReader<16> r;
+        CHECK(r.parse(strm, nullptr) == 3);
+        CHECK(!r.isDone());
+    }
+}
+
+TEST_CASE("JSONPathQuery") {
+    const std::string json = "{\"id\":\"abc\",\"data\":{\"items\":[{\"v\":1},{\"v\":2.5,\"w\":[true,null]}],\"n\":\"42\"},"
+            "\"obj\":{},\"items\":[7]}";
+    const char* const paths[] = { "id", "data.items[1].v", "data.items[1].w[0]", "data.items[1].w[1]",
+            "data.n", "obj", "data.items", "items[0]", "data.missing", "data.items[2].v" };
+    JSONPathQuery q(paths, sizeof(paths) / sizeof(paths[0]));
+    REQUIRE(q.resultCount() == 10);
+    StaticJSONStreamReader<32> r;
+
+    SECTION("extracts values by path") {
+        REQUIRE(r.parse(json.data(), json.size(), &q) == (int)json.size());
+        REQUIRE(r.finish(&q) == 0);
+        CHECK(!q.isComplete());
+        CHECK(q.result(0).type() == JSON_TYPE_STRING);
+        CHECK(strcmp(q.result(0).data(), "abc") == 0);
+        CHECK(q.result(0).toString() == "abc");
+        CHECK(q.result(1).type() == JSON_TYPE_NUMBER);
+        CHECK(q.result(1).toDouble() == 2.5);
+        CHECK(q.result(1).toInt() == 2);
+        CHECK(q.result(2).type() == JSON_TYPE_BOOL);
+        CHECK(q.result(2).toBool() == true);
+        CHECK(q.result(3).type() == JSON_TYPE_NULL);
+        CHECK(q.result(4).type() == JSON_TYPE_STRING);
+        CHECK(q.result(4).toInt() == 42);
+        CHECK(q.result(5).type() == JSON_TYPE_OBJECT);
+        CHECK(q.result(6).type() == JSON_TYPE_ARRAY);
+        CHECK(q.result(7).toInt() == 7);
+        CHECK(!q.result(8).isValid());
+        CHECK(!q.result(9).isValid());
+    }
+
+    SECTION("reports when all values have been found") {
+        const char* const paths[] = { "id", "data.items[0].v" };
+        JSONPathQuery q(paths, 2);
+        CHECK(!q.isComplete());
+        REQUIRE(r.parse(json.data(), json.size(), &q) == (int)json.size());
+        CHECK(q.isComplete());
+        q.reset();
+        CHECK(!q.isComplete());
+        CHECK(!q.result(0).isValid());
+    }
+}
+
+TEST_CASE("JSONStreamReader benchmark", "[.][benchmark][json]") {
+    const std::string json = largeDocument(200);
+    const int iterations = 200;
+    int checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        const JSONValue v = JSONValue::parseCopy(json.data(), json.size());
+        JSONObjectIterator it(v);
+        while (it.next()) {
+            if (it.name() == "status") {
+                JSONObjectIterator it2(it.value());
+                while (it2.next()) {
+                    if (it2.name() == "code") {
+                        checksum += it2.value().toInt();
+                    }
+                }
+            }
+        }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    CATCH_WARN("JSONValue (jsmn): " << iterations << " iterations, " << json.size() << " bytes, " << elapsed.count() << " us");
+    const char* const paths[] = { "status.code" };
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        StaticJSONStreamReader<64> r;
+        JSONPathQuery q(paths, 1);
+        // Simulate data arriving over the network
+        for (size_t offs = 0; offs < json.size(); offs += 512) {
+            r.parse(json.data() + offs, std::min<size_t>(512, json.size() - offs), &q);
+        }
+        checksum -= q.result(0).toInt();
+    }
+    elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    CATCH_WARN("JSONStreamReader: " << iterations << " iterations, " << json.size() << " bytes, " << elapsed.count() << " us");
+    CHECK(checksum == 0);
+}
@@ -2,6 +2,11 @@
 #include "catch.hpp"
 #include "spark_wiring_print.h"
 
+#include <chrono>
+#include <string>
+#include <cstdarg>
+#include <cstdio>
+
 
 class BufferPrint : public Print
 {
@@ -56,3 +61,145 @@ SCENARIO("Print.printf() with a a > 20 char string", "[print]")
     print.printf("abcdabcdabcdabcd %d xyzxyzxyzxyzxyzxyzxyzxyz", 100);
     REQUIRE(String("abcdabcdabcdabcd 100 xyzxyzxyzxyzxyzxyzxyzxyz") == print.result());
 }
+
+namespace {
+
+// Counts the write() calls made by Print
+class CountingPrint : public Print
+{
+    std::string value;
+    int writes = 0;
+
+public:
+    size_t write(uint8_t c) override
+    {
+        ++writes;
+        value += (char)c;
+        return 1;
+    }
+
+    size_t write(const uint8_t* buf, size_t size) override
+    {
+        ++writes;
+        value.append((const char*)buf, size);
+        return size;
+    }
+
+    const std::string& result() const
+    {
+        return value;
+    }
+
+    int writeCount() const
+    {
+        return writes;
+    }
+};
+
+// Formats a string using vsnprintf() for comparison
+std::string reference(const char* fmt, ...) __attribute__ ((format(printf, 1, 2)));
+
+std::string reference(const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    char buf[1024];
+    const int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return std::string(buf, n);
+}
+
+} // namespace
+
+#define CHECK_PRINTF(...) \
+    do { \
+        CountingPrint p; \
+        const size_t n = p.printf(__VA_ARGS__); \
+        const auto s = reference(__VA_ARGS__); \
+        CHECK(p.result() == s); \
+        CHECK(n == s.size()); \
+    } while (false)
+
+TEST_CASE("Print.printf() formats arguments like vsnprintf()", "[print]")
+{
+    CHECK_PRINTF("%d %i %u %x %X %o", -1, 42, 42u, 0xbeefu, 0xbeefu, 8u);
+    CHECK_PRINTF("%hhd %hd %ld %lld %jd %zd %td", (signed char)-5, (short)-300, -100000L, -10000000000LL, (intmax_t)-7,
+            (ssize_t)-8, (ptrdiff_t)-9);
+    CHECK_PRINTF("%hhu %hu %lu %llu %ju %zu %tx", (unsigned char)250, (unsigned short)60000, 100000UL,
+            10000000000ULL, (uintmax_t)7, (size_t)8, (ptrdiff_t)255);
+    CHECK_PRINTF("[%5d] [%-5d] [%05d] [%+d] [% d] [%#x] [%#o]", 42, 42, 42, 42, 42, 255u, 8u);
+    CHECK_PRINTF("[%*d] [%-*d] [%*d] [%.*d]", 6, 1, 6, 2, -6, 3, 4, 5);
+    CHECK_PRINTF("%f %.2f %e %.3E %g %G %a", 3.14159, 2.71828, 12345.678, 0.000123, 0.0001, 1e20, 1.0);
+    CHECK_PRINTF("%10.3f|%-10.2e|%Lf", -1.5, 100.0, (long double)2.5);
+    CHECK_PRINTF("%c%c%c %5c %-3c|", 'a', 'b', 'c', 'd', 'e');
+    CHECK_PRINTF("%s %10s %-10s| %.2s %*.*s|", "str", "right", "left", "truncated", 8, 3, "abcdef");
+    CHECK_PRINTF("%p", (void*)0x1234);
+    CHECK_PRINTF("100%% %d%%", 5);
+    CHECK_PRINTF("no conversions at all");
+    CHECK_PRINTF("%s", "");
+}
+
+TEST_CASE("Print.printf() handles output longer than its internal buffers", "[print]")
+{
+    const std::string longStr(1000, 'x');
+    CHECK_PRINTF("a%sb", longStr.c_str());
+    CHECK_PRINTF("%200d|%-150s|", 1, "pad");
+    CHECK_PRINTF("%f", 1e300);
+    CHECK_PRINTF("%.60f", 1.0 / 3);
+    std::string fmt;
+    for (int i = 0; i < 50; ++i) {
+        fmt += "key%d=%s;";
+    }
+    CountingPrint p;
+    p.printf(fmt.c_str(), 0, "v0", 1, "v1", 2, "v2", 3, "v3", 4, "v4", 5, "v5", 6, "v6", 7, "v7", 8, "v8", 9, "v9",
+            10, "v10", 11, "v11", 12, "v12", 13, "v13", 14, "v14", 15, "v15", 16, "v16", 17, "v17", 18, "v18", 19, "v19",
+            20, "v20", 21, "v21", 22, "v22", 23, "v23", 24, "v24", 25, "v25", 26, "v26", 27, "v27", 28, "v28", 29, "v29",
+            30, "v30", 31, "v31", 32, "v32", 33, "v33", 34, "v34", 35, "v35", 36, "v36", 37, "v37", 38, "v38", 39, "v39",
+            40, "v40", 41, "v41", 42, "v42", 43, "v43", 44, "v44", 45, "v45", 46, "v46", 47, "v47", 48, "v48", 49, "v49");
+    std::string expected;
+    for (int i = 0; i < 50; ++i) {
+        expected += "key" + std::to_string(i) + "=v" + std::to_string(i) + ";";
+    }
+    CHECK(p.result() == expected);
+}
+
+TEST_CASE("Print.printf() writes output in chunks", "[print]")
+{
+    SECTION("short output is written at once")
+    {
+        CountingPrint p;
+        p.printf("GET %s HTTP/1.1\r\nHost: %s\r\n", "/index.html", "example.com");
+        CHECK(p.result() == "GET /index.html HTTP/1.1\r\nHost: example.com\r\n");
+        CHECK(p.writeCount() == 1);
+    }
+    SECTION("long output is written in a few chunks")
+    {
+        CountingPrint p;
+        std::string s(500, 'y');
+        p.printf("%d %s %d", 1, s.c_str(), 2);
+        CHECK(p.result() == "1 " + s + " 2");
+        CHECK(p.writeCount() <= 3);
+    }
+    SECTION("%n stores the number of characters formatted so far")
+    {
+        CountingPrint p;
+        int n1 = 0, n2 = 0;
+        p.printf("abc%n%10d%n", &n1, 5, &n2);
+        CHECK(n1 == 3);
+        CHECK(n2 == 13);
+    }
+}
+
+TEST_CASE("Print.printf() benchmark", "[.][benchmark][print]")
+{
+    const int iterations = 100000;
+    size_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        CountingPrint p;
+        total += p.printf("{\"temp\":%.2f,\"hum\":%d,\"name\":\"%s\",\"seq\":%lu}", 21.5 + i % 10, i % 100,
+                "sensor-abcdefgh", (unsigned long)i);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    WARN("Print.printf(): " << iterations << " iterations, " << total << " bytes, " << elapsed.count() << " us");
+}
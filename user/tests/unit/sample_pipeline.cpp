@@ -0,0 +1,126 @@
+#include "sample_pipeline.h"
+#include "system_error.h"
+
+#include "tools/catch.h"
+
+#include <vector>
+#include <cmath>
+
+using namespace particle;
+
+namespace {
+
+std::vector<int16_t> process(SamplePipeline* p, const std::vector<int16_t>& in) {
+    std::vector<int16_t> out(p->maxOutputSize(in.size()));
+    const size_t n = p->process(in.data(), in.size(), out.data());
+    REQUIRE(n <= out.size());
+    out.resize(n);
+    return out;
+}
+
+// Generates interleaved samples of a sine wave for each channel
+std::vector<int16_t> sine(size_t scans, size_t channels, double freq, double amplitude) {
+    std::vector<int16_t> v;
+    for (size_t i = 0; i < scans; ++i) {
+        for (size_t j = 0; j < channels; ++j) {
+            v.push_back(std::lround(amplitude * std::sin(2 * M_PI * freq * i)));
+        }
+    }
+    return v;
+}
+
+int16_t peak(const std::vector<int16_t>& v, size_t from) {
+    int16_t p = 0;
+    for (size_t i = from; i < v.size(); ++i) {
+        p = std::max<int16_t>(p, std::abs(v[i]));
+    }
+    return p;
+}
+
+// 15-tap low-pass filter (Hamming window), cutoff at 1/8 of the sample rate
+const int16_t LOW_PASS[] = { -84, -219, -374, 0, 1582, 4321, 7054, 8208, 7054, 4321, 1582, 0, -374, -219, -84 };
+
+} // namespace
+
+TEST_CASE("SamplePipeline") {
+    SamplePipeline p;
+
+    SECTION("validates arguments") {
+        const int16_t coeffs[SamplePipeline::MAX_FILTER_TAPS + 1] = {};
+        CHECK(p.init(0) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(p.init(SamplePipeline::MAX_CHANNELS + 1) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(p.init(1, 0) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(p.init(1, SamplePipeline::MAX_DECIMATION + 1) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(p.init(1, 1, nullptr, 3) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(p.init(1, 1, coeffs, SamplePipeline::MAX_FILTER_TAPS + 1) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(p.init(SamplePipeline::MAX_CHANNELS, SamplePipeline::MAX_DECIMATION, coeffs, SamplePipeline::MAX_FILTER_TAPS) == 0);
+    }
+
+    SECTION("passes the samples through if no processing is configured") {
+        REQUIRE(p.init(3) == 0);
+        const std::vector<int16_t> in = { 1, 2, 3, 4, 5, 6, -7, -8, -9 };
+        CHECK(process(&p, in) == in);
+    }
+
+    SECTION("averages the samples of each channel") {
+        REQUIRE(p.init(2, 4) == 0);
+        const std::vector<int16_t> in = {
+            10, -1,  11, -2,  12, -3,  13, -4, // 11.5, -2.5
+            100, 0,  100, 0,  100, 0,  101, 1  // 100.25, 0.25
+        };
+        CHECK(process(&p, in) == std::vector<int16_t>({ 12, -3, 100, 0 }));
+    }
+
+    SECTION("carries the state over between blocks") {
+        REQUIRE(p.init(2, 5, LOW_PASS, sizeof(LOW_PASS) / sizeof(LOW_PASS[0])) == 0);
+        const auto in = sine(1000, 2, 0.01, 10000);
+        const auto expected = process(&p, in);
+        CHECK(expected.size() == 400);
+        p.reset();
+        std::vector<int16_t> out;
+        size_t offs = 0;
+        size_t size = 2;
+        while (offs < in.size()) {
+            // Use blocks of varying size
+            const size_t n = std::min(size, in.size() - offs);
+            const auto v = process(&p, std::vector<int16_t>(in.begin() + offs, in.begin() + offs + n));
+            out.insert(out.end(), v.begin(), v.end());
+            offs += n;
+            size = (size * 3) % 64 + 2;
+        }
+        CHECK(out == expected);
+    }
+
+    SECTION("FIR filter has the expected impulse response") {
+        const int16_t coeffs[] = { 16384, 8192, -4096, 2048 }; // 0.5, 0.25, -0.125, 0.0625
+        REQUIRE(p.init(1, 1, coeffs, 4) == 0);
+        const std::vector<int16_t> in = { 1000, 0, 0, 0, 0, 0 };
+        CHECK(process(&p, in) == std::vector<int16_t>({ 500, 250, -125, 63, 0, 0 }));
+    }
+
+    SECTION("FIR filter attenuates high frequencies") {
+        REQUIRE(p.init(2, 1, LOW_PASS, sizeof(LOW_PASS) / sizeof(LOW_PASS[0])) == 0);
+        const auto low = process(&p, sine(400, 2, 0.02, 10000));
+        CHECK(peak(low, 100) > 9000);
+        p.reset();
+        const auto high = process(&p, sine(400, 2, 0.4, 10000));
+        CHECK(peak(high, 100) < 500);
+    }
+
+    SECTION("filters and decimates the samples in place") {
+        REQUIRE(p.init(2, 4, LOW_PASS, sizeof(LOW_PASS) / sizeof(LOW_PASS[0])) == 0);
+        auto in = sine(256, 2, 0.01, 10000);
+        const auto expected = process(&p, in);
+        p.reset();
+        const size_t n = p.process(in.data(), in.size(), in.data());
+        REQUIRE(n == expected.size());
+        in.resize(n);
+        CHECK(in == expected);
+    }
+
+    SECTION("saturates the filter output") {
+        const int16_t coeffs[] = { 32767, 32767 };
+        REQUIRE(p.init(1, 1, coeffs, 2) == 0);
+        CHECK(process(&p, { 30000, 30000, -30000, -30000 }) == std::vector<int16_t>({ 29999, 32767, 0, -32768 }));
+    }
+}
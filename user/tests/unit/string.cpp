@@ -4,6 +4,10 @@
 #include "catch.hpp"
 
 #include "spark_wiring_string.h"
+#include "spark_wiring_string_builder.h"
+
+#include <chrono>
+#include <string>
 
 TEST_CASE("Can use HEX radix with String numeric conversion constructors") {
 
@@ -101,3 +105,155 @@ TEST_CASE("Substring with left and right after the end returns until the end of
 TEST_CASE("Substring with flipped left and right returns the correct substring") {
     REQUIRE(String("test123").substring(5, 3)==String("t1"));
 }
+
+namespace {
+
+// Exposes the capacity of a string to count reallocations
+class TestString : public String {
+public:
+    unsigned int currentCapacity() const {
+        return capacity;
+    }
+};
+
+class CountingAllocator : public particle::SimpleAllocator {
+public:
+    int allocs = 0;
+    int frees = 0;
+    bool fail = false;
+
+    void* alloc(size_t size) override {
+        if (fail) {
+            return nullptr;
+        }
+        ++allocs;
+        return malloc(size);
+    }
+
+    void free(void* ptr) override {
+        ++frees;
+        ::free(ptr);
+    }
+};
+
+} // namespace
+
+TEST_CASE("String concatenation grows the buffer geometrically") {
+    TestString s;
+    unsigned int cap = 0;
+    int reallocs = 0;
+    for (int i = 0; i < 10000; ++i) {
+        s += (char)('a' + i % 26);
+        if (s.currentCapacity() != cap) {
+            cap = s.currentCapacity();
+            ++reallocs;
+        }
+    }
+    REQUIRE(s.length() == 10000);
+    CHECK(s.charAt(9999) == (char)('a' + 9999 % 26));
+    CHECK(reallocs < 25);
+}
+
+TEST_CASE("String can be appended to itself") {
+    String s("abc");
+    s += s;
+    CHECK(s == "abcabc");
+    for (int i = 0; i < 5; ++i) {
+        s += s;
+    }
+    CHECK(s.length() == 6 * 32);
+}
+
+TEST_CASE("String::format() formats long strings") {
+    std::string expected(300, 'z');
+    String s = String::format("%s-%d", expected.c_str(), 42);
+    CHECK(std::string(s.c_str()) == expected + "-42");
+}
+
+TEST_CASE("StringBuilder") {
+    SECTION("accumulates text in chunks") {
+        CountingAllocator alloc;
+        {
+            StringBuilder b(16, &alloc);
+            std::string expected;
+            for (int i = 0; i < 100; ++i) {
+                b.printf("item%d,", i);
+                expected += "item" + std::to_string(i) + ",";
+            }
+            CHECK(b.isValid());
+            CHECK(b.length() == expected.size());
+            CHECK(std::string(b.toString().c_str()) == expected);
+            std::string buf(expected.size() + 1, '\xff');
+            CHECK(b.copyTo(&buf[0], buf.size()) == expected.size());
+            CHECK(buf == expected + '\0');
+            // Chunk sizes double, so there are only a few allocations
+            CHECK(alloc.allocs <= 7);
+        }
+        CHECK(alloc.frees == alloc.allocs);
+    }
+
+    SECTION("uses the provided buffer first") {
+        CountingAllocator alloc;
+        char buf[32];
+        StringBuilder b(buf, sizeof(buf), &alloc);
+        b.print("0123456789");
+        b.print("abcdefghij");
+        CHECK(alloc.allocs == 0);
+        b.print("0123456789abcdefghij");
+        CHECK(alloc.allocs == 1);
+        CHECK(b.toString() == "0123456789abcdefghij0123456789abcdefghij");
+        b.clear();
+        CHECK(b.length() == 0);
+        CHECK(alloc.frees == 1);
+        b.print("xyz");
+        CHECK(b.toString() == "xyz");
+        CHECK(alloc.allocs == 1);
+    }
+
+    SECTION("truncates the output of copyTo()") {
+        StringBuilder b(4);
+        b.print("abcdefghijkl");
+        char buf[6] = {};
+        CHECK(b.copyTo(buf, sizeof(buf)) == 12);
+        CHECK(std::string(buf) == "abcde");
+    }
+
+    SECTION("reports allocation errors") {
+        CountingAllocator alloc;
+        alloc.fail = true;
+        char buf[4];
+        StringBuilder b(buf, sizeof(buf), &alloc);
+        CHECK(b.print("abcdef") == 4);
+        CHECK(!b.isValid());
+        CHECK(b.toString() == "abcd");
+    }
+}
+
+TEST_CASE("String and StringBuilder benchmark", "[.][benchmark]") {
+    const int iterations = 1000;
+    const int appends = 200;
+    size_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        String s;
+        for (int j = 0; j < appends; ++j) {
+            s += "\"key\":";
+            s += j;
+            s += ',';
+        }
+        total += s.length();
+    }
+    auto stringTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    start = std::chrono::steady_clock::now();
+    CountingAllocator alloc;
+    for (int i = 0; i < iterations; ++i) {
+        StringBuilder b(64, &alloc);
+        for (int j = 0; j < appends; ++j) {
+            b.printf("\"key\":%d,", j);
+        }
+        total += b.toString().length();
+    }
+    auto builderTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    WARN("String: " << stringTime.count() << " us; StringBuilder: " << builderTime.count() << " us, " <<
+            (double)alloc.allocs / iterations << " chunk allocations per string; " << total << " bytes");
+}
@@ -34,3 +34,6 @@ bool spark_cloud_flag_connected() {
 String spark_deviceID(void) {
     return "_THIS_IS_STUB_DEVICE_ID_";
 }
+
+void spark_process() {
+}
@@ -0,0 +1,10 @@
+#include "system_task.h"
+
+uint8_t application_thread_current(void* reserved) {
+    return 1;
+}
+
+uint8_t application_thread_invoke(void (*callback)(void* data), void* data, void* reserved) {
+    callback(data);
+    return 0;
+}
@@ -0,0 +1,318 @@
+#include "timer_wheel.h"
+#include "inplace_function.h"
+
+#include "tools/catch.h"
+
+#include <vector>
+#include <list>
+#include <random>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+using namespace particle;
+
+namespace {
+
+struct TestEntry: TimerWheel::Entry {
+    system_tick_t due;
+    bool popped;
+
+    TestEntry() :
+            due(0),
+            popped(false) {
+    }
+};
+
+// Pops all entries that are due at the specified time
+std::vector<TestEntry*> popAll(TimerWheel* w, system_tick_t now) {
+    std::vector<TestEntry*> v;
+    TimerWheel::Entry* e = nullptr;
+    while ((e = w->pop(now))) {
+        v.push_back(static_cast<TestEntry*>(e));
+    }
+    return v;
+}
+
+struct Counter {
+    static int instances;
+
+    Counter() {
+        ++instances;
+    }
+
+    Counter(const Counter&) {
+        ++instances;
+    }
+
+    ~Counter() {
+        --instances;
+    }
+};
+
+int Counter::instances = 0;
+
+} // namespace
+
+TEST_CASE("TimerWheel") {
+    TimerWheel w(1000);
+
+    SECTION("is empty after construction") {
+        system_tick_t t = 0;
+        CHECK(w.size() == 0);
+        CHECK(!w.nextExpiry(&t));
+        CHECK(w.pop(5000) == nullptr);
+        CHECK(w.time() == 5000);
+    }
+
+    SECTION("expires entries at their expiration times") {
+        const system_tick_t delays[] = { 1, 2, 63, 64, 65, 127, 128, 4095, 4096, 4097, 100000, 262143, 262144,
+                (1 << 24) - 1, (1 << 24), (1 << 24) + 1000, 100000000 };
+        for (auto delay: delays) {
+            TestEntry e;
+            const system_tick_t now = w.time();
+            w.add(&e, now + delay);
+            CHECK(w.size() == 1);
+            CHECK(TimerWheel::isScheduled(&e));
+            // Advance the time in steps as the timer thread would do
+            system_tick_t t = 0;
+            while (w.nextExpiry(&t) && t != now + delay) {
+                REQUIRE((int32_t)(now + delay - t) > 0);
+                REQUIRE(w.pop(t) == nullptr);
+            }
+            REQUIRE(w.pop(now + delay - 1) == nullptr);
+            REQUIRE(w.pop(now + delay) == &e);
+            CHECK(!TimerWheel::isScheduled(&e));
+            CHECK(w.size() == 0);
+        }
+    }
+
+    SECTION("expires an overdue entry on the next tick") {
+        TestEntry e;
+        w.add(&e, 900);
+        CHECK(w.pop(1000) == nullptr);
+        CHECK(w.pop(1001) == &e);
+    }
+
+    SECTION("reschedules an entry that is already scheduled") {
+        TestEntry e;
+        w.add(&e, 2000);
+        w.add(&e, 1500);
+        CHECK(w.size() == 1);
+        CHECK(w.pop(1500) == &e);
+        CHECK(w.pop(3000) == nullptr);
+    }
+
+    SECTION("cancels entries") {
+        TestEntry e1, e2, e3;
+        w.add(&e1, 1010);
+        w.add(&e2, 1010);
+        w.add(&e3, 5000);
+        w.remove(&e1);
+        w.remove(&e3);
+        w.remove(&e3); // No-op
+        CHECK(w.size() == 1);
+        CHECK(!TimerWheel::isScheduled(&e1));
+        CHECK(w.pop(10000) == &e2);
+        CHECK(w.pop(10000) == nullptr);
+        system_tick_t t = 0;
+        CHECK(!w.nextExpiry(&t));
+    }
+
+    SECTION("cancels an expired entry that has not been returned yet") {
+        TestEntry e1, e2;
+        w.add(&e1, 1010);
+        w.add(&e2, 1010);
+        const auto e = w.pop(1010);
+        REQUIRE(e);
+        w.remove(e == &e1 ? &e2 : &e1);
+        CHECK(w.pop(1010) == nullptr);
+    }
+
+    SECTION("handles the wrap-around of the system tick counter") {
+        TimerWheel w2(0xffffff00);
+        TestEntry e1, e2;
+        w2.add(&e1, 0xffffff00 + 0x80);
+        w2.add(&e2, 0x20000);
+        CHECK(w2.pop(0xffffff7f) == nullptr);
+        CHECK(w2.pop(0xffffff80) == &e1);
+        CHECK(w2.pop(0x1ffff) == nullptr);
+        CHECK(w2.pop(0x20000) == &e2);
+    }
+
+    SECTION("returns entries in the order of their expiration times") {
+        std::mt19937 gen(12345);
+        std::uniform_int_distribution<system_tick_t> delay(0, 500000);
+        std::uniform_int_distribution<system_tick_t> step(1, 2000);
+        std::vector<TestEntry> entries(1000);
+        for (auto& e: entries) {
+            e.due = w.time() + delay(gen);
+            w.add(&e, e.due);
+        }
+        system_tick_t now = w.time();
+        system_tick_t last = now;
+        while (w.size() > 0) {
+            system_tick_t t = 0;
+            REQUIRE(w.nextExpiry(&t));
+            // The next expiration time is never later than the actual one
+            for (const auto& e: entries) {
+                if (!e.popped) {
+                    REQUIRE((int32_t)(e.due - t) >= 0);
+                }
+            }
+            now += step(gen);
+            for (auto e: popAll(&w, now)) {
+                REQUIRE(!e->popped);
+                REQUIRE((int32_t)(now - e->due) >= 0);
+                REQUIRE((int32_t)(e->due - last) >= 0);
+                e->popped = true;
+                last = e->due;
+            }
+            for (const auto& e: entries) {
+                if (!e.popped) {
+                    REQUIRE((int32_t)(e.due - now) > 0);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("InplaceFunction") {
+    SECTION("is empty by default") {
+        InplaceFunction<int()> f;
+        CHECK(!f);
+        InplaceFunction<int()> f2(nullptr);
+        CHECK(!f2);
+        int (*fp)() = nullptr;
+        InplaceFunction<int()> f3(fp);
+        CHECK(!f3);
+    }
+
+    SECTION("invokes a function pointer") {
+        InplaceFunction<int(int, int)> f([](int a, int b) {
+            return a + b;
+        });
+        REQUIRE(f);
+        CHECK(f(2, 3) == 5);
+    }
+
+    SECTION("invokes a lambda with captures") {
+        int x = 0;
+        int y = 10;
+        InplaceFunction<void(int)> f([&x, y](int v) {
+            x += v + y;
+        });
+        f(1);
+        f(2);
+        CHECK(x == 23);
+    }
+
+    SECTION("invokes a member function") {
+        struct S {
+            int val = 0;
+            void inc() {
+                ++val;
+            }
+        } s;
+        void (S::*handler)() = &S::inc;
+        InplaceFunction<void()> f([handler, &s]() {
+            (s.*handler)();
+        });
+        f();
+        f();
+        CHECK(s.val == 2);
+    }
+
+    SECTION("copies, moves and destroys the callable object") {
+        {
+            Counter c;
+            InplaceFunction<int()> f([c]() {
+                return Counter::instances;
+            });
+            CHECK(Counter::instances == 2);
+            InplaceFunction<int()> f2(f);
+            CHECK(Counter::instances == 3);
+            InplaceFunction<int()> f3(std::move(f2));
+            CHECK(Counter::instances == 3);
+            CHECK(!f2);
+            CHECK(f3() == 3);
+            f = nullptr;
+            CHECK(Counter::instances == 2);
+            f2 = f3;
+            CHECK(Counter::instances == 3);
+            f2 = []() {
+                return -1;
+            };
+            CHECK(Counter::instances == 2);
+            CHECK(f2() == -1);
+        }
+        CHECK(Counter::instances == 0);
+    }
+}
+
+TEST_CASE("TimerWheel benchmark", "[.][benchmark][timer]") {
+    const size_t timerCount = 1000;
+    const system_tick_t duration = 60 * 60 * 1000; // 1 hour
+    std::mt19937 gen(12345);
+    std::uniform_int_distribution<system_tick_t> period(10, 10000);
+    std::vector<system_tick_t> periods(timerCount);
+    for (auto& p: periods) {
+        p = period(gen);
+    }
+    // Baseline: sorted list of active timers, as used by the RTOS timer service
+    struct ListTimer {
+        system_tick_t expiry;
+        system_tick_t period;
+    };
+    std::list<ListTimer> list;
+    size_t listExpired = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto insert = [&list](const ListTimer& t) {
+        auto it = list.begin();
+        while (it != list.end() && it->expiry <= t.expiry) {
+            ++it;
+        }
+        list.insert(it, t);
+    };
+    for (auto p: periods) {
+        insert({ p, p });
+    }
+    system_tick_t now = 0;
+    while (now < duration) {
+        now = list.front().expiry;
+        while (!list.empty() && list.front().expiry <= now) {
+            auto t = list.front();
+            list.pop_front();
+            ++listExpired;
+            t.expiry += t.period;
+            insert(t);
+        }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    CATCH_WARN("Sorted list: " << timerCount << " timers, " << listExpired << " expirations, " << elapsed.count() << " us");
+
+    struct WheelTimer: TimerWheel::Entry {
+        system_tick_t period;
+    };
+    std::unique_ptr<WheelTimer[]> timers(new WheelTimer[timerCount]);
+    TimerWheel w(0);
+    size_t wheelExpired = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < timerCount; ++i) {
+        timers[i].period = periods[i];
+        w.add(&timers[i], periods[i]);
+    }
+    now = 0;
+    while (now < duration) {
+        w.nextExpiry(&now); // Sleep until the next expiration time
+        TimerWheel::Entry* e = nullptr;
+        while ((e = w.pop(now))) {
+            const auto t = static_cast<WheelTimer*>(e);
+            ++wheelExpired;
+            w.add(t, t->expiry + t->period);
+        }
+    }
+    elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    CATCH_WARN("Timing wheel: " << timerCount << " timers, " << wheelExpired << " expirations, " << elapsed.count() << " us");
+    CATCH_CHECK(wheelExpired >= listExpired - timerCount);
+}
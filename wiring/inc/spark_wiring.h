@@ -38,6 +38,7 @@
 #include "debug.h"
 #include "spark_wiring_constants.h"
 #include "spark_wiring_stream.h"
+#include "spark_wiring_string_builder.h"
 #include "spark_wiring_printable.h"
 #include "spark_wiring_ipaddress.h"
 #include "spark_wiring_cellular_printable.h"
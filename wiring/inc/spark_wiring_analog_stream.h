@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "adc_hal.h"
+#include "sample_pipeline.h"
+#include "ringbuffer.h"
+
+#include <initializer_list>
+#include <memory>
+
+namespace particle {
+
+/**
+ * Options of a continuous analog acquisition.
+ */
+class AnalogStreamOptions {
+public:
+    static const size_t DEFAULT_BLOCK_SIZE = 256;
+    static const size_t DEFAULT_BUFFER_SIZE = 1024;
+
+    AnalogStreamOptions() :
+            coeffs_(nullptr),
+            tapCount_(0),
+            blockSize_(DEFAULT_BLOCK_SIZE),
+            bufferSize_(DEFAULT_BUFFER_SIZE),
+            decimation_(1) {
+    }
+
+    /**
+     * Sets the number of samples acquired per DMA transfer.
+     *
+     * The block size is rounded down to a multiple of the number of pins.
+     */
+    AnalogStreamOptions& blockSize(size_t size) {
+        blockSize_ = size;
+        return *this;
+    }
+
+    size_t blockSize() const {
+        return blockSize_;
+    }
+
+    /**
+     * Sets the size of the buffer for the processed samples.
+     *
+     * If 0, the samples are only delivered to the callback.
+     */
+    AnalogStreamOptions& bufferSize(size_t size) {
+        bufferSize_ = size;
+        return *this;
+    }
+
+    size_t bufferSize() const {
+        return bufferSize_;
+    }
+
+    /**
+     * Sets the decimation factor.
+     */
+    AnalogStreamOptions& decimation(unsigned factor) {
+        decimation_ = factor;
+        return *this;
+    }
+
+    unsigned decimation() const {
+        return decimation_;
+    }
+
+    /**
+     * Sets the coefficients of an FIR filter in the Q15 format.
+     *
+     * The coefficients are copied.
+     */
+    AnalogStreamOptions& filter(const int16_t* coeffs, size_t count) {
+        coeffs_ = coeffs;
+        tapCount_ = count;
+        return *this;
+    }
+
+    const int16_t* filterCoefficients() const {
+        return coeffs_;
+    }
+
+    size_t filterTapCount() const {
+        return tapCount_;
+    }
+
+private:
+    const int16_t* coeffs_;
+    size_t tapCount_;
+    size_t blockSize_;
+    size_t bufferSize_;
+    unsigned decimation_;
+};
+
+/**
+ * Continuous acquisition of analog samples.
+ *
+ * The ADC scans a list of pins at a rate driven by a hardware timer and transfers the samples via
+ * DMA into one half of a double buffer while the other half is being processed. Each block of
+ * samples is filtered and decimated, and then stored in a ring buffer and/or passed to a callback.
+ *
+ * Example:
+ * ```
+ * AnalogStream stream;
+ *
+ * void setup() {
+ *     stream.begin({ A0, A1 }, 8000, AnalogStreamOptions().decimation(4));
+ * }
+ *
+ * void loop() {
+ *     int16_t samples[64];
+ *     const size_t n = stream.read(samples, 64);
+ *     // samples[0], samples[2], ... are from A0, samples[1], samples[3], ... are from A1
+ * }
+ * ```
+ */
+class AnalogStream {
+public:
+    /**
+     * Callback invoked for each block of processed samples.
+     *
+     * The callback is invoked in an ISR context.
+     */
+    typedef void (*Callback)(const int16_t* samples, size_t count, void* context);
+
+    AnalogStream();
+    ~AnalogStream();
+
+    /**
+     * Starts the acquisition.
+     *
+     * @param pins Pins to scan.
+     * @param sampleRate Number of scans per second.
+     * @param opts Options.
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int begin(std::initializer_list<pin_t> pins, unsigned sampleRate, const AnalogStreamOptions& opts = AnalogStreamOptions());
+    int begin(const pin_t* pins, size_t pinCount, unsigned sampleRate, const AnalogStreamOptions& opts = AnalogStreamOptions());
+
+    /**
+     * Stops the acquisition.
+     */
+    void end();
+
+    /**
+     * Sets the callback for the processed samples.
+     */
+    void onSamples(Callback callback, void* context = nullptr);
+
+    /**
+     * Returns the number of samples available for reading.
+     */
+    size_t available() const;
+
+    /**
+     * Reads the processed samples.
+     *
+     * @return Number of samples read. The number is always a multiple of the number of pins.
+     */
+    size_t read(int16_t* samples, size_t count);
+
+    /**
+     * Returns the number of samples that have been discarded because the buffer was full.
+     */
+    size_t droppedSamples() const {
+        return dropped_;
+    }
+
+    bool isActive() const {
+        return active_;
+    }
+
+    // This class is non-copyable
+    AnalogStream(const AnalogStream&) = delete;
+    AnalogStream& operator=(const AnalogStream&) = delete;
+
+private:
+    SamplePipeline pipeline_;
+    services::RingBuffer<int16_t> ring_;
+    std::unique_ptr<int16_t[]> dmaBuf_;
+    std::unique_ptr<int16_t[]> outBuf_;
+    std::unique_ptr<int16_t[]> ringBuf_;
+    Callback callback_;
+    void* callbackCtx_;
+    volatile size_t dropped_;
+    size_t pinCount_;
+    bool active_;
+
+    void processBlock(const int16_t* samples, size_t count);
+
+    static void blockCallback(const int16_t* samples, size_t count, void* context);
+};
+
+} // namespace particle
+
+using particle::AnalogStream;
+using particle::AnalogStreamOptions;
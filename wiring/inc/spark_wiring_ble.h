@@ -719,7 +719,9 @@ public:
             : minRssi_(BLE_RSSI_INVALID),
               maxRssi_(BLE_RSSI_INVALID),
               customData_(nullptr),
-              customDataLen_(0) {
+              customDataLen_(0),
+              allowDuplicates_(true),
+              rssiChangeThreshold_(0) {
     }
     ~BleScanFilter() = default;
 
@@ -805,6 +807,26 @@ public:
         return customData_;
     }
 
+    // Duplicates. If not allowed, a device is reported only once per scan, unless its advertising data
+    // or RSSI has changed since it was reported last time
+    BleScanFilter& allowDuplicates(bool allow) {
+        allowDuplicates_ = allow;
+        return *this;
+    }
+    bool allowDuplicates() const {
+        return allowDuplicates_;
+    }
+
+    // Minimum change of the average RSSI, in dBm, for a device to be reported again when duplicates
+    // are not allowed. 0 means that changes of the RSSI are ignored
+    BleScanFilter& rssiChangeThreshold(uint8_t threshold) {
+        rssiChangeThreshold_ = threshold;
+        return *this;
+    }
+    uint8_t rssiChangeThreshold() const {
+        return rssiChangeThreshold_;
+    }
+
     BleScanFilter& clear() {
         deviceNames_.clear();
         serviceUuids_.clear();
@@ -813,6 +835,8 @@ public:
         minRssi_ = maxRssi_ = BLE_RSSI_INVALID;
         customData_ = nullptr;
         customDataLen_ = 0;
+        allowDuplicates_ = true;
+        rssiChangeThreshold_ = 0;
         return *this;
     }
 
@@ -825,6 +849,8 @@ private:
     int8_t maxRssi_;
     const uint8_t* customData_;
     size_t customDataLen_;
+    bool allowDuplicates_;
+    uint8_t rssiChangeThreshold_;
 };
 
 
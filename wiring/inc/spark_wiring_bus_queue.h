@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "spark_wiring_bus_transaction.h"
+#include "spark_wiring_spi.h"
+#include "spark_wiring_i2c.h"
+#include "concurrent_hal.h"
+
+#include <utility>
+
+namespace particle {
+
+/**
+ * SPI bus driver.
+ *
+ * The bus is acquired via `SPIClass::beginTransaction()`, which takes the same HAL lock that is
+ * used by the system drivers sharing the bus (see `spi_lock.h`). `BusTransaction::settings` can
+ * point to an `SPISettings` object. `BusTransaction::address` is the chip select pin.
+ */
+class SpiBusDriver: public BusDriver {
+public:
+    explicit SpiBusDriver(SPIClass& spi);
+
+    int begin(const BusTransaction& t) override;
+    int step(const BusTransaction& t, const BusStep& step) override;
+    void end(const BusTransaction& t) override;
+
+private:
+    SPIClass& spi_;
+    bool selected_;
+
+    int transfer(const uint8_t* tx, uint8_t* rx, size_t size);
+};
+
+/**
+ * I2C bus driver.
+ *
+ * `BusTransaction::address` is the 7-bit device address. `TwoWire::begin()` needs to be called
+ * before any transactions are submitted.
+ */
+class I2cBusDriver: public BusDriver {
+public:
+    explicit I2cBusDriver(TwoWire& wire);
+
+    int begin(const BusTransaction& t) override;
+    int step(const BusTransaction& t, const BusStep& step) override;
+    void end(const BusTransaction& t) override;
+
+private:
+    TwoWire& wire_;
+};
+
+#if PLATFORM_THREADING
+
+namespace detail {
+
+// Holds the bus driver of a queue. Queue classes inherit from this class before inheriting from
+// ThreadedBusTransactionQueue, so that the driver is constructed before the queue's thread is started
+// and destroyed after the thread is stopped
+template<typename DriverT>
+class BusDriverHolder {
+protected:
+    template<typename... ArgsT>
+    explicit BusDriverHolder(ArgsT&&... args) :
+            busDriver_(std::forward<ArgsT>(args)...) {
+    }
+
+    DriverT busDriver_;
+};
+
+} // namespace detail
+
+/**
+ * Transaction queue that is processed in a dedicated thread.
+ *
+ * Completion callbacks are invoked in the queue's thread.
+ */
+class ThreadedBusTransactionQueue: public BusTransactionQueue {
+public:
+    ThreadedBusTransactionQueue(BusDriver* driver, const char* name, os_thread_prio_t priority = OS_THREAD_PRIORITY_DEFAULT,
+            size_t stackSize = OS_THREAD_STACK_SIZE_DEFAULT);
+    ~ThreadedBusTransactionQueue();
+
+protected:
+    void notify() override;
+
+private:
+    os_thread_t thread_;
+    os_semaphore_t sem_;
+    volatile bool exit_;
+
+    static os_thread_return_t run(void* data);
+};
+
+/**
+ * Transaction queue for an SPI bus.
+ *
+ * Example:
+ * ```
+ * SpiTransactionQueue spiQueue(SPI);
+ * SPISettings settings(8 * MHZ, MSBFIRST, SPI_MODE0);
+ *
+ * const uint8_t cmd[] = { 0x0b, 0x00, 0x00, 0x00, 0x00 };
+ * uint8_t data[64];
+ * const BusStep steps[] = {
+ *     BusStep::select(),
+ *     BusStep::write(cmd, sizeof(cmd)),
+ *     BusStep::read(data, sizeof(data)),
+ *     BusStep::deselect()
+ * };
+ * BusTransaction t(steps, 4, D5);
+ * t.settings = &settings;
+ * spiQueue.submitAsync(&t).onSuccess([]() { ... });
+ * ```
+ */
+class SpiTransactionQueue: private detail::BusDriverHolder<SpiBusDriver>, public ThreadedBusTransactionQueue {
+public:
+    explicit SpiTransactionQueue(SPIClass& spi, os_thread_prio_t priority = OS_THREAD_PRIORITY_DEFAULT) :
+            BusDriverHolder(spi),
+            ThreadedBusTransactionQueue(&busDriver_, "spi_queue", priority) {
+    }
+};
+
+/**
+ * Transaction queue for an I2C bus.
+ */
+class I2cTransactionQueue: private detail::BusDriverHolder<I2cBusDriver>, public ThreadedBusTransactionQueue {
+public:
+    explicit I2cTransactionQueue(TwoWire& wire, os_thread_prio_t priority = OS_THREAD_PRIORITY_DEFAULT) :
+            BusDriverHolder(wire),
+            ThreadedBusTransactionQueue(&busDriver_, "i2c_queue", priority) {
+    }
+};
+
+#endif // PLATFORM_THREADING
+
+} // namespace particle
+
+using particle::BusStep;
+using particle::BusTransaction;
+#if PLATFORM_THREADING
+using particle::SpiTransactionQueue;
+using particle::I2cTransactionQueue;
+#endif
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "spark_wiring_async.h"
+#include "completion_handler.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace particle {
+
+/**
+ * Step of a bus transaction.
+ */
+struct BusStep {
+    enum Type: uint8_t {
+        SELECT, ///< Assert the chip select line (SPI).
+        DESELECT, ///< Deassert the chip select line (SPI).
+        WRITE, ///< Write `size` bytes from `tx`.
+        READ, ///< Read `size` bytes into `rx`.
+        TRANSFER, ///< Write `size` bytes from `tx` while reading into `rx` (SPI).
+        DELAY ///< Wait for `size` milliseconds.
+    };
+
+    enum Flag: uint8_t {
+        NO_STOP = 0x01 ///< Don't generate a stop condition after a write or read (I2C).
+    };
+
+    Type type;
+    uint8_t flags;
+    const uint8_t* tx;
+    uint8_t* rx;
+    size_t size;
+
+    static BusStep select() {
+        return { SELECT, 0, nullptr, nullptr, 0 };
+    }
+
+    static BusStep deselect() {
+        return { DESELECT, 0, nullptr, nullptr, 0 };
+    }
+
+    static BusStep write(const void* data, size_t size, uint8_t flags = 0) {
+        return { WRITE, flags, (const uint8_t*)data, nullptr, size };
+    }
+
+    static BusStep read(void* data, size_t size, uint8_t flags = 0) {
+        return { READ, flags, nullptr, (uint8_t*)data, size };
+    }
+
+    static BusStep transfer(const void* tx, void* rx, size_t size) {
+        return { TRANSFER, 0, (const uint8_t*)tx, (uint8_t*)rx, size };
+    }
+
+    static BusStep delay(system_tick_t ms) {
+        return { DELAY, 0, nullptr, nullptr, ms };
+    }
+};
+
+/**
+ * Bus transaction.
+ *
+ * A transaction is a chain of steps that are executed while the bus is held by the queue. The
+ * transaction object and the steps are owned by the caller and need to remain valid until the
+ * transaction completes.
+ *
+ * Example: reading a register of an I2C device.
+ * ```
+ * const uint8_t reg = 0x0f;
+ * uint8_t val = 0;
+ * const BusStep steps[] = {
+ *     BusStep::write(&reg, 1, BusStep::NO_STOP),
+ *     BusStep::read(&val, 1)
+ * };
+ * BusTransaction t(steps, 2, 0x68);
+ * ```
+ */
+struct BusTransaction {
+    enum State: uint8_t {
+        IDLE,
+        QUEUED,
+        RUNNING,
+        DONE
+    };
+
+    const BusStep* steps;
+    size_t stepCount;
+    uint16_t address; ///< Device address (I2C) or chip select pin (SPI).
+    int8_t priority; ///< Transactions with higher priority are executed first.
+    const void* settings; ///< Bus-specific settings, e.g. `SPISettings`. If `nullptr`, the defaults are used.
+    completion_callback callback; ///< Completion callback.
+    void* callbackData;
+
+    // Fields below are maintained by the queue
+    BusTransaction* next;
+    void* promiseData; ///< Promise of a transaction submitted via `submitAsync()`.
+    volatile State state;
+    int result;
+
+    BusTransaction(const BusStep* steps = nullptr, size_t stepCount = 0, uint16_t address = 0, int8_t priority = 0) :
+            steps(steps),
+            stepCount(stepCount),
+            address(address),
+            priority(priority),
+            settings(nullptr),
+            callback(nullptr),
+            callbackData(nullptr),
+            next(nullptr),
+            promiseData(nullptr),
+            state(IDLE),
+            result(0) {
+    }
+};
+
+/**
+ * Bus driver interface.
+ */
+class BusDriver {
+public:
+    virtual ~BusDriver() = default;
+
+    /**
+     * Acquires the bus and applies the transaction's settings.
+     */
+    virtual int begin(const BusTransaction& t) = 0;
+
+    /**
+     * Executes a step.
+     */
+    virtual int step(const BusTransaction& t, const BusStep& step) = 0;
+
+    /**
+     * Releases the bus. Called after `begin()` has succeeded, even if one of the steps has failed.
+     */
+    virtual void end(const BusTransaction& t) = 0;
+};
+
+/**
+ * Queue of bus transactions.
+ *
+ * Transactions are executed one at a time in the order of their priority, and in the order of
+ * submission if the priorities are equal. By default, the queue is processed in the thread that
+ * submits a transaction when the queue is idle; subclasses can override `notify()` to process the
+ * queue in a dedicated thread.
+ *
+ * Submitting and cancelling transactions is safe from any thread.
+ */
+class BusTransactionQueue {
+public:
+    explicit BusTransactionQueue(BusDriver* driver);
+    virtual ~BusTransactionQueue() = default;
+
+    /**
+     * Submits a transaction.
+     *
+     * The completion callback is invoked with the result of the transaction.
+     *
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int submit(BusTransaction* t);
+
+    /**
+     * Submits a transaction and returns a future for its result.
+     *
+     * The transaction's completion callback, if any, is still invoked. The transaction can be
+     * resubmitted via `submit()` or `submitAsync()` once it's completed.
+     */
+    Future<void> submitAsync(BusTransaction* t);
+
+    /**
+     * Cancels a queued transaction.
+     *
+     * The completion callback is invoked with `SYSTEM_ERROR_CANCELLED`. A transaction that is
+     * already running cannot be cancelled.
+     *
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int cancel(BusTransaction* t);
+
+    /**
+     * Executes queued transactions until the queue is empty.
+     */
+    void process();
+
+    /**
+     * Returns the number of queued transactions, not including the running one.
+     */
+    size_t queued() const {
+        return count_;
+    }
+
+    // This class is non-copyable
+    BusTransactionQueue(const BusTransactionQueue&) = delete;
+    BusTransactionQueue& operator=(const BusTransactionQueue&) = delete;
+
+protected:
+    /**
+     * Called when a transaction has been submitted and the queue is idle.
+     */
+    virtual void notify() {
+        process();
+    }
+
+private:
+    BusDriver* driver_;
+    BusTransaction* head_;
+    volatile size_t count_;
+    volatile bool processing_;
+
+    int submit(BusTransaction* t, void* promiseData);
+    int execute(const BusTransaction& t);
+
+    static void complete(BusTransaction* t, int result);
+};
+
+} // namespace particle
@@ -57,6 +57,7 @@ const PublishFlag PUBLIC(PUBLISH_EVENT_FLAG_PUBLIC);
 const PublishFlag PRIVATE(PUBLISH_EVENT_FLAG_PRIVATE);
 const PublishFlag NO_ACK(PUBLISH_EVENT_FLAG_NO_ACK);
 const PublishFlag WITH_ACK(PUBLISH_EVENT_FLAG_WITH_ACK);
+const PublishFlag PRIORITY(PUBLISH_EVENT_FLAG_PRIORITY);
 
 // Test if the paramater a regular C "string" literal
 template <typename T>
@@ -282,6 +283,26 @@ public:
     int publishVitals(system_tick_t period_s = particle::NOW);
     inline int publishVitals(std::chrono::seconds s) { return publishVitals(s.count()); }
 
+    /**
+     * @brief Keep a history of vitals
+     *
+     * The system samples its diagnostic data every \p period_s seconds and sends the samples
+     * along with the next vitals message in a compact delta-encoded form.
+     *
+     * @param[in] period_s The sampling period in seconds. If 0, the history is disabled
+     * @param[in] depth The maximum number of samples to keep. The depth is limited so that the
+     *            samples fit in a single vitals message
+     *
+     * @returns \p system_error_t result code
+     * @retval \p system_error_t::SYSTEM_ERROR_NONE
+     * @retval \p system_error_t::SYSTEM_ERROR_NO_MEMORY
+     *
+     * @note Sampling is not available on platforms without threading. The history then contains
+     * only the values sampled at publish time.
+     */
+    int vitalsHistory(system_tick_t period_s, size_t depth);
+    inline int vitalsHistory(std::chrono::seconds s, size_t depth) { return vitalsHistory(s.count(), depth); }
+
     inline bool subscribe(const char *eventName, EventHandler handler, Spark_Subscription_Scope_TypeDef scope)
     {
         return spark_subscribe(eventName, handler, NULL, scope, NULL, NULL);
@@ -19,6 +19,7 @@
 #define SPARK_WIRING_JSON_H
 
 #include "spark_wiring_print.h"
+#include "spark_wiring_stream.h"
 #include "spark_wiring_string.h"
 
 #include "jsmn.h"
@@ -159,6 +160,172 @@ private:
     JSONObjectIterator(const jsmntok_t *token, detail::JSONDataPtr data);
 };
 
+enum JSONEvent {
+    JSON_EVENT_BEGIN_OBJECT,
+    JSON_EVENT_END_OBJECT,
+    JSON_EVENT_BEGIN_ARRAY,
+    JSON_EVENT_END_ARRAY,
+    JSON_EVENT_NAME, // Name of an object's property
+    JSON_EVENT_STRING,
+    JSON_EVENT_NUMBER,
+    JSON_EVENT_BOOL,
+    JSON_EVENT_NULL
+};
+
+// Receives events generated by JSONStreamReader
+class JSONReaderHandler {
+public:
+    virtual ~JSONReaderHandler() = default;
+
+    // Data is a null-terminated string containing an unescaped name or string value, or the text
+    // of a primitive value. It is only valid for the duration of the call. Returning false stops
+    // the parsing
+    virtual bool onEvent(JSONEvent event, const char *data, size_t size) = 0;
+};
+
+// Incremental JSON parser. Unlike JSONValue::parse(), it doesn't need the entire document to be
+// available in memory and doesn't allocate any tokens: the document is processed chunk by chunk
+// and the handler is notified about every element as soon as it's parsed
+class JSONStreamReader {
+public:
+    static const unsigned MAX_DEPTH = 32;
+
+    // The buffer is used to accumulate a single name or value and limits its maximum size
+    JSONStreamReader(char *buf, size_t size);
+
+    // Returns the number of bytes consumed, or a negative result code in case of an error. The
+    // parsing stops at the end of the top-level value
+    int parse(const char *data, size_t size, JSONReaderHandler *handler);
+    // Reads all data available in the stream, or until the end of the top-level value
+    int parse(Stream &stream, JSONReaderHandler *handler);
+    // Signals the end of the input. Returns an error if the document is incomplete
+    int finish(JSONReaderHandler *handler);
+
+    void reset();
+
+    bool isDone() const;
+    unsigned depth() const;
+
+private:
+    enum State {
+        VALUE, // Expecting a value
+        VALUE_OR_END, // Expecting a value or the end of an array
+        NAME, // Expecting a property name
+        NAME_OR_END, // Expecting a property name or the end of an object
+        COLON, // Expecting a name separator
+        COMMA_OR_END, // Expecting a value separator or the end of a compound value
+        DONE,
+        ERROR
+    };
+
+    enum Token {
+        NONE,
+        STRING,
+        NAME_STRING,
+        NUMBER,
+        LITERAL
+    };
+
+    char *buf_;
+    size_t bufSize_, n_;
+    uint32_t objects_; // Bit set identifying objects in the stack of compound values
+    unsigned depth_;
+    State state_;
+    Token token_;
+    int escape_; // Number of remaining characters of an escape sequence, or -1 for "\"
+    size_t escapeStart_;
+    int error_;
+
+    int processChar(char c, JSONReaderHandler *handler);
+    int processStringChar(char c, JSONReaderHandler *handler);
+    int endToken(JSONReaderHandler *handler);
+    int beginCompound(bool object, JSONReaderHandler *handler);
+    int endCompound(bool object, JSONReaderHandler *handler);
+    int emit(JSONEvent event, JSONReaderHandler *handler);
+    bool append(char c);
+    int fail(int error);
+    void valueParsed();
+};
+
+// Statically allocated buffer for JSONStreamReader
+template<size_t N>
+class StaticJSONStreamReader: public JSONStreamReader {
+public:
+    StaticJSONStreamReader() :
+            JSONStreamReader(buf_, sizeof(buf_)) {
+    }
+
+private:
+    char buf_[N];
+};
+
+// Value captured by JSONPathQuery
+class JSONQueryResult {
+public:
+    JSONQueryResult();
+
+    bool toBool() const;
+    int toInt() const;
+    double toDouble() const;
+    String toString() const;
+
+    const char* data() const; // Returns null-terminated string
+    size_t size() const;
+
+    JSONType type() const;
+    bool isValid() const;
+
+private:
+    std::unique_ptr<char[]> s_;
+    size_t size_;
+    JSONType type_;
+
+    friend class JSONPathQuery;
+};
+
+// Handler extracting the values of a few properties from a document. A path consists of property
+// names separated by dots and array indices in square brackets, e.g. "data.items[1].id". Only
+// primitive values are captured, for compound values only their type is reported
+class JSONPathQuery: public JSONReaderHandler {
+public:
+    static const unsigned MAX_DEPTH = 16;
+
+    // The path strings must remain valid while the query is in use
+    JSONPathQuery(const char* const *paths, size_t count);
+    ~JSONPathQuery();
+
+    const JSONQueryResult& result(size_t index) const;
+    size_t resultCount() const;
+    bool isComplete() const; // Returns true if all values have been found
+
+    void reset();
+
+    virtual bool onEvent(JSONEvent event, const char *data, size_t size) override;
+
+    // This class is non-copyable
+    JSONPathQuery(const JSONPathQuery&) = delete;
+    JSONPathQuery& operator=(const JSONPathQuery&) = delete;
+
+private:
+    struct Level {
+        int index; // Index of the current array element
+        size_t nameOffs; // Offset of the current property name in the name buffer
+        size_t nameSize;
+        bool nameValid;
+        bool array;
+    };
+
+    Level levels_[MAX_DEPTH];
+    char names_[128];
+    const char* const *paths_;
+    JSONQueryResult *results_;
+    size_t count_, found_;
+    unsigned depth_, skipDepth_;
+
+    bool matchPath(const char *path) const;
+    void capture(JSONType type, const char *data, size_t size);
+};
+
 // Abstract JSON document writer
 class JSONWriter {
 public:
@@ -277,6 +444,54 @@ inline bool spark::JSONValue::isValid() const {
     return type() != JSON_TYPE_INVALID;
 }
 
+// spark::JSONStreamReader
+inline bool spark::JSONStreamReader::isDone() const {
+    return state_ == DONE;
+}
+
+inline unsigned spark::JSONStreamReader::depth() const {
+    return depth_;
+}
+
+// spark::JSONQueryResult
+inline spark::JSONQueryResult::JSONQueryResult() :
+        size_(0),
+        type_(JSON_TYPE_INVALID) {
+}
+
+inline String spark::JSONQueryResult::toString() const {
+    return String(data(), size_);
+}
+
+inline const char* spark::JSONQueryResult::data() const {
+    return s_ ? s_.get() : "";
+}
+
+inline size_t spark::JSONQueryResult::size() const {
+    return size_;
+}
+
+inline spark::JSONType spark::JSONQueryResult::type() const {
+    return type_;
+}
+
+inline bool spark::JSONQueryResult::isValid() const {
+    return type_ != JSON_TYPE_INVALID;
+}
+
+// spark::JSONPathQuery
+inline const spark::JSONQueryResult& spark::JSONPathQuery::result(size_t index) const {
+    return results_[index];
+}
+
+inline size_t spark::JSONPathQuery::resultCount() const {
+    return count_;
+}
+
+inline bool spark::JSONPathQuery::isComplete() const {
+    return found_ == count_;
+}
+
 inline spark::JSONValue spark::JSONValue::parseCopy(const char *json) {
     return parseCopy(json, strlen(json));
 }
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "hal_platform.h"
+
+#if PLATFORM_THREADING
+
+#include "timer_wheel.h"
+#include "inplace_function.h"
+
+#include <chrono>
+
+namespace particle {
+
+/**
+ * A software timer.
+ *
+ * Unlike `Timer`, which creates an RTOS timer for every instance, all instances of this class are
+ * served by a single thread that keeps them in a timing wheel. Starting and stopping a timer takes
+ * constant time and never blocks, and expired timers are processed in a batch. The callback is
+ * stored in the timer object itself, so creating a timer doesn't allocate memory.
+ *
+ * All methods except `dispose()` and the destructor can be called from an ISR.
+ */
+class SoftTimer {
+public:
+    typedef InplaceFunction<void()> timer_callback_fn;
+
+    SoftTimer(unsigned period, timer_callback_fn callback, bool oneShot = false);
+
+    template<typename T>
+    SoftTimer(unsigned period, void (T::*handler)(), T& instance, bool oneShot = false) :
+            SoftTimer(period, [handler, &instance]() { (instance.*handler)(); }, oneShot) {
+    }
+
+    SoftTimer(std::chrono::milliseconds period, timer_callback_fn callback, bool oneShot = false) :
+            SoftTimer(period.count(), std::move(callback), oneShot) {
+    }
+
+    virtual ~SoftTimer();
+
+    /**
+     * Starts the timer. If the timer is already running, it's restarted.
+     */
+    bool start();
+
+    /**
+     * Stops the timer.
+     */
+    bool stop();
+
+    /**
+     * Restarts the timer.
+     */
+    bool reset() {
+        return start();
+    }
+
+    /**
+     * Changes the period of the timer and restarts it.
+     */
+    bool changePeriod(unsigned period);
+
+    bool changePeriod(std::chrono::milliseconds period) {
+        return changePeriod(period.count());
+    }
+
+    // Compatibility with `Timer`
+    bool startFromISR() {
+        return start();
+    }
+
+    bool stopFromISR() {
+        return stop();
+    }
+
+    bool resetFromISR() {
+        return reset();
+    }
+
+    bool changePeriodFromISR(unsigned period) {
+        return changePeriod(period);
+    }
+
+    bool isValid() const {
+        return true;
+    }
+
+    bool isActive() const;
+
+    /**
+     * Stops the timer and waits until its callback returns if it's running.
+     */
+    void dispose();
+
+    /**
+     * Subclasses can either provide a callback function, or override this method.
+     */
+    virtual void timeout() {
+        if (callback_) {
+            callback_();
+        }
+    }
+
+    // This class is non-copyable
+    SoftTimer(const SoftTimer&) = delete;
+    SoftTimer& operator=(const SoftTimer&) = delete;
+
+private:
+    struct Entry: TimerWheel::Entry {
+        SoftTimer* timer;
+    };
+
+    Entry entry_;
+    timer_callback_fn callback_;
+    SoftTimer* nextRequest_; // Next timer with a pending request
+    SoftTimer** pprevRequest_; // Pointer to this timer in the list of pending requests
+    system_tick_t period_;
+    system_tick_t expiry_; // Requested expiration time
+    bool oneShot_;
+    volatile bool active_; // Requested state
+
+    friend class SoftTimerService;
+};
+
+} // namespace particle
+
+using particle::SoftTimer;
+
+#endif // PLATFORM_THREADING
@@ -51,6 +51,10 @@ class __FlashStringHelper;
 // result objects are assumed to be writable by subsequent concatenations.
 class StringSumHelper;
 
+namespace particle {
+class StringBuilder;
+} // namespace particle
+
 // The string class
 class String
 {
@@ -207,6 +211,7 @@ protected:
 protected:
 	void init(void);
 	void invalidate(void);
+	unsigned char grow(unsigned int size);
 	unsigned char changeBuffer(unsigned int maxStrLen);
 	unsigned char concat(const char *cstr, unsigned int length);
 
@@ -219,6 +224,7 @@ protected:
 	#endif
 
         friend class StringPrintableHelper;
+        friend class particle::StringBuilder;
 
 };
 
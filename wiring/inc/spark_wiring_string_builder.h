@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "spark_wiring_print.h"
+#include "spark_wiring_string.h"
+#include "allocator.h"
+
+#include <cstddef>
+
+namespace particle {
+
+/**
+ * A `Print` sink that accumulates text in a chain of buffers.
+ *
+ * Unlike `String`, appending to a builder never moves the data that has already been written:
+ * the text is stored in the caller-provided buffer first, and then in chunks allocated with the
+ * given allocator. The chunk size doubles with every allocation. The text can be copied into a
+ * `String` or a plain buffer with a single allocation once it's complete.
+ */
+class StringBuilder: public Print {
+public:
+    static const size_t DEFAULT_CHUNK_SIZE = 64;
+    static const size_t MAX_CHUNK_SIZE = 1024;
+
+    /**
+     * Constructs a builder that stores all text in allocated chunks.
+     *
+     * @param chunkSize Size of the first chunk.
+     * @param alloc Allocator. If `nullptr`, the heap is used.
+     */
+    explicit StringBuilder(size_t chunkSize = DEFAULT_CHUNK_SIZE, SimpleAllocator* alloc = nullptr);
+
+    /**
+     * Constructs a builder that stores the text in the provided buffer until it's full.
+     *
+     * @param buf Buffer.
+     * @param size Buffer size.
+     * @param alloc Allocator. If `nullptr`, the heap is used.
+     */
+    StringBuilder(char* buf, size_t size, SimpleAllocator* alloc = nullptr);
+
+    ~StringBuilder();
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* data, size_t size) override;
+
+    using Print::write;
+
+    /**
+     * Returns the length of the text.
+     */
+    size_t length() const {
+        return len_;
+    }
+
+    /**
+     * Returns `false` if some of the text has been lost due to a memory allocation error.
+     */
+    bool isValid() const {
+        return !error_;
+    }
+
+    /**
+     * Copies the text to a buffer.
+     *
+     * The text is truncated if the buffer is too small. The output is always null-terminated
+     * unless `size` is 0.
+     *
+     * @return Length of the text.
+     */
+    size_t copyTo(char* buf, size_t size) const;
+
+    /**
+     * Returns a copy of the text.
+     */
+    String toString() const;
+
+    /**
+     * Discards the text and frees all allocated chunks.
+     */
+    void clear();
+
+    // This class is non-copyable
+    StringBuilder(const StringBuilder&) = delete;
+    StringBuilder& operator=(const StringBuilder&) = delete;
+
+private:
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+        size_t used;
+
+        char* data() {
+            return (char*)(this + 1);
+        }
+
+        const char* data() const {
+            return (const char*)(this + 1);
+        }
+    };
+
+    SimpleAllocator* alloc_;
+    Chunk* head_;
+    Chunk* tail_;
+    char* buf_; // Caller-provided buffer
+    size_t bufSize_;
+    size_t bufUsed_;
+    size_t nextChunkSize_;
+    size_t initChunkSize_;
+    size_t len_;
+    bool error_;
+
+    bool addChunk(size_t minSize);
+
+    template<typename F>
+    void forEachPart(F fn) const;
+};
+
+} // namespace particle
+
+using particle::StringBuilder;
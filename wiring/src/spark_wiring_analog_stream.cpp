@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_analog_stream.h"
+
+#include "spark_wiring_interrupts.h"
+#include "check.h"
+
+#include <algorithm>
+
+namespace particle {
+
+const size_t AnalogStreamOptions::DEFAULT_BLOCK_SIZE;
+const size_t AnalogStreamOptions::DEFAULT_BUFFER_SIZE;
+
+AnalogStream::AnalogStream() :
+        callback_(nullptr),
+        callbackCtx_(nullptr),
+        dropped_(0),
+        pinCount_(0),
+        active_(false) {
+    ring_.init(nullptr, 0);
+}
+
+AnalogStream::~AnalogStream() {
+    end();
+}
+
+int AnalogStream::begin(std::initializer_list<pin_t> pins, unsigned sampleRate, const AnalogStreamOptions& opts) {
+    return begin(pins.begin(), pins.size(), sampleRate, opts);
+}
+
+int AnalogStream::begin(const pin_t* pins, size_t pinCount, unsigned sampleRate, const AnalogStreamOptions& opts) {
+    end();
+    CHECK_TRUE(pins && pinCount > 0, SYSTEM_ERROR_INVALID_ARGUMENT);
+    const size_t blockSize = opts.blockSize() - opts.blockSize() % pinCount;
+    CHECK_TRUE(blockSize > 0, SYSTEM_ERROR_INVALID_ARGUMENT);
+    CHECK(pipeline_.init(pinCount, opts.decimation(), opts.filterCoefficients(), opts.filterTapCount()));
+    std::unique_ptr<int16_t[]> dmaBuf(new(std::nothrow) int16_t[blockSize * 2]);
+    std::unique_ptr<int16_t[]> outBuf(new(std::nothrow) int16_t[pipeline_.maxOutputSize(blockSize)]);
+    CHECK_TRUE(dmaBuf && outBuf, SYSTEM_ERROR_NO_MEMORY);
+    std::unique_ptr<int16_t[]> ringBuf;
+    if (opts.bufferSize() > 0) {
+        ringBuf.reset(new(std::nothrow) int16_t[opts.bufferSize()]);
+        CHECK_TRUE(ringBuf, SYSTEM_ERROR_NO_MEMORY);
+    }
+    ring_.init(ringBuf.get(), opts.bufferSize());
+    dmaBuf_ = std::move(dmaBuf);
+    outBuf_ = std::move(outBuf);
+    ringBuf_ = std::move(ringBuf);
+    pinCount_ = pinCount;
+    dropped_ = 0;
+    hal_adc_stream_config conf = {};
+    conf.size = sizeof(conf);
+    conf.version = HAL_ADC_STREAM_CONFIG_VERSION;
+    conf.pins = pins;
+    conf.pin_count = pinCount;
+    conf.sample_rate = sampleRate;
+    conf.buffer = dmaBuf_.get();
+    conf.block_size = blockSize;
+    conf.callback = blockCallback;
+    conf.context = this;
+    active_ = true;
+    const int r = hal_adc_stream_start(&conf, nullptr);
+    if (r < 0) {
+        active_ = false;
+        return r;
+    }
+    return 0;
+}
+
+void AnalogStream::end() {
+    if (!active_) {
+        return;
+    }
+    hal_adc_stream_stop(nullptr);
+    active_ = false;
+    ATOMIC_BLOCK() {
+        ring_.init(nullptr, 0);
+    }
+    dmaBuf_.reset();
+    outBuf_.reset();
+    ringBuf_.reset();
+}
+
+void AnalogStream::onSamples(Callback callback, void* context) {
+    ATOMIC_BLOCK() {
+        callback_ = callback;
+        callbackCtx_ = context;
+    }
+}
+
+size_t AnalogStream::available() const {
+    ssize_t n = 0;
+    ATOMIC_BLOCK() {
+        n = ring_.data();
+    }
+    return std::max(n, (ssize_t)0);
+}
+
+size_t AnalogStream::read(int16_t* samples, size_t count) {
+    if (!pinCount_) {
+        return 0;
+    }
+    // Only complete scans are stored in the buffer
+    count -= count % pinCount_;
+    ssize_t n = 0;
+    ATOMIC_BLOCK() {
+        n = std::min(ring_.data(), (ssize_t)count);
+        if (n > 0) {
+            n = ring_.get(samples, n);
+        }
+    }
+    return std::max(n, (ssize_t)0);
+}
+
+void AnalogStream::processBlock(const int16_t* samples, size_t count) {
+    const size_t n = pipeline_.process(samples, count, outBuf_.get());
+    if (!n) {
+        return;
+    }
+    if (callback_) {
+        callback_(outBuf_.get(), n, callbackCtx_);
+    }
+    if (ring_.size() > 0) {
+        // Discard the entire block if it doesn't fit, so that the buffer only contains complete scans
+        if (ring_.space() >= (ssize_t)n) {
+            ring_.put(outBuf_.get(), n);
+        } else {
+            dropped_ += n;
+        }
+    }
+}
+
+void AnalogStream::blockCallback(const int16_t* samples, size_t count, void* context) {
+    const auto self = static_cast<AnalogStream*>(context);
+    self->processBlock(samples, count);
+}
+
+} // namespace particle
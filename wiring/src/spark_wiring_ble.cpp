@@ -26,6 +26,7 @@
 #include "scope_guard.h"
 #include "hex_to_bytes.h"
 #include "bytes2hexbuf.h"
+#include "ble_scan_util.h"
 
 #include "logging.h"
 LOG_SOURCE_CATEGORY("wiring.ble")
@@ -61,6 +62,9 @@ const uint8_t PARTICLE_DEFAULT_BLE_SVC_UUID[BLE_SIG_UUID_128BIT_LEN] = {
     0x7b, 0xe3, 0x27, 0x74, 0x7b, 0xf8, 0x15, 0xac, 0xdd, 0x49, 0xa9, 0x13, 0x00, 0x00, 0x72, 0xf5
 };
 
+// Maximum number of devices tracked by the scans that don't allow duplicates
+constexpr size_t BLE_SCAN_DEDUP_TABLE_SIZE = 64;
+
 } //anonymous namespace
 
 
@@ -2234,6 +2238,58 @@ bool BleLocalDevice::advertising() const {
     return hal_ble_gap_is_advertising(nullptr);
 }
 
+/*
+ * Scan filter compiled into a form that can be matched against the raw advertising data received
+ * from the HAL, so that no scan result object is constructed for the devices that don't pass the filter.
+ */
+class BleScanFilterMatcher {
+public:
+    int compile(const BleScanFilter& filter) {
+        matcher_.clear();
+        for (const auto& address : filter.addresses()) {
+            const auto addr = address.halAddress();
+            CHECK_TRUE(matcher_.addAddress(addr.addr, addr.addr_type), SYSTEM_ERROR_NO_MEMORY);
+        }
+        for (const auto& name : filter.deviceNames()) {
+            CHECK_TRUE(matcher_.addName(name.c_str(), name.length()), SYSTEM_ERROR_NO_MEMORY);
+        }
+        for (const auto& uuid : filter.serviceUUIDs()) {
+            if (uuid.type() == BleUuidType::SHORT) {
+                CHECK_TRUE(matcher_.addServiceUuid16(uuid.shorted()), SYSTEM_ERROR_NO_MEMORY);
+            } else {
+                CHECK_TRUE(matcher_.addServiceUuid128(uuid.rawBytes()), SYSTEM_ERROR_NO_MEMORY);
+            }
+        }
+        for (const auto& appearance : filter.appearances()) {
+            CHECK_TRUE(matcher_.addAppearance(appearance), SYSTEM_ERROR_NO_MEMORY);
+        }
+        size_t customDataLen = 0;
+        const auto customData = filter.customData(&customDataLen);
+        matcher_.customData(customData, customDataLen);
+        if (filter.minRssi() != BLE_RSSI_INVALID) {
+            matcher_.minRssi(filter.minRssi());
+        }
+        if (filter.maxRssi() != BLE_RSSI_INVALID) {
+            matcher_.maxRssi(filter.maxRssi());
+        }
+        return SYSTEM_ERROR_NONE;
+    }
+
+    bool match(const hal_ble_scan_result_evt_t& event) const {
+        return matcher_.match(event.peer_addr.addr, event.peer_addr.addr_type, event.rssi, event.adv_data,
+                event.adv_data_len, event.sr_data, event.sr_data_len);
+    }
+
+private:
+    ScanFilterMatcher matcher_;
+};
+
+/*
+ * Scan results reported so far. Only used by the scans that don't allow duplicates. Every scan
+ * gets its own table, so the devices seen during a previous scan are reported again.
+ */
+typedef ScanDedupTable<BLE_SCAN_DEDUP_TABLE_SIZE> BleScanDedupTable;
+
 class BleScanDelegator {
 public:
     BleScanDelegator()
@@ -2241,13 +2297,15 @@ public:
               targetCount_(0),
               foundCount_(0),
               scanResultCallback_(nullptr),
-              scanResultCallbackRef_(nullptr) {
+              scanResultCallbackRef_(nullptr),
+              error_(SYSTEM_ERROR_NONE) {
         resultsVector_.clear();
     }
 
     ~BleScanDelegator() = default;
 
     int start(BleOnScanResultCallback callback, void* context) {
+        CHECK(error_);
         scanResultCallback_ = callback ? std::bind(callback, _1, context) : (std::function<void(const BleScanResult*)>)nullptr;
         scanResultCallbackRef_ = nullptr;
         CHECK(hal_ble_gap_start_scan(onScanResultCallback, this, nullptr));
@@ -2255,6 +2313,7 @@ public:
     }
 
     int start(BleOnScanResultCallbackRef callback, void* context) {
+        CHECK(error_);
         scanResultCallback_ = nullptr;
         scanResultCallbackRef_ = callback ? std::bind(callback, _1, context) : (BleOnScanResultStdFunction)nullptr;
         CHECK(hal_ble_gap_start_scan(onScanResultCallback, this, nullptr));
@@ -2262,6 +2321,7 @@ public:
     }
 
     int start(BleScanResult* results, size_t resultCount) {
+        CHECK(error_);
         scanResultCallback_ = nullptr;
         scanResultCallbackRef_ = nullptr;
         resultsPtr_ = results;
@@ -2271,6 +2331,9 @@ public:
     }
 
     Vector<BleScanResult> start() {
+        if (error_ != SYSTEM_ERROR_NONE) {
+            return Vector<BleScanResult>();
+        }
         scanResultCallback_ = nullptr;
         scanResultCallbackRef_ = nullptr;
         hal_ble_gap_start_scan(onScanResultCallback, this, nullptr);
@@ -2278,6 +2341,7 @@ public:
     }
 
     int start(const BleOnScanResultStdFunction& callback) {
+        CHECK(error_);
         scanResultCallback_ = nullptr;
         scanResultCallbackRef_ = callback;
         CHECK(hal_ble_gap_start_scan(onScanResultCallback, this, nullptr));
@@ -2285,7 +2349,19 @@ public:
     }
 
     BleScanDelegator& setScanFilter(const BleScanFilter& filter) {
-        filter_ = filter;
+        // Don't scan unfiltered if the filter can't be applied
+        error_ = matcher_.compile(filter);
+        if (error_ != SYSTEM_ERROR_NONE) {
+            LOG(ERROR, "Failed to compile scan filter: %d", error_);
+            return *this;
+        }
+        dedupTable_.reset();
+        if (!filter.allowDuplicates()) {
+            dedupTable_.reset(new(std::nothrow) BleScanDedupTable(filter.rssiChangeThreshold()));
+            if (!dedupTable_) {
+                error_ = SYSTEM_ERROR_NO_MEMORY;
+            }
+        }
         return *this;
     }
 
@@ -2298,20 +2374,23 @@ private:
      */
     static void onScanResultCallback(const hal_ble_scan_result_evt_t* event, void* context) {
         BleScanDelegator* delegator = static_cast<BleScanDelegator*>(context);
+        if (!delegator->matcher_.match(*event)) {
+            return;
+        }
+        if (delegator->dedupTable_) {
+            uint32_t hash = fnv1a_update(FNV1A_INIT, event->adv_data, event->adv_data_len);
+            hash = fnv1a_update(hash, event->sr_data, event->sr_data_len);
+            const auto ret = delegator->dedupTable_->update(event->peer_addr.addr, event->peer_addr.addr_type, event->rssi, hash);
+            if (ret == ScanDedupResult::UNCHANGED) {
+                return;
+            }
+        }
+
         BleScanResult result = {};
         result.address(event->peer_addr).rssi(event->rssi)
               .scanResponse(event->sr_data, event->sr_data_len)
               .advertisingData(event->adv_data, event->adv_data_len);
 
-        if (!delegator->filterByRssi(result) ||
-              !delegator->filterByAddress(result) ||
-              !delegator->filterByDeviceName(result) ||
-              !delegator->filterByServiceUUID(result) ||
-              !delegator->filterByAppearance(result) ||
-              !delegator->filterByCustomData(result)) {
-            return;
-        }
-
         if (delegator->scanResultCallback_) {
             delegator->foundCount_++;
             delegator->scanResultCallback_(&result);
@@ -2335,152 +2414,15 @@ private:
         delegator->resultsVector_.append(result);
     }
 
-    bool filterByRssi(const BleScanResult& result) {
-        int8_t filterRssi = filter_.minRssi();
-        if (filterRssi != BLE_RSSI_INVALID && result.rssi() < filterRssi) {
-            LOG_DEBUG(TRACE, "Exceed min. RSSI");
-            return false;
-        }
-        filterRssi = filter_.maxRssi();
-        if (filterRssi != BLE_RSSI_INVALID && result.rssi() > filterRssi) {
-            LOG_DEBUG(TRACE, "Exceed max. RSSI.");
-            return false;
-        }
-        return true;
-    }
-
-    bool filterByAddress(const BleScanResult& result) {
-        auto filerAddresses = filter_.addresses();
-        if (filerAddresses.size() > 0) {
-            for (const auto& address : filerAddresses) {
-                if (address == result.address()) {
-                    return true;
-                }
-            }
-            LOG_DEBUG(TRACE, "Address mismatched.");
-            return false;
-        }
-        return true;
-    }
-
-    bool filterByDeviceName(const BleScanResult& result) {
-        auto filterDeviceNames = filter_.deviceNames();
-        if (filterDeviceNames.size() > 0) {
-            String srName = result.scanResponse().deviceName();
-            String advName = result.advertisingData().deviceName();
-            if (srName.length() == 0 && advName.length() == 0) {
-                LOG_DEBUG(TRACE, "Device name mismatched.");
-                return false;
-            }
-            for (const auto& name : filterDeviceNames) {
-                if (name == srName || name == advName) {
-                    return true;
-                }
-            }
-            LOG_DEBUG(TRACE, "Device name mismatched.");
-            return false;
-        }
-        return true;
-    }
-
-    bool filterByServiceUUID(const BleScanResult& result) {
-        auto filterServiceUuids = filter_.serviceUUIDs();
-        if (filterServiceUuids.size() > 0) {
-            const Vector<BleUuid>& srUuids = result.scanResponse().serviceUUID();
-            const Vector<BleUuid>& advUuids = result.advertisingData().serviceUUID();
-            if (srUuids.size() <= 0 && advUuids.size() <= 0) {
-                LOG_DEBUG(TRACE, "Service UUID mismatched.");
-                return false;
-            }
-            for (const auto& uuid : filterServiceUuids) {
-                for (const auto& found : srUuids) {
-                    if (uuid == found) {
-                        return true;
-                    }
-                }
-                for (const auto& found : advUuids) {
-                    if (uuid == found) {
-                        return true;
-                    }
-                }
-            }
-            LOG_DEBUG(TRACE, "Service UUID mismatched.");
-            return false;
-        }
-        return true;
-    }
-
-    bool filterByAppearance(const BleScanResult& result) {
-        auto filterAppearances = filter_.appearances();
-        if (filterAppearances.size() > 0) {
-            ble_sig_appearance_t srAppearance = result.scanResponse().appearance();
-            ble_sig_appearance_t advAppearance = result.advertisingData().appearance();
-            for (const auto& appearance : filterAppearances) {
-                if (appearance == srAppearance || appearance == advAppearance) {
-                    return true;
-                }
-            }
-            LOG_DEBUG(TRACE, "Appearance mismatched.");
-            return false;
-        }
-        return true;
-    }
-
-    bool filterByCustomData(const BleScanResult& result) {
-        size_t filterCustomDatalen;
-        const uint8_t* filterCustomData = filter_.customData(&filterCustomDatalen);
-        if (filterCustomData != nullptr && filterCustomDatalen > 0) {
-            size_t srLen = result.scanResponse().get(BleAdvertisingDataType::MANUFACTURER_SPECIFIC_DATA, nullptr, sizeof(size_t));
-            size_t advLen = result.advertisingData().get(BleAdvertisingDataType::MANUFACTURER_SPECIFIC_DATA, nullptr, sizeof(size_t));
-            if (srLen != filterCustomDatalen && advLen != filterCustomDatalen) {
-                LOG_DEBUG(TRACE, "Custom data mismatched.");
-                return false;
-            }
-            if (srLen == filterCustomDatalen) {
-                uint8_t* buf = (uint8_t*)malloc(srLen);
-                SCOPE_GUARD({
-                    if (buf) {
-                        free(buf);
-                    }
-                });
-                if (!buf) {
-                    LOG(ERROR, "Failed to allocate memory!");
-                    return false;
-                }
-                result.scanResponse().get(BleAdvertisingDataType::MANUFACTURER_SPECIFIC_DATA, buf, srLen);
-                if (!memcmp(buf, filterCustomData, srLen)) {
-                    return true;
-                }
-            }
-            if (advLen == filterCustomDatalen) {
-                uint8_t* buf = (uint8_t*)malloc(advLen);
-                SCOPE_GUARD({
-                    if (buf) {
-                        free(buf);
-                    }
-                });
-                if (!buf) {
-                    LOG(ERROR, "Failed to allocate memory!");
-                    return false;
-                }
-                result.advertisingData().get(BleAdvertisingDataType::MANUFACTURER_SPECIFIC_DATA, buf, advLen);
-                if (!memcmp(buf, filterCustomData, advLen)) {
-                    return true;
-                }
-            }
-            LOG_DEBUG(TRACE, "Custom data mismatched.");
-            return false;
-        }
-        return true;
-    }
-
     Vector<BleScanResult> resultsVector_;
     BleScanResult* resultsPtr_;
     size_t targetCount_;
     size_t foundCount_;
     std::function<void(const BleScanResult*)> scanResultCallback_;
     BleOnScanResultStdFunction scanResultCallbackRef_;
-    BleScanFilter filter_;
+    BleScanFilterMatcher matcher_;
+    std::unique_ptr<BleScanDedupTable> dedupTable_;
+    int error_;
 };
 
 int BleLocalDevice::setScanTimeout(uint16_t timeout) const {
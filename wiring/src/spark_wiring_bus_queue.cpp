@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_bus_queue.h"
+
+#include "spark_wiring_ticks.h"
+#include "spark_wiring.h"
+#include "system_error.h"
+#include "check.h"
+#include "debug.h"
+
+namespace particle {
+
+namespace {
+
+#if PLATFORM_THREADING
+
+// DMA completion callbacks don't take a context argument, so there's a callback and a semaphore
+// per SPI interface
+os_semaphore_t g_spiDmaSem[3] = {};
+
+template<int N>
+void spiDmaDone() {
+    os_semaphore_give(g_spiDmaSem[N], false);
+}
+
+const wiring_spi_dma_transfercomplete_callback_t SPI_DMA_CALLBACKS[] = {
+    spiDmaDone<0>,
+    spiDmaDone<1>,
+    spiDmaDone<2>
+};
+
+static_assert(sizeof(SPI_DMA_CALLBACKS) / sizeof(SPI_DMA_CALLBACKS[0]) == sizeof(g_spiDmaSem) / sizeof(g_spiDmaSem[0]),
+        "Invalid number of DMA callbacks");
+
+#endif // PLATFORM_THREADING
+
+} // namespace
+
+SpiBusDriver::SpiBusDriver(SPIClass& spi) :
+        spi_(spi),
+        selected_(false) {
+#if PLATFORM_THREADING
+    const unsigned i = spi_.interface();
+    if (i < sizeof(g_spiDmaSem) / sizeof(g_spiDmaSem[0]) && !g_spiDmaSem[i]) {
+        os_semaphore_create(&g_spiDmaSem[i], 1 /* max_count */, 0 /* initial_count */);
+        SPARK_ASSERT(g_spiDmaSem[i]);
+    }
+#endif
+}
+
+int SpiBusDriver::begin(const BusTransaction& t) {
+    CHECK_TRUE(spi_.isEnabled(), SYSTEM_ERROR_INVALID_STATE);
+    if (t.settings) {
+        CHECK(spi_.beginTransaction(*static_cast<const SPISettings*>(t.settings)));
+    } else {
+        CHECK(spi_.beginTransaction());
+    }
+    selected_ = false;
+    return 0;
+}
+
+int SpiBusDriver::step(const BusTransaction& t, const BusStep& step) {
+    switch (step.type) {
+    case BusStep::SELECT:
+        digitalWrite(t.address, LOW);
+        selected_ = true;
+        return 0;
+    case BusStep::DESELECT:
+        digitalWrite(t.address, HIGH);
+        selected_ = false;
+        return 0;
+    case BusStep::WRITE:
+        return transfer(step.tx, nullptr, step.size);
+    case BusStep::READ:
+        return transfer(nullptr, step.rx, step.size);
+    case BusStep::TRANSFER:
+        return transfer(step.tx, step.rx, step.size);
+    case BusStep::DELAY:
+        delay(step.size);
+        return 0;
+    default:
+        return SYSTEM_ERROR_NOT_SUPPORTED;
+    }
+}
+
+void SpiBusDriver::end(const BusTransaction& t) {
+    // Make sure the device is not left selected if one of the steps has failed
+    if (selected_) {
+        digitalWrite(t.address, HIGH);
+        selected_ = false;
+    }
+    spi_.endTransaction();
+}
+
+int SpiBusDriver::transfer(const uint8_t* tx, uint8_t* rx, size_t size) {
+    if (!size) {
+        return 0;
+    }
+#if PLATFORM_THREADING
+    const unsigned i = spi_.interface();
+    if (i < sizeof(g_spiDmaSem) / sizeof(g_spiDmaSem[0])) {
+        // Let other threads run while the transfer is in progress
+        spi_.transfer(tx, rx, size, SPI_DMA_CALLBACKS[i]);
+        os_semaphore_take(g_spiDmaSem[i], CONCURRENT_WAIT_FOREVER, false);
+        return 0;
+    }
+#endif
+    spi_.transfer(tx, rx, size, nullptr);
+    return 0;
+}
+
+I2cBusDriver::I2cBusDriver(TwoWire& wire) :
+        wire_(wire) {
+}
+
+int I2cBusDriver::begin(const BusTransaction& t) {
+    CHECK_TRUE(wire_.isEnabled(), SYSTEM_ERROR_INVALID_STATE);
+    wire_.lock();
+    return 0;
+}
+
+int I2cBusDriver::step(const BusTransaction& t, const BusStep& step) {
+    const bool stop = !(step.flags & BusStep::NO_STOP);
+    switch (step.type) {
+    case BusStep::WRITE: {
+        wire_.beginTransmission(WireTransmission(t.address));
+        const size_t n = wire_.write(step.tx, step.size);
+        const uint8_t r = wire_.endTransmission(stop);
+        CHECK_TRUE(n == step.size && r == 0, SYSTEM_ERROR_IO);
+        return 0;
+    }
+    case BusStep::READ: {
+        const size_t n = wire_.requestFrom(WireTransmission(t.address).quantity(step.size).stop(stop));
+        CHECK_TRUE(n == step.size, SYSTEM_ERROR_IO);
+        for (size_t i = 0; i < n; ++i) {
+            step.rx[i] = wire_.read();
+        }
+        return 0;
+    }
+    case BusStep::DELAY:
+        delay(step.size);
+        return 0;
+    default:
+        return SYSTEM_ERROR_NOT_SUPPORTED;
+    }
+}
+
+void I2cBusDriver::end(const BusTransaction& t) {
+    wire_.unlock();
+}
+
+#if PLATFORM_THREADING
+
+ThreadedBusTransactionQueue::ThreadedBusTransactionQueue(BusDriver* driver, const char* name, os_thread_prio_t priority,
+        size_t stackSize) :
+        BusTransactionQueue(driver),
+        thread_(nullptr),
+        sem_(nullptr),
+        exit_(false) {
+    os_semaphore_create(&sem_, 1 /* max_count */, 0 /* initial_count */);
+    SPARK_ASSERT(sem_);
+    os_thread_create(&thread_, name, priority, run, this, stackSize);
+    SPARK_ASSERT(thread_);
+}
+
+ThreadedBusTransactionQueue::~ThreadedBusTransactionQueue() {
+    exit_ = true;
+    os_semaphore_give(sem_, false);
+    os_thread_join(thread_);
+    os_thread_cleanup(thread_);
+    os_semaphore_destroy(sem_);
+}
+
+void ThreadedBusTransactionQueue::notify() {
+    os_semaphore_give(sem_, false);
+}
+
+os_thread_return_t ThreadedBusTransactionQueue::run(void* data) {
+    const auto self = static_cast<ThreadedBusTransactionQueue*>(data);
+    for (;;) {
+        os_semaphore_take(self->sem_, CONCURRENT_WAIT_FOREVER, false);
+        if (self->exit_) {
+            break;
+        }
+        self->process();
+    }
+    os_thread_exit(nullptr);
+}
+
+#endif // PLATFORM_THREADING
+
+} // namespace particle
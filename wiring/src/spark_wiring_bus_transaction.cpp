@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_bus_transaction.h"
+
+#include "spark_wiring_interrupts.h"
+#include "system_error.h"
+#include "check.h"
+
+namespace particle {
+
+BusTransactionQueue::BusTransactionQueue(BusDriver* driver) :
+        driver_(driver),
+        head_(nullptr),
+        count_(0),
+        processing_(false) {
+}
+
+int BusTransactionQueue::submit(BusTransaction* t) {
+    return submit(t, nullptr /* promiseData */);
+}
+
+int BusTransactionQueue::submit(BusTransaction* t, void* promiseData) {
+    CHECK_TRUE(t && (t->steps || !t->stepCount), SYSTEM_ERROR_INVALID_ARGUMENT);
+    bool idle = false;
+    ATOMIC_BLOCK() {
+        if (t->state == BusTransaction::QUEUED || t->state == BusTransaction::RUNNING) {
+            return SYSTEM_ERROR_BUSY;
+        }
+        // Keep the queue sorted by priority; transactions with equal priority are executed in FIFO order
+        BusTransaction** p = &head_;
+        while (*p && (*p)->priority >= t->priority) {
+            p = &(*p)->next;
+        }
+        t->next = *p;
+        *p = t;
+        t->state = BusTransaction::QUEUED;
+        t->result = 0;
+        t->promiseData = promiseData;
+        ++count_;
+        idle = !processing_;
+    }
+    if (idle) {
+        notify();
+    }
+    return 0;
+}
+
+Future<void> BusTransactionQueue::submitAsync(BusTransaction* t) {
+    Promise<void> p;
+    const auto data = p.dataPtr();
+    const int r = submit(t, data);
+    if (r < 0) {
+        // Release the promise's data
+        Promise<void>::fromDataPtr(data);
+        return Future<void>((Error::Type)r);
+    }
+    return p.future();
+}
+
+int BusTransactionQueue::cancel(BusTransaction* t) {
+    CHECK_TRUE(t, SYSTEM_ERROR_INVALID_ARGUMENT);
+    bool found = false;
+    ATOMIC_BLOCK() {
+        if (t->state == BusTransaction::RUNNING) {
+            return SYSTEM_ERROR_BUSY;
+        }
+        BusTransaction** p = &head_;
+        while (*p && *p != t) {
+            p = &(*p)->next;
+        }
+        if (*p) {
+            *p = t->next;
+            t->next = nullptr;
+            --count_;
+            found = true;
+        }
+    }
+    CHECK_TRUE(found, SYSTEM_ERROR_NOT_FOUND);
+    complete(t, SYSTEM_ERROR_CANCELLED);
+    return 0;
+}
+
+void BusTransactionQueue::process() {
+    ATOMIC_BLOCK() {
+        if (processing_) {
+            return; // The queue is being processed by another thread
+        }
+        processing_ = true;
+    }
+    for (;;) {
+        BusTransaction* t = nullptr;
+        ATOMIC_BLOCK() {
+            t = head_;
+            if (t) {
+                head_ = t->next;
+                t->next = nullptr;
+                t->state = BusTransaction::RUNNING;
+                --count_;
+            } else {
+                processing_ = false;
+            }
+        }
+        if (!t) {
+            break;
+        }
+        const int r = execute(*t);
+        complete(t, r);
+    }
+}
+
+int BusTransactionQueue::execute(const BusTransaction& t) {
+    CHECK(driver_->begin(t));
+    int r = 0;
+    for (size_t i = 0; i < t.stepCount; ++i) {
+        r = driver_->step(t, t.steps[i]);
+        if (r < 0) {
+            break;
+        }
+    }
+    driver_->end(t);
+    return (r < 0) ? r : 0;
+}
+
+void BusTransactionQueue::complete(BusTransaction* t, int result) {
+    // The transaction may be resubmitted or destroyed as soon as it's marked as done
+    const auto callback = t->callback;
+    const auto data = t->callbackData;
+    const auto promiseData = t->promiseData;
+    t->promiseData = nullptr;
+    // Publish the result before the state, so that a caller polling the state never sees a stale result
+    t->result = result;
+    ATOMIC_BLOCK() {
+        t->state = BusTransaction::DONE;
+    }
+    if (callback) {
+        callback(result, nullptr, data, nullptr);
+    }
+    if (promiseData) {
+        Promise<void>::defaultCallback(result, nullptr, promiseData, nullptr);
+    }
+}
+
+} // namespace particle
@@ -94,6 +94,10 @@ int CloudClass::publishVitals(system_tick_t period_s_) {
     return spark_publish_vitals(period_s_, nullptr);
 }
 
+int CloudClass::vitalsHistory(system_tick_t period_s, size_t depth) {
+    return spark_vitals_history(period_s, depth, nullptr);
+}
+
 void CloudClass::disconnect(const CloudDisconnectOptions& options) {
     const auto opts = options.toSystemOptions();
     spark_cloud_disconnect(&opts, nullptr /* reserved */);
@@ -17,6 +17,8 @@
 
 #include "spark_wiring_json.h"
 
+#include "system_error.h"
+
 #include <algorithm>
 
 #include <cstdio>
@@ -404,6 +406,479 @@ bool spark::JSONArrayIterator::next() {
     return true;
 }
 
+// spark::JSONStreamReader
+const unsigned spark::JSONStreamReader::MAX_DEPTH;
+
+spark::JSONStreamReader::JSONStreamReader(char *buf, size_t size) :
+        buf_(buf),
+        bufSize_(size) {
+    reset();
+}
+
+int spark::JSONStreamReader::parse(const char *data, size_t size, JSONReaderHandler *handler) {
+    if (state_ == ERROR) {
+        return error_;
+    }
+    size_t i = 0;
+    while (i < size && state_ != DONE) {
+        const int ret = processChar(data[i], handler);
+        if (ret < 0) {
+            return ret;
+        }
+        ++i;
+    }
+    return i;
+}
+
+int spark::JSONStreamReader::parse(Stream &stream, JSONReaderHandler *handler) {
+    // Data is read byte by byte so that nothing is consumed past the end of the top-level value
+    size_t n = 0;
+    while (state_ != DONE && stream.available() > 0) {
+        const char c = stream.read();
+        const int ret = parse(&c, 1, handler);
+        if (ret < 0) {
+            return ret;
+        }
+        ++n;
+    }
+    return n;
+}
+
+int spark::JSONStreamReader::finish(JSONReaderHandler *handler) {
+    if (state_ == ERROR) {
+        return error_;
+    }
+    if (token_ == NUMBER || token_ == LITERAL) {
+        const int ret = endToken(handler);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    if (state_ != DONE) {
+        return fail(SYSTEM_ERROR_BAD_DATA); // Unexpected end of data
+    }
+    return 0;
+}
+
+void spark::JSONStreamReader::reset() {
+    n_ = 0;
+    objects_ = 0;
+    depth_ = 0;
+    state_ = VALUE;
+    token_ = NONE;
+    escape_ = 0;
+    escapeStart_ = 0;
+    error_ = 0;
+}
+
+int spark::JSONStreamReader::processChar(char c, JSONReaderHandler *handler) {
+    switch (token_) {
+    case STRING:
+    case NAME_STRING:
+        return processStringChar(c, handler);
+    case NUMBER:
+        if ((c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+' || c == 'e' || c == 'E') {
+            return append(c) ? 0 : fail(SYSTEM_ERROR_TOO_LARGE);
+        }
+        break;
+    case LITERAL:
+        if (c >= 'a' && c <= 'z') {
+            return append(c) ? 0 : fail(SYSTEM_ERROR_TOO_LARGE);
+        }
+        break;
+    default:
+        break;
+    }
+    if (token_ != NONE) {
+        // The character terminates a primitive value and needs to be processed separately
+        const int ret = endToken(handler);
+        if (ret < 0) {
+            return ret;
+        }
+        if (state_ == DONE) {
+            return 0;
+        }
+    }
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+        return 0;
+    }
+    switch (state_) {
+    case VALUE:
+    case VALUE_OR_END: {
+        if (c == '{') {
+            return beginCompound(true /* object */, handler);
+        } else if (c == '[') {
+            return beginCompound(false /* object */, handler);
+        } else if (c == '"') {
+            token_ = STRING;
+            return 0;
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            token_ = NUMBER;
+            append(c);
+            return 0;
+        } else if (c >= 'a' && c <= 'z') {
+            token_ = LITERAL;
+            append(c);
+            return 0;
+        } else if (c == ']' && state_ == VALUE_OR_END) {
+            return endCompound(false /* object */, handler);
+        }
+        break;
+    }
+    case NAME:
+    case NAME_OR_END: {
+        if (c == '"') {
+            token_ = NAME_STRING;
+            return 0;
+        } else if (c == '}' && state_ == NAME_OR_END) {
+            return endCompound(true /* object */, handler);
+        }
+        break;
+    }
+    case COLON: {
+        if (c == ':') {
+            state_ = VALUE;
+            return 0;
+        }
+        break;
+    }
+    case COMMA_OR_END: {
+        const bool object = objects_ & (1u << (depth_ - 1));
+        if (c == ',') {
+            state_ = object ? NAME : VALUE;
+            return 0;
+        } else if (c == (object ? '}' : ']')) {
+            return endCompound(object, handler);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return fail(SYSTEM_ERROR_BAD_DATA); // Unexpected character
+}
+
+int spark::JSONStreamReader::processStringChar(char c, JSONReaderHandler *handler) {
+    if (escape_ == 0) {
+        if (c == '"') {
+            return endToken(handler);
+        }
+        if (c == '\\') {
+            escape_ = -1;
+            return 0;
+        }
+    } else if (escape_ < 0) {
+        switch (c) {
+        case '"':
+        case '\\':
+        case '/':
+            break;
+        case 'b': // Backspace
+            c = 0x08;
+            break;
+        case 't': // Tab
+            c = 0x09;
+            break;
+        case 'n': // Line feed
+            c = 0x0a;
+            break;
+        case 'f': // Form feed
+            c = 0x0c;
+            break;
+        case 'r': // Carriage return
+            c = 0x0d;
+            break;
+        case 'u': { // Arbitrary character, e.g. "\u001f"
+            // Keep the escaped sequence in the buffer until it's complete
+            escapeStart_ = n_;
+            escape_ = 4;
+            if (!append('\\') || !append('u')) {
+                return fail(SYSTEM_ERROR_TOO_LARGE);
+            }
+            return 0;
+        }
+        default:
+            return fail(SYSTEM_ERROR_BAD_DATA); // Invalid escaped sequence
+        }
+        escape_ = 0;
+    } else {
+        if (!isxdigit((unsigned char)c)) {
+            return fail(SYSTEM_ERROR_BAD_DATA); // Invalid escaped sequence
+        }
+        if (!append(c)) {
+            return fail(SYSTEM_ERROR_TOO_LARGE);
+        }
+        if (--escape_ == 0) {
+            uint32_t u = 0;
+            hexToInt(buf_ + escapeStart_ + 2, 4, &u);
+            if (u <= 0x7f) {
+                // Processing only code points within the basic latin block, other sequences are
+                // left escaped
+                n_ = escapeStart_;
+                append(u);
+            }
+        }
+        return 0;
+    }
+    return append(c) ? 0 : fail(SYSTEM_ERROR_TOO_LARGE);
+}
+
+int spark::JSONStreamReader::endToken(JSONReaderHandler *handler) {
+    const Token token = token_;
+    token_ = NONE;
+    switch (token) {
+    case NAME_STRING: {
+        state_ = COLON;
+        return emit(JSON_EVENT_NAME, handler);
+    }
+    case STRING: {
+        valueParsed();
+        return emit(JSON_EVENT_STRING, handler);
+    }
+    case NUMBER: {
+        valueParsed();
+        return emit(JSON_EVENT_NUMBER, handler);
+    }
+    case LITERAL: {
+        buf_[n_] = '\0';
+        JSONEvent event = JSON_EVENT_NULL;
+        if (strcmp(buf_, "true") == 0 || strcmp(buf_, "false") == 0) {
+            event = JSON_EVENT_BOOL;
+        } else if (strcmp(buf_, "null") != 0) {
+            return fail(SYSTEM_ERROR_BAD_DATA); // Unknown literal name
+        }
+        valueParsed();
+        return emit(event, handler);
+    }
+    default:
+        return 0;
+    }
+}
+
+int spark::JSONStreamReader::beginCompound(bool object, JSONReaderHandler *handler) {
+    if (depth_ == MAX_DEPTH) {
+        return fail(SYSTEM_ERROR_LIMIT_EXCEEDED);
+    }
+    if (object) {
+        objects_ |= (1u << depth_);
+    } else {
+        objects_ &= ~(1u << depth_);
+    }
+    ++depth_;
+    state_ = object ? NAME_OR_END : VALUE_OR_END;
+    return emit(object ? JSON_EVENT_BEGIN_OBJECT : JSON_EVENT_BEGIN_ARRAY, handler);
+}
+
+int spark::JSONStreamReader::endCompound(bool object, JSONReaderHandler *handler) {
+    --depth_;
+    valueParsed();
+    return emit(object ? JSON_EVENT_END_OBJECT : JSON_EVENT_END_ARRAY, handler);
+}
+
+int spark::JSONStreamReader::emit(JSONEvent event, JSONReaderHandler *handler) {
+    buf_[n_] = '\0';
+    const size_t n = n_;
+    n_ = 0;
+    if (handler && !handler->onEvent(event, buf_, n)) {
+        return fail(SYSTEM_ERROR_CANCELLED);
+    }
+    return 0;
+}
+
+bool spark::JSONStreamReader::append(char c) {
+    if (n_ + 1 >= bufSize_) { // Reserve space for the term. null character
+        return false;
+    }
+    buf_[n_++] = c;
+    return true;
+}
+
+int spark::JSONStreamReader::fail(int error) {
+    state_ = ERROR;
+    error_ = error;
+    return error;
+}
+
+void spark::JSONStreamReader::valueParsed() {
+    state_ = (depth_ > 0) ? COMMA_OR_END : DONE;
+}
+
+// spark::JSONQueryResult
+bool spark::JSONQueryResult::toBool() const {
+    const char* const s = data();
+    switch (type_) {
+    case JSON_TYPE_BOOL:
+        return *s == 't';
+    case JSON_TYPE_NUMBER:
+        return strcmp(s, "0") != 0 && strcmp(s, "0.0") != 0;
+    case JSON_TYPE_STRING:
+        return *s != '\0' && strcmp(s, "false") != 0 && strcmp(s, "0") != 0 && strcmp(s, "0.0") != 0;
+    default:
+        return false;
+    }
+}
+
+int spark::JSONQueryResult::toInt() const {
+    switch (type_) {
+    case JSON_TYPE_BOOL:
+        return *data() == 't';
+    case JSON_TYPE_NUMBER:
+    case JSON_TYPE_STRING:
+        return strtol(data(), nullptr, 10);
+    default:
+        return 0;
+    }
+}
+
+double spark::JSONQueryResult::toDouble() const {
+    switch (type_) {
+    case JSON_TYPE_BOOL:
+        return *data() == 't';
+    case JSON_TYPE_NUMBER:
+    case JSON_TYPE_STRING:
+        return strtod(data(), nullptr);
+    default:
+        return 0.0;
+    }
+}
+
+// spark::JSONPathQuery
+const unsigned spark::JSONPathQuery::MAX_DEPTH;
+
+spark::JSONPathQuery::JSONPathQuery(const char* const *paths, size_t count) :
+        paths_(paths),
+        results_(new(std::nothrow) JSONQueryResult[count]),
+        count_(results_ ? count : 0) {
+    reset();
+}
+
+spark::JSONPathQuery::~JSONPathQuery() {
+    delete[] results_;
+}
+
+void spark::JSONPathQuery::reset() {
+    for (size_t i = 0; i < count_; ++i) {
+        results_[i] = JSONQueryResult();
+    }
+    found_ = 0;
+    depth_ = 0;
+    skipDepth_ = 0;
+}
+
+bool spark::JSONPathQuery::onEvent(JSONEvent event, const char *data, size_t size) {
+    if (event == JSON_EVENT_END_OBJECT || event == JSON_EVENT_END_ARRAY) {
+        if (skipDepth_ > 0) {
+            --skipDepth_;
+        } else {
+            --depth_;
+        }
+        return true;
+    }
+    if (skipDepth_ > 0) {
+        // Values nested deeper than the maximum supported depth can't match any of the paths
+        if (event == JSON_EVENT_BEGIN_OBJECT || event == JSON_EVENT_BEGIN_ARRAY) {
+            ++skipDepth_;
+        }
+        return true;
+    }
+    if (event == JSON_EVENT_NAME) {
+        Level& l = levels_[depth_ - 1];
+        l.nameValid = (l.nameOffs + size <= sizeof(names_));
+        l.nameSize = l.nameValid ? size : 0;
+        memcpy(names_ + l.nameOffs, data, l.nameSize);
+        return true;
+    }
+    if (depth_ > 0 && levels_[depth_ - 1].array) {
+        ++levels_[depth_ - 1].index;
+    }
+    switch (event) {
+    case JSON_EVENT_BEGIN_OBJECT:
+    case JSON_EVENT_BEGIN_ARRAY: {
+        capture((event == JSON_EVENT_BEGIN_OBJECT) ? JSON_TYPE_OBJECT : JSON_TYPE_ARRAY, nullptr, 0);
+        if (depth_ == MAX_DEPTH) {
+            skipDepth_ = 1;
+            break;
+        }
+        Level& l = levels_[depth_];
+        l.index = -1;
+        // Names of the nested objects are stored in the buffer one after another
+        l.nameOffs = (depth_ > 0) ? levels_[depth_ - 1].nameOffs + levels_[depth_ - 1].nameSize : 0;
+        l.nameSize = 0;
+        l.nameValid = false;
+        l.array = (event == JSON_EVENT_BEGIN_ARRAY);
+        ++depth_;
+        break;
+    }
+    case JSON_EVENT_STRING:
+        capture(JSON_TYPE_STRING, data, size);
+        break;
+    case JSON_EVENT_NUMBER:
+        capture(JSON_TYPE_NUMBER, data, size);
+        break;
+    case JSON_EVENT_BOOL:
+        capture(JSON_TYPE_BOOL, data, size);
+        break;
+    case JSON_EVENT_NULL:
+        capture(JSON_TYPE_NULL, data, size);
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+void spark::JSONPathQuery::capture(JSONType type, const char *data, size_t size) {
+    for (size_t i = 0; i < count_; ++i) {
+        if (results_[i].type_ == JSON_TYPE_INVALID && matchPath(paths_[i])) {
+            JSONQueryResult& r = results_[i];
+            if (data) {
+                r.s_.reset(new(std::nothrow) char[size + 1]);
+                if (!r.s_) {
+                    continue;
+                }
+                memcpy(r.s_.get(), data, size + 1); // Including the term. null character
+                r.size_ = size;
+            }
+            r.type_ = type;
+            ++found_;
+        }
+    }
+}
+
+bool spark::JSONPathQuery::matchPath(const char *path) const {
+    const char *p = path;
+    for (unsigned i = 0; i < depth_; ++i) {
+        const Level& l = levels_[i];
+        if (l.array) {
+            if (*p != '[') {
+                return false;
+            }
+            char *end = nullptr;
+            const long index = strtol(p + 1, &end, 10);
+            if (end == p + 1 || *end != ']' || index != l.index) {
+                return false;
+            }
+            p = end + 1;
+        } else {
+            if (p != path) {
+                if (*p != '.') {
+                    return false;
+                }
+                ++p;
+            }
+            if (!l.nameValid) {
+                return false;
+            }
+            const size_t n = strcspn(p, ".[");
+            if (n != l.nameSize || memcmp(p, names_ + l.nameOffs, n) != 0) {
+                return false;
+            }
+            p += n;
+        }
+    }
+    return *p == '\0';
+}
+
 // spark::JSONWriter
 spark::JSONWriter& spark::JSONWriter::beginArray() {
     writeSeparator();
@@ -27,6 +27,12 @@
 #include <math.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <wchar.h>
+#include <algorithm>
+#include <memory>
+#include <new>
 #include "spark_wiring_print.h"
 #include "spark_wiring_string.h"
 #include "spark_wiring_stream.h"
@@ -211,28 +217,290 @@ size_t Print::printFloat(double number, uint8_t digits)
   return n;
 }
 
-size_t Print::vprintf(bool newline, const char* format, va_list args)
-{
-    const int bufsize = 20;
-    char test[bufsize];
-    va_list args2;
-    va_copy(args2, args);
-    size_t n = vsnprintf(test, bufsize, format, args);
-
-    if (n<bufsize)
-    {
-        n = print(test);
+namespace {
+
+// Size of the buffer used to collect formatted output before passing it to the sink
+const size_t PRINTF_CHUNK_SIZE = 64;
+// Size of the buffer used to format a single conversion specification
+const size_t PRINTF_CONV_BUFFER_SIZE = 32;
+
+// Formats a string in a single pass and writes the output to a Print sink in chunks
+class PrintfFormatter {
+public:
+    explicit PrintfFormatter(Print* p) :
+            p_(p),
+            size_(0),
+            count_(0),
+            written_(0) {
+    }
+
+    ~PrintfFormatter() {
+        flush();
+    }
+
+    size_t format(const char* fmt, va_list args) {
+        va_list ap;
+        va_copy(ap, args);
+        for (;;) {
+            const char* lit = fmt;
+            while (*fmt && *fmt != '%') {
+                ++fmt;
+            }
+            append(lit, fmt - lit);
+            if (!*fmt) {
+                break;
+            }
+            fmt = formatSpec(fmt, ap);
+        }
+        va_end(ap);
+        flush();
+        return written_;
+    }
+
+private:
+    Print* p_;
+    char buf_[PRINTF_CHUNK_SIZE];
+    size_t size_; // Number of bytes in the chunk buffer
+    size_t count_; // Total number of formatted characters
+    size_t written_; // Number of bytes written to the sink
+
+    // Parses and formats a single conversion specification. Returns a pointer to the character that
+    // follows the specification in the format string
+    const char* formatSpec(const char* fmt, va_list& ap) {
+        const char* const start = fmt++; // Skip '%'
+        // Rebuild the specification with the width and precision arguments resolved
+        char spec[48];
+        size_t specLen = 0;
+        spec[specLen++] = '%';
+        bool leftAlign = false;
+        while (*fmt && strchr("-+ #0", *fmt)) {
+            if (*fmt == '-') {
+                leftAlign = true;
+            }
+            if (specLen < 8) {
+                spec[specLen++] = *fmt;
+            }
+            ++fmt;
+        }
+        int width = -1;
+        if (*fmt == '*') {
+            width = va_arg(ap, int);
+            if (width < 0) {
+                width = -width;
+                leftAlign = true;
+                spec[specLen++] = '-';
+            }
+            ++fmt;
+        } else if (isdigit((unsigned char)*fmt)) {
+            width = strtol(fmt, (char**)&fmt, 10);
+        }
+        int prec = -1;
+        if (*fmt == '.') {
+            ++fmt;
+            if (*fmt == '*') {
+                prec = va_arg(ap, int); // Negative precision is ignored
+                ++fmt;
+            } else {
+                prec = strtol(fmt, (char**)&fmt, 10);
+            }
+        }
+        if (width >= 0) {
+            specLen += snprintf(spec + specLen, sizeof(spec) - specLen, "%d", width);
+        }
+        if (prec >= 0) {
+            specLen += snprintf(spec + specLen, sizeof(spec) - specLen, ".%d", prec);
+        }
+        const char* const lenMod = fmt;
+        while (*fmt && strchr("hljztL", *fmt)) {
+            ++fmt;
+        }
+        const size_t lenModLen = fmt - lenMod;
+        if (lenModLen > 2 || !*fmt) {
+            // Unsupported specification, print it as is
+            append(start, fmt - start);
+            return fmt;
+        }
+        const char conv = *fmt++;
+        memcpy(spec + specLen, lenMod, lenModLen);
+        specLen += lenModLen;
+        spec[specLen++] = conv;
+        spec[specLen] = '\0';
+        const char mod = lenModLen ? lenMod[0] : '\0';
+        const bool dbl = (lenModLen == 2); // "hh" or "ll"
+        switch (conv) {
+        case '%': {
+            append("%", 1);
+            break;
+        }
+        case 'd':
+        case 'i': {
+            if (mod == 'l') {
+                dbl ? formatValue(spec, va_arg(ap, long long)) : formatValue(spec, va_arg(ap, long));
+            } else if (mod == 'j') {
+                formatValue(spec, va_arg(ap, intmax_t));
+            } else if (mod == 'z') {
+                formatValue(spec, va_arg(ap, std::make_signed<size_t>::type));
+            } else if (mod == 't') {
+                formatValue(spec, va_arg(ap, ptrdiff_t));
+            } else {
+                formatValue(spec, va_arg(ap, int));
+            }
+            break;
+        }
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X': {
+            if (mod == 'l') {
+                dbl ? formatValue(spec, va_arg(ap, unsigned long long)) : formatValue(spec, va_arg(ap, unsigned long));
+            } else if (mod == 'j') {
+                formatValue(spec, va_arg(ap, uintmax_t));
+            } else if (mod == 'z') {
+                formatValue(spec, va_arg(ap, size_t));
+            } else if (mod == 't') {
+                formatValue(spec, va_arg(ap, std::make_unsigned<ptrdiff_t>::type));
+            } else {
+                formatValue(spec, va_arg(ap, unsigned));
+            }
+            break;
+        }
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A': {
+            if (mod == 'L') {
+                formatValue(spec, va_arg(ap, long double));
+            } else {
+                formatValue(spec, va_arg(ap, double));
+            }
+            break;
+        }
+        case 'c': {
+            if (mod == 'l') {
+                formatValue(spec, va_arg(ap, wint_t));
+            } else {
+                formatValue(spec, va_arg(ap, int));
+            }
+            break;
+        }
+        case 's': {
+            if (mod == 'l') {
+                formatValue(spec, va_arg(ap, const wchar_t*));
+            } else {
+                formatString(va_arg(ap, const char*), width, prec, leftAlign);
+            }
+            break;
+        }
+        case 'p': {
+            formatValue(spec, va_arg(ap, void*));
+            break;
+        }
+        case 'n': {
+            const int n = count_;
+            if (mod == 'l') {
+                dbl ? (void)(*va_arg(ap, long long*) = n) : (void)(*va_arg(ap, long*) = n);
+            } else if (mod == 'h') {
+                dbl ? (void)(*va_arg(ap, signed char*) = n) : (void)(*va_arg(ap, short*) = n);
+            } else if (mod == 'j') {
+                *va_arg(ap, intmax_t*) = n;
+            } else if (mod == 'z') {
+                *va_arg(ap, std::make_signed<size_t>::type*) = n;
+            } else if (mod == 't') {
+                *va_arg(ap, ptrdiff_t*) = n;
+            } else {
+                *va_arg(ap, int*) = n;
+            }
+            break;
+        }
+        default: {
+            // Unknown conversion, print it as is
+            append(start, fmt - start);
+            break;
+        }
+        }
+        return fmt;
+    }
+
+    template<typename T>
+    void formatValue(const char* spec, T val) {
+        char buf[PRINTF_CONV_BUFFER_SIZE];
+        const int n = snprintf(buf, sizeof(buf), spec, val);
+        if (n < 0) {
+            return;
+        }
+        if ((size_t)n < sizeof(buf)) {
+            append(buf, n);
+            return;
+        }
+        // Rare case, e.g. a large width or a very large floating point number
+        std::unique_ptr<char[]> b(new(std::nothrow) char[n + 1]);
+        if (b) {
+            snprintf(b.get(), n + 1, spec, val);
+            append(b.get(), n);
+        }
+    }
+
+    // Strings are written as is without copying them to a temporary buffer
+    void formatString(const char* str, int width, int prec, bool leftAlign) {
+        if (!str) {
+            str = "(null)";
+        }
+        const size_t len = (prec >= 0) ? strnlen(str, prec) : strlen(str);
+        const size_t pad = (width > 0 && (size_t)width > len) ? width - len : 0;
+        if (!leftAlign) {
+            appendPadding(pad);
+        }
+        append(str, len);
+        if (leftAlign) {
+            appendPadding(pad);
+        }
     }
-    else
-    {
-        char bigger[n+1];
-        n = vsnprintf(bigger, n+1, format, args2);
-        n = print(bigger);
+
+    void appendPadding(size_t n) {
+        static const char spaces[] = "                ";
+        while (n > 0) {
+            const size_t k = std::min(n, sizeof(spaces) - 1);
+            append(spaces, k);
+            n -= k;
+        }
+    }
+
+    void append(const char* data, size_t size) {
+        count_ += size;
+        if (size > sizeof(buf_) - size_) {
+            flush();
+            if (size >= sizeof(buf_)) {
+                write(data, size);
+                return;
+            }
+        }
+        memcpy(buf_ + size_, data, size);
+        size_ += size;
+    }
+
+    void flush() {
+        if (size_ > 0) {
+            write(buf_, size_);
+            size_ = 0;
+        }
+    }
+
+    void write(const char* data, size_t size) {
+        written_ += p_->write((const uint8_t*)data, size);
     }
+};
+
+} // namespace
+
+size_t Print::vprintf(bool newline, const char* format, va_list args)
+{
+    size_t n = PrintfFormatter(this).format(format, args);
     if (newline)
         n += println();
-
-    va_end(args2);
     return n;
 }
 
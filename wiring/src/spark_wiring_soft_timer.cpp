@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_soft_timer.h"
+
+#if PLATFORM_THREADING
+
+#include "spark_wiring_interrupts.h"
+#include "concurrent_hal.h"
+#include "timer_hal.h"
+#include "debug.h"
+
+namespace particle {
+
+namespace {
+
+const size_t SOFT_TIMER_STACK_SIZE = 1024;
+
+} // namespace
+
+/*
+ * Timers can be started and stopped from an ISR, but the time it takes to advance the wheel depends
+ * on the number of timers. Instead of updating the wheel in a critical section, start() and stop()
+ * record the requested state of a timer and put the timer on a list of pending requests, which takes
+ * constant time. The requests are applied to the wheel by the service thread, and the wheel itself
+ * is protected with a mutex.
+ */
+class SoftTimerService {
+public:
+    SoftTimerService() :
+            wheel_(HAL_Timer_Get_Milli_Seconds()),
+            thread_(nullptr),
+            sem_(nullptr),
+            mutex_(nullptr),
+            requests_(nullptr),
+            running_(nullptr) {
+        os_mutex_create(&mutex_);
+        SPARK_ASSERT(mutex_);
+        os_semaphore_create(&sem_, 1 /* max_count */, 0 /* initial_count */);
+        SPARK_ASSERT(sem_);
+        os_thread_create(&thread_, "soft_timer", OS_THREAD_PRIORITY_DEFAULT + 1, run, this, SOFT_TIMER_STACK_SIZE);
+        SPARK_ASSERT(thread_);
+    }
+
+    void start(SoftTimer* timer) {
+        bool wake = false;
+        ATOMIC_BLOCK() {
+            timer->expiry_ = HAL_Timer_Get_Milli_Seconds() + timer->period_;
+            timer->active_ = true;
+            wake = addRequest(timer);
+        }
+        if (wake) {
+            os_semaphore_give(sem_, false);
+        }
+    }
+
+    void stop(SoftTimer* timer) {
+        bool wake = false;
+        ATOMIC_BLOCK() {
+            // An inactive timer without a pending request is not in the wheel
+            if (timer->active_ || timer->pprevRequest_) {
+                timer->active_ = false;
+                wake = addRequest(timer);
+            }
+        }
+        if (wake) {
+            os_semaphore_give(sem_, false);
+        }
+    }
+
+    bool isActive(const SoftTimer* timer) {
+        return timer->active_;
+    }
+
+    void dispose(SoftTimer* timer) {
+        os_mutex_lock(mutex_);
+        ATOMIC_BLOCK() {
+            timer->active_ = false;
+            removeRequest(timer);
+        }
+        wheel_.remove(&timer->entry_);
+        os_mutex_unlock(mutex_);
+        // The callback cannot be waited for from within itself
+        if (os_thread_is_current(thread_)) {
+            return;
+        }
+        for (;;) {
+            bool running = false;
+            ATOMIC_BLOCK() {
+                running = (running_ == timer);
+            }
+            if (!running) {
+                break;
+            }
+            os_thread_yield();
+        }
+    }
+
+    static SoftTimerService* instance() {
+        static SoftTimerService service;
+        return &service;
+    }
+
+private:
+    TimerWheel wheel_;
+    os_thread_t thread_;
+    os_semaphore_t sem_;
+    os_mutex_t mutex_;
+    SoftTimer* requests_; // Timers with pending requests
+    SoftTimer* volatile running_;
+
+    // Returns true if the service thread needs to be woken up
+    bool addRequest(SoftTimer* timer) {
+        if (timer->pprevRequest_) {
+            return false; // The request will be applied using the current state of the timer
+        }
+        const bool wasEmpty = !requests_;
+        timer->nextRequest_ = requests_;
+        if (requests_) {
+            requests_->pprevRequest_ = &timer->nextRequest_;
+        }
+        requests_ = timer;
+        timer->pprevRequest_ = &requests_;
+        return wasEmpty;
+    }
+
+    void removeRequest(SoftTimer* timer) {
+        if (!timer->pprevRequest_) {
+            return;
+        }
+        *timer->pprevRequest_ = timer->nextRequest_;
+        if (timer->nextRequest_) {
+            timer->nextRequest_->pprevRequest_ = timer->pprevRequest_;
+        }
+        timer->nextRequest_ = nullptr;
+        timer->pprevRequest_ = nullptr;
+    }
+
+    // Should be called with the mutex locked
+    void applyRequests() {
+        for (;;) {
+            SoftTimer* timer = nullptr;
+            bool active = false;
+            system_tick_t expiry = 0;
+            ATOMIC_BLOCK() {
+                timer = requests_;
+                if (timer) {
+                    removeRequest(timer);
+                    active = timer->active_;
+                    expiry = timer->expiry_;
+                }
+            }
+            if (!timer) {
+                break;
+            }
+            if (active) {
+                wheel_.add(&timer->entry_, expiry);
+            } else {
+                wheel_.remove(&timer->entry_);
+            }
+        }
+    }
+
+    // Should be called with the mutex locked
+    SoftTimer* popExpired(system_tick_t now) {
+        for (;;) {
+            const auto entry = static_cast<SoftTimer::Entry*>(wheel_.pop(now));
+            if (!entry) {
+                return nullptr;
+            }
+            const auto timer = entry->timer;
+            bool expired = false;
+            system_tick_t period = 0;
+            ATOMIC_BLOCK() {
+                // A timer with a pending request has been stopped or restarted after it was popped
+                if (!timer->pprevRequest_) {
+                    if (timer->oneShot_) {
+                        timer->active_ = false;
+                    }
+                    period = timer->period_;
+                    running_ = timer;
+                    expired = true;
+                }
+            }
+            if (!expired) {
+                continue;
+            }
+            if (!timer->oneShot_) {
+                // Keep the timer in phase unless it has fallen behind by a whole period
+                system_tick_t expiry = entry->expiry + period;
+                if ((int32_t)(expiry - now) <= 0) {
+                    expiry = now + period;
+                }
+                wheel_.add(entry, expiry);
+            }
+            return timer;
+        }
+    }
+
+    void process() {
+        for (;;) {
+            system_tick_t timeout = CONCURRENT_WAIT_FOREVER;
+            os_mutex_lock(mutex_);
+            applyRequests();
+            const system_tick_t now = HAL_Timer_Get_Milli_Seconds();
+            const auto timer = popExpired(now);
+            if (!timer) {
+                system_tick_t t = 0;
+                if (wheel_.nextExpiry(&t)) {
+                    timeout = ((int32_t)(t - now) > 0) ? t - now : 0;
+                }
+            }
+            os_mutex_unlock(mutex_);
+            if (timer) {
+                timer->timeout();
+                ATOMIC_BLOCK() {
+                    running_ = nullptr;
+                }
+            } else {
+                // The semaphore is given if a request is added while the thread is not waiting on it
+                os_semaphore_take(sem_, timeout, false);
+            }
+        }
+    }
+
+    static os_thread_return_t run(void* data) {
+        const auto self = static_cast<SoftTimerService*>(data);
+        self->process();
+        os_thread_exit(nullptr);
+    }
+};
+
+SoftTimer::SoftTimer(unsigned period, timer_callback_fn callback, bool oneShot) :
+        callback_(std::move(callback)),
+        nextRequest_(nullptr),
+        pprevRequest_(nullptr),
+        period_(period),
+        expiry_(0),
+        oneShot_(oneShot),
+        active_(false) {
+    entry_.timer = this;
+    // Make sure the service is initialized before the timer can be started from an ISR
+    SoftTimerService::instance();
+}
+
+SoftTimer::~SoftTimer() {
+    dispose();
+}
+
+bool SoftTimer::start() {
+    SoftTimerService::instance()->start(this);
+    return true;
+}
+
+bool SoftTimer::stop() {
+    SoftTimerService::instance()->stop(this);
+    return true;
+}
+
+bool SoftTimer::changePeriod(unsigned period) {
+    ATOMIC_BLOCK() {
+        period_ = period;
+    }
+    return start();
+}
+
+bool SoftTimer::isActive() const {
+    return SoftTimerService::instance()->isActive(this);
+}
+
+void SoftTimer::dispose() {
+    SoftTimerService::instance()->dispose(this);
+}
+
+} // namespace particle
+
+#endif // PLATFORM_THREADING
@@ -33,6 +33,9 @@
 #include <stdlib.h>
 #include "string_convert.h"
 
+// Minimum capacity of a string buffer growing due to appends
+static const unsigned int STRING_MIN_CAPACITY = 15;
+
 //These are very crude implementations - will refine later
 //------------------------------------------------------------------------------------------
 
@@ -202,6 +205,21 @@ unsigned char String::reserve(unsigned int size)
 	return 0;
 }
 
+// Grows the buffer geometrically so that a sequence of appends results in a logarithmic number
+// of reallocations
+unsigned char String::grow(unsigned int size)
+{
+	if (buffer && capacity >= size) return 1;
+	unsigned int newCapacity = capacity + capacity / 2;
+	if (newCapacity < STRING_MIN_CAPACITY) newCapacity = STRING_MIN_CAPACITY;
+	if (newCapacity < size || newCapacity < capacity /* overflow */) newCapacity = size;
+	if (changeBuffer(newCapacity) || changeBuffer(size)) {
+		if (len == 0) buffer[0] = 0;
+		return 1;
+	}
+	return 0;
+}
+
 unsigned char String::changeBuffer(unsigned int maxStrLen)
 {
 	char *newbuffer = (char *)realloc(buffer, maxStrLen + 1);
@@ -309,9 +327,14 @@ unsigned char String::concat(const char *cstr, unsigned int length)
 	unsigned int newlen = len + length;
 	if (!cstr) return 0;
 	if (length == 0) return 1;
-	if (!reserve(newlen)) return 0;
-	strcpy(buffer + len, cstr);
+	// The source may be a part of this string's own buffer
+	const bool self = buffer && cstr >= buffer && cstr <= buffer + len;
+	const size_t offs = self ? cstr - buffer : 0;
+	if (!grow(newlen)) return 0;
+	if (self) cstr = buffer + offs;
+	memcpy(buffer + len, cstr, length);
 	len = newlen;
+	buffer[len] = 0;
 	return 1;
 }
 
@@ -813,20 +836,11 @@ String::String(const Printable& printable)
 
 String String::format(const char* fmt, ...)
 {
+    String result;
+    StringPrintableHelper help(result);
     va_list marker;
     va_start(marker, fmt);
-    const int bufsize = 5;
-    char test[bufsize];
-    size_t n = vsnprintf(test, bufsize, fmt, marker);
+    help.vprintf(false, fmt, marker);
     va_end(marker);
-
-    String result;
-    result.reserve(n);  // internally adds +1 for null terminator
-    if (result.buffer) {
-        va_start(marker, fmt);
-        n = vsnprintf(result.buffer, n+1, fmt, marker);
-        va_end(marker);
-        result.len = n;
-    }
     return result;
 }
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_string_builder.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace particle {
+
+const size_t StringBuilder::DEFAULT_CHUNK_SIZE;
+const size_t StringBuilder::MAX_CHUNK_SIZE;
+
+StringBuilder::StringBuilder(size_t chunkSize, SimpleAllocator* alloc) :
+        StringBuilder(nullptr, 0, alloc) {
+    if (chunkSize > 0) {
+        nextChunkSize_ = chunkSize;
+        initChunkSize_ = chunkSize;
+    }
+}
+
+StringBuilder::StringBuilder(char* buf, size_t size, SimpleAllocator* alloc) :
+        alloc_(alloc ? alloc : HeapAllocator::instance()),
+        head_(nullptr),
+        tail_(nullptr),
+        buf_(buf),
+        bufSize_(buf ? size : 0),
+        bufUsed_(0),
+        nextChunkSize_(DEFAULT_CHUNK_SIZE),
+        initChunkSize_(DEFAULT_CHUNK_SIZE),
+        len_(0),
+        error_(false) {
+}
+
+StringBuilder::~StringBuilder() {
+    clear();
+}
+
+size_t StringBuilder::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t StringBuilder::write(const uint8_t* data, size_t size) {
+    size_t written = 0;
+    if (bufUsed_ < bufSize_) {
+        const size_t n = std::min(size, bufSize_ - bufUsed_);
+        memcpy(buf_ + bufUsed_, data, n);
+        bufUsed_ += n;
+        written += n;
+    }
+    while (written < size) {
+        if (!tail_ || tail_->used == tail_->size) {
+            if (!addChunk(size - written)) {
+                error_ = true;
+                break;
+            }
+        }
+        const size_t n = std::min(size - written, tail_->size - tail_->used);
+        memcpy(tail_->data() + tail_->used, data + written, n);
+        tail_->used += n;
+        written += n;
+    }
+    len_ += written;
+    return written;
+}
+
+size_t StringBuilder::copyTo(char* buf, size_t size) const {
+    if (size > 0) {
+        size_t offs = 0;
+        forEachPart([&](const char* data, size_t n) {
+            n = std::min(n, size - 1 - offs);
+            memcpy(buf + offs, data, n);
+            offs += n;
+        });
+        buf[offs] = '\0';
+    }
+    return len_;
+}
+
+String StringBuilder::toString() const {
+    String s;
+    if (!s.reserve(len_)) {
+        return s;
+    }
+    forEachPart([&](const char* data, size_t n) {
+        s.concat(data, n);
+    });
+    return s;
+}
+
+void StringBuilder::clear() {
+    Chunk* c = head_;
+    while (c) {
+        Chunk* next = c->next;
+        alloc_->free(c);
+        c = next;
+    }
+    head_ = nullptr;
+    tail_ = nullptr;
+    bufUsed_ = 0;
+    nextChunkSize_ = initChunkSize_;
+    len_ = 0;
+    error_ = false;
+}
+
+bool StringBuilder::addChunk(size_t minSize) {
+    const size_t size = std::max(nextChunkSize_, minSize);
+    const auto c = (Chunk*)alloc_->alloc(sizeof(Chunk) + size);
+    if (!c) {
+        return false;
+    }
+    c->next = nullptr;
+    c->size = size;
+    c->used = 0;
+    if (tail_) {
+        tail_->next = c;
+    } else {
+        head_ = c;
+    }
+    tail_ = c;
+    nextChunkSize_ = std::min(nextChunkSize_ * 2, MAX_CHUNK_SIZE);
+    return true;
+}
+
+template<typename F>
+void StringBuilder::forEachPart(F fn) const {
+    if (bufUsed_ > 0) {
+        fn(buf_, bufUsed_);
+    }
+    for (const Chunk* c = head_; c; c = c->next) {
+        fn(c->data(), c->used);
+    }
+}
+
+} // namespace particle